@@ -0,0 +1,15 @@
+/**
+ * @brief sunxifb的blit和旋转内核自测：逐个与C参考实现（旋转与LVGL的sw_rotate）比对，并打印吞吐
+ *
+ * 板上运行检查NEON内核；主机构建不编译sunxifb，这里单独带上sunxiblit的C内核。
+ */
+#include <stdio.h>
+#include "lv_drivers/display/sunxiblit.h"
+
+int main(void)
+{
+    int errors = sunxiblit_self_test();
+    if (errors != 0)
+        printf("Error: blit kernel self test fail (%d)\n", errors);
+    return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,96 @@
+/**
+ * @brief DRM/KMS上屏测试：整屏刷新DRM_BENCH_FRAMES帧，打印内核上报的上屏时间、帧间隔、丢vblank和翻页延迟
+ *
+ * 只在make USE_DRM=1时编译。没有屏幕时用vkms：modprobe vkms后DRM_CARD=/dev/dri/cardN ./bench/drm_bench_host
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "lvgl/lvgl.h"
+#include "lv_drivers/display/drm.h"
+
+#define DRM_BENCH_FRAMES 300
+#define DRM_BENCH_PRINT_FRAMES 5
+
+int main(void)
+{
+    lv_init();
+    drm_init();
+
+    lv_coord_t width = 0, height = 0;
+    drm_get_sizes(&width, &height, NULL);
+    if (width <= 0 || height <= 0)
+    {
+        printf("Error: DRM init fail (DRM_CARD=%s)\n", getenv("DRM_CARD") ? getenv("DRM_CARD") : DRM_CARD);
+        return 1;
+    }
+
+    // 整屏刷新，每帧只有一次flush，也就是一次翻页
+    uint32_t bufSize = width * height;
+    lv_color_t *buf = (lv_color_t *)malloc(bufSize * sizeof(lv_color_t));
+    if (buf == NULL)
+    {
+        printf("Error: malloc draw buffer fail\n");
+        drm_exit();
+        return 1;
+    }
+
+    static lv_disp_draw_buf_t drawBuf;
+    lv_disp_draw_buf_init(&drawBuf, buf, NULL, bufSize);
+
+    static lv_disp_drv_t dispDrv;
+    lv_disp_drv_init(&dispDrv);
+    dispDrv.draw_buf = &drawBuf;
+    dispDrv.flush_cb = drm_flush;
+    dispDrv.hor_res = width;
+    dispDrv.ver_res = height;
+    dispDrv.full_refresh = 1;
+    lv_disp_t *disp = lv_disp_drv_register(&dispDrv);
+
+    lv_obj_t *box = lv_obj_create(lv_scr_act());
+    lv_obj_set_size(box, height / 4, height / 4);
+
+    uint32_t periodUs = drm_get_refresh_period_us();
+    printf("[DRM] %dx%d, refresh period %u us, %d frames\n", width, height, periodUs, DRM_BENCH_FRAMES);
+
+    drm_present_stats_t stats;
+    uint32_t minInterval = UINT32_MAX, maxInterval = 0;
+    uint64_t sumInterval = 0, sumLatency = 0;
+    uint32_t intervals = 0;
+
+    for (uint32_t i = 0; i < DRM_BENCH_FRAMES; i++)
+    {
+        lv_obj_set_pos(box, (i * 8) % (width - height / 4), height / 3);
+        lv_refr_now(disp);
+
+        // drm_flush等到翻页完成才返回，这里读到的就是这一帧的上屏信息
+        drm_get_present_stats(&stats);
+        if (i < DRM_BENCH_PRINT_FRAMES)
+            printf("[DRM] frame %u: vblank %u present %llu us interval %u us latency %u us\n",
+                   stats.frames, stats.last_sequence, (unsigned long long)stats.last_present_us,
+                   i > 0 ? stats.last_interval_us : 0, stats.last_latency_us);
+
+        sumLatency += stats.last_latency_us;
+        if (i > 0)
+        {
+            if (stats.last_interval_us < minInterval)
+                minInterval = stats.last_interval_us;
+            if (stats.last_interval_us > maxInterval)
+                maxInterval = stats.last_interval_us;
+            sumInterval += stats.last_interval_us;
+            intervals++;
+        }
+    }
+
+    drm_get_present_stats(&stats);
+    printf("[DRM] presented %u/%d frames, missed vblanks %u\n", stats.frames, DRM_BENCH_FRAMES, stats.missed_vblanks);
+    if (intervals > 0)
+        printf("[DRM] interval avg %llu min %u max %u us\n",
+               (unsigned long long)(sumInterval / intervals), minInterval, maxInterval);
+    if (stats.frames > 0)
+        printf("[DRM] flip latency avg %llu max %u us\n",
+               (unsigned long long)(sumLatency / DRM_BENCH_FRAMES), stats.max_latency_us);
+
+    drm_exit();
+    free(buf);
+    return stats.frames == DRM_BENCH_FRAMES ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+/**
+ * @brief S:盘的.bin图片解码基准：对比直接使用映射和逐行读取（打开 + 像绘制一样逐行取出像素 + 关闭）
+ *
+ * 用法：fs_bench [S:<.bin图片> [次数]]，不给图片时在/tmp生成一张480x480的真彩色图片
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "MappedFs.h"
+#include "../utils/Tick/Tick.h"
+
+#define FS_BENCH_IMAGE "/tmp/fs_bench.bin"
+#define FS_BENCH_SIZE 480
+
+/**
+ * @brief 生成一张渐变的真彩色.bin图片
+ */
+static bool makeImage(const char *path)
+{
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL)
+        return false;
+
+    lv_img_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.cf = LV_IMG_CF_TRUE_COLOR;
+    header.w = FS_BENCH_SIZE;
+    header.h = FS_BENCH_SIZE;
+    fwrite(&header, sizeof(header), 1, fp);
+
+    lv_color_t line[FS_BENCH_SIZE];
+    for (int y = 0; y < FS_BENCH_SIZE; y++)
+    {
+        for (int x = 0; x < FS_BENCH_SIZE; x++)
+            line[x] = lv_color_make(x * 255 / FS_BENCH_SIZE, y * 255 / FS_BENCH_SIZE, 128);
+        fwrite(line, sizeof(line), 1, fp);
+    }
+    return fclose(fp) == 0;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *src = argc > 1 ? argv[1] : "S:" FS_BENCH_IMAGE;
+    uint32_t rounds = argc > 2 ? atoi(argv[2]) : 20;
+
+    if (argc <= 1 && !makeImage(FS_BENCH_IMAGE))
+    {
+        printf("[MappedFs] cannot create %s\n", FS_BENCH_IMAGE);
+        return 1;
+    }
+
+    lv_init();
+    MappedFs::Init('S');
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        uint64_t first = 0, total = 0;
+        uint8_t *line = NULL;
+
+        MappedFs::SetZeroCopy(pass == 0);
+        for (uint32_t r = 0; r < rounds; r++)
+        {
+            uint64_t t0 = tick_get_us();
+            lv_img_decoder_dsc_t dsc;
+            if (lv_img_decoder_open(&dsc, src, lv_color_black(), 0) != LV_RES_OK)
+            {
+                printf("[MappedFs] cannot decode %s\n", src);
+                return 1;
+            }
+
+            lv_coord_t w = dsc.header.w;
+            uint32_t stride = w * lv_img_cf_get_px_size(dsc.header.cf) / 8;
+            if (line == NULL)
+                line = (uint8_t *)malloc(w * LV_IMG_PX_SIZE_ALPHA_BYTE);
+            for (lv_coord_t y = 0; line != NULL && y < dsc.header.h; y++)
+            {
+                if (dsc.img_data != NULL)
+                    memcpy(line, dsc.img_data + y * stride, stride);
+                else
+                    lv_img_decoder_read_line(&dsc, 0, y, w, line);
+            }
+            lv_img_decoder_close(&dsc);
+
+            uint64_t us = tick_get_us() - t0;
+            if (r == 0)
+                first = us;
+            total += us;
+        }
+        free(line);
+
+        printf("[MappedFs] %s %s: first %llu us, avg %llu us over %u rounds\n", src,
+               pass == 0 ? "zero-copy" : "read_line", (unsigned long long)first,
+               (unsigned long long)(rounds ? total / rounds : 0), rounds);
+    }
+
+    MappedFs::Stats stats = MappedFs::GetStats();
+    printf("[MappedFs] opens %u (mapped %u, reused %u), zero-copy %u, reads %u\n",
+           stats.opens, stats.mapped, stats.mapReuses, stats.zeroCopy, stats.reads);
+    return 0;
+}
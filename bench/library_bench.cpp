@@ -0,0 +1,193 @@
+/**
+ * @brief 媒体库基准：在临时目录的两个根目录下生成文件，测量全量扫描（无缓存和元数据缓存命中）
+ *        和按文件名查找的耗时，并与原来每次查找都opendir/readdir遍历目录的方式对比
+ *
+ * 用法：library_bench [文件数]，默认10000个，其中十分之一不是视频
+ */
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "MediaLibrary.h"
+#include "../utils/Tick/Tick.h"
+
+/* 等待扫描和探测完成的最长时间 */
+#define LIBRARY_BENCH_TIMEOUT_MS 30000
+
+static const char *extensions[] = {".mp4", ".mkv", ".avi", ".MP4", ".ts", ".mov", ".flv", ".webm", ".3gp", ".txt"};
+
+static std::string fileName(uint32_t i)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "clip_%06u%s", i, extensions[i % 10]);
+    return name;
+}
+
+/**
+ * @brief 扫描一次直到元数据全部就绪，打印耗时和统计
+ */
+static bool scanOnce(const std::vector<std::string> &roots, const char *cachePath, const char *name)
+{
+    MediaLibrary library(roots, cachePath);
+    library.SetProbeCallback([](const std::string &path, MetadataCache::Meta &meta)
+                             {
+        memset(&meta, 0, sizeof(meta));
+        meta.durationMs = 60000;
+        meta.width = 1280;
+        meta.height = 720;
+        return true; });
+
+    uint64_t t0 = tick_get_us();
+    library.StartScan();
+
+    uint64_t readyUs = 0;
+    MediaLibrary::ScanStats stats;
+    for (;;)
+    {
+        stats = library.GetStats();
+        if (readyUs == 0 && library.IsReady())
+            readyUs = tick_get_us() - t0;
+        if (readyUs != 0 && stats.cacheHits + stats.probed >= stats.files)
+            break;
+        if (tick_get_us() - t0 > LIBRARY_BENCH_TIMEOUT_MS * 1000ULL)
+        {
+            printf("[Bench] %s scan timed out\n", name);
+            return false;
+        }
+        usleep(1000);
+    }
+
+    printf("[Bench] scan %-6s: %u files, %u skipped, ready after %llu us (load %u us, scan %u us), "
+           "%u cache hits, %u probed in %u us\n",
+           name, stats.files, stats.skipped, (unsigned long long)readyUs, stats.loadUs, stats.scanUs,
+           stats.cacheHits, stats.probed, stats.probeUs);
+    return true;
+}
+
+/**
+ * @brief 原来的方式：按顺序遍历各根目录，找到同名文件为止
+ */
+static bool findByReaddir(const std::vector<std::string> &roots, const std::string &name, std::string &path)
+{
+    for (auto &root : roots)
+    {
+        DIR *dir = opendir(root.c_str());
+        if (dir == NULL)
+            continue;
+        struct dirent *ent;
+        while ((ent = readdir(dir)) != NULL)
+        {
+            if (name == ent->d_name)
+            {
+                path = root + ent->d_name;
+                closedir(dir);
+                return true;
+            }
+        }
+        closedir(dir);
+    }
+    return false;
+}
+
+/**
+ * @brief 查找已索引的、不存在的文件名，以及用readdir查找，打印平均耗时
+ */
+static void lookup(const std::vector<std::string> &roots, uint32_t files)
+{
+    MediaLibrary library(roots);
+    library.StartScan();
+    while (!library.IsReady())
+        usleep(1000);
+
+    // 文件名先生成好，只计查找本身；命中的只取视频文件名
+    const uint32_t rounds = files * 10;
+    std::vector<std::string> hits, misses;
+    uint32_t seed = 1;
+    for (uint32_t i = 0; i < rounds; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        uint32_t index = (seed >> 8) % files;
+        hits.push_back(fileName(index % 10 == 9 ? index - 1 : index));
+        misses.push_back(fileName(files + i));
+    }
+
+    MediaLibrary::MediaEntry entry;
+    uint32_t found = 0, missFound = 0;
+
+    uint64_t t0 = tick_get_us();
+    for (auto &name : hits)
+        found += library.Lookup(name, entry);
+    uint64_t hitUs = tick_get_us() - t0;
+
+    t0 = tick_get_us();
+    for (auto &name : misses)
+        missFound += library.Lookup(name, entry);
+    uint64_t missUs = tick_get_us() - t0;
+
+    // 逐个遍历目录太慢，只取少量文件名，分布在两个根目录的各个位置
+    const uint32_t scans = 50;
+    uint32_t scanFound = 0;
+    std::string path;
+    t0 = tick_get_us();
+    for (uint32_t i = 0; i < scans; i++)
+        scanFound += findByReaddir(roots, fileName(i * (files / scans)), path);
+    uint64_t scanUs = tick_get_us() - t0;
+
+    printf("[Bench] lookup hit  : %.0f ns avg over %u (%u found)\n", hitUs * 1000.0 / rounds, rounds, found);
+    printf("[Bench] lookup miss : %.0f ns avg over %u (%u found)\n", missUs * 1000.0 / rounds, rounds, missFound);
+    printf("[Bench] readdir find: %.0f us avg over %u (%u found)\n", (double)scanUs / scans, scans, scanFound);
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t files = argc > 1 ? atoi(argv[1]) : 10000;
+    if (files < 100)
+    {
+        printf("usage: %s [files >= 100]\n", argv[0]);
+        return 1;
+    }
+
+    char base[] = "/tmp/library_bench.XXXXXX";
+    if (mkdtemp(base) == NULL)
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    std::vector<std::string> roots = {std::string(base) + "/UDISK/", std::string(base) + "/exUDISK/"};
+    std::string cachePath = std::string(base) + "/media.cache";
+
+    // 前一半在第一个根目录，后一半在第二个
+    uint64_t t0 = tick_get_us();
+    for (auto &root : roots)
+        mkdir(root.c_str(), 0755);
+    for (uint32_t i = 0; i < files; i++)
+    {
+        std::string path = roots[i < files / 2 ? 0 : 1] + fileName(i);
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || write(fd, &i, sizeof(i)) != sizeof(i))
+        {
+            perror(path.c_str());
+            return 1;
+        }
+        close(fd);
+    }
+    printf("[Bench] created %u files in %s in %llu ms\n", files, base,
+           (unsigned long long)(tick_get_us() - t0) / 1000);
+
+    bool ok = scanOnce(roots, NULL, "plain") &&
+              scanOnce(roots, cachePath.c_str(), "cold") &&
+              scanOnce(roots, cachePath.c_str(), "warm");
+    if (ok)
+        lookup(roots, files);
+
+    for (uint32_t i = 0; i < files; i++)
+        unlink((roots[i < files / 2 ? 0 : 1] + fileName(i)).c_str());
+    for (auto &root : roots)
+        rmdir(root.c_str());
+    unlink(cachePath.c_str());
+    rmdir(base);
+    return ok ? 0 : 1;
+}
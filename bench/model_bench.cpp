@@ -0,0 +1,264 @@
+/**
+ * @brief Model命令执行器基准：空闲时的CPU占用，以及命令入队到Model线程开始执行的延迟
+ *
+ * 主机上用host/下的TPlayer桩运行。不启动LVGL线程，CPU占用只包括Model线程、播放器、
+ * 媒体库和缩略图等后台线程。用法：model_bench [每段空闲的秒数 [每种命令的次数]]
+ *
+ * 开机视频不存在时先创建一个（桩不解码，内容任意），结束后删除；视频没有开始播放则返回1。
+ * 最后用同一组时间点对比直接跳转和对齐到关键帧的跳转延迟（MediaPlayer::GetSeekStats）。
+ */
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "Model.h"
+
+/* 空闲测量前后执行的命令设置的音量 */
+#define MODEL_BENCH_VOLUME 20
+/* Model线程启动时打开的视频 */
+#define MODEL_BENCH_VIDEO UDISK_DIR "video/wallpaper4.mp4"
+#define MODEL_BENCH_VIDEO_SIZE 100000
+/* 等待开机视频开始播放的最长时间 */
+#define MODEL_BENCH_START_TIMEOUT_MS 5000
+/* 跳转延迟：跳转的次数，等待第一帧的最长时间，没有设置EMP_STUB_GOP_MS时桩的关键帧间隔 */
+#define MODEL_BENCH_SEEKS 30
+#define MODEL_BENCH_SEEK_TIMEOUT_MS 2000
+#define MODEL_BENCH_GOP_MS 2000
+
+using Page::Model;
+
+static uint64_t processCpuUs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief 开机视频不存在时创建一个
+ * @retval true 新创建了文件，结束时需要删除
+ */
+static bool createStubVideo(void)
+{
+    struct stat st;
+    if (stat(MODEL_BENCH_VIDEO, &st) == 0)
+        return false;
+
+    mkdir(UDISK_DIR, 0755);
+    mkdir(UDISK_DIR "video", 0755);
+    int fd = open(MODEL_BENCH_VIDEO, O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (fd < 0)
+        return false;
+    bool ok = ftruncate(fd, MODEL_BENCH_VIDEO_SIZE) == 0;
+    close(fd);
+    if (!ok)
+    {
+        unlink(MODEL_BENCH_VIDEO);
+        return false;
+    }
+
+    printf("[Bench] created stub video %s\n", MODEL_BENCH_VIDEO);
+    return true;
+}
+
+/**
+ * @brief 等待开机视频开始播放
+ * @retval true 正在播放 / false 超时
+ */
+static bool waitPlaying(const std::function<MediaPlayer::PlaybackSnapshot(void)> &getSnapshot)
+{
+    uint64_t t0 = tick_get_us();
+
+    while (!getSnapshot().playing)
+    {
+        if (tick_get_us() - t0 > MODEL_BENCH_START_TIMEOUT_MS * 1000ULL)
+            return false;
+        usleep(10000);
+    }
+    printf("[Bench] playback started after %llu ms\n", (unsigned long long)((tick_get_us() - t0) / 1000));
+    return true;
+}
+
+/**
+ * @brief 跳转并等到跳转后的第一帧
+ * @retval true 成功 / false 超时
+ */
+static bool seekAndWait(MediaPlayer *mp, int posMs, bool snapped)
+{
+    int i = snapped ? 1 : 0;
+    uint32_t count = mp->GetSeekStats().count[i];
+    uint64_t t0 = tick_get_us();
+
+    mp->SetCurrentPos(posMs, snapped);
+    while (mp->GetSeekStats().count[i] == count)
+    {
+        if (tick_get_us() - t0 > MODEL_BENCH_SEEK_TIMEOUT_MS * 1000ULL)
+            return false;
+        usleep(1000);
+    }
+    return true;
+}
+
+/**
+ * @brief 同一组时间点分别直接跳转和对齐到关键帧后跳转，打印跳转 -> 第一帧的平均和最大延迟
+ *
+ * 桩文件不是MP4，KeyframeIndex解析不出关键帧，按桩的关键帧间隔（EMP_STUB_GOP_MS）对齐
+ * @retval true 成功 / false 没有播放或跳转超时
+ */
+static bool measureSeeks(uint32_t rounds)
+{
+    const char *gopEnv = getenv("EMP_STUB_GOP_MS");
+    int gopMs = gopEnv != NULL ? atoi(gopEnv) : MODEL_BENCH_GOP_MS;
+    bool ok = true;
+
+    MediaPlayer *mp = new MediaPlayer();
+    mp->OpenAsync(MODEL_BENCH_VIDEO);
+    if (!waitPlaying([mp]() { return mp->GetSnapshot(); }))
+    {
+        printf("Error: seek player did not start playing\n");
+        delete mp;
+        return false;
+    }
+
+    int rangeMs = mp->GetSnapshot().durationMs - gopMs;
+    uint32_t seed = 1;
+    for (uint32_t i = 0; i < rounds && ok && rangeMs > 0; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        int posMs = (seed >> 8) % rangeMs;
+        int snappedMs = gopMs > 0 ? posMs - posMs % gopMs : posMs;
+
+        ok = seekAndWait(mp, posMs, false) && seekAndWait(mp, snappedMs, true);
+    }
+
+    MediaPlayer::SeekStats stats = mp->GetSeekStats();
+    delete mp;
+
+    static const char *names[] = {"unsnapped", "snapped"};
+    for (int i = 0; i < 2; i++)
+        printf("[Bench] seek %-9s x%u: first frame avg %llu us, max %u us\n", names[i], stats.count[i],
+               stats.count[i] ? (unsigned long long)(stats.totalUs[i] / stats.count[i]) : 0ULL, stats.maxUs[i]);
+    if (!ok)
+        printf("Error: no first frame within %d ms after a seek\n", MODEL_BENCH_SEEK_TIMEOUT_MS);
+    return ok;
+}
+
+/**
+ * @brief 入队一条命令并等它开始执行，返回这条命令的统计
+ */
+static Model::CommandStats runCommand(Model *model, Model::Command::Type type, int value)
+{
+    uint32_t count = model->getCommandStats().count;
+
+    model->pushCommand(type, value);
+    for (;;)
+    {
+        Model::CommandStats stats = model->getCommandStats();
+        if (stats.count != count)
+            return stats;
+        usleep(100);
+    }
+}
+
+/**
+ * @brief 空闲seconds秒，打印进程和Model线程的CPU占用
+ */
+static void measureIdle(Model *model, const char *name, uint32_t seconds)
+{
+    // 前后各执行一条不改变状态的命令，取Model线程执行命令时记录的CPU时间
+    uint64_t threadCpu = runCommand(model, Model::Command::CMD_SET_VOLUME, MODEL_BENCH_VOLUME).threadCpuUs;
+    uint64_t cpu = processCpuUs();
+    uint64_t t0 = tick_get_us();
+
+    sleep(seconds);
+
+    uint64_t wallUs = tick_get_us() - t0;
+    cpu = processCpuUs() - cpu;
+    threadCpu = runCommand(model, Model::Command::CMD_SET_VOLUME, MODEL_BENCH_VOLUME).threadCpuUs - threadCpu;
+    printf("[Bench] idle %-7s: process %.2f%% (%llu us), model thread %llu us over %.1f s\n", name,
+           100.0 * cpu / wallUs, (unsigned long long)cpu, (unsigned long long)threadCpu, wallUs / 1e6);
+}
+
+/**
+ * @brief 逐条执行rounds次命令，打印入队到开始执行的延迟分布
+ */
+static void measureLatency(Model *model, const char *name, Model::Command::Type type,
+                           int value0, int value1, uint32_t rounds)
+{
+    std::vector<uint32_t> latency;
+
+    for (uint32_t i = 0; i < rounds; i++)
+    {
+        Model::Command::Type t = type;
+        // 暂停和播放交替
+        if (type == Model::Command::CMD_PAUSE && (i & 1))
+            t = Model::Command::CMD_PLAY;
+        latency.push_back(runCommand(model, t, (i & 1) ? value1 : value0).lastLatencyUs);
+        usleep(2000);
+    }
+
+    std::sort(latency.begin(), latency.end());
+    uint64_t total = 0;
+    for (uint32_t us : latency)
+        total += us;
+    printf("[Bench] %-7s x%u: avg %llu us, p50 %u us, p99 %u us, max %u us\n", name, rounds,
+           (unsigned long long)(total / rounds), latency[rounds / 2], latency[rounds * 99 / 100],
+           latency.back());
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t seconds = argc > 1 ? atoi(argv[1]) : 2;
+    uint32_t rounds = argc > 2 ? atoi(argv[2]) : 200;
+    if (seconds == 0 || rounds == 0)
+    {
+        printf("usage: %s [idle seconds [commands per type]]\n", argv[0]);
+        return 1;
+    }
+
+    bool stubVideo = createStubVideo();
+
+    HAL::Init();
+    Model *model = new Model([]() {}, lv_mutex);
+
+    // 等开机的视频开始播放，没有播放时测到的“播放中”空闲没有意义
+    int ret = 0;
+    if (!waitPlaying([model]() { return model->getSnapshot(); }))
+    {
+        printf("Error: %s did not start playing within %d ms\n", MODEL_BENCH_VIDEO, MODEL_BENCH_START_TIMEOUT_MS);
+        ret = 1;
+        goto exit;
+    }
+    // 再等媒体库扫描完成
+    sleep(1);
+
+    measureIdle(model, "playing", seconds);
+    if (!model->getSnapshot().playing)
+    {
+        printf("Error: playback stopped during the idle measurement\n");
+        ret = 1;
+        goto exit;
+    }
+    runCommand(model, Model::Command::CMD_PAUSE, 0);
+    measureIdle(model, "paused", seconds);
+
+    measureLatency(model, "volume", Model::Command::CMD_SET_VOLUME, 10, 20, rounds);
+    measureLatency(model, "seek", Model::Command::CMD_SEEK, 10, 20, rounds);
+    measureLatency(model, "pause", Model::Command::CMD_PAUSE, 0, 0, rounds);
+
+    {
+        Model::CommandStats stats = model->getCommandStats();
+        printf("[Bench] %u commands, %u wakeups, max latency %u us\n", stats.count, stats.wakeups, stats.maxLatencyUs);
+    }
+
+exit:
+    delete model;
+    // 不经过Model，单独用一个播放器对比跳转延迟
+    if (ret == 0 && !measureSeeks(MODEL_BENCH_SEEKS))
+        ret = 1;
+    HAL::Deinit();
+    if (stubVideo)
+        unlink(MODEL_BENCH_VIDEO);
+    return ret;
+}
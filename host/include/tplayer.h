@@ -0,0 +1,136 @@
+#ifndef _HOST_TPLAYER_H_
+#define _HOST_TPLAYER_H_
+
+/**
+ * @brief 主机（x86）构建用的TPlayer桩，只包含本项目用到的接口，声明与Tina SDK的tplayer.h一致
+ *
+ * 不解码：按单调时钟模拟播放进度，并在内部线程里像CedarX一样发出准备完成、跳转完成、
+ * 播放结束和视频帧（渐变的NV21画面）等通知。时长和准备耗时可用环境变量调整：
+ *   EMP_STUB_DURATION_MS  视频时长，默认60000
+ *   EMP_STUB_PREPARE_MS   准备耗时，默认30
+ *   EMP_STUB_FPS          播放时视频帧通知的帧率，默认25，0为不发
+ *   EMP_STUB_GOP_MS       关键帧间隔，默认2000，关键帧在它的整数倍处
+ *   EMP_STUB_DECODE_US    跳转时从前一个关键帧解码到目标点，每帧的耗时，默认4000
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct TPlayerContext TPlayer;
+
+typedef enum PlayerType
+{
+    CEDARX_PLAYER = 0,
+    AUDIO_PLAYER,
+} PlayerType;
+
+enum TPlayerNotifyMsg
+{
+    TPLAYER_NOTIFY_PREPARED = 0,
+    TPLAYER_NOTIFY_PLAYBACK_COMPLETE,
+    TPLAYER_NOTIFY_SEEK_COMPLETE,
+    TPLAYER_NOTIFY_MEDIA_ERROR,
+    TPLAYER_NOTIFY_NOT_SEEKABLE,
+    TPLAYER_NOTIFY_BUFFER_START,
+    TPLAYER_NOTIFY_BUFFER_END,
+    TPLAYER_NOTIFY_DOWNLOAD_START,
+    TPLAYER_NOTIFY_DOWNLOAD_END,
+    TPLAYER_NOTIFY_DOWNLOAD_ERROR,
+    TPLAYER_NOTIFY_AUDIO_FRAME,
+    TPLAYER_NOTIFY_VIDEO_FRAME,
+    TPLAYER_NOTIFY_SUBTITLE_FRAME,
+    TPLAYER_NOTYFY_DECODED_VIDEO_SIZE,
+};
+
+enum TPlayerMediaError
+{
+    TPLAYER_MEDIA_ERROR_UNKNOWN = 1,
+    TPLAYER_MEDIA_ERROR_OUT_OF_MEMORY,
+    TPLAYER_MEDIA_ERROR_IO,
+    TPLAYER_MEDIA_ERROR_UNSUPPORTED,
+};
+
+typedef enum TplayerPlaySpeedType
+{
+    PLAY_SPEED_FAST_FORWARD_16 = 0,
+    PLAY_SPEED_FAST_FORWARD_8 = 1,
+    PLAY_SPEED_FAST_FORWARD_4 = 2,
+    PLAY_SPEED_FAST_FORWARD_2 = 3,
+    PLAY_SPEED_1 = 4,
+    PLAY_SPEED_FAST_BACKWARD_2 = 5,
+    PLAY_SPEED_FAST_BACKWARD_4 = 6,
+    PLAY_SPEED_FAST_BACKWARD_8 = 7,
+    PLAY_SPEED_FAST_BACKWARD_16 = 8,
+} TplayerPlaySpeedType;
+
+typedef enum TplayerVideoRotateType
+{
+    TPLAYER_VIDEO_ROTATE_DEGREE_0 = 0,
+    TPLAYER_VIDEO_ROTATE_DEGREE_90 = 1,
+    TPLAYER_VIDEO_ROTATE_DEGREE_180 = 2,
+    TPLAYER_VIDEO_ROTATE_DEGREE_270 = 3,
+} TplayerVideoRotateType;
+
+typedef struct VideoStreamInfo
+{
+    int eCodecFormat;
+    int nWidth;
+    int nHeight;
+    int nFrameRate;
+} VideoStreamInfo;
+
+typedef struct MediaInfo
+{
+    int64_t nFileSize;
+    int nDurationMs;
+    int nVideoStreamNum;
+    VideoStreamInfo *pVideoStreamInfo;
+} MediaInfo;
+
+typedef struct VideoPicData
+{
+    char *pData0; // Y
+    char *pData1; // VU（NV21）
+    char *pData2;
+    int nPts;
+    int nWidth;
+    int nHeight;
+    int nLineStride;
+} VideoPicData;
+
+typedef int (*TPlayerNotifyCallback)(void *pUser, int msg, int ext1, void *para);
+
+TPlayer *TPlayerCreate(PlayerType type);
+int TPlayerDestroy(TPlayer *p);
+int TPlayerSetDebugFlag(TPlayer *p, bool debugFlag);
+int TPlayerSetNotifyCallback(TPlayer *p, TPlayerNotifyCallback notifier, void *pUserData);
+int TPlayerSetDataSource(TPlayer *p, const char *pUrl, void *pHeaders);
+int TPlayerPrepare(TPlayer *p);
+int TPlayerPrepareAsync(TPlayer *p);
+int TPlayerStart(TPlayer *p);
+int TPlayerPause(TPlayer *p);
+int TPlayerStop(TPlayer *p);
+int TPlayerReset(TPlayer *p);
+int TPlayerSeekTo(TPlayer *p, int nSeekTimeMs);
+bool TPlayerIsPlaying(TPlayer *p);
+int TPlayerGetCurrentPosition(TPlayer *p, int *msec);
+int TPlayerGetDuration(TPlayer *p, int *msec);
+MediaInfo *TPlayerGetMediaInfo(TPlayer *p);
+int TPlayerSetLooping(TPlayer *p, bool bLoop);
+int TPlayerSetRotate(TPlayer *p, TplayerVideoRotateType rotateDegree);
+int TPlayerSetSpeed(TPlayer *p, TplayerPlaySpeedType nSpeed);
+int TPlayerSetHoldLastPicture(TPlayer *p, bool bHold);
+int TPlayerSetVolume(TPlayer *p, int volume);
+int TPlayerGetVolume(TPlayer *p);
+int TPlayerSetDisplayRect(TPlayer *p, int x, int y, unsigned int width, unsigned int height);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,495 @@
+#include "tplayer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+/* 桩画面的大小 */
+#define STUB_FRAME_W 318
+#define STUB_FRAME_H 180
+/* 像CedarX一样每行补齐到32字节，补齐部分填0xff */
+#define STUB_FRAME_STRIDE ((STUB_FRAME_W + 31) & ~31)
+/* 跳转到关键帧时的耗时 */
+#define STUB_SEEK_US 20000
+
+struct TPlayerContext
+{
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool exit;
+
+    TPlayerNotifyCallback notifier;
+    void *userData;
+
+    char url[512];
+    bool prepared;
+    bool playing;
+    bool loop;
+    int volume;
+    TplayerPlaySpeedType speed;
+    int durationMs;
+    int posMs;         // anchorUs时的播放时间点
+    uint64_t anchorUs; // 最近一次改变播放状态的时间
+
+    uint64_t prepareDueUs; // 异步准备完成的时间，0为没有
+    uint64_t seekDueUs;    // 跳转完成的时间，0为没有
+    uint64_t frameDueUs;   // 下一个视频帧通知的时间
+    bool sizeSent;         // 已发出解码尺寸通知
+
+    MediaInfo info;
+    VideoStreamInfo stream;
+    uint8_t frame[STUB_FRAME_STRIDE * STUB_FRAME_H * 3 / 2];
+};
+
+static uint64_t nowUs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int envInt(const char *name, int def)
+{
+    const char *value = getenv(name);
+    return value != NULL ? atoi(value) : def;
+}
+
+/**
+ * @brief 当前播放时间点，调用时持有mutex
+ */
+static int currentPos(TPlayer *p, uint64_t now)
+{
+    static const int speedFactor[] = {16, 8, 4, 2, 1, -2, -4, -8, -16};
+
+    if (!p->playing)
+        return p->posMs;
+
+    int64_t pos = p->posMs + (int64_t)(now - p->anchorUs) * speedFactor[p->speed] / 1000;
+    if (pos < 0)
+        pos = 0;
+    if (pos > p->durationMs)
+        pos = p->durationMs;
+
+    return (int)pos;
+}
+
+/**
+ * @brief 把播放进度固定到当前时刻，调用时持有mutex
+ */
+static void anchor(TPlayer *p)
+{
+    uint64_t now = nowUs();
+
+    p->posMs = currentPos(p, now);
+    p->anchorUs = now;
+}
+
+/**
+ * @brief 生成一帧随播放时间移动的渐变画面（NV21）
+ */
+static void fillFrame(TPlayer *p, int posMs)
+{
+    uint8_t shift = (uint8_t)(posMs / 40);
+
+    memset(p->frame, 0xff, sizeof(p->frame));
+    for (int y = 0; y < STUB_FRAME_H; y++)
+    {
+        for (int x = 0; x < STUB_FRAME_W; x++)
+            p->frame[y * STUB_FRAME_STRIDE + x] = (uint8_t)(x + y + shift);
+        if (y < STUB_FRAME_H / 2)
+            memset(p->frame + STUB_FRAME_STRIDE * (STUB_FRAME_H + y), 128, STUB_FRAME_W);
+    }
+}
+
+static void notify(TPlayer *p, int msg, int ext1, void *para)
+{
+    if (p->notifier != NULL)
+        p->notifier(p->userData, msg, ext1, para);
+}
+
+/**
+ * @brief 模拟解码器线程：到时间就发出通知，通知在不持锁时发出（回调里可以再调用接口）
+ */
+static void *stubThread(void *arg)
+{
+    TPlayer *p = (TPlayer *)arg;
+    const int fps = envInt("EMP_STUB_FPS", 25);
+
+    pthread_mutex_lock(&p->mutex);
+    while (!p->exit)
+    {
+        uint64_t now = nowUs();
+        uint64_t due = now + 1000000;
+
+        if (p->prepareDueUs != 0 && now >= p->prepareDueUs)
+        {
+            p->prepareDueUs = 0;
+            p->prepared = true;
+            pthread_mutex_unlock(&p->mutex);
+            notify(p, TPLAYER_NOTIFY_PREPARED, 0, NULL);
+            pthread_mutex_lock(&p->mutex);
+            continue;
+        }
+        if (p->seekDueUs != 0 && now >= p->seekDueUs)
+        {
+            p->seekDueUs = 0;
+            p->frameDueUs = now;
+            pthread_mutex_unlock(&p->mutex);
+            notify(p, TPLAYER_NOTIFY_SEEK_COMPLETE, 0, NULL);
+            pthread_mutex_lock(&p->mutex);
+            continue;
+        }
+
+        if (p->playing)
+        {
+            int pos = currentPos(p, now);
+            if (pos >= p->durationMs)
+            {
+                p->posMs = p->loop ? 0 : p->durationMs;
+                p->anchorUs = now;
+                if (!p->loop)
+                {
+                    p->playing = false;
+                    pthread_mutex_unlock(&p->mutex);
+                    notify(p, TPLAYER_NOTIFY_PLAYBACK_COMPLETE, 0, NULL);
+                    pthread_mutex_lock(&p->mutex);
+                    continue;
+                }
+            }
+
+            if (!p->sizeSent)
+            {
+                int size[2] = {p->stream.nWidth, p->stream.nHeight};
+                p->sizeSent = true;
+                pthread_mutex_unlock(&p->mutex);
+                notify(p, TPLAYER_NOTYFY_DECODED_VIDEO_SIZE, 0, size);
+                pthread_mutex_lock(&p->mutex);
+                continue;
+            }
+
+            // 跳转完成前解码器在丢弃关键帧到目标点之间的帧，不出画面
+            if (fps > 0 && p->seekDueUs == 0 && now >= p->frameDueUs)
+            {
+                VideoPicData pic = {0};
+                fillFrame(p, pos);
+                pic.pData0 = (char *)p->frame;
+                pic.pData1 = (char *)p->frame + STUB_FRAME_STRIDE * STUB_FRAME_H;
+                pic.nPts = pos;
+                pic.nWidth = STUB_FRAME_W;
+                pic.nHeight = STUB_FRAME_H;
+                pic.nLineStride = STUB_FRAME_STRIDE;
+                p->frameDueUs = now + 1000000 / fps;
+                pthread_mutex_unlock(&p->mutex);
+                notify(p, TPLAYER_NOTIFY_VIDEO_FRAME, 0, &pic);
+                pthread_mutex_lock(&p->mutex);
+                continue;
+            }
+
+            if (fps > 0 && p->seekDueUs == 0 && p->frameDueUs < due)
+                due = p->frameDueUs;
+        }
+
+        if (p->prepareDueUs != 0 && p->prepareDueUs < due)
+            due = p->prepareDueUs;
+        if (p->seekDueUs != 0 && p->seekDueUs < due)
+            due = p->seekDueUs;
+
+        // 条件变量使用CLOCK_MONOTONIC，见TPlayerCreate
+        struct timespec ts;
+        ts.tv_sec = due / 1000000;
+        ts.tv_nsec = (due % 1000000) * 1000;
+        pthread_cond_timedwait(&p->cond, &p->mutex, &ts);
+    }
+    pthread_mutex_unlock(&p->mutex);
+
+    return NULL;
+}
+
+/**
+ * @brief 修改状态后唤醒模拟线程重新计算下一个通知的时间
+ */
+static void kick(TPlayer *p)
+{
+    pthread_cond_signal(&p->cond);
+    pthread_mutex_unlock(&p->mutex);
+}
+
+TPlayer *TPlayerCreate(PlayerType type)
+{
+    TPlayer *p = (TPlayer *)calloc(1, sizeof(TPlayer));
+    if (p == NULL)
+        return NULL;
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&p->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&p->mutex, NULL);
+
+    p->volume = 20;
+    p->speed = PLAY_SPEED_1;
+    p->stream.nWidth = 1280;
+    p->stream.nHeight = 720;
+    p->stream.nFrameRate = 25000;
+
+    if (pthread_create(&p->thread, NULL, stubThread, p) != 0)
+    {
+        pthread_cond_destroy(&p->cond);
+        pthread_mutex_destroy(&p->mutex);
+        free(p);
+        return NULL;
+    }
+
+    return p;
+}
+
+int TPlayerDestroy(TPlayer *p)
+{
+    pthread_mutex_lock(&p->mutex);
+    p->exit = true;
+    kick(p);
+    pthread_join(p->thread, NULL);
+
+    pthread_cond_destroy(&p->cond);
+    pthread_mutex_destroy(&p->mutex);
+    free(p);
+
+    return 0;
+}
+
+int TPlayerSetDebugFlag(TPlayer *p, bool debugFlag)
+{
+    return 0;
+}
+
+int TPlayerSetNotifyCallback(TPlayer *p, TPlayerNotifyCallback notifier, void *pUserData)
+{
+    pthread_mutex_lock(&p->mutex);
+    p->notifier = notifier;
+    p->userData = pUserData;
+    pthread_mutex_unlock(&p->mutex);
+
+    return 0;
+}
+
+int TPlayerSetDataSource(TPlayer *p, const char *pUrl, void *pHeaders)
+{
+    struct stat st;
+
+    if (stat(pUrl, &st) != 0)
+        return -1;
+
+    pthread_mutex_lock(&p->mutex);
+    snprintf(p->url, sizeof(p->url), "%s", pUrl);
+    p->info.nFileSize = st.st_size;
+    pthread_mutex_unlock(&p->mutex);
+
+    return 0;
+}
+
+/**
+ * @brief 准备完成后的媒体信息，调用时持有mutex
+ */
+static void setPrepared(TPlayer *p)
+{
+    p->durationMs = envInt("EMP_STUB_DURATION_MS", 60000);
+    p->info.nDurationMs = p->durationMs;
+    p->info.nVideoStreamNum = 1;
+    p->info.pVideoStreamInfo = &p->stream;
+}
+
+int TPlayerPrepare(TPlayer *p)
+{
+    if (p->url[0] == '\0')
+        return -1;
+
+    usleep(envInt("EMP_STUB_PREPARE_MS", 30) * 1000);
+
+    pthread_mutex_lock(&p->mutex);
+    setPrepared(p);
+    p->prepared = true;
+    pthread_mutex_unlock(&p->mutex);
+
+    return 0;
+}
+
+int TPlayerPrepareAsync(TPlayer *p)
+{
+    if (p->url[0] == '\0')
+        return -1;
+
+    pthread_mutex_lock(&p->mutex);
+    setPrepared(p);
+    p->prepareDueUs = nowUs() + envInt("EMP_STUB_PREPARE_MS", 30) * 1000 + 1;
+    kick(p);
+
+    return 0;
+}
+
+int TPlayerStart(TPlayer *p)
+{
+    pthread_mutex_lock(&p->mutex);
+    if (!p->prepared)
+    {
+        pthread_mutex_unlock(&p->mutex);
+        return -1;
+    }
+    anchor(p);
+    if (p->posMs >= p->durationMs)
+        p->posMs = 0;
+    p->playing = true;
+    p->frameDueUs = p->anchorUs;
+    kick(p);
+
+    return 0;
+}
+
+int TPlayerPause(TPlayer *p)
+{
+    pthread_mutex_lock(&p->mutex);
+    anchor(p);
+    p->playing = false;
+    kick(p);
+
+    return 0;
+}
+
+int TPlayerStop(TPlayer *p)
+{
+    return TPlayerPause(p);
+}
+
+int TPlayerReset(TPlayer *p)
+{
+    pthread_mutex_lock(&p->mutex);
+    p->url[0] = '\0';
+    p->prepared = false;
+    p->playing = false;
+    p->sizeSent = false;
+    p->posMs = 0;
+    p->durationMs = 0;
+    p->speed = PLAY_SPEED_1;
+    p->prepareDueUs = 0;
+    p->seekDueUs = 0;
+    memset(&p->info, 0, sizeof(p->info));
+    kick(p);
+
+    return 0;
+}
+
+int TPlayerSeekTo(TPlayer *p, int nSeekTimeMs)
+{
+    pthread_mutex_lock(&p->mutex);
+    if (!p->prepared)
+    {
+        pthread_mutex_unlock(&p->mutex);
+        return -1;
+    }
+    p->posMs = nSeekTimeMs < 0 ? 0 : (nSeekTimeMs > p->durationMs ? p->durationMs : nSeekTimeMs);
+    p->anchorUs = nowUs();
+
+    // 像CedarX一样从前一个关键帧开始解码，目标点前的帧解码后丢弃
+    int gopMs = envInt("EMP_STUB_GOP_MS", 2000);
+    int fps = envInt("EMP_STUB_FPS", 25);
+    int skipFrames = gopMs > 0 ? (p->posMs % gopMs) * (fps > 0 ? fps : 25) / 1000 : 0;
+    p->seekDueUs = p->anchorUs + STUB_SEEK_US + (uint64_t)skipFrames * envInt("EMP_STUB_DECODE_US", 4000);
+    kick(p);
+
+    return 0;
+}
+
+bool TPlayerIsPlaying(TPlayer *p)
+{
+    pthread_mutex_lock(&p->mutex);
+    bool playing = p->playing;
+    pthread_mutex_unlock(&p->mutex);
+
+    return playing;
+}
+
+int TPlayerGetCurrentPosition(TPlayer *p, int *msec)
+{
+    pthread_mutex_lock(&p->mutex);
+    *msec = currentPos(p, nowUs());
+    pthread_mutex_unlock(&p->mutex);
+
+    return 0;
+}
+
+int TPlayerGetDuration(TPlayer *p, int *msec)
+{
+    pthread_mutex_lock(&p->mutex);
+    *msec = p->durationMs;
+    pthread_mutex_unlock(&p->mutex);
+
+    return 0;
+}
+
+MediaInfo *TPlayerGetMediaInfo(TPlayer *p)
+{
+    pthread_mutex_lock(&p->mutex);
+    MediaInfo *info = p->prepared ? &p->info : NULL;
+    pthread_mutex_unlock(&p->mutex);
+
+    return info;
+}
+
+int TPlayerSetLooping(TPlayer *p, bool bLoop)
+{
+    pthread_mutex_lock(&p->mutex);
+    p->loop = bLoop;
+    pthread_mutex_unlock(&p->mutex);
+
+    return 0;
+}
+
+int TPlayerSetRotate(TPlayer *p, TplayerVideoRotateType rotateDegree)
+{
+    return 0;
+}
+
+int TPlayerSetSpeed(TPlayer *p, TplayerPlaySpeedType nSpeed)
+{
+    if (nSpeed < PLAY_SPEED_FAST_FORWARD_16 || nSpeed > PLAY_SPEED_FAST_BACKWARD_16)
+        return -1;
+
+    pthread_mutex_lock(&p->mutex);
+    anchor(p);
+    p->speed = nSpeed;
+    kick(p);
+
+    return 0;
+}
+
+int TPlayerSetHoldLastPicture(TPlayer *p, bool bHold)
+{
+    return 0;
+}
+
+int TPlayerSetVolume(TPlayer *p, int volume)
+{
+    pthread_mutex_lock(&p->mutex);
+    p->volume = volume;
+    pthread_mutex_unlock(&p->mutex);
+
+    return 0;
+}
+
+int TPlayerGetVolume(TPlayer *p)
+{
+    pthread_mutex_lock(&p->mutex);
+    int volume = p->volume;
+    pthread_mutex_unlock(&p->mutex);
+
+    return volume;
+}
+
+int TPlayerSetDisplayRect(TPlayer *p, int x, int y, unsigned int width, unsigned int height)
+{
+    return 0;
+}
@@ -0,0 +1,92 @@
+#ifndef _DISPLAYFLUSHER_H_
+#define _DISPLAYFLUSHER_H_
+
+#include <stdint.h>
+#include <pthread.h>
+#include <atomic>
+#include "../libs/lvgl/lvgl.h"
+#include "../utils/SpscRing/SpscRing.h"
+#include "../utils/SeqLock/SeqLock.h"
+
+/* 待刷新区域队列长度（LVGL同一时刻最多只有一个区域在刷新，留一点余量） */
+#define DISPLAYFLUSHER_QUEUE_LEN 4
+
+/**
+ * @brief 显示刷新器：接管LVGL显示驱动的flush回调，统计每帧的渲染和刷新耗时
+ *
+ * 线程模式下（两个部分大小的绘制缓冲），flush回调只把渲染好的区域放进队列就返回，
+ * 由专门的刷新线程调用底层flush函数拷贝到framebuffer并通知lv_disp_flush_ready，
+ * LVGL线程同时渲染下一个区域；非线程模式下在LVGL线程里直接刷新，只做统计。
+ */
+class DisplayFlusher
+{
+public:
+    using FlushCb = void (*)(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_p);
+    using RenderStartCb = void (*)(lv_disp_drv_t *drv);
+
+    struct Stats
+    {
+        uint32_t frames;        // 已刷新的帧数
+        uint32_t areas;         // 已刷新的区域数
+        uint32_t lastFrameUs;   // 最近一帧：开始渲染 -> 最后一个区域刷新完
+        uint32_t lastRenderUs;  // 最近一帧LVGL线程的渲染耗时（不含等待缓冲的时间）
+        uint32_t lastFlushUs;   // 最近一帧拷贝到framebuffer的耗时
+        uint32_t lastWaitUs;    // 最近一帧LVGL线程等待空闲缓冲的时间
+        uint64_t totalFrameUs;  // 以下为累计值，除以frames得平均值
+        uint64_t totalRenderUs;
+        uint64_t totalFlushUs;
+        uint64_t totalWaitUs;
+    };
+
+private:
+    struct Job
+    {
+        lv_disp_drv_t *drv;
+        lv_area_t area;
+        lv_color_t *color_p;
+        bool last;             // 是否是本帧最后一个区域
+        uint64_t frameStartUs; // 以下只在last为true时有效
+        uint32_t renderUs;
+        uint32_t waitUs;
+    };
+
+    FlushCb _flushCb;       // 底层flush函数，结束时必须调用lv_disp_flush_ready
+    RenderStartCb _renderStartCb; // 每帧开始渲染时在LVGL线程调用，可为空
+    bool _threaded;         // 是否使用刷新线程
+    pthread_t _pthread;     // 刷新线程
+    pthread_mutex_t _mutex; // 配合两个条件变量使用
+    pthread_cond_t _jobCond;  // 有新区域
+    pthread_cond_t _doneCond; // 一个区域刷新完成
+    std::atomic<bool> _stop;  // 通知线程退出
+    bool _threadRunning;      // 线程是否已创建
+    SpscRing<Job, DISPLAYFLUSHER_QUEUE_LEN> _jobs; // LVGL线程 -> 刷新线程
+
+    /* 以下只在LVGL线程访问 */
+    uint64_t _frameStartUs; // 本帧开始渲染的时间
+    uint64_t _segStartUs;   // 本段渲染开始的时间（开始渲染、flush返回或等待结束）
+    uint32_t _renderUs;     // 本帧累计渲染时间
+    uint32_t _waitUs;       // 本帧累计等待时间
+
+    /* 以下只在执行刷新的线程访问 */
+    uint32_t _flushUs; // 本帧累计刷新时间
+    Stats _work;       // 统计的工作副本
+    SeqLock<Stats> _stats; // 发布给其他线程的统计
+
+    static void *threadProcHandler(void *arg);
+    static void flushHandler(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_p);
+    static void waitHandler(lv_disp_drv_t *drv);
+    static void renderStartHandler(lv_disp_drv_t *drv);
+    void doFlush(const Job &job);
+
+public:
+    DisplayFlusher(FlushCb flushCb, bool threaded);
+    ~DisplayFlusher();
+
+    void Attach(lv_disp_drv_t *drv);
+    void SetRenderStartCb(RenderStartCb cb) { _renderStartCb = cb; }
+    void Stop(void);
+    Stats GetStats(void) const { return _stats.Read(); }
+    bool IsThreaded(void) const { return _threaded; }
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef _FRAMESOURCE_H_
+#define _FRAMESOURCE_H_
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <stdint.h>
+
+/**
+ * @brief 一帧画面，只在FrameSink回调期间有效
+ */
+struct Frame
+{
+    enum Format
+    {
+        FRAME_NV21 = 0, // Y平面 + VU交织平面
+        FRAME_NV12,     // Y平面 + UV交织平面
+        FRAME_RGB888,   // 单平面 R,G,B
+    } format;
+    int width;
+    int height;
+    int stride;            // plane0每行字节数
+    int stride1;           // plane1每行字节数
+    const uint8_t *plane0; // Y 或 RGB
+    const uint8_t *plane1; // UV，RGB888时为NULL
+};
+
+using FrameSink = std::function<void(const Frame &frame)>;
+
+/**
+ * @brief 帧来源：给定视频文件取一帧有代表性的画面
+ */
+class FrameSource
+{
+public:
+    virtual ~FrameSource() {}
+
+    /**
+     * @brief 取一帧并同步调用sink
+     * @param posMs 取帧位置（ms），小于0表示由帧来源选一个有代表性的位置
+     * @retval true 已调用sink / false 取帧失败
+     */
+    virtual bool Grab(const std::string &path, int posMs, const FrameSink &sink) = 0;
+};
+
+/**
+ * @brief 用一个临时的TPlayer实例解码，从视频帧通知中取第一帧（默认跳到片头10%处的关键帧）
+ */
+class TPlayerFrameSource : public FrameSource
+{
+public:
+    bool Grab(const std::string &path, int posMs, const FrameSink &sink) override;
+};
+
+/**
+ * @brief 文件桩：读取视频同名的.ppm（P6）图片当作任意位置的画面，用于没有解码器的环境
+ */
+class FileFrameSource : public FrameSource
+{
+public:
+    bool Grab(const std::string &path, int posMs, const FrameSink &sink) override;
+};
+
+#endif
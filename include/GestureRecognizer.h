@@ -0,0 +1,128 @@
+#ifndef _GESTURERECOGNIZER_H_
+#define _GESTURERECOGNIZER_H_
+
+#include <stdint.h>
+#include <functional>
+#include "../libs/lvgl/lvgl.h"
+#include "../utils/SpscRing/SpscRing.h"
+#include "../utils/SeqLock/SeqLock.h"
+
+/* 手指移动超过这么多像素就不再算长按 */
+#define GESTURE_SLOP_PX 12
+/* 滑动：位移至少这么多像素，且速度至少这么快（像素/秒） */
+#define GESTURE_SWIPE_MIN_PX 60
+#define GESTURE_SWIPE_MIN_VELOCITY 300
+/* 计算速度时只看最近这段时间内的采样 */
+#define GESTURE_VELOCITY_WINDOW_MS 80
+/* 按住不动这么久算长按 */
+#define GESTURE_LONG_PRESS_MS 500
+/* 两指起始距离小于这么多像素时不识别缩放（可能是同一根手指被报成两点） */
+#define GESTURE_PINCH_MIN_PX 30
+/* 缩放比例变化小于这个值时不上报 */
+#define GESTURE_PINCH_STEP 0.02f
+/* 识别结果队列长度，2的幂 */
+#define GESTURE_QUEUE_LEN 32
+/* 速度计算保留的采样数 */
+#define GESTURE_HISTORY 8
+
+/**
+ * @brief 手势识别：滑动（带速度）、长按、两指缩放
+ *
+ * 在触摸输入线程里按帧调用Process，不经过LVGL的读取周期；识别结果放进无锁队列，
+ * 由LVGL线程用Pop取出处理。坐标为触摸设备坐标，未经显示旋转。
+ */
+class GestureRecognizer
+{
+public:
+    using NotifyCb = std::function<void(void)>;
+
+    enum Type
+    {
+        SWIPE = 0,   // 滑动，检测到即上报，不等松手
+        LONG_PRESS,  // 长按
+        PINCH_BEGIN, // 两指按下
+        PINCH,       // 两指距离变化
+        PINCH_END,   // 有手指抬起
+    };
+
+    struct Touch
+    {
+        int id; // 触点跟踪ID
+        int x;
+        int y;
+    };
+
+    struct Gesture
+    {
+        Type type;
+        lv_dir_t dir;    // SWIPE：方向
+        int16_t x, y;    // SWIPE：起点；LONG_PRESS：按下点；PINCH：两指中点
+        int16_t dx, dy;  // SWIPE：位移
+        float vx, vy;    // SWIPE：速度（像素/秒）
+        float scale;     // PINCH：当前两指距离 / 起始距离
+        uint64_t timeUs; // 触发该手势的输入帧的时间（CLOCK_MONOTONIC）
+    };
+
+    struct Stats
+    {
+        uint32_t frames;      // 处理的输入帧数
+        uint32_t swipes;      // 识别的滑动数
+        uint32_t longPresses; // 识别的长按数
+        uint32_t pinches;     // 识别的缩放次数（按PINCH_BEGIN计）
+        uint32_t dropped;     // 队列满丢弃的手势数
+    };
+
+private:
+    enum State
+    {
+        IDLE,     // 没有触点
+        SINGLE,   // 单指：等待滑动或长按
+        PINCHING, // 两指缩放
+        WAIT_UP,  // 手势已结束，等所有手指抬起
+    };
+
+    struct Sample
+    {
+        int x;
+        int y;
+        uint64_t us;
+    };
+
+    NotifyCb _notifyCb; // 有新手势时在输入线程调用，可为空
+    SpscRing<Gesture, GESTURE_QUEUE_LEN> _queue; // 输入线程 -> LVGL线程
+
+    /* 以下只在输入线程访问 */
+    State _state;
+    int _id;                          // 单指：跟踪的触点ID
+    Sample _start;                    // 单指：按下的位置和时间
+    Sample _history[GESTURE_HISTORY]; // 单指：最近的采样
+    uint32_t _historyLen;
+    bool _moved;                      // 单指：移动超过GESTURE_SLOP_PX
+    bool _swiped;                     // 单指：已上报滑动
+    bool _longPressed;                // 单指：已上报长按
+    int _pinchIds[2];                 // 缩放：两个触点ID
+    float _pinchDist;                 // 缩放：起始距离
+    float _lastScale;                 // 缩放：最近上报的比例
+    Stats _work;                      // 统计的工作副本
+    SeqLock<Stats> _stats;            // 发布给其他线程的统计
+
+    void beginSingle(const Touch &touch, uint64_t timeUs);
+    void moveSingle(const Touch &touch, uint64_t timeUs);
+    void endSingle(uint64_t timeUs);
+    void beginPinch(const Touch *touches, int count, uint64_t timeUs);
+    bool checkLongPress(uint64_t nowUs);
+    bool trySwipe(uint64_t timeUs);
+    bool velocity(float &vx, float &vy) const;
+    const Touch *find(const Touch *touches, int count, int id) const;
+    void emit(const Gesture &gesture);
+    int timeout(uint64_t nowUs) const;
+
+public:
+    GestureRecognizer(NotifyCb notifyCb = nullptr);
+
+    int Process(const Touch *touches, int count, uint64_t timeUs, uint64_t nowUs);
+    bool Pop(Gesture &gesture) { return _queue.Pop(gesture); }
+    Stats GetStats(void) const { return _stats.Read(); }
+};
+
+#endif
@@ -1,10 +1,49 @@
 #pragma once
 
 #include "common_inc.h"
+#include "DisplayFlusher.h"
+#include "GestureRecognizer.h"
+#include "InputResampler.h"
+
+/* 绘制缓冲为屏幕的1/HAL_DRAW_BUF_DIV，使用两个缓冲并由独立线程刷新；为1时使用单个全屏缓冲 */
+#ifndef HAL_DRAW_BUF_DIV
+#define HAL_DRAW_BUF_DIV 10
+#endif
 
 namespace HAL
 {
+    using GestureCb = std::function<void(const GestureRecognizer::Gesture &gesture)>;
+
+    /* 刷新调度统计 */
+    struct SchedStats
+    {
+        uint32_t wakeups;     // LVGL线程醒来的次数
+        uint32_t idleWakeups; // 其中刷新暂停（界面静止）时醒来的次数
+        uint32_t activations; // 静止 -> 活动的次数
+        uint32_t periodMs;    // 活动时的刷新周期（显示帧率）
+        bool active;          // 当前是否在按显示帧率刷新
+        uint64_t activeUs;    // 累计活动时间
+        uint64_t idleUs;      // 累计静止时间
+        uint64_t cpuUs;       // LVGL线程累计占用的CPU时间
+    };
+
     void Init(void);
     void LVGL_Proc(void);
+    void Deinit(void);
+    void WakeUp(void);
+    bool GetSchedStats(SchedStats &stats);
+#if USE_EVDEV
+    bool GetInputStats(evdev_stats_t &stats);
+#endif
+    bool GetResampledPointer(lv_point_t &point);
+    void SetResamplerConfig(const InputResampler::Config &config);
+    bool SetGestureCb(GestureCb cb);
+    bool GetGestureStats(GestureRecognizer::Stats &stats);
+    bool GetRenderStats(DisplayFlusher::Stats &stats);
+    bool SetUiCompositing(bool en);
+#if !USE_VFB
+    bool GetCompositingStats(sunxifb_comp_stats_t &stats);
+    bool GetPresentStats(sunxifb_present_stats_t &stats);
+#endif
 }
 
@@ -0,0 +1,82 @@
+#ifndef _INPUTRESAMPLER_H_
+#define _INPUTRESAMPLER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../utils/SeqLock/SeqLock.h"
+
+/* 保留的触摸采样数 */
+#define INPUTRESAMPLER_HISTORY 8
+/* 外推速度用最近这段时间内的采样做最小二乘 */
+#define INPUTRESAMPLER_VELOCITY_WINDOW_US 50000
+/* 最新采样比这更旧时认为手指停住了，不再外推 */
+#define INPUTRESAMPLER_STALE_US 40000
+/* 默认预测量：在显示时间上再往后（正）或往前（负，换取平滑）取位置 */
+#define INPUTRESAMPLER_PREDICT_US 0
+/* 默认最多超出最新采样外推这么久 */
+#define INPUTRESAMPLER_MAX_EXTRAPOLATE_US 20000
+
+/**
+ * @brief 触摸重采样：按事件时间戳把手指位置插值/外推到帧的显示时间
+ *
+ * 输入线程用Add/Release写入主触点的采样，其他线程（LVGL线程）用Resample取某一时刻的位置，
+ * 不受LVGL读取周期和触摸屏采样率的影响。拖动动画（如smooth_ui_toolkit的SmoothDrag）在
+ * LV_EVENT_PRESSING里用HAL::GetResampledPointer取点再调用drag，可以减少滞后和抖动（进度条拖动见View::scrubDrag）。
+ */
+class InputResampler
+{
+public:
+    struct Sample
+    {
+        int x;
+        int y;
+        uint64_t us; // CLOCK_MONOTONIC
+    };
+
+    struct Config
+    {
+        int32_t predictUs;         // 预测量，见INPUTRESAMPLER_PREDICT_US
+        uint32_t maxExtrapolateUs; // 最多外推的时间
+    };
+
+    /* 回放评估结果：与轨迹本身在显示时刻的真实位置比较 */
+    struct Report
+    {
+        uint32_t frames;     // 参与统计的帧数
+        float rawMeanErr;    // 直接用LVGL周期读取的最新点：平均误差（像素）
+        float rawMaxErr;     // 最大误差
+        float rawLagMs;      // 沿运动方向的等效滞后
+        float meanErr;       // 重采样：平均误差
+        float maxErr;        // 最大误差
+        float lagMs;         // 等效滞后（负值表示超前）
+    };
+
+private:
+    struct History
+    {
+        Sample samples[INPUTRESAMPLER_HISTORY]; // 环形保存
+        uint32_t count;                         // 写入过的采样数
+        bool down;                              // 手指是否按下
+    };
+
+    Config _config;
+    int _id;                   // 当前跟踪的触点ID，只在输入线程访问
+    History _work;             // 历史的工作副本，只在输入线程访问
+    SeqLock<History> _history; // 发布给读取线程的历史
+
+    static bool estimate(const History &history, uint64_t targetUs, const Config &config, int &x, int &y);
+
+public:
+    InputResampler();
+
+    void SetConfig(const Config &config) { _config = config; }
+    Config GetConfig(void) const { return _config; }
+    void Add(int id, int x, int y, uint64_t us);
+    void Release(void);
+    bool Resample(uint64_t presentUs, int &x, int &y) const;
+
+    static Report Replay(const Config &config, const Sample *trace, size_t count,
+                         uint32_t frameUs, uint32_t readPeriodUs);
+};
+
+#endif
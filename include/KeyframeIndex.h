@@ -0,0 +1,39 @@
+#ifndef _KEYFRAMEINDEX_H_
+#define _KEYFRAMEINDEX_H_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/* 一个文件最多记录的关键帧数 */
+#define KEYFRAME_INDEX_MAX 65536
+
+/**
+ * @brief 单个视频文件的关键帧时间戳索引
+ *
+ * MP4/MOV/3GP从moov的视频轨stss/stts表直接算出关键帧时间，不经过解码器；
+ * 结果以 路径 + 文件大小 + 修改时间 的哈希为文件名保存在索引目录中，下次直接载入。
+ * 其他格式或所有帧都是关键帧时索引为空，Snap原样返回。
+ */
+class KeyframeIndex
+{
+private:
+    std::string _dir;                  // 索引目录（以'/'结尾）
+    std::string _path;                 // 视频路径
+    std::vector<uint32_t> _keyframes;  // 关键帧时间（ms），升序
+
+    std::string indexPath(uint64_t size, int64_t mtime) const;
+    bool loadDisk(const std::string &file);
+    void saveDisk(const std::string &file) const;
+    static bool parseMp4(const std::string &path, std::vector<uint32_t> &keyframes);
+
+public:
+    KeyframeIndex(const char *dir);
+
+    bool Load(const std::string &path, uint64_t size, int64_t mtime);
+    int Snap(int posMs) const;
+    size_t Size(void) const { return _keyframes.size(); }
+    const std::string &Path(void) const { return _path; }
+};
+
+#endif
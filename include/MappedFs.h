@@ -0,0 +1,50 @@
+#ifndef _MAPPEDFS_H_
+#define _MAPPEDFS_H_
+
+#include <stdint.h>
+#include "../libs/lvgl/lvgl.h"
+
+/* 不超过这个大小的只读文件整个映射，按指针读取 */
+#define MAPPEDFS_MAP_MAX (4 * 1024 * 1024)
+/* 保留的映射数：关闭后仍保留，再次打开（如无图片缓存时每次绘制都重新打开）直接复用 */
+#define MAPPEDFS_MAP_CACHE 16
+/* 大文件按块pread并缓存，块大小和块数 */
+#define MAPPEDFS_BLOCK_SIZE (64 * 1024)
+#define MAPPEDFS_CACHE_BLOCKS 8
+
+/**
+ * @brief LVGL文件系统驱动：小的只读文件mmap后按指针读取，大文件和用户目录下的文件pread并带块缓存和预读
+ *
+ * 同时注册一个.bin图片解码器：真彩色图片直接使用映射中的像素，不经过逐行读取和拷贝。
+ */
+namespace MappedFs
+{
+    struct Config
+    {
+        uint32_t mapMax;      // 整个映射的文件大小上限，0不映射
+        uint32_t blockSize;   // pread的块大小
+        uint32_t cacheBlocks; // 缓存的块数，0不缓存
+        const char *const *preadRoots; // 用户可改写的目录（NULL结尾），其中的文件一律pread，不映射
+    };
+
+    struct Stats
+    {
+        uint32_t opens;      // 打开次数
+        uint32_t mapped;     // 其中由映射读取的
+        uint32_t mapReuses;  // 其中复用了保留的映射的
+        uint32_t reads;      // 读取次数
+        uint64_t bytes;      // 读出的字节数
+        uint32_t hits;       // 块缓存命中
+        uint32_t misses;     // 块缓存未命中（各一次pread）
+        uint32_t direct;     // 不小于一块、绕过缓存直接pread的读取
+        uint32_t readAheads; // 顺序读取时提前让内核读入的块
+        uint32_t zeroCopy;   // 图片解码器直接使用映射的次数
+    };
+
+    void Init(char letter, const Config *config = NULL);
+    bool GetData(lv_fs_file_t *file, const uint8_t *&data, uint32_t &size);
+    void SetZeroCopy(bool en);
+    Stats GetStats(void);
+}
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef _MEDIALIBRARY_H_
+#define _MEDIALIBRARY_H_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <atomic>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include "MetadataCache.h"
+
+/* 目录变化的合并窗口：最后一个事件后安静这么久才应用一批更新 */
+#define MEDIALIBRARY_COALESCE_MS 300
+/* 持续有事件时，一批更新最多推迟这么久 */
+#define MEDIALIBRARY_COALESCE_MAX_MS 2000
+
+/**
+ * @brief 媒体库：后台扫描视频目录，建立 文件名 -> 路径/元数据 的哈希索引
+ *
+ * 首次全量扫描后，由同一个线程通过inotify监视各根目录、通过/proc/self/mounts监视挂载变化，
+ * 把一段时间内的变化合并成一批，只重新stat/探测涉及的文件。
+ */
+class MediaLibrary
+{
+public:
+    struct MediaEntry
+    {
+        std::string name; // 文件名
+        std::string path; // 完整路径
+        int root;         // 所属根目录下标（越小优先级越高）
+        uint64_t size;    // 文件大小（byte）
+        int64_t mtime;    // 修改时间（s）
+        bool hasMeta;     // 是否已有元数据（缓存命中或已探测）
+        MetadataCache::Meta meta;
+    };
+
+    struct ScanStats
+    {
+        uint32_t files;       // 索引的视频文件数
+        uint32_t skipped;     // 跳过的非视频文件数
+        uint32_t cacheHits;   // 元数据缓存命中数
+        uint32_t probed;      // 重新探测元数据的文件数
+        uint32_t loadUs;      // 载入元数据缓存耗时
+        uint32_t scanUs;      // 遍历目录+查缓存耗时（索引可用前）
+        uint32_t probeUs;     // 探测变化文件耗时
+        uint32_t events;      // 收到的inotify事件数
+        uint32_t batches;     // 应用的增量更新批数
+        uint32_t lastBatchUs; // 最近一批增量更新耗时
+    };
+
+    /* 一批更新，full为true表示全量扫描的结果 */
+    struct Changes
+    {
+        bool full;
+        std::vector<std::string> added;   // 新增的文件名
+        std::vector<std::string> updated; // 路径、大小、修改时间或元数据变化的文件名
+        std::vector<std::string> removed; // 删除的文件名
+    };
+
+    using UpdateCb = std::function<void(const Changes &changes)>;
+    using ProbeCb = std::function<bool(const std::string &path, MetadataCache::Meta &meta)>;
+
+private:
+    struct RootWatch
+    {
+        int wd;    // inotify watch描述符，-1表示目录不存在（未挂载）
+        dev_t dev; // 被监视目录的设备号和inode，挂载变化后会不同
+        ino_t ino;
+    };
+
+    std::vector<std::string> _roots;                      // 扫描的根目录（以'/'结尾）
+    std::vector<RootWatch> _watches;                      // 与_roots一一对应
+    std::unordered_map<std::string, MediaEntry> _entries; // 文件名 -> 条目
+    pthread_mutex_t _mutex;                               // 保护索引与统计
+    pthread_t _pthread;                                   // 扫描/监视线程
+    bool _threadRunning;                                  // 线程是否已创建
+    std::atomic<bool> _stop;                              // 通知线程退出
+    int _inotifyFd;                                       // inotify描述符
+    int _mountsFd;                                        // /proc/self/mounts，挂载表变化时POLLPRI
+    int _stopFd;                                          // eventfd，唤醒poll退出
+    bool _ready;                                          // 是否完成过一次扫描
+    ScanStats _stats;                                     // 扫描统计
+    UpdateCb _updateCb;                                   // 更新回调，在扫描/监视线程中调用
+    MetadataCache *_cache;                                // 元数据缓存，为空则不缓存
+    ProbeCb _probeCb;                                     // 元数据探测函数
+
+    static void *threadProcHandler(void *arg);
+    void scan(void);
+    void probe(void);
+    void publish(std::unordered_map<std::string, MediaEntry> &entries);
+    bool lookupDirect(const std::string &name, MediaEntry &entry);
+    void stopThread(void);
+
+    void watch(void);
+    bool readEvents(std::unordered_set<std::string> &dirty);
+    void checkRoots(std::unordered_set<std::string> &dirty);
+    void listRoot(int root, std::unordered_set<std::string> &dirty);
+    void markRootEntries(int root, std::unordered_set<std::string> &dirty);
+    bool resolve(const std::string &name, MediaEntry &entry);
+    void applyChanges(std::unordered_set<std::string> &dirty);
+
+public:
+    MediaLibrary(const std::vector<std::string> &roots, const char *cachePath = NULL);
+    ~MediaLibrary();
+
+    void SetProbeCallback(ProbeCb probeCb) { _probeCb = probeCb; }
+    void StartScan(UpdateCb updateCb = nullptr);
+    bool IsReady(void);
+    bool Lookup(const std::string &name, MediaEntry &entry);
+    std::vector<MediaEntry> GetEntries(void);
+    std::vector<std::string> GetPlaylist(void);
+    ScanStats GetStats(void);
+
+    static bool IsMediaFile(const char *name);
+};
+
+#endif
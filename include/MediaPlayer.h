@@ -2,30 +2,241 @@
 #define _MEDIAPLAYER_H_
 
 #include <string>
+#include <deque>
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <stdint.h>
+#include <pthread.h>
 #include <semaphore.h>
+#include <sys/types.h>
 #include <tplayer.h>
+#include "../utils/MpscRing/MpscRing.h"
+#include "../utils/SeqLock/SeqLock.h"
 
 #define LCD_WIDTH 480.0
+#define LCD_HEIGHT 480.0
+
+/* 预加载（pre-roll）的最大深度，即最多同时存在的备用TPlayer实例数 */
+#ifndef MEDIAPLAYER_PREROLL_MAX
+#define MEDIAPLAYER_PREROLL_MAX 2
+#endif
+
+/* 每个TPlayer实例的事件队列长度 */
+#ifndef MEDIAPLAYER_EVENT_QUEUE_LEN
+#define MEDIAPLAYER_EVENT_QUEUE_LEN 32
+#endif
+
+/* 备用实例准备的超时时间（ms） */
+#ifndef MEDIAPLAYER_PREROLL_TIMEOUT_MS
+#define MEDIAPLAYER_PREROLL_TIMEOUT_MS 3000
+#endif
+
+/* 预加载失败的文件多久重新检查一次大小和修改时间（ms），没变就继续跳过 */
+#ifndef MEDIAPLAYER_PREROLL_RETRY_MS
+#define MEDIAPLAYER_PREROLL_RETRY_MS 10000
+#endif
+
+/* 播放状态快照的刷新周期（ms），只在播放时刷新 */
+#ifndef MEDIAPLAYER_SNAPSHOT_PERIOD_MS
+#define MEDIAPLAYER_SNAPSHOT_PERIOD_MS 100
+#endif
 
 class MediaPlayer
 {
 public:
+    /* 异步打开视频的结果 */
+    enum PrepareResult
+    {
+        PREPARE_OK = 0,   // 准备完成
+        PREPARE_FAILED,   // TPlayer返回错误
+        PREPARE_TIMEOUT,  // 等待TPLAYER_NOTIFY_PREPARED超时
+        PREPARE_CANCELED, // 被新的打开请求取代
+    };
+
+    /* 打开视频各阶段耗时（us） */
+    struct PrepareTimings
+    {
+        uint32_t resetUs;     // TPlayerReset
+        uint32_t setSourceUs; // TPlayerSetDataSource
+        uint32_t prepareUs;   // TPlayerPrepareAsync -> TPLAYER_NOTIFY_PREPARED
+        uint32_t totalUs;     // 请求入队 -> 完成回调
+    };
+
+    /* 切换视频的统计，用于对比预加载前后的切换间隙 */
+    struct SwitchStats
+    {
+        uint32_t switchCount;  // 自动开始播放的切换次数
+        uint32_t prerollHits;  // 直接换入备用实例的次数
+        uint32_t prerollMiss;  // 走复位+准备流程的次数
+        uint32_t lastGapUs;    // 最近一次切换间隙：请求 -> 新视频开始播放
+        uint32_t maxGapUs;     // 最大切换间隙
+        uint64_t totalGapUs;   // 切换间隙总和，除以switchCount得平均值
+        long standbyRssKb;     // 备用实例创建并准备后带来的常驻内存增量
+    };
+
+    /* 跳转 -> 第一帧画面的延迟，[0]为普通跳转，[1]为对齐到关键帧的跳转 */
+    struct SeekStats
+    {
+        uint32_t count[2];
+        uint32_t lastUs[2];
+        uint32_t maxUs[2];
+        uint64_t totalUs[2]; // 除以count得平均值
+    };
+
+    /* 播放状态快照，由播放器线程定时发布，UI读取时不需要调用TPlayer */
+    struct PlaybackSnapshot
+    {
+        int positionMs;    // 采样时的播放时间点
+        int durationMs;    // 总时长
+        int volume;        // 音量（0 ~ 40）
+        int speed;         // 播放速度（TplayerPlaySpeedType）
+        bool prepared;     // 是否准备完成
+        bool playing;      // 是否正在播放
+        bool buffering;    // 是否正在缓冲
+        uint64_t sampleUs; // 采样时的单调时钟时间
+    };
+
+    /* 解码器回调投递给播放器线程的事件 */
+    struct PlayerEvent
+    {
+        enum Type
+        {
+            EVENT_PREPARED = 0,
+            EVENT_PLAYBACK_COMPLETE,
+            EVENT_SEEK_COMPLETE,
+            EVENT_MEDIA_ERROR,
+            EVENT_NOT_SEEKABLE,
+            EVENT_BUFFER_START,
+            EVENT_BUFFER_END,
+            EVENT_VIDEO_SIZE,
+            EVENT_FIRST_FRAME, // 跳转后的第一帧视频
+            EVENT_UNKNOWN,
+        } type;
+        bool active;          // 是否来自活动实例
+        int param0;           // 原始消息的param0（错误类型等）
+        int width;            // EVENT_VIDEO_SIZE：解码后的宽
+        int height;           // EVENT_VIDEO_SIZE：解码后的高
+        uint64_t timestampUs; // 回调发生时的单调时钟时间
+    };
+
+    /* 事件队列统计 */
+    struct EventStats
+    {
+        uint32_t count;          // 已处理的事件数
+        uint32_t dropped;        // 队列满被丢弃的事件数
+        uint32_t lastLatencyUs;  // 最近一次回调 -> 处理的延迟
+        uint32_t maxLatencyUs;   // 最大延迟
+        uint64_t totalLatencyUs; // 延迟总和，除以count得平均值
+    };
+
+    using PrepareDoneCb = std::function<void(uint32_t id, PrepareResult result, const PrepareTimings &timings)>;
+    using EventCb = std::function<void(const PlayerEvent &event)>;
+
 private:
-    TPlayer *mTPlayer;            // 播放器
-    std::string _sourceUrl;       // 播放的视频路径
-    sem_t _sem;                   // 异步通知信号量
-    bool _prepareFinishFlag;      // 音视频是否准备标志位
-    bool _fullScreenFlag = false; // is video full of screen flag
+    /* 预加载失败的文件，大小和修改时间不变就不再预加载 */
+    struct PrerollFailure
+    {
+        std::string url;
+        off_t size;       // 失败时的大小，-1表示文件不存在
+        time_t mtime;     // 失败时的修改时间
+        uint64_t checkUs; // 上次检查的时间
+    };
+
+    struct OpenRequest
+    {
+        uint32_t id;
+        std::string url;
+        bool autoStart;
+        PrepareDoneCb doneCb;
+        uint64_t enqueueUs;
+    };
+
+    /* 一个TPlayer实例，活动实例负责播放，其余为预加载播放列表后续视频的备用实例 */
+    struct PlayerSlot
+    {
+        MediaPlayer *owner;
+        TPlayer *player;
+        std::string url;  // 已准备（或正在准备）的视频路径
+        bool prepared;    // 是否收到TPLAYER_NOTIFY_PREPARED
+        bool failed;      // 是否收到TPLAYER_NOTIFY_MEDIA_ERROR
+        bool preparing;   // 备用实例已开始预加载，等待准备完成
+        uint64_t prepareStartUs; // 预加载开始的时间
+        long rssStartKb;  // 预加载开始时的常驻内存
+        long rssKb;       // 该实例带来的内存增量
+
+        MpscRing<PlayerEvent, MEDIAPLAYER_EVENT_QUEUE_LEN> events; // 回调线程（CedarX有多个）-> 播放器线程
+        std::atomic<uint32_t> dropped;                             // 队列满丢弃的事件数
+        std::atomic<bool> seekPending;                             // 跳转后还没收到视频帧
+        int videoWidth;                                            // 解码后的视频宽，0表示还没收到
+        int videoHeight;                                           // 解码后的视频高
+    };
+
+    TPlayer *mTPlayer;                    // 播放器（当前活动实例）
+    pthread_mutex_t _playerMutex;         // 保护mTPlayer的切换以及对活动实例的TPlayer调用
+    std::string _sourceUrl;               // 播放的视频路径
+    sem_t _sem;                           // 播放器线程唤醒信号量（新请求 / 准备完成）
+    std::atomic<bool> _prepareFinishFlag; // 音视频是否准备标志位，在_playerMutex内修改
+    bool _fullScreenFlag = false;         // 是否全屏，在_playerMutex内读写
+
+    pthread_t _pthread;                 // 播放器线程，串行执行打开请求
+    std::atomic<bool> _threadExitFlag;  // 线程退出标志位
+    pthread_mutex_t _reqMutex;          // 保护请求队列与耗时统计
+    std::deque<OpenRequest> _reqQueue;  // 待处理的打开请求
+    uint32_t _reqSeq;                   // 请求序号
+    uint32_t _latestReqId;              // 最新的请求，旧请求据此判断是否被取代
+    PrepareTimings _lastTimings;        // 最近一次完成的打开耗时
+
+    PlayerSlot _slots[1 + MEDIAPLAYER_PREROLL_MAX]; // 活动实例 + 备用实例
+    int _active;                                    // 活动实例下标
+    int _prerollDepth;                              // 预加载深度，0表示关闭
+    std::vector<std::string> _playlist;             // 播放列表
+    int _playlistIndex;                             // 当前播放的播放列表下标
+    bool _completePending;                          // 活动实例播放结束，等待切换到下一个
+    int _volume;                                    // 用户设置的音量，-1表示未设置
+    TplayerPlaySpeedType _speed;                    // 用户设置的播放速度
+    std::vector<PrerollFailure> _prerollFailed;     // 预加载失败的文件，只在播放器线程访问
+    bool _prerollPending;                           // 有备用实例正在准备，只在播放器线程访问
+    SwitchStats _switchStats;                       // 切换统计
+    EventStats _eventStats;                         // 事件队列统计
+    SeekStats _seekStats;                           // 跳转延迟统计
+    uint64_t _seekStartUs;                          // 最近一次跳转的时间
+    bool _seekSnapped;                              // 最近一次跳转是否对齐到关键帧
+    EventCb _eventCb;                               // 事件监听者，在播放器线程中调用
+
+    SeqLock<PlaybackSnapshot> _snapshot; // 播放状态快照，读者无锁
+    pthread_mutex_t _snapMutex;          // 快照的写者互斥
 
     friend int CallbackForTPlayer(void *pUserData, int msg, int param0, void *param1);
 
+    static void *threadProcHandler(void *arg);
+    bool popRequest(OpenRequest &req);
+    bool isSuperseded(uint32_t id);
+    void processOpen(OpenRequest &req);
+    PrepareResult openOnActive(OpenRequest &req, PrepareTimings &timings);
+    bool swapToStandby(OpenRequest &req, PrepareTimings &timings);
+    bool prerollStandby(void);
+    bool finishPreroll(PlayerSlot &slot);
+    bool prerollFailed(const std::string &url);
+    void applyState(TPlayer *player, int defaultVolume);
+    void applyDisplayRect(PlayerSlot &slot);
+    PrepareResult waitPrepared(PlayerSlot &slot, uint32_t id);
+    bool createSlot(PlayerSlot &slot);
+    void destroySlot(PlayerSlot &slot);
+    void recordSwitch(bool prerollHit, uint32_t gapUs);
+    void sampleSnapshot(void);
+    void updateSnapshot(const std::function<void(PlaybackSnapshot &snap)> &modify);
+    static int interpolatePos(const PlaybackSnapshot &snap, uint64_t nowUs);
+    void drainEvents(void);
+    void handleEvent(PlayerSlot &slot, const PlayerEvent &event);
+
 public:
     MediaPlayer(std::string *url = nullptr);
     ~MediaPlayer(void);
 
     void Start(void);
     void Pause(void);
-    void SetCurrentPos(int seekMs);
+    void SetCurrentPos(int seekMs, bool snapped = false);
     int GetCurrentPos(void);
     int GetDuration(void);
     int GetVolume(void);
@@ -37,12 +248,24 @@ public:
     bool SetSpeed(TplayerPlaySpeedType speed);
     bool SetFullScreen(bool isFullScreen);
     bool GetFullScreen(void);
-    MediaInfo *GetMediaInfo(void)
-    {
-        return TPlayerGetMediaInfo(mTPlayer);
-    }
+    MediaInfo *GetMediaInfo(void);
+
+    uint32_t OpenAsync(const std::string &url, bool autoStart = true, PrepareDoneCb doneCb = nullptr);
+    PrepareTimings GetPrepareTimings(void);
+
+    void SetPlaylist(const std::vector<std::string> &urls);
+    void SkipToNext(void);
+    void SetPrerollDepth(int depth);
+    int GetPrerollDepth(void) const { return _prerollDepth; }
+    SwitchStats GetSwitchStats(void);
+
+    PlaybackSnapshot GetSnapshot(void) const { return _snapshot.Read(); }
 
+    void SetEventListener(EventCb eventCb);
+    EventStats GetEventStats(void);
+    SeekStats GetSeekStats(void);
     bool SetNewVideo(std::string &url);
+    static bool Probe(const std::string &url, int &durationMs, int &width, int &height, int &codec);
     bool IsPrepareFinish(void) const { return _prepareFinishFlag; }
 };
 
@@ -0,0 +1,78 @@
+#ifndef _METADATACACHE_H_
+#define _METADATACACHE_H_
+
+#include <string>
+#include <unordered_map>
+#include <stdint.h>
+
+/**
+ * @brief 媒体元数据的磁盘缓存
+ *
+ * 文件格式：Header + Record[count] + 路径字符串表，启动时整体mmap只读映射，
+ * 以 路径 + 文件大小 + 修改时间 为键，任何一项变化都视为失效，需要重新探测。
+ */
+class MetadataCache
+{
+public:
+    struct Meta
+    {
+        int32_t durationMs; // 总时长
+        uint16_t width;     // 视频宽
+        uint16_t height;    // 视频高
+        int32_t codec;      // 视频编码格式（TPlayer的eCodecFormat）
+    };
+
+private:
+    struct Header
+    {
+        char magic[4];        // "EMPC"
+        uint32_t version;     // 格式版本
+        uint32_t count;       // 记录数
+        uint32_t stringsSize; // 字符串表大小
+    };
+
+    struct Record
+    {
+        uint64_t pathHash;
+        uint64_t size;
+        int64_t mtime;
+        uint32_t pathOffset; // 在字符串表中的偏移
+        uint16_t pathLen;
+        uint16_t reserved;
+        Meta meta;
+    };
+
+    struct LiveRecord
+    {
+        uint64_t size;
+        int64_t mtime;
+        Meta meta;
+    };
+
+    std::string _path;                             // 缓存文件路径
+    void *_map;                                    // mmap映射
+    size_t _mapSize;                               // 映射大小
+    const Record *_records;                        // 映射中的记录
+    const char *_strings;                          // 映射中的字符串表
+    uint32_t _count;                               // 映射中的记录数
+    std::unordered_map<uint64_t, uint32_t> _index; // 路径哈希 -> 记录下标
+    std::unordered_map<std::string, LiveRecord> _live; // 路径 -> 仍然存在的文件，保存时写入
+    bool _dirty;                                   // 是否有新探测的记录或删除的记录
+
+    static uint64_t hashPath(const char *path, size_t len);
+    void unmap(void);
+
+public:
+    MetadataCache(const std::string &path);
+    ~MetadataCache();
+
+    bool Load(void);
+    void BeginScan(void);
+    bool Find(const std::string &path, uint64_t size, int64_t mtime, Meta &meta);
+    void Put(const std::string &path, uint64_t size, int64_t mtime, const Meta &meta);
+    void Erase(const std::string &path);
+    bool Save(void);
+    uint32_t Size(void) const { return _count; }
+};
+
+#endif
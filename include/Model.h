@@ -1,11 +1,16 @@
 #pragma once
 
 #include <string>
+#include <deque>
+#include <memory>
+#include <unordered_set>
 #include <functional>
-#include <dirent.h>
 #include "common_inc.h"
 #include "View.h"
 #include "MediaPlayer.h"
+#include "MediaLibrary.h"
+#include "ThumbnailCache.h"
+#include "KeyframeIndex.h"
 #include "../libs/lvgl/lvgl.h"
 
 namespace Page
@@ -13,11 +18,60 @@ namespace Page
     class Model
     {
     public:
+        /* 交给Model线程执行的命令 */
+        struct Command
+        {
+            enum Type
+            {
+                CMD_PLAY = 0,       // 播放指定视频（name），name为空则继续播放
+                CMD_PAUSE,          // 暂停
+                CMD_SEEK,           // 跳转（value：s）
+                CMD_SCRUB_SEEK,     // 拖动进度条松手后跳转（value：ms，已对齐关键帧）
+                CMD_SET_VOLUME,     // 设置音量（value）
+                CMD_SET_SPEED,      // 设置倍速（value）
+                CMD_SET_ROTATE,     // 设置翻转（value）
+                CMD_SET_FULLSCREEN, // 设置全屏（value）
+                CMD_LIBRARY_UPDATE, // 媒体库有更新，刷新播放列表（value：变化的文件数）
+                CMD_SHUTDOWN,       // 退出线程
+            } type;
+            int value;
+            std::string name;
+            uint64_t enqueueUs; // 入队时的单调时钟时间
+        };
+
+        /* 命令队列统计 */
+        struct CommandStats
+        {
+            uint32_t count;          // 已执行的命令数
+            uint32_t wakeups;        // 线程被唤醒的次数
+            uint32_t lastLatencyUs;  // 最近一次入队 -> 开始执行的延迟
+            uint32_t maxLatencyUs;   // 最大延迟
+            uint64_t totalLatencyUs; // 延迟总和，除以count得平均值
+            uint64_t threadCpuUs;    // Model线程累计占用的CPU时间
+        };
+
     private:
+        /* 拖动预览的对象：当前视频及其关键帧索引，构建后只读 */
+        struct ScrubTarget
+        {
+            MediaLibrary::MediaEntry entry;
+            KeyframeIndex index;
+        };
+
         MediaPlayer *_mp;        // 媒体播放器对象指针
+        MediaLibrary *_library;  // 媒体库
+        ThumbnailCache *_thumbs; // 缩略图缓存
+        std::shared_ptr<const ScrubTarget> _scrubTarget; // 拖动预览对象，Model线程清空、缩略图线程发布，LVGL线程读取
+        std::string _scrubPath;                          // 最近请求索引的视频，只发布它的索引
+        pthread_mutex_t _scrubMutex;                     // 保护_scrubTarget指针和_scrubPath
+        std::unordered_set<std::string> _keyframeFailed; // 索引解析失败的 路径+大小+修改时间，只在缩略图线程中访问
         pthread_t _pthread;      // 数据处理线程
-        bool _threadExitFlag;    // 线程退出标志位
         pthread_mutex_t *_mutex; // 互斥量
+
+        pthread_mutex_t _cmdMutex;      // 保护命令队列
+        pthread_cond_t _cmdCond;        // 有新命令时唤醒Model线程
+        std::deque<Command> _cmdQueue;  // 命令队列
+        CommandStats _cmdStats;         // 命令队列统计
         View _view;              // View的实例
         lv_timer_t *_timer;      // LVGL软定时器
 
@@ -30,8 +84,11 @@ namespace Page
         static void *threadProcHandler(void *);
         void update(void);
         static void onTimerUpdate(lv_timer_t *timer);
+        bool requestUpdate(void);
 
-        int searchVideo(std::string path);
+        void execute(const Command &cmd);
+        void loadKeyframes(const std::string &path);
+        void buildKeyframes(const std::string &path);
 
         // funtion for View
         bool getState(void);
@@ -45,9 +102,16 @@ namespace Page
         void setSpeed(int speed);
         void setRotate(int angle);
         void setFullScreen(bool isFullScreen);
+        int scrub(int posMs, ThumbnailCache::ThumbPtr &preview);
+        void scrubEnd(int posMs);
+        void setPanelVisible(bool visible);
 
     public:
         Model(std::function<void(void)> exitCb, pthread_mutex_t &mutex);
         ~Model();
+
+        void pushCommand(Command::Type type, int value = 0, const char *name = NULL);
+        CommandStats getCommandStats(void);
+        MediaPlayer::PlaybackSnapshot getSnapshot(void);
     };
 }
\ No newline at end of file
@@ -0,0 +1,126 @@
+#ifndef _THUMBNAILCACHE_H_
+#define _THUMBNAILCACHE_H_
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <stdint.h>
+#include <pthread.h>
+#include "FrameSource.h"
+#include "MediaLibrary.h"
+#include "../libs/lvgl/lvgl.h"
+
+/* 默认缩略图尺寸（保持比例缩放到此范围内） */
+#define THUMBNAIL_WIDTH 160
+#define THUMBNAIL_HEIGHT 90
+/* 默认内存预算 */
+#define THUMBNAIL_BUDGET_DEFAULT (2 * 1024 * 1024)
+
+/**
+ * @brief 一张缩略图，dsc.data指向pixels
+ */
+struct Thumbnail
+{
+    lv_img_dsc_t dsc;
+    std::vector<lv_color_t> pixels;
+};
+
+/**
+ * @brief 缩略图流水线：后台线程取帧、缩小成lv_img_dsc_t，内存LRU + 磁盘缓存
+ *
+ * 内存中的缩略图用shared_ptr交出，被LRU淘汰时正在显示的图片不会被释放。
+ * 磁盘缓存以 路径 + 文件大小 + 修改时间 的哈希为文件名，文件变化后自然失效。
+ * 拖动进度条时的预览帧（GetAt）只放在内存LRU中，且只保留最新的一个待生成请求。
+ * 暂停预取（视频正在播放）时，第二个解码器只为拖动中的预览帧工作：拖动结束（EndScrub）
+ * 丢弃没开始的预览帧，磁盘上没有的默认缩略图推迟到恢复后再解码。
+ */
+class ThumbnailCache
+{
+public:
+    using ThumbPtr = std::shared_ptr<const Thumbnail>;
+    using ReadyCb = std::function<void(const std::string &name)>;
+    using Task = std::function<void(void)>;
+
+    struct Stats
+    {
+        uint32_t hits;         // Get命中内存
+        uint32_t misses;       // Get未命中内存
+        uint32_t diskHits;     // 从磁盘缓存载入
+        uint32_t decoded;      // 解码生成
+        uint32_t failed;       // 取帧失败
+        uint32_t evictions;    // 因内存预算被淘汰
+        uint32_t memBytes;     // 内存中缩略图占用
+        uint32_t budgetBytes;  // 内存预算
+        uint32_t lastDecodeUs; // 最近一次取帧+缩放耗时
+    };
+
+private:
+    struct Job
+    {
+        uint64_t key;
+        std::string name;
+        std::string path;
+        int posMs;     // 取帧位置，小于0为默认缩略图，否则为拖动预览帧
+        bool toMemory; // 需要放入内存（Get触发）；否则只生成磁盘缓存（预取）
+    };
+
+    struct LruItem
+    {
+        uint64_t key;
+        ThumbPtr thumb;
+    };
+
+    FrameSource *_source; // 帧来源（拥有）
+    std::string _diskDir; // 磁盘缓存目录（以'/'结尾）
+    int _maxWidth;
+    int _maxHeight;
+
+    pthread_t _pthread;
+    pthread_mutex_t _mutex; // 保护以下所有成员
+    pthread_cond_t _cond;
+    std::deque<Job> _jobs;
+    std::deque<Job> _deferred;             // 暂停时磁盘未命中、等恢复后再解码的默认缩略图
+    std::deque<Task> _tasks;               // Post的任务，排在缩略图之前，暂停时也执行
+    std::unordered_set<uint64_t> _pending; // 已在队列中的key，去重
+    std::list<LruItem> _lru;               // 表头最近使用
+    std::unordered_map<uint64_t, std::list<LruItem>::iterator> _lruIndex;
+    size_t _memBytes;
+    size_t _budget;
+    bool _paused;
+    bool _exit;
+    ReadyCb _readyCb;
+    Stats _stats;
+
+    static void *threadProcHandler(void *arg);
+    static uint64_t makeKey(const MediaLibrary::MediaEntry &entry, int posMs);
+    std::string diskPath(uint64_t key);
+    ThumbPtr loadDisk(uint64_t key);
+    void saveDisk(uint64_t key, const Thumbnail &thumb);
+    ThumbPtr generate(const std::string &path, int posMs);
+    void insert(uint64_t key, ThumbPtr thumb);
+    void evict(void);
+    void enqueue(const MediaLibrary::MediaEntry &entry, uint64_t key, int posMs, bool toMemory);
+
+public:
+    ThumbnailCache(FrameSource *source, const char *diskDir,
+                   int maxWidth = THUMBNAIL_WIDTH, int maxHeight = THUMBNAIL_HEIGHT,
+                   size_t budget = THUMBNAIL_BUDGET_DEFAULT);
+    ~ThumbnailCache();
+
+    ThumbPtr Get(const MediaLibrary::MediaEntry &entry);
+    ThumbPtr GetAt(const MediaLibrary::MediaEntry &entry, int posMs);
+    void Prefetch(const std::vector<MediaLibrary::MediaEntry> &entries);
+    void SetMemoryBudget(size_t bytes);
+    void SetPaused(bool paused);
+    void EndScrub(void);
+    void SetReadyCallback(ReadyCb readyCb);
+    void Post(Task task);
+    Stats GetStats(void);
+};
+
+#endif
@@ -4,6 +4,9 @@
 #include "../utils/lv_ext/lv_obj_ext_func.h"
 #include "../utils/lv_ext/lv_anim_timeline_wrapper.h"
 #include <functional>
+#include <atomic>
+#include "ThumbnailCache.h"
+#include "GestureRecognizer.h"
 // #include "../utils/smooth_ui_toolkit/src/smooth_ui_toolkit.h"
 
 namespace Page
@@ -20,6 +23,9 @@ namespace Page
     using SetSpeedCb = std::function<void(int)>;
     using SetRotateCb = std::function<void(int)>;
     using SetFullScreenCb = std::function<void(bool)>;
+    using ScrubCb = std::function<int(int, ThumbnailCache::ThumbPtr &)>;
+    using ScrubEndCb = std::function<void(int)>;
+    using PanelCb = std::function<void(bool)>;
 
     struct Operations
     {
@@ -35,6 +41,9 @@ namespace Page
         SetSpeedCb setSpeedCb;           // 设置视频倍速回调函数
         SetRotateCb setRotateCb;         // 设置翻转屏幕回调函数
         SetFullScreenCb setFullScreenCb; // 设置视频是否全屏回调函数
+        ScrubCb scrubCb;                 // 拖动进度条：对齐关键帧并取预览帧
+        ScrubEndCb scrubEndCb;           // 松开进度条：跳转到对齐后的时间点
+        PanelCb panelCb;                 // 底部面板展开（true）/收起（false）回调函数
     };
 
     class View
@@ -43,6 +52,20 @@ namespace Page
         Operations _opts; // View回调函数集
         bool _isPlaying = false;
 
+        bool _isScrubbing = false;         // 正在拖动进度条
+        int _scrubMs = 0;                  // 拖动到的时间点（已对齐关键帧）
+        int _scrubTargetMs = 0;            // 手指所在的时间点（未对齐），由定时器合并后处理
+        bool _scrubDirty = false;          // _scrubTargetMs变了，还没取预览帧
+        int _durationMs = 0;               // 拖动开始时的视频总长度
+        ThumbnailCache::ThumbPtr _preview; // 正在显示的预览帧，显示期间不能被释放
+        lv_timer_t *_scrubTimer = nullptr; // 拖动期间合并滑块事件、取预览帧的定时器
+        std::atomic<bool> _previewReady{false}; // 缩略图线程生成了新的帧
+        uint32_t _resampledMoves = 0;      // 本次拖动中用重采样位置更新滑块的次数
+        int64_t _resampledLeadPx = 0;      // 重采样位置沿移动方向超前LVGL读到的点的像素和
+
+        bool _nativeGestures = false; // 手势由触摸输入线程识别（否则用LVGL的LV_EVENT_GESTURE）
+        bool _pinchHandled = false;   // 本次两指缩放已切换过全屏
+
     public:
         struct
         {
@@ -78,6 +101,8 @@ namespace Page
                 lv_obj_t *qrCode;
                 lv_obj_t *logoImage;
                 lv_obj_t *objectionImage;
+                lv_obj_t *progressSlider; // 播放进度条，可拖动预览
+                lv_obj_t *previewImage;   // 拖动时的预览帧
 
             } bottomCont;
 
@@ -94,6 +119,8 @@ namespace Page
         void appearAnimStart(bool reverse = false);
         void appearAnimTop(bool reverse = false);
         void appearAnimBottom(bool reverse = false);
+        void updateProgress(int curMs, int durationMs);
+        void previewReady(void);
 
     private:
         void AttachEvent(lv_obj_t *obj);
@@ -105,6 +132,14 @@ namespace Page
 
         static void onEvent(lv_event_t *event);
         static void buttonEventHandler(lv_event_t *event);
+        static void sliderEventHandler(lv_event_t *event);
+        void scrubTo(int posMs);
+        void scrubDrag(lv_obj_t *slider);
+        static void onScrubTimer(lv_timer_t *timer);
+        void onGesture(const GestureRecognizer::Gesture &gesture);
+        void onSwipe(lv_dir_t dir, float velocity);
+        void seekBy(int seconds);
+        bool isControlAt(lv_coord_t x, lv_coord_t y);
 
         lv_obj_t *btnCreate(lv_obj_t *par, const void *img_src, lv_coord_t x_ofs, lv_coord_t y_ofs, lv_coord_t w = 50, lv_coord_t h = 50);
     };
@@ -12,7 +12,19 @@
 #include "../libs/lvgl/lvgl.h"
 #include "../libs/lv_drivers/display/sunxifb.h"
 #include "../libs/lv_drivers/indev/evdev.h"
+#include "../libs/lv_drivers/display/vfb.h"
+#include "../libs/lv_drivers/display/drm.h"
+#include "../libs/lv_drivers/indev/vinput.h"
+#include "../utils/Tick/Tick.h"
 #include "MediaPlayer.h"
 #include "HAL.h"
 
+/* 板上的存储分区（视频、字体和各种缓存），主机构建时指向本地目录 */
+#ifndef UDISK_DIR
+#define UDISK_DIR "/mnt/UDISK/"
+#endif
+#ifndef EXUDISK_DIR
+#define EXUDISK_DIR "/mnt/exUDISK/"
+#endif
+
 extern pthread_mutex_t lv_mutex;
@@ -22,6 +22,8 @@
 #include <errno.h>
 #include <sys/mman.h>
 #include <inttypes.h>
+#include <string.h>
+#include <poll.h>
 
 #include <xf86drm.h>
 #include <xf86drmMode.h>
@@ -36,6 +38,17 @@
 #define info(msg, ...) print(msg "\n", ##__VA_ARGS__)
 #define dbg(msg, ...)  {} //print(DBG_TAG ": " msg "\n", ##__VA_ARGS__)
 
+/* Max. number of areas remembered per frame to bring the back buffer up to
+ * date after a flip. More areas (or a large total) copy the whole frame. */
+#ifndef DRM_DAMAGE_MAX
+#define DRM_DAMAGE_MAX		16
+#endif
+
+/* Give up waiting for a flip-complete event after this long */
+#ifndef DRM_FLIP_TIMEOUT_MS
+#define DRM_FLIP_TIMEOUT_MS	100
+#endif
+
 struct drm_buffer {
 	uint32_t handle;
 	uint32_t pitch;
@@ -66,9 +79,28 @@ struct drm_dev {
 	drmModePropertyPtr crtc_props[128];
 	drmModePropertyPtr conn_props[128];
 	struct drm_buffer drm_bufs[2]; /* DUMB buffers */
-	struct drm_buffer *cur_bufs[2]; /* double buffering handling */
+	struct drm_buffer *cur_bufs[2]; /* [0] on screen, [1] being drawn */
+	bool atomic;			/* atomic commits, else legacy SetCrtc/PageFlip */
+	bool modeset_done;		/* the first commit did the modeset */
+	bool flip_pending;		/* waiting for the flip-complete event */
+	uint32_t prop_fb_id, prop_crtc_id, prop_src_x, prop_src_y, prop_src_w, prop_src_h;
+	uint32_t prop_crtc_x, prop_crtc_y, prop_crtc_w, prop_crtc_h;
+	uint64_t commit_us;		/* when the pending flip was committed */
+	lv_area_t damage[DRM_DAMAGE_MAX]; /* areas drawn into cur_bufs[1] this frame */
+	uint32_t damage_cnt;
+	uint32_t damage_px;
+	bool damage_full;
+	pthread_mutex_t stats_lock;
+	drm_present_stats_t stats;
 } drm_dev;
 
+static uint64_t get_time_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 static uint32_t get_plane_property_id(const char *name)
 {
 	uint32_t i;
@@ -114,10 +146,31 @@ static uint32_t get_conn_property_id(const char *name)
 	return 0;
 }
 
+/* The kernel reports the vblank the new buffer went on screen at (CLOCK_MONOTONIC) */
 static void page_flip_handler(int fd, unsigned int sequence, unsigned int tv_sec,
 			      unsigned int tv_usec, void *user_data)
 {
+	uint64_t present_us = (uint64_t)tv_sec * 1000000 + tv_usec;
+	drm_present_stats_t *st = &drm_dev.stats;
+
 	dbg("flip");
+
+	pthread_mutex_lock(&drm_dev.stats_lock);
+	if (st->frames > 0) {
+		st->last_interval_us = present_us - st->last_present_us;
+		/* A frame that took more than one vblank to arrive */
+		if (sequence - st->last_sequence > 1)
+			st->missed_vblanks += sequence - st->last_sequence - 1;
+	}
+	st->frames++;
+	st->last_sequence = sequence;
+	st->last_present_us = present_us;
+	st->last_latency_us = present_us > drm_dev.commit_us ? present_us - drm_dev.commit_us : 0;
+	if (st->last_latency_us > st->max_latency_us)
+		st->max_latency_us = st->last_latency_us;
+	pthread_mutex_unlock(&drm_dev.stats_lock);
+
+	drm_dev.flip_pending = false;
 }
 
 static int drm_get_plane_props(void)
@@ -183,25 +236,44 @@ static int drm_get_conn_props(void)
 	return 0;
 }
 
-static int drm_add_plane_property(const char *name, uint64_t value)
+static int drm_add_plane_property(uint32_t prop_id, uint64_t value)
 {
 	int ret;
-	uint32_t prop_id = get_plane_property_id(name);
-
-	if (!prop_id) {
-		err("Couldn't find plane prop %s", name);
-		return -1;
-	}
 
-	ret = drmModeAtomicAddProperty(drm_dev.req, drm_dev.plane_id, get_plane_property_id(name), value);
+	ret = drmModeAtomicAddProperty(drm_dev.req, drm_dev.plane_id, prop_id, value);
 	if (ret < 0) {
-		err("drmModeAtomicAddProperty (%s:%" PRIu64 ") failed: %d", name, value, ret);
+		err("drmModeAtomicAddProperty (%u:%" PRIu64 ") failed: %d", prop_id, value, ret);
 		return ret;
 	}
 
 	return 0;
 }
 
+/* Plane properties are set on every commit: look them up once */
+static int drm_cache_plane_props(void)
+{
+	drm_dev.prop_fb_id = get_plane_property_id("FB_ID");
+	drm_dev.prop_crtc_id = get_plane_property_id("CRTC_ID");
+	drm_dev.prop_src_x = get_plane_property_id("SRC_X");
+	drm_dev.prop_src_y = get_plane_property_id("SRC_Y");
+	drm_dev.prop_src_w = get_plane_property_id("SRC_W");
+	drm_dev.prop_src_h = get_plane_property_id("SRC_H");
+	drm_dev.prop_crtc_x = get_plane_property_id("CRTC_X");
+	drm_dev.prop_crtc_y = get_plane_property_id("CRTC_Y");
+	drm_dev.prop_crtc_w = get_plane_property_id("CRTC_W");
+	drm_dev.prop_crtc_h = get_plane_property_id("CRTC_H");
+
+	if (!drm_dev.prop_fb_id || !drm_dev.prop_crtc_id || !drm_dev.prop_src_x ||
+	    !drm_dev.prop_src_y || !drm_dev.prop_src_w || !drm_dev.prop_src_h ||
+	    !drm_dev.prop_crtc_x || !drm_dev.prop_crtc_y || !drm_dev.prop_crtc_w ||
+	    !drm_dev.prop_crtc_h) {
+		err("Couldn't find plane props");
+		return -1;
+	}
+
+	return 0;
+}
+
 static int drm_add_crtc_property(const char *name, uint64_t value)
 {
 	int ret;
@@ -243,44 +315,113 @@ static int drm_add_conn_property(const char *name, uint64_t value)
 static int drm_dmabuf_set_plane(struct drm_buffer *buf)
 {
 	int ret;
-	static int first = 1;
-	uint32_t flags = DRM_MODE_PAGE_FLIP_EVENT;
+	uint32_t flags = DRM_MODE_PAGE_FLIP_EVENT | DRM_MODE_ATOMIC_NONBLOCK;
 
 	drm_dev.req = drmModeAtomicAlloc();
 
 	/* On first Atomic commit, do a modeset */
-	if (first) {
+	if (!drm_dev.modeset_done) {
 		drm_add_conn_property("CRTC_ID", drm_dev.crtc_id);
 
 		drm_add_crtc_property("MODE_ID", drm_dev.blob_id);
 		drm_add_crtc_property("ACTIVE", 1);
 
 		flags |= DRM_MODE_ATOMIC_ALLOW_MODESET;
-
-		first = 0;
 	}
 
-	drm_add_plane_property("FB_ID", buf->fb_handle);
-	drm_add_plane_property("CRTC_ID", drm_dev.crtc_id);
-	drm_add_plane_property("SRC_X", 0);
-	drm_add_plane_property("SRC_Y", 0);
-	drm_add_plane_property("SRC_W", drm_dev.width << 16);
-	drm_add_plane_property("SRC_H", drm_dev.height << 16);
-	drm_add_plane_property("CRTC_X", 0);
-	drm_add_plane_property("CRTC_Y", 0);
-	drm_add_plane_property("CRTC_W", drm_dev.width);
-	drm_add_plane_property("CRTC_H", drm_dev.height);
+	drm_add_plane_property(drm_dev.prop_fb_id, buf->fb_handle);
+	drm_add_plane_property(drm_dev.prop_crtc_id, drm_dev.crtc_id);
+	drm_add_plane_property(drm_dev.prop_src_x, 0);
+	drm_add_plane_property(drm_dev.prop_src_y, 0);
+	drm_add_plane_property(drm_dev.prop_src_w, drm_dev.width << 16);
+	drm_add_plane_property(drm_dev.prop_src_h, drm_dev.height << 16);
+	drm_add_plane_property(drm_dev.prop_crtc_x, 0);
+	drm_add_plane_property(drm_dev.prop_crtc_y, 0);
+	drm_add_plane_property(drm_dev.prop_crtc_w, drm_dev.width);
+	drm_add_plane_property(drm_dev.prop_crtc_h, drm_dev.height);
 
 	ret = drmModeAtomicCommit(drm_dev.fd, drm_dev.req, flags, NULL);
+	drmModeAtomicFree(drm_dev.req);
+	drm_dev.req = NULL;
 	if (ret) {
 		err("drmModeAtomicCommit failed: %s", strerror(errno));
-		drmModeAtomicFree(drm_dev.req);
 		return ret;
 	}
 
+	drm_dev.modeset_done = true;
 	return 0;
 }
 
+/* Drivers without atomic support: SetCrtc once, then page flips */
+static int drm_legacy_flip(struct drm_buffer *buf)
+{
+	int ret;
+
+	if (!drm_dev.modeset_done) {
+		ret = drmModeSetCrtc(drm_dev.fd, drm_dev.crtc_id, buf->fb_handle, 0, 0,
+				     &drm_dev.conn_id, 1, &drm_dev.mode);
+		if (ret) {
+			err("drmModeSetCrtc failed: %s", strerror(errno));
+			return ret;
+		}
+		drm_dev.modeset_done = true;
+		/* Synchronous, there is no event to wait for */
+		drm_dev.flip_pending = false;
+		return 0;
+	}
+
+	ret = drmModePageFlip(drm_dev.fd, drm_dev.crtc_id, buf->fb_handle,
+			      DRM_MODE_PAGE_FLIP_EVENT, NULL);
+	if (ret) {
+		err("drmModePageFlip failed: %s", strerror(errno));
+		return ret;
+	}
+
+	return 0;
+}
+
+/* Remember an area drawn into the back buffer in the current frame */
+static void drm_damage_add(int32_t x1, int32_t y1, int32_t x2, int32_t y2)
+{
+	if (drm_dev.damage_full)
+		return;
+
+	drm_dev.damage_px += (x2 - x1 + 1) * (y2 - y1 + 1);
+	if (drm_dev.damage_cnt == DRM_DAMAGE_MAX ||
+	    drm_dev.damage_px >= drm_dev.width * drm_dev.height) {
+		drm_dev.damage_full = true;
+		return;
+	}
+
+	lv_area_set(&drm_dev.damage[drm_dev.damage_cnt++], x1, y1, x2, y2);
+}
+
+/* Bring the new back buffer (two frames old) up to date with the frame that
+ * was just presented by copying that frame's damage */
+static void drm_damage_sync(struct drm_buffer *dst, const struct drm_buffer *src)
+{
+	uint32_t bpp = LV_COLOR_SIZE / 8;
+	uint32_t i;
+	int32_t y;
+
+	if (drm_dev.damage_full) {
+		memcpy(dst->map, src->map, dst->size);
+	} else {
+		for (i = 0; i < drm_dev.damage_cnt; i++) {
+			const lv_area_t *a = &drm_dev.damage[i];
+			uint32_t len = lv_area_get_width(a) * bpp;
+			for (y = a->y1; y <= a->y2; y++) {
+				uint32_t off = y * src->pitch + a->x1 * bpp;
+				memcpy((uint8_t *)dst->map + off, (uint8_t *)src->map + off, len);
+			}
+		}
+	}
+
+	drm_dev.damage_cnt = 0;
+	drm_dev.damage_px = 0;
+	drm_dev.damage_full = false;
+}
+
 static int find_plane(unsigned int fourcc, uint32_t *plane_id, uint32_t crtc_id, uint32_t crtc_idx)
 {
 	drmModePlaneResPtr planes;
@@ -464,7 +605,7 @@ static int drm_find_connector(void)
 		drmModeFreeEncoder(enc);
 	}
 
-	drm_dev.crtc_idx = -1;
+	drm_dev.crtc_idx = UINT32_MAX;
 
 	for (i = 0; i < res->count_crtcs; ++i) {
 		if (drm_dev.crtc_id == res->crtcs[i]) {
@@ -473,12 +614,12 @@ static int drm_find_connector(void)
 		}
 	}
 
-	if (drm_dev.crtc_idx == -1) {
+	if (drm_dev.crtc_idx == UINT32_MAX) {
 		err("drm: CRTC not found");
 		goto free_res;
 	}
 
-	dbg("crtc_idx: %d", drm_dev.crtc_idx);
+	dbg("crtc_idx: %u", drm_dev.crtc_idx);
 
 	return 0;
 
@@ -535,10 +676,9 @@ static int drm_setup(unsigned int fourcc)
 		return -1;
 
 	ret = drmSetClientCap(drm_dev.fd, DRM_CLIENT_CAP_ATOMIC, 1);
-	if (ret) {
-		err("No atomic modesetting support: %s", strerror(errno));
-		goto err;
-	}
+	drm_dev.atomic = (ret == 0);
+	if (!drm_dev.atomic)
+		info("drm: no atomic modesetting support, using legacy page flips");
 
 	ret = drm_find_connector();
 	if (ret) {
@@ -546,18 +686,6 @@ static int drm_setup(unsigned int fourcc)
 		goto err;
 	}
 
-	ret = find_plane(fourcc, &drm_dev.plane_id, drm_dev.crtc_id, drm_dev.crtc_idx);
-	if (ret) {
-		err("Cannot find plane");
-		goto err;
-	}
-
-	drm_dev.plane = drmModeGetPlane(drm_dev.fd, drm_dev.plane_id);
-	if (!drm_dev.plane) {
-		err("Cannot get plane");
-		goto err;
-	}
-
 	drm_dev.crtc = drmModeGetCrtc(drm_dev.fd, drm_dev.crtc_id);
 	if (!drm_dev.crtc) {
 		err("Cannot get crtc");
@@ -570,22 +698,40 @@ static int drm_setup(unsigned int fourcc)
 		goto err;
 	}
 
-	ret = drm_get_plane_props();
-	if (ret) {
-		err("Cannot get plane props");
-		goto err;
-	}
+	if (drm_dev.atomic) {
+		ret = find_plane(fourcc, &drm_dev.plane_id, drm_dev.crtc_id, drm_dev.crtc_idx);
+		if (ret) {
+			err("Cannot find plane");
+			goto err;
+		}
 
-	ret = drm_get_crtc_props();
-	if (ret) {
-		err("Cannot get crtc props");
-		goto err;
-	}
+		drm_dev.plane = drmModeGetPlane(drm_dev.fd, drm_dev.plane_id);
+		if (!drm_dev.plane) {
+			err("Cannot get plane");
+			goto err;
+		}
 
-	ret = drm_get_conn_props();
-	if (ret) {
-		err("Cannot get connector props");
-		goto err;
+		ret = drm_get_plane_props();
+		if (ret) {
+			err("Cannot get plane props");
+			goto err;
+		}
+
+		ret = drm_cache_plane_props();
+		if (ret)
+			goto err;
+
+		ret = drm_get_crtc_props();
+		if (ret) {
+			err("Cannot get crtc props");
+			goto err;
+		}
+
+		ret = drm_get_conn_props();
+		if (ret) {
+			err("Cannot get connector props");
+			goto err;
+		}
 	}
 
 	drm_dev.drm_event_ctx.version = DRM_EVENT_CONTEXT_VERSION;
@@ -678,80 +824,122 @@ static int drm_setup_buffers(void)
 	if (ret)
 		return ret;
 
-	/* Set buffering handling */
-	drm_dev.cur_bufs[0] = NULL;
+	/* Set buffering handling: both buffers start cleared, so nothing has to
+	 * be synced before the first frame */
+	drm_dev.cur_bufs[0] = &drm_dev.drm_bufs[1];
 	drm_dev.cur_bufs[1] = &drm_dev.drm_bufs[0];
 
 	return 0;
 }
 
+/**
+ * Block until the pending flip (if any) has completed
+ * @param disp_drv unused, so it can also serve as `wait_cb`
+ */
 void drm_wait_vsync(lv_disp_drv_t *disp_drv)
 {
+	struct pollfd pfd;
 	int ret;
-	fd_set fds;
-	FD_ZERO(&fds);
-	FD_SET(drm_dev.fd, &fds);
 
-	do {
-		ret = select(drm_dev.fd + 1, &fds, NULL, NULL, NULL);
-	} while (ret == -1 && errno == EINTR);
+	LV_UNUSED(disp_drv);
 
-	if (ret < 0) {
-		err("select failed: %s", strerror(errno));
-		drmModeAtomicFree(drm_dev.req);
-		drm_dev.req = NULL;
-		return;
-	}
+	pfd.fd = drm_dev.fd;
+	pfd.events = POLLIN;
 
-	if (FD_ISSET(drm_dev.fd, &fds))
-		drmHandleEvent(drm_dev.fd, &drm_dev.drm_event_ctx);
+	while (drm_dev.flip_pending) {
+		ret = poll(&pfd, 1, DRM_FLIP_TIMEOUT_MS);
+		if (ret < 0 && errno == EINTR)
+			continue;
 
-	drmModeAtomicFree(drm_dev.req);
-	drm_dev.req = NULL;
+		if (ret <= 0) {
+			err("flip-complete event %s", ret == 0 ? "timed out" : strerror(errno));
+			drm_dev.flip_pending = false;
+			break;
+		}
+
+		drmHandleEvent(drm_dev.fd, &drm_dev.drm_event_ctx);
+	}
 }
 
+/**
+ * Copy an area into the back buffer. The last area of a frame flips the
+ * buffers and `lv_disp_flush_ready` is only called once the flip-complete
+ * event arrived, so the next frame never draws into the scanned out buffer.
+ */
 void drm_flush(lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_t *color_p)
 {
 	struct drm_buffer *fbuf = drm_dev.cur_bufs[1];
-	lv_coord_t w = (area->x2 - area->x1 + 1);
-	lv_coord_t h = (area->y2 - area->y1 + 1);
-	int i, y;
+	uint32_t bpp = LV_COLOR_SIZE / 8;
+	int32_t y;
 
-	dbg("x %d:%d y %d:%d w %d h %d", area->x1, area->x2, area->y1, area->y2, w, h);
+	if (drm_dev.fd < 0 || fbuf == NULL || area->x2 < 0 || area->y2 < 0 ||
+	    area->x1 > (int32_t)drm_dev.width - 1 || area->y1 > (int32_t)drm_dev.height - 1) {
+		lv_disp_flush_ready(disp_drv);
+		return;
+	}
 
-	/* Partial update */
-	if ((w != drm_dev.width || h != drm_dev.height) && drm_dev.cur_bufs[0])
-		memcpy(fbuf->map, drm_dev.cur_bufs[0]->map, fbuf->size);
+	/* Truncate the area to the screen */
+	int32_t act_x1 = area->x1 < 0 ? 0 : area->x1;
+	int32_t act_y1 = area->y1 < 0 ? 0 : area->y1;
+	int32_t act_x2 = area->x2 > (int32_t)drm_dev.width - 1 ? (int32_t)drm_dev.width - 1 : area->x2;
+	int32_t act_y2 = area->y2 > (int32_t)drm_dev.height - 1 ? (int32_t)drm_dev.height - 1 : area->y2;
+	lv_coord_t src_w = lv_area_get_width(area);
+	uint32_t len = (act_x2 - act_x1 + 1) * bpp;
 
-	for (y = 0, i = area->y1 ; i <= area->y2 ; ++i, ++y) {
-                memcpy((uint8_t *)fbuf->map + (area->x1 * (LV_COLOR_SIZE/8)) + (fbuf->pitch * i),
-                       (uint8_t *)color_p + (w * (LV_COLOR_SIZE/8) * y),
-		       w * (LV_COLOR_SIZE/8));
+	dbg("x %d:%d y %d:%d", act_x1, act_x2, act_y1, act_y2);
+
+	color_p += (act_y1 - area->y1) * src_w + (act_x1 - area->x1);
+	for (y = act_y1; y <= act_y2; y++) {
+		memcpy((uint8_t *)fbuf->map + act_x1 * bpp + fbuf->pitch * y, color_p, len);
+		color_p += src_w;
 	}
 
-	if (drm_dev.req)
-		drm_wait_vsync(disp_drv);
+	drm_damage_add(act_x1, act_y1, act_x2, act_y2);
+
+	if (!lv_disp_flush_is_last(disp_drv)) {
+		lv_disp_flush_ready(disp_drv);
+		return;
+	}
 
 	/* show fbuf plane */
-	if (drm_dmabuf_set_plane(fbuf)) {
+	drm_dev.flip_pending = true;
+	drm_dev.commit_us = get_time_us();
+	if ((drm_dev.atomic ? drm_dmabuf_set_plane(fbuf) : drm_legacy_flip(fbuf)) != 0) {
 		err("Flush fail");
+		drm_dev.flip_pending = false;
+		lv_disp_flush_ready(disp_drv);
 		return;
 	}
-	else
-		dbg("Flush done");
 
-	if (!drm_dev.cur_bufs[0])
-		drm_dev.cur_bufs[1] = &drm_dev.drm_bufs[1];
-	else
-		drm_dev.cur_bufs[1] = drm_dev.cur_bufs[0];
+	drm_wait_vsync(disp_drv);
+	dbg("Flush done");
 
+	drm_dev.cur_bufs[1] = (fbuf == &drm_dev.drm_bufs[0]) ? &drm_dev.drm_bufs[1] : &drm_dev.drm_bufs[0];
 	drm_dev.cur_bufs[0] = fbuf;
+	drm_damage_sync(drm_dev.cur_bufs[1], fbuf);
 
 	lv_disp_flush_ready(disp_drv);
 }
 
+void drm_get_present_stats(drm_present_stats_t *stats)
+{
+	pthread_mutex_lock(&drm_dev.stats_lock);
+	*stats = drm_dev.stats;
+	pthread_mutex_unlock(&drm_dev.stats_lock);
+}
+
+/* Refresh period of the current mode, 60 Hz if unknown */
+uint32_t drm_get_refresh_period_us(void)
+{
+	if (drm_dev.mode.vrefresh == 0)
+		return 16667;
+
+	return 1000000 / drm_dev.mode.vrefresh;
+}
+
 #if LV_COLOR_DEPTH == 32
-#define DRM_FOURCC DRM_FORMAT_ARGB8888
+/* The primary plane of most drivers (vkms included) scans out XRGB8888 */
+#define DRM_FOURCC DRM_FORMAT_XRGB8888
 #elif LV_COLOR_DEPTH == 16
 #define DRM_FOURCC DRM_FORMAT_RGB565
 #else
@@ -774,6 +962,9 @@ void drm_init(void)
 {
 	int ret;
 
+	pthread_mutex_init(&drm_dev.stats_lock, NULL);
+	memset(&drm_dev.stats, 0, sizeof(drm_dev.stats));
+
 	ret = drm_setup(DRM_FOURCC);
 	if (ret) {
 		close(drm_dev.fd);
@@ -794,6 +985,29 @@ void drm_init(void)
 
 void drm_exit(void)
 {
+	int i;
+
+	if (drm_dev.fd < 0)
+		return;
+
+	drm_wait_vsync(NULL);
+
+	for (i = 0; i < 2; i++) {
+		struct drm_buffer *buf = &drm_dev.drm_bufs[i];
+		struct drm_mode_destroy_dumb dreq;
+
+		if (buf->fb_handle)
+			drmModeRmFB(drm_dev.fd, buf->fb_handle);
+		if (buf->map && buf->map != MAP_FAILED)
+			munmap(buf->map, buf->size);
+		if (buf->handle) {
+			memset(&dreq, 0, sizeof(dreq));
+			dreq.handle = buf->handle;
+			drmIoctl(drm_dev.fd, DRM_IOCTL_MODE_DESTROY_DUMB, &dreq);
+		}
+		memset(buf, 0, sizeof(*buf));
+	}
+
 	close(drm_dev.fd);
 	drm_dev.fd = -1;
 }
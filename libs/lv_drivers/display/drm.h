@@ -36,6 +36,15 @@ extern "C" {
 /**********************
  *      TYPEDEFS
  **********************/
+typedef struct {
+    uint32_t frames;          /*Flips completed*/
+    uint32_t missed_vblanks;  /*Vblanks skipped between consecutive flips*/
+    uint32_t last_sequence;   /*Vblank counter of the last flip*/
+    uint64_t last_present_us; /*CLOCK_MONOTONIC time the last frame went on screen*/
+    uint32_t last_interval_us;/*Time between the last two presents*/
+    uint32_t last_latency_us; /*Commit -> on screen for the last frame*/
+    uint32_t max_latency_us;
+} drm_present_stats_t;
 
 /**********************
  * GLOBAL PROTOTYPES
@@ -45,6 +54,8 @@ void drm_get_sizes(lv_coord_t *width, lv_coord_t *height, uint32_t *dpi);
 void drm_exit(void);
 void drm_flush(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color_p);
 void drm_wait_vsync(lv_disp_drv_t * drv);
+void drm_get_present_stats(drm_present_stats_t *stats);
+uint32_t drm_get_refresh_period_us(void);
 
 
 /**********************
@@ -0,0 +1,770 @@
+/**
+ * @file sunxiblit.c
+ *
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "sunxiblit.h"
+#if USE_SUNXIFB
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if SUNXIBLIT_NEON
+#include <arm_neon.h>
+#endif /* SUNXIBLIT_NEON */
+
+#include <time.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+/*4x4 ordered dither matrix (0..15)*/
+static const uint8_t bayer4[4][4] = {
+    { 0,  8,  2, 10},
+    {12,  4, 14,  6},
+    { 3, 11,  1,  9},
+    {15,  7, 13,  5},
+};
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+static void blit_copy(uint8_t * dst, const lv_color_t * src, uint32_t w,
+        uint32_t x, uint32_t y) {
+    LV_UNUSED(x);
+    LV_UNUSED(y);
+    memcpy(dst, src, w * sizeof(lv_color_t));
+}
+
+#if LV_COLOR_DEPTH != 32
+static void blit_generic32(uint8_t * dst, const lv_color_t * src, uint32_t w,
+        uint32_t x, uint32_t y) {
+    uint32_t * d = (uint32_t *) dst;
+    uint32_t i;
+    LV_UNUSED(x);
+    LV_UNUSED(y);
+    for (i = 0; i < w; i++)
+        d[i] = lv_color_to32(src[i]);
+}
+
+static void blit_generic24(uint8_t * dst, const lv_color_t * src, uint32_t w,
+        uint32_t x, uint32_t y) {
+    uint32_t i;
+    LV_UNUSED(x);
+    LV_UNUSED(y);
+    for (i = 0; i < w; i++) {
+        uint32_t c = lv_color_to32(src[i]);
+        dst[0] = c & 0xFF;
+        dst[1] = (c >> 8) & 0xFF;
+        dst[2] = (c >> 16) & 0xFF;
+        dst += 3;
+    }
+}
+
+static void blit_generic16(uint8_t * dst, const lv_color_t * src, uint32_t w,
+        uint32_t x, uint32_t y) {
+    uint16_t * d = (uint16_t *) dst;
+    uint32_t i;
+    LV_UNUSED(x);
+    LV_UNUSED(y);
+    for (i = 0; i < w; i++)
+        d[i] = lv_color_to16(src[i]);
+}
+
+static void blit_pack1_generic(uint8_t * dst, const lv_color_t * src, uint32_t w,
+        uint32_t x, uint32_t y) {
+    uint32_t i;
+    LV_UNUSED(y);
+    for (i = 0; i < w; i++, x++) {
+#if LV_COLOR_DEPTH == 1
+        bool on = src[i].full & 1;
+#else
+        bool on = lv_color_brightness(src[i]) >= 128;
+#endif
+        dst[x >> 3] &= ~(1 << (x & 7));
+        dst[x >> 3] |= on << (x & 7);
+    }
+}
+#endif /* LV_COLOR_DEPTH != 32 */
+
+#if LV_COLOR_DEPTH != 8
+static void blit_generic8(uint8_t * dst, const lv_color_t * src, uint32_t w,
+        uint32_t x, uint32_t y) {
+    uint32_t i;
+    LV_UNUSED(x);
+    LV_UNUSED(y);
+    for (i = 0; i < w; i++)
+        dst[i] = lv_color_to8(src[i]);
+}
+#endif /* LV_COLOR_DEPTH != 8 */
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+#if LV_COLOR_DEPTH == 32
+/*--------------------
+ * Scalar reference
+ *--------------------*/
+void sunxiblit_copy32_c(uint8_t * dst, const lv_color_t * src, uint32_t w,
+        uint32_t x, uint32_t y) {
+    blit_copy(dst, src, w, x, y);
+}
+
+static inline uint16_t rgb565(uint8_t r, uint8_t g, uint8_t b) {
+    return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+}
+
+void sunxiblit_to_rgb565_c(uint8_t * dst, const lv_color_t * src, uint32_t w,
+        uint32_t x, uint32_t y) {
+    uint16_t * d = (uint16_t *) dst;
+    uint32_t i;
+    LV_UNUSED(x);
+    LV_UNUSED(y);
+    for (i = 0; i < w; i++)
+        d[i] = rgb565(src[i].ch.red, src[i].ch.green, src[i].ch.blue);
+}
+
+void sunxiblit_to_rgb565_dither_c(uint8_t * dst, const lv_color_t * src,
+        uint32_t w, uint32_t x, uint32_t y) {
+    uint16_t * d = (uint16_t *) dst;
+    const uint8_t * row = bayer4[y & 3];
+    uint32_t i;
+    for (i = 0; i < w; i++) {
+        /*Red/blue drop 3 bits, green drops 2: scale the threshold to the lost range*/
+        uint8_t t = row[(x + i) & 3];
+        uint32_t r = src[i].ch.red + (t >> 1);
+        uint32_t g = src[i].ch.green + (t >> 2);
+        uint32_t b = src[i].ch.blue + (t >> 1);
+        d[i] = rgb565(LV_MIN(r, 255), LV_MIN(g, 255), LV_MIN(b, 255));
+    }
+}
+
+void sunxiblit_to_rgb888_c(uint8_t * dst, const lv_color_t * src, uint32_t w,
+        uint32_t x, uint32_t y) {
+    uint32_t i;
+    LV_UNUSED(x);
+    LV_UNUSED(y);
+    for (i = 0; i < w; i++) {
+        dst[0] = src[i].ch.blue;
+        dst[1] = src[i].ch.green;
+        dst[2] = src[i].ch.red;
+        dst += 3;
+    }
+}
+
+/*Same threshold as lv_color_brightness(c) >= 128*/
+static inline bool pixel_on(lv_color_t c) {
+    return 3u * c.ch.red + c.ch.blue + 4u * c.ch.green >= 1024;
+}
+
+void sunxiblit_pack1_c(uint8_t * dst, const lv_color_t * src, uint32_t w,
+        uint32_t x, uint32_t y) {
+    uint32_t i;
+    LV_UNUSED(y);
+    for (i = 0; i < w; i++, x++) {
+        dst[x >> 3] &= ~(1 << (x & 7));
+        dst[x >> 3] |= pixel_on(src[i]) << (x & 7);
+    }
+}
+
+/*Destination pixel of the top left of a rotated `w` x `h` block*/
+static inline uint32_t * rot_dst(uint8_t * dst, uint32_t dst_stride, uint32_t w,
+        uint32_t h, uint32_t sx, uint32_t sy, uint32_t bw, uint32_t bh,
+        uint32_t rotated) {
+    uint32_t left, top;
+
+    if (rotated == LV_DISP_ROT_90) {
+        left = sy;
+        top = w - sx - bw;
+    } else if (rotated == LV_DISP_ROT_270) {
+        left = h - sy - bh;
+        top = sx;
+    } else {
+        left = w - sx - bw;
+        top = h - sy - bh;
+    }
+
+    return (uint32_t *) (dst + top * dst_stride) + left;
+}
+
+void sunxiblit_rotate32_c(uint8_t * dst, uint32_t dst_stride, const lv_color_t * src,
+        uint32_t src_stride, uint32_t w, uint32_t h, uint32_t rotated) {
+    const uint32_t * s = (const uint32_t *) src;
+    uint32_t tx, ty, x, y;
+
+    /*Rows are only reversed, no tiling needed*/
+    if (rotated == LV_DISP_ROT_180) {
+        for (y = 0; y < h; y++) {
+            uint32_t * d = (uint32_t *) (dst + (h - 1 - y) * dst_stride) + w - 1;
+            const uint32_t * r = s + y * src_stride;
+            for (x = 0; x < w; x++)
+                *d-- = r[x];
+        }
+        return;
+    }
+
+    /*A source column becomes a destination row: go tile by tile so the
+     *lines touched on both sides stay in the cache*/
+    for (ty = 0; ty < h; ty += SUNXIBLIT_ROT_TILE) {
+        uint32_t th = LV_MIN(SUNXIBLIT_ROT_TILE, h - ty);
+        for (tx = 0; tx < w; tx += SUNXIBLIT_ROT_TILE) {
+            uint32_t tw = LV_MIN(SUNXIBLIT_ROT_TILE, w - tx);
+            for (x = tx; x < tx + tw; x++) {
+                const uint32_t * c = s + ty * src_stride + x;
+                if (rotated == LV_DISP_ROT_90) {
+                    uint32_t * d = (uint32_t *) (dst + (w - 1 - x) * dst_stride) + ty;
+                    for (y = 0; y < th; y++)
+                        d[y] = c[y * src_stride];
+                } else {
+                    uint32_t * d = (uint32_t *) (dst + x * dst_stride) + h - 1 - ty;
+                    for (y = 0; y < th; y++)
+                        *d-- = c[y * src_stride];
+                }
+            }
+        }
+    }
+}
+
+#if SUNXIBLIT_NEON
+/*--------------------
+ * ARMv7 NEON
+ *--------------------*/
+void sunxiblit_copy32_neon(uint8_t * dst, const lv_color_t * src, uint32_t w,
+        uint32_t x, uint32_t y) {
+    const uint32_t * s = (const uint32_t *) src;
+    uint32_t * d = (uint32_t *) dst;
+    LV_UNUSED(x);
+    LV_UNUSED(y);
+
+    for (; w >= 16; w -= 16) {
+        uint32x4_t a = vld1q_u32(s);
+        uint32x4_t b = vld1q_u32(s + 4);
+        uint32x4_t c = vld1q_u32(s + 8);
+        uint32x4_t e = vld1q_u32(s + 12);
+        vst1q_u32(d, a);
+        vst1q_u32(d + 4, b);
+        vst1q_u32(d + 8, c);
+        vst1q_u32(d + 12, e);
+        s += 16;
+        d += 16;
+    }
+    for (; w >= 4; w -= 4) {
+        vst1q_u32(d, vld1q_u32(s));
+        s += 4;
+        d += 4;
+    }
+    while (w--)
+        *d++ = *s++;
+}
+
+/*Pack 8 pixels: r[7:3] << 11 | g[7:2] << 5 | b[7:3]*/
+static inline uint16x8_t neon_pack565(uint8x8_t r, uint8x8_t g, uint8x8_t b) {
+    uint16x8_t out = vshll_n_u8(r, 8);
+    out = vsriq_n_u16(out, vshll_n_u8(g, 8), 5);
+    out = vsriq_n_u16(out, vshll_n_u8(b, 8), 11);
+    return out;
+}
+
+void sunxiblit_to_rgb565_neon(uint8_t * dst, const lv_color_t * src, uint32_t w,
+        uint32_t x, uint32_t y) {
+    const uint8_t * s = (const uint8_t *) src;
+    uint16_t * d = (uint16_t *) dst;
+    uint32_t n = w & ~7u;
+    uint32_t i;
+
+    for (i = 0; i < n; i += 8) {
+        uint8x8x4_t px = vld4_u8(s); /*B, G, R, A*/
+        vst1q_u16(d, neon_pack565(px.val[2], px.val[1], px.val[0]));
+        s += 32;
+        d += 8;
+    }
+    sunxiblit_to_rgb565_c((uint8_t *) d, src + n, w - n, x + n, y);
+}
+
+void sunxiblit_to_rgb565_dither_neon(uint8_t * dst, const lv_color_t * src,
+        uint32_t w, uint32_t x, uint32_t y) {
+    const uint8_t * s = (const uint8_t *) src;
+    uint16_t * d = (uint16_t *) dst;
+    const uint8_t * row = bayer4[y & 3];
+    uint32_t n = w & ~7u;
+    uint32_t i;
+
+    /*The matrix repeats every 4 columns, so one vector serves the whole row*/
+    uint8_t t[8];
+    for (i = 0; i < 8; i++)
+        t[i] = row[(x + i) & 3];
+    uint8x8_t thr = vld1_u8(t);
+    uint8x8_t thr_rb = vshr_n_u8(thr, 1);
+    uint8x8_t thr_g = vshr_n_u8(thr, 2);
+
+    for (i = 0; i < n; i += 8) {
+        uint8x8x4_t px = vld4_u8(s);
+        uint8x8_t r = vqadd_u8(px.val[2], thr_rb);
+        uint8x8_t g = vqadd_u8(px.val[1], thr_g);
+        uint8x8_t b = vqadd_u8(px.val[0], thr_rb);
+        vst1q_u16(d, neon_pack565(r, g, b));
+        s += 32;
+        d += 8;
+    }
+    sunxiblit_to_rgb565_dither_c((uint8_t *) d, src + n, w - n, x + n, y);
+}
+
+void sunxiblit_to_rgb888_neon(uint8_t * dst, const lv_color_t * src, uint32_t w,
+        uint32_t x, uint32_t y) {
+    const uint8_t * s = (const uint8_t *) src;
+    uint32_t n = w & ~7u;
+    uint32_t i;
+
+    for (i = 0; i < n; i += 8) {
+        uint8x8x4_t px = vld4_u8(s);
+        uint8x8x3_t out;
+        out.val[0] = px.val[0];
+        out.val[1] = px.val[1];
+        out.val[2] = px.val[2];
+        vst3_u8(dst, out);
+        s += 32;
+        dst += 24;
+    }
+    sunxiblit_to_rgb888_c(dst, src + n, w - n, x + n, y);
+}
+
+void sunxiblit_pack1_neon(uint8_t * dst, const lv_color_t * src, uint32_t w,
+        uint32_t x, uint32_t y) {
+    static const uint8_t bits[8] = {1, 2, 4, 8, 16, 32, 64, 128};
+    uint32_t head = (8 - (x & 7)) & 7;
+
+    /*Unaligned head bits*/
+    if (head > w)
+        head = w;
+    sunxiblit_pack1_c(dst, src, head, x, y);
+    src += head;
+    w -= head;
+    x += head;
+
+    /*Whole bytes, LSB first*/
+    const uint8_t * s = (const uint8_t *) src;
+    uint8_t * d = dst + (x >> 3);
+    uint8x8_t bit = vld1_u8(bits);
+    uint8x8_t k3 = vdup_n_u8(3);
+    uint8x8_t k4 = vdup_n_u8(4);
+    uint16x8_t limit = vdupq_n_u16(1024);
+    uint32_t n = w & ~7u;
+    uint32_t i;
+
+    for (i = 0; i < n; i += 8) {
+        uint8x8x4_t px = vld4_u8(s);
+        uint16x8_t l = vmull_u8(px.val[2], k3);
+        l = vaddw_u8(l, px.val[0]);
+        l = vmlal_u8(l, px.val[1], k4);
+        uint8x8_t on = vand_u8(vmovn_u16(vcgeq_u16(l, limit)), bit);
+        on = vpadd_u8(on, on);
+        on = vpadd_u8(on, on);
+        on = vpadd_u8(on, on);
+        *d++ = vget_lane_u8(on, 0);
+        s += 32;
+    }
+
+    /*Tail bits*/
+    sunxiblit_pack1_c(dst, src + n, w - n, x + n, y);
+}
+
+static inline uint32x4_t neon_rev32x4(uint32x4_t v) {
+    v = vrev64q_u32(v);
+    return vcombine_u32(vget_high_u32(v), vget_low_u32(v));
+}
+
+void sunxiblit_rotate32_neon(uint8_t * dst, uint32_t dst_stride, const lv_color_t * src,
+        uint32_t src_stride, uint32_t w, uint32_t h, uint32_t rotated) {
+    const uint32_t * s = (const uint32_t *) src;
+    uint32_t w4 = w & ~3u;
+    uint32_t h4 = h & ~3u;
+    uint32_t tx, ty, x, y;
+
+    if (rotated == LV_DISP_ROT_180) {
+        for (y = 0; y < h; y++) {
+            uint32_t * d = (uint32_t *) (dst + (h - 1 - y) * dst_stride) + w;
+            const uint32_t * r = s + y * src_stride;
+            for (x = 0; x < w4; x += 4) {
+                d -= 4;
+                vst1q_u32(d, neon_rev32x4(vld1q_u32(r + x)));
+            }
+            for (; x < w; x++)
+                *--d = r[x];
+        }
+        return;
+    }
+
+    /*4x4 transposes inside cache sized tiles*/
+    for (ty = 0; ty < h4; ty += SUNXIBLIT_ROT_TILE) {
+        uint32_t th = LV_MIN(SUNXIBLIT_ROT_TILE, h4 - ty);
+        for (tx = 0; tx < w4; tx += SUNXIBLIT_ROT_TILE) {
+            uint32_t tw = LV_MIN(SUNXIBLIT_ROT_TILE, w4 - tx);
+            for (y = ty; y < ty + th; y += 4) {
+                for (x = tx; x < tx + tw; x += 4) {
+                    const uint32_t * p = s + y * src_stride + x;
+                    uint32x4x2_t t01 = vtrnq_u32(vld1q_u32(p), vld1q_u32(p + src_stride));
+                    uint32x4x2_t t23 = vtrnq_u32(vld1q_u32(p + 2 * src_stride),
+                            vld1q_u32(p + 3 * src_stride));
+                    uint32x4_t c[4];
+                    uint32_t i;
+
+                    /*c[i] is source column x + i, rows y..y+3*/
+                    c[0] = vcombine_u32(vget_low_u32(t01.val[0]), vget_low_u32(t23.val[0]));
+                    c[1] = vcombine_u32(vget_low_u32(t01.val[1]), vget_low_u32(t23.val[1]));
+                    c[2] = vcombine_u32(vget_high_u32(t01.val[0]), vget_high_u32(t23.val[0]));
+                    c[3] = vcombine_u32(vget_high_u32(t01.val[1]), vget_high_u32(t23.val[1]));
+
+                    for (i = 0; i < 4; i++) {
+                        if (rotated == LV_DISP_ROT_90)
+                            vst1q_u32((uint32_t *) (dst + (w - 1 - x - i) * dst_stride) + y, c[i]);
+                        else
+                            vst1q_u32((uint32_t *) (dst + (x + i) * dst_stride) + h - 4 - y,
+                                    neon_rev32x4(c[i]));
+                    }
+                }
+            }
+        }
+    }
+
+    /*Right and bottom edges narrower than 4 pixels*/
+    if (w4 < w)
+        sunxiblit_rotate32_c((uint8_t *) rot_dst(dst, dst_stride, w, h, w4, 0, w - w4, h, rotated),
+                dst_stride, src + w4, src_stride, w - w4, h, rotated);
+    if (h4 < h)
+        sunxiblit_rotate32_c((uint8_t *) rot_dst(dst, dst_stride, w, h, 0, h4, w4, h - h4, rotated),
+                dst_stride, src + h4 * src_stride, src_stride, w4, h - h4, rotated);
+}
+#endif /* SUNXIBLIT_NEON */
+#endif /* LV_COLOR_DEPTH == 32 */
+
+sunxiblit_row_cb_t sunxiblit_select(uint32_t bits_per_pixel, bool dither,
+        const char ** name) {
+    sunxiblit_row_cb_t cb = NULL;
+    const char * n = "none";
+
+    LV_UNUSED(dither);
+
+    if (bits_per_pixel == LV_COLOR_DEPTH && bits_per_pixel != 1
+#if LV_COLOR_DEPTH == 32
+            && !SUNXIBLIT_NEON
+#endif
+            ) {
+        cb = blit_copy;
+        n = "copy";
+    }
+#if LV_COLOR_DEPTH == 32
+#if SUNXIBLIT_NEON
+    else if (bits_per_pixel == 32) {
+        cb = sunxiblit_copy32_neon;
+        n = "copy32_neon";
+    } else if (bits_per_pixel == 24) {
+        cb = sunxiblit_to_rgb888_neon;
+        n = "rgb888_neon";
+    } else if (bits_per_pixel == 16) {
+        cb = dither ? sunxiblit_to_rgb565_dither_neon : sunxiblit_to_rgb565_neon;
+        n = dither ? "rgb565_dither_neon" : "rgb565_neon";
+    } else if (bits_per_pixel == 1) {
+        cb = sunxiblit_pack1_neon;
+        n = "pack1_neon";
+    }
+#else
+    else if (bits_per_pixel == 24) {
+        cb = sunxiblit_to_rgb888_c;
+        n = "rgb888_c";
+    } else if (bits_per_pixel == 16) {
+        cb = dither ? sunxiblit_to_rgb565_dither_c : sunxiblit_to_rgb565_c;
+        n = dither ? "rgb565_dither_c" : "rgb565_c";
+    } else if (bits_per_pixel == 1) {
+        cb = sunxiblit_pack1_c;
+        n = "pack1_c";
+    }
+#endif /* SUNXIBLIT_NEON */
+#else
+    else if (bits_per_pixel == 32) {
+        cb = blit_generic32;
+        n = "generic32";
+    } else if (bits_per_pixel == 24) {
+        cb = blit_generic24;
+        n = "generic24";
+    } else if (bits_per_pixel == 16) {
+        cb = blit_generic16;
+        n = "generic16";
+    } else if (bits_per_pixel == 1) {
+        cb = blit_pack1_generic;
+        n = "pack1_generic";
+    }
+#endif /* LV_COLOR_DEPTH == 32 */
+#if LV_COLOR_DEPTH != 8
+    else if (bits_per_pixel == 8) {
+        cb = blit_generic8;
+        n = "generic8";
+    }
+#endif /* LV_COLOR_DEPTH != 8 */
+
+    if (name)
+        *name = n;
+
+    return cb;
+}
+
+sunxiblit_rotate_cb_t sunxiblit_select_rotate(uint32_t bits_per_pixel,
+        const char ** name) {
+    sunxiblit_rotate_cb_t cb = NULL;
+    const char * n = "none";
+
+#if LV_COLOR_DEPTH == 32
+    if (bits_per_pixel == 32) {
+#if SUNXIBLIT_NEON
+        cb = sunxiblit_rotate32_neon;
+        n = "rotate32_neon";
+#else
+        cb = sunxiblit_rotate32_c;
+        n = "rotate32_c";
+#endif /* SUNXIBLIT_NEON */
+    }
+#else
+    LV_UNUSED(bits_per_pixel);
+#endif /* LV_COLOR_DEPTH == 32 */
+
+    if (name)
+        *name = n;
+
+    return cb;
+}
+
+#define SELF_TEST_W     480
+#define SELF_TEST_H     480
+#define SELF_TEST_LOOPS 20
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*MB/s of source pixels converted by `cb` over a full screen*/
+static double bench(sunxiblit_row_cb_t cb, uint8_t * dst, uint32_t dst_stride,
+        const lv_color_t * src) {
+    double t0 = now_sec();
+    uint32_t i, y;
+    for (i = 0; i < SELF_TEST_LOOPS; i++)
+        for (y = 0; y < SELF_TEST_H; y++)
+            cb(dst + y * dst_stride, src + y * SELF_TEST_W, SELF_TEST_W, 0, y);
+    double t = now_sec() - t0;
+    return t > 0 ? (double) SELF_TEST_LOOPS * SELF_TEST_W * SELF_TEST_H * sizeof(lv_color_t) / t / 1e6 : 0;
+}
+
+#if LV_COLOR_DEPTH == 32
+/*LVGL's sw_rotate path (lv_refr.c): rotate LV_DISP_ROT_MAX_BUF sized chunks
+ *pixel by pixel into a temporary buffer, or reverse the whole buffer in place
+ *for 180 degrees, then copy the rows to the framebuffer*/
+static void rotate_lvgl(uint8_t * dst, uint32_t dst_stride, lv_color_t * buf,
+        uint32_t w, uint32_t h, uint32_t rotated, lv_color_t * rot_buf) {
+    uint32_t x, y, row;
+
+    if (rotated == LV_DISP_ROT_180) {
+        uint32_t i = w * h - 1, j = 0;
+        while (i > j) {
+            lv_color_t tmp = buf[i];
+            buf[i--] = buf[j];
+            buf[j++] = tmp;
+        }
+        for (y = 0; y < h; y++)
+            memcpy(dst + y * dst_stride, buf + y * w, w * sizeof(lv_color_t));
+        return;
+    }
+
+    uint32_t max_row = LV_MIN(LV_DISP_ROT_MAX_BUF / sizeof(lv_color_t) / w, h);
+    for (row = 0; row < h; row += max_row) {
+        uint32_t height = LV_MIN(max_row, h - row);
+        bool invert_i = rotated == LV_DISP_ROT_270;
+        uint32_t invert = w * height - 1;
+        const lv_color_t * p = buf + row * w;
+
+        for (y = 0; y < height; y++) {
+            uint32_t i = (w - 1) * height + y;
+            if (invert_i)
+                i = invert - i;
+            for (x = 0; x < w; x++) {
+                rot_buf[i] = *p++;
+                if (invert_i)
+                    i += height;
+                else
+                    i -= height;
+            }
+        }
+
+        /*The chunk is `height` pixels wide and `w` lines high*/
+        uint32_t left = rotated == LV_DISP_ROT_90 ? row : h - row - height;
+        for (y = 0; y < w; y++)
+            memcpy(dst + y * dst_stride + left * sizeof(lv_color_t),
+                    rot_buf + y * height, height * sizeof(lv_color_t));
+    }
+}
+
+/*Check the rotation kernels against LVGL's path and print Mpx/s of each*/
+static int rotate_self_test(void) {
+    static const struct {
+        uint32_t w;
+        uint32_t h;
+    } sizes[] = { {37, 23}, {480, 480}, {800, 480} };
+    static const uint32_t rots[] = { LV_DISP_ROT_90, LV_DISP_ROT_180, LV_DISP_ROT_270 };
+    struct {
+        const char * name;
+        sunxiblit_rotate_cb_t cb;
+    } kernels[] = {
+        {"c", sunxiblit_rotate32_c},
+#if SUNXIBLIT_NEON
+        {"neon", sunxiblit_rotate32_neon},
+#endif /* SUNXIBLIT_NEON */
+    };
+    uint32_t npx = 800 * 480;
+    lv_color_t * src = malloc(npx * sizeof(lv_color_t));
+    lv_color_t * buf = malloc(npx * sizeof(lv_color_t));
+    lv_color_t * rot_buf = malloc(LV_DISP_ROT_MAX_BUF);
+    uint8_t * ref = malloc(npx * sizeof(lv_color_t));
+    uint8_t * out = malloc(npx * sizeof(lv_color_t));
+    int errors = 0;
+    uint32_t i, k, r, z;
+
+    if (src == NULL || buf == NULL || rot_buf == NULL || ref == NULL || out == NULL) {
+        errors = -1;
+        goto out;
+    }
+
+    for (i = 0; i < npx; i++)
+        src[i].full = ((uint32_t) rand() << 16) ^ (uint32_t) rand();
+
+    for (z = 0; z < sizeof(sizes) / sizeof(sizes[0]); z++) {
+        for (r = 0; r < sizeof(rots) / sizeof(rots[0]); r++) {
+            uint32_t w = sizes[z].w, h = sizes[z].h, rot = rots[r];
+            uint32_t stride = (rot == LV_DISP_ROT_180 ? w : h) * sizeof(lv_color_t);
+            double mpx[2] = { 0, 0 };
+            bool ok = true;
+
+            memcpy(buf, src, w * h * sizeof(lv_color_t));
+            rotate_lvgl(ref, stride, buf, w, h, rot, rot_buf);
+
+            double t0 = now_sec();
+            for (i = 0; i < SELF_TEST_LOOPS; i++)
+                rotate_lvgl(out, stride, buf, w, h, rot, rot_buf);
+            double t_lvgl = now_sec() - t0;
+
+            for (k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+                memset(out, 0x5A, w * h * sizeof(lv_color_t));
+                kernels[k].cb(out, stride, src, w, w, h, rot);
+                ok = ok && memcmp(ref, out, w * h * sizeof(lv_color_t)) == 0;
+
+                t0 = now_sec();
+                for (i = 0; i < SELF_TEST_LOOPS; i++)
+                    kernels[k].cb(out, stride, src, w, w, h, rot);
+                double t = now_sec() - t0;
+                mpx[k] = t > 0 ? (double) SELF_TEST_LOOPS * w * h / t / 1e6 : 0;
+            }
+
+            printf("sunxiblit rotate%-3u %3ux%-3u %s  lvgl %6.1f Mpx/s  c %6.1f Mpx/s",
+                    rot * 90, w, h, ok ? "ok  " : "FAIL",
+                    t_lvgl > 0 ? (double) SELF_TEST_LOOPS * w * h / t_lvgl / 1e6 : 0,
+                    mpx[0]);
+#if SUNXIBLIT_NEON
+            printf("  neon %6.1f Mpx/s", mpx[1]);
+#endif /* SUNXIBLIT_NEON */
+            printf("\n");
+            if (!ok)
+                errors++;
+        }
+    }
+
+out:
+    free(src);
+    free(buf);
+    free(rot_buf);
+    free(ref);
+    free(out);
+    return errors;
+}
+#endif /* LV_COLOR_DEPTH == 32 */
+
+int sunxiblit_self_test(void) {
+    int errors = 0;
+#if LV_COLOR_DEPTH == 32
+    struct {
+        const char * name;
+        sunxiblit_row_cb_t ref;
+        sunxiblit_row_cb_t opt;
+        uint32_t bpp;
+    } kernels[] = {
+#if SUNXIBLIT_NEON
+        {"copy32", sunxiblit_copy32_c, sunxiblit_copy32_neon, 32},
+        {"rgb888", sunxiblit_to_rgb888_c, sunxiblit_to_rgb888_neon, 24},
+        {"rgb565", sunxiblit_to_rgb565_c, sunxiblit_to_rgb565_neon, 16},
+        {"rgb565_dither", sunxiblit_to_rgb565_dither_c, sunxiblit_to_rgb565_dither_neon, 16},
+        {"pack1", sunxiblit_pack1_c, sunxiblit_pack1_neon, 1},
+#else
+        {"copy32", sunxiblit_copy32_c, sunxiblit_copy32_c, 32},
+        {"rgb888", sunxiblit_to_rgb888_c, sunxiblit_to_rgb888_c, 24},
+        {"rgb565", sunxiblit_to_rgb565_c, sunxiblit_to_rgb565_c, 16},
+        {"rgb565_dither", sunxiblit_to_rgb565_dither_c, sunxiblit_to_rgb565_dither_c, 16},
+        {"pack1", sunxiblit_pack1_c, sunxiblit_pack1_c, 1},
+#endif /* SUNXIBLIT_NEON */
+    };
+    uint32_t npx = SELF_TEST_W * SELF_TEST_H;
+    lv_color_t * src = malloc(npx * sizeof(lv_color_t));
+    uint8_t * a = malloc(npx * 4 + 64);
+    uint8_t * b = malloc(npx * 4 + 64);
+    uint32_t i, k;
+
+    if (src == NULL || a == NULL || b == NULL) {
+        free(src);
+        free(a);
+        free(b);
+        return -1;
+    }
+
+    srand(1);
+    for (i = 0; i < npx; i++)
+        src[i].full = ((uint32_t) rand() << 16) ^ (uint32_t) rand();
+
+    for (k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        uint32_t stride = kernels[k].bpp == 1 ? (SELF_TEST_W + 7) / 8 + 1 : SELF_TEST_W * kernels[k].bpp / 8 + 4;
+        bool ok = true;
+        uint32_t x, w;
+
+        /*Odd widths and start columns exercise the heads and tails*/
+        for (x = 0; x < 9 && ok; x++) {
+            for (w = 1; w < 70 && ok; w += 7) {
+                uint32_t off = kernels[k].bpp == 1 ? 0 : x * kernels[k].bpp / 8;
+                memset(a, 0x5A, stride);
+                memset(b, 0x5A, stride);
+                kernels[k].ref(a + off, src + x, w, x, x);
+                kernels[k].opt(b + off, src + x, w, x, x);
+                ok = memcmp(a, b, stride) == 0;
+            }
+        }
+
+        double mb_ref = bench(kernels[k].ref, a, stride, src);
+        double mb_opt = bench(kernels[k].opt, b, stride, src);
+        printf("sunxiblit %-14s %s  ref %7.1f MB/s  opt %7.1f MB/s\n",
+                kernels[k].name, ok ? "ok  " : "FAIL", mb_ref, mb_opt);
+        if (!ok)
+            errors++;
+    }
+
+    free(src);
+    free(a);
+    free(b);
+
+    errors += rotate_self_test();
+#endif /* LV_COLOR_DEPTH == 32 */
+    return errors;
+}
+
+#endif /* USE_SUNXIFB */
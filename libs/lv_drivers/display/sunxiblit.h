@@ -0,0 +1,140 @@
+/**
+ * @file sunxiblit.h
+ *
+ * Row blit / pixel format conversion kernels used by sunxifb_flush.
+ * ARMv7 NEON versions are used when the compiler targets NEON,
+ * the scalar versions are the reference and the fallback on other CPUs.
+ */
+
+#ifndef SUNXIBLIT_H
+#define SUNXIBLIT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#ifndef LV_DRV_NO_CONF
+#ifdef LV_CONF_INCLUDE_SIMPLE
+#include "lv_drv_conf.h"
+#else
+#include "../../lv_drv_conf.h"
+#endif
+#endif
+
+#if USE_SUNXIFB
+
+#ifdef LV_LVGL_H_INCLUDE_SIMPLE
+#include "lvgl.h"
+#else
+#include "lvgl/lvgl.h"
+#endif
+
+/*********************
+ *      DEFINES
+ *********************/
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define SUNXIBLIT_NEON 1
+#else
+#define SUNXIBLIT_NEON 0
+#endif
+
+/*Edge of the square tiles a rotation is done in, sized for the L1 cache*/
+#ifndef SUNXIBLIT_ROT_TILE
+#define SUNXIBLIT_ROT_TILE 16
+#endif
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+/**
+ * Convert one row of `w` LVGL pixels into framebuffer format.
+ * @param dst first destination byte of the row
+ * @param src source pixels
+ * @param w number of pixels
+ * @param x column of the first pixel (dither phase); for 1 bpp the bit index of
+ *          the first pixel inside `dst[0]`
+ * @param y row (dither phase)
+ */
+typedef void (*sunxiblit_row_cb_t)(uint8_t * dst, const lv_color_t * src,
+        uint32_t w, uint32_t x, uint32_t y);
+
+/**
+ * Rotate a block of LVGL pixels into the framebuffer, in the same direction as
+ * LVGL's `sw_rotate`.
+ * @param dst first byte of the destination rectangle (its top left pixel)
+ * @param dst_stride bytes per framebuffer line
+ * @param src source pixels
+ * @param src_stride pixels per source line
+ * @param w width of the source block
+ * @param h height of the source block
+ * @param rotated `LV_DISP_ROT_90`, `LV_DISP_ROT_180` or `LV_DISP_ROT_270`
+ */
+typedef void (*sunxiblit_rotate_cb_t)(uint8_t * dst, uint32_t dst_stride,
+        const lv_color_t * src, uint32_t src_stride, uint32_t w, uint32_t h,
+        uint32_t rotated);
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+/**
+ * Pick the row kernel for a framebuffer format.
+ * @param bits_per_pixel `vinfo.bits_per_pixel`
+ * @param dither use ordered dithering when reducing to 16 bpp
+ * @param name if not NULL, set to the name of the selected kernel
+ * @return the kernel or NULL if the format is not supported
+ */
+sunxiblit_row_cb_t sunxiblit_select(uint32_t bits_per_pixel, bool dither,
+        const char ** name);
+
+/**
+ * Pick the rotation kernel for a framebuffer format.
+ * @param bits_per_pixel `vinfo.bits_per_pixel`
+ * @param name if not NULL, set to the name of the selected kernel
+ * @return the kernel or NULL if rotation is not supported for the format
+ */
+sunxiblit_rotate_cb_t sunxiblit_select_rotate(uint32_t bits_per_pixel,
+        const char ** name);
+
+#if LV_COLOR_DEPTH == 32
+/*Scalar reference kernels*/
+void sunxiblit_copy32_c(uint8_t * dst, const lv_color_t * src, uint32_t w, uint32_t x, uint32_t y);
+void sunxiblit_to_rgb565_c(uint8_t * dst, const lv_color_t * src, uint32_t w, uint32_t x, uint32_t y);
+void sunxiblit_to_rgb565_dither_c(uint8_t * dst, const lv_color_t * src, uint32_t w, uint32_t x, uint32_t y);
+void sunxiblit_to_rgb888_c(uint8_t * dst, const lv_color_t * src, uint32_t w, uint32_t x, uint32_t y);
+void sunxiblit_pack1_c(uint8_t * dst, const lv_color_t * src, uint32_t w, uint32_t x, uint32_t y);
+void sunxiblit_rotate32_c(uint8_t * dst, uint32_t dst_stride, const lv_color_t * src,
+        uint32_t src_stride, uint32_t w, uint32_t h, uint32_t rotated);
+
+#if SUNXIBLIT_NEON
+void sunxiblit_copy32_neon(uint8_t * dst, const lv_color_t * src, uint32_t w, uint32_t x, uint32_t y);
+void sunxiblit_to_rgb565_neon(uint8_t * dst, const lv_color_t * src, uint32_t w, uint32_t x, uint32_t y);
+void sunxiblit_to_rgb565_dither_neon(uint8_t * dst, const lv_color_t * src, uint32_t w, uint32_t x, uint32_t y);
+void sunxiblit_to_rgb888_neon(uint8_t * dst, const lv_color_t * src, uint32_t w, uint32_t x, uint32_t y);
+void sunxiblit_pack1_neon(uint8_t * dst, const lv_color_t * src, uint32_t w, uint32_t x, uint32_t y);
+void sunxiblit_rotate32_neon(uint8_t * dst, uint32_t dst_stride, const lv_color_t * src,
+        uint32_t src_stride, uint32_t w, uint32_t h, uint32_t rotated);
+#endif /* SUNXIBLIT_NEON */
+#endif /* LV_COLOR_DEPTH == 32 */
+
+/**
+ * Check every NEON kernel against its scalar reference and print MB/s of each
+ * kernel. The rotation kernels are checked against and timed next to LVGL's
+ * `sw_rotate` path at 480x480 and 800x480. Run by bench/blit_bench.
+ * @return number of mismatching kernels
+ */
+int sunxiblit_self_test(void);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#endif  /*USE_SUNXIFB*/
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /*SUNXIBLIT_H*/
@@ -10,18 +10,23 @@
 #if USE_SUNXIFB
 
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <sys/ioctl.h>
+#include <pthread.h>
+#include <time.h>
 #include <linux/fb.h>
 
 #ifdef LV_USE_SUNXIFB_DEBUG
 #include <sys/time.h>
 #endif /* LV_USE_SUNXIFB_DEBUG */
 
+#include "sunxiblit.h"
+
 #ifdef USE_SUNXIFB_G2D
 #include "sunximem.h"
 #include "sunxig2d.h"
@@ -34,6 +39,48 @@
 #define SUNXIFB_PATH  "/dev/fb0"
 #endif
 
+/*Ordered dithering when converting to 16 bit per pixel*/
+#ifndef SUNXIFB_DITHER
+#define SUNXIFB_DITHER  0
+#endif
+
+#ifdef USE_SUNXIFB_DOUBLE_BUFFER
+/*Max. number of framebuffers in the present queue: 2 for double, 3 for
+ *triple buffering. The real number is limited by smem_len*/
+#ifndef SUNXIFB_MAX_BUFFERS
+#define SUNXIFB_MAX_BUFFERS  3
+#endif
+#endif /* USE_SUNXIFB_DOUBLE_BUFFER */
+
+/*Gaps between two frames longer than this are idle time, not slow frames*/
+#ifndef SUNXIFB_IDLE_MS
+#define SUNXIFB_IDLE_MS  100
+#endif
+
+#if defined(USE_SUNXIFB_DOUBLE_BUFFER) && !defined(USE_SUNXIFB_G2D)
+/*Without G2D the back buffer is synced by the CPU: only copy the areas
+ *drawn in the current frame instead of the whole frame*/
+#define SUNXIFB_DAMAGE_TRACK 1
+
+/*Max. number of damaged areas remembered per frame*/
+#ifndef SUNXIFB_DAMAGE_MAX
+#define SUNXIFB_DAMAGE_MAX  16
+#endif
+
+/*Copy the whole frame when the damage covers more than this percentage of the screen*/
+#ifndef SUNXIFB_DAMAGE_FULL_PCT
+#define SUNXIFB_DAMAGE_FULL_PCT  60
+#endif
+#endif /* USE_SUNXIFB_DOUBLE_BUFFER && !USE_SUNXIFB_G2D */
+
+/*UI compositing: tile size of the content mask*/
+#ifndef SUNXIFB_COMP_TILE
+#define SUNXIFB_COMP_TILE  32
+#endif
+
+/*Max. number of tiles, enough for 1920x1080 with 32 px tiles*/
+#define SUNXIFB_COMP_MAX_TILES  4096
+
 /**********************
  *      TYPEDEFS
  **********************/
@@ -41,10 +88,41 @@
 /**********************
  *      STRUCTURES
  **********************/
+#ifdef SUNXIFB_DAMAGE_TRACK
+struct sunxifb_damage {
+    lv_area_t area[SUNXIFB_DAMAGE_MAX];
+    uint32_t cnt;
+    uint32_t px;
+    bool full;
+};
+#endif /* SUNXIFB_DAMAGE_TRACK */
 
 /**********************
  *  STATIC PROTOTYPES
  **********************/
+static uint8_t* fb_addr(int32_t x, int32_t y);
+static bool comp_flush(const lv_area_t *area, lv_color_t *color_p,
+        int32_t act_x1, int32_t act_y1, int32_t act_x2, int32_t act_y2,
+        lv_area_t *written);
+static uint64_t get_time_us(void);
+static uint32_t refresh_period_us(void);
+static void present_record(uint64_t queued_us, uint64_t now_us);
+#ifdef USE_SUNXIFB_DOUBLE_BUFFER
+static void pan_to(uint32_t index);
+static void* present_thread(void *arg);
+static void present_queue(uint32_t index);
+static void present_next(void);
+static void present_drain(void);
+#endif /* USE_SUNXIFB_DOUBLE_BUFFER */
+#ifdef SUNXIFB_DAMAGE_TRACK
+static void damage_add(struct sunxifb_damage *d, int32_t x1, int32_t y1,
+        int32_t x2, int32_t y2);
+static void damage_merge(struct sunxifb_damage *dst,
+        const struct sunxifb_damage *src);
+static void damage_reset(struct sunxifb_damage *d);
+static uint32_t damage_sync(char *dst, const char *src,
+        struct sunxifb_damage *d);
+#endif /* SUNXIFB_DAMAGE_TRACK */
 
 /**********************
  *  STATIC VARIABLES
@@ -58,6 +136,42 @@ static uint32_t fbp_w;
 static uint32_t fbp_h;
 static uint32_t fbp_line_length;
 
+/*Converts one row of LVGL pixels to the framebuffer format, picked at init*/
+static sunxiblit_row_cb_t blit_row;
+
+/*Rotation done by the CPU in the flush when G2D rotation is not available*/
+static sunxiblit_rotate_cb_t blit_rotate;
+static uint32_t cpu_rotated = LV_DISP_ROT_NONE;
+
+/*UI compositing over the video layer: only tiles with UI content are
+ *written, empty tiles are cleared once and then left alone*/
+struct sunxifb_comp {
+    volatile bool en;
+    uint32_t cols;
+    uint32_t rows;
+    /*Masks published by the rendering thread, tagged with a sequence number*/
+    pthread_mutex_t lock;
+    uint8_t pending[2][SUNXIFB_COMP_MAX_TILES];
+    uint32_t pending_seq[2];
+    uint32_t seq;
+    /*Owned by the flushing thread*/
+    uint8_t mask[SUNXIFB_COMP_MAX_TILES];   /*Tile may contain UI in this frame*/
+    uint8_t dirty[SUNXIFB_COMP_MAX_TILES];  /*Tile may hold non-zero pixels on screen*/
+    uint32_t latched_seq;
+    bool frame_open;
+    uint32_t frame_written;
+    uint32_t frame_cleared;
+    uint32_t frame_skipped;
+    sunxifb_comp_stats_t stats;
+};
+
+static struct sunxifb_comp comp = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+/*Frame pacing statistics, written by the thread doing the flips*/
+static pthread_mutex_t pstats_lock = PTHREAD_MUTEX_INITIALIZER;
+static sunxifb_present_stats_t pstats;
+static uint64_t pstats_last_us;
+
 #ifdef USE_SUNXIFB_DOUBLE_BUFFER
 #define FBIO_CACHE_SYNC         0x4630
 #define FBIO_ENABLE_CACHE       0x4631
@@ -66,9 +180,9 @@ static uint32_t fbp_line_length;
 #define FBIOGET_DMABUF          _IOR('F', 0x21, struct fb_dmabuf_export)
 
 struct sunxifb_info {
-    char *screenfbp[2];
+    char *screenfbp[SUNXIFB_MAX_BUFFERS];
     uint32_t fbnum;
-    uint32_t fbindex;
+    uint32_t fbindex; /*Buffer being drawn*/
     volatile bool dbuf_en;
 #ifdef USE_SUNXIFB_G2D
 #ifdef USE_SUNXIFB_G2D_ROTATE
@@ -79,6 +193,23 @@ struct sunxifb_info {
     uint32_t rotatefbp_h;
 #endif /* USE_SUNXIFB_G2D_ROTATE */
 #endif /* USE_SUNXIFB_G2D */
+#ifdef SUNXIFB_DAMAGE_TRACK
+    struct sunxifb_damage damage;                        /*Drawn in this frame*/
+    struct sunxifb_damage pending[SUNXIFB_MAX_BUFFERS];  /*Missing from each buffer*/
+#endif /* SUNXIFB_DAMAGE_TRACK */
+    sunxifb_copy_stats_t copy_stats;
+
+    /*Present queue. With FBIO_WAITFORVSYNC the flips are done by a thread
+     *which waits for the vblank, otherwise directly in the flush*/
+    bool vsync;
+    bool present_run;
+    pthread_t present_tid;
+    pthread_mutex_t present_lock;
+    pthread_cond_t present_cond;
+    int queued;                      /*Buffer waiting to be shown, -1 if none*/
+    uint64_t queued_us;
+    uint32_t scanout;                /*Buffer on screen*/
+    bool busy[SUNXIFB_MAX_BUFFERS];  /*Queued or on screen: can not be drawn*/
 };
 
 static struct sunxifb_info sinfo;
@@ -138,21 +269,75 @@ void sunxifb_init(uint32_t rotated) {
     fbp_h = vinfo.yres;
     fbp_line_length = finfo.line_length;
 
+    comp.cols = (fbp_w + SUNXIFB_COMP_TILE - 1) / SUNXIFB_COMP_TILE;
+    comp.rows = (fbp_h + SUNXIFB_COMP_TILE - 1) / SUNXIFB_COMP_TILE;
+
+    memset(&pstats, 0, sizeof(pstats));
+    pstats.buffers = 1;
+    pstats.period_us = refresh_period_us();
+    pstats_last_us = 0;
+
+    const char *blit_name;
+    blit_row = sunxiblit_select(vinfo.bits_per_pixel, SUNXIFB_DITHER,
+            &blit_name);
+    printf("blit kernel: %s\n", blit_name);
+
+#ifndef USE_SUNXIFB_G2D_ROTATE
+    /*LVGL draws in the rotated orientation, the flush rotates into the
+     *framebuffer. Not supported formats are left to LVGL's sw_rotate*/
+    cpu_rotated = LV_DISP_ROT_NONE;
+    if (rotated != LV_DISP_ROT_NONE) {
+        blit_rotate = sunxiblit_select_rotate(vinfo.bits_per_pixel, &blit_name);
+        if (blit_rotate != NULL) {
+            cpu_rotated = rotated;
+            if (rotated == LV_DISP_ROT_90 || rotated == LV_DISP_ROT_270) {
+                fbp_w = vinfo.yres;
+                fbp_h = vinfo.xres;
+            }
+        }
+        printf("rotate kernel: %s\n", blit_name);
+    }
+#endif /* USE_SUNXIFB_G2D_ROTATE */
+
 #ifdef USE_SUNXIFB_DOUBLE_BUFFER
     memset(&sinfo, 0, sizeof(struct sunxifb_info));
     sinfo.dbuf_en = true;
     // Do not clear fb and pointer to back fb
     sinfo.fbnum = (uint32_t)(screensize / (finfo.line_length * vinfo.yres));
+    if (sinfo.fbnum > SUNXIFB_MAX_BUFFERS)
+        sinfo.fbnum = SUNXIFB_MAX_BUFFERS;
+    sinfo.queued = -1;
     if (sinfo.fbnum > 1) {
-        printf("Turn on double buffering.\n");
-
-        sinfo.screenfbp[0] = fbp;
-        sinfo.screenfbp[1] = fbp + finfo.line_length * vinfo.yres;
-
-        if (vinfo.yoffset == 0) {
-            sinfo.fbindex = !sinfo.fbindex;
-            fbp = sinfo.screenfbp[sinfo.fbindex];
+        printf("Turn on %s buffering.\n", sinfo.fbnum > 2 ? "triple" : "double");
+
+        uint32_t i;
+        for (i = 0; i < sinfo.fbnum; i++)
+            sinfo.screenfbp[i] = fbp + i * finfo.line_length * vinfo.yres;
+
+        /*Keep what is on the screen and draw into the next buffer*/
+        sinfo.scanout = vinfo.yoffset / vinfo.yres;
+        if (sinfo.scanout >= sinfo.fbnum)
+            sinfo.scanout = 0;
+        sinfo.busy[sinfo.scanout] = true;
+        sinfo.fbindex = (sinfo.scanout + 1) % sinfo.fbnum;
+        fbp = sinfo.screenfbp[sinfo.fbindex];
+        pstats.buffers = sinfo.fbnum;
+
+        /*Flip in a thread on the vblank if the driver can wait for it*/
+        uint32_t crtc = 0;
+        sinfo.vsync = ioctl(fbfd, FBIO_WAITFORVSYNC, &crtc) == 0;
+        if (sinfo.vsync) {
+            pthread_mutex_init(&sinfo.present_lock, NULL);
+            pthread_cond_init(&sinfo.present_cond, NULL);
+            sinfo.present_run = true;
+            if (pthread_create(&sinfo.present_tid, NULL, present_thread, NULL) != 0) {
+                perror("Error: cannot create present thread");
+                sinfo.present_run = false;
+                sinfo.vsync = false;
+            }
         }
+        printf("present queue: %u buffers, %s, refresh %u us\n", sinfo.fbnum,
+                sinfo.vsync ? "vsync" : "no vsync", pstats.period_us);
 
 #ifdef USE_SUNXIFB_G2D
         printf("Turn on 2d hardware acceleration.\n");
@@ -208,10 +393,23 @@ void sunxifb_init(uint32_t rotated) {
 #else
     memset(fbp, 0, screensize);
 #endif /* USE_SUNXIFB_DOUBLE_BUFFER */
+
+    /*fbp_w/fbp_h may have been swapped for the rotate buffer*/
+    comp.cols = (fbp_w + SUNXIFB_COMP_TILE - 1) / SUNXIFB_COMP_TILE;
+    comp.rows = (fbp_h + SUNXIFB_COMP_TILE - 1) / SUNXIFB_COMP_TILE;
 }
 
 void sunxifb_exit(void) {
 #ifdef USE_SUNXIFB_DOUBLE_BUFFER
+    if (sinfo.present_run) {
+        present_drain();
+        pthread_mutex_lock(&sinfo.present_lock);
+        sinfo.present_run = false;
+        pthread_cond_broadcast(&sinfo.present_cond);
+        pthread_mutex_unlock(&sinfo.present_lock);
+        pthread_join(sinfo.present_tid, NULL);
+    }
+
 #ifdef USE_SUNXIFB_CACHE
     uintptr_t args[2] = { 0, 0 };
     if (ioctl(fbfd, FBIO_ENABLE_CACHE, args) < 0) {
@@ -231,6 +429,20 @@ void sunxifb_exit(void) {
     close(fbfd);
 }
 
+/**
+ * Pan the display back to the first buffer so the console shows again.
+ * Only an ioctl on the already open fd: safe to call from a signal handler
+ * when the process has to exit without running sunxifb_exit.
+ */
+void sunxifb_restore_console(void) {
+    if (fbfd <= 0)
+        return;
+
+    struct fb_var_screeninfo var = vinfo;
+    var.yoffset = 0;
+    ioctl(fbfd, FBIOPAN_DISPLAY, &var);
+}
+
 /**
  * Flush a buffer to the marked area
  * @param drv pointer to driver where this function belongs
@@ -255,93 +467,93 @@ void sunxifb_flush(lv_disp_drv_t *drv, const lv_area_t *area,
             area->y2 > (int32_t) fbp_h - 1 ? (int32_t) fbp_h - 1 : area->y2;
 
     lv_coord_t w = (act_x2 - act_x1 + 1);
+    lv_coord_t src_w = lv_area_get_width(area);
+    uint8_t *fbp8 = (uint8_t*) fbp;
     long int location = 0;
-    long int byte_location = 0;
-    unsigned char bit_location = 0;
+    int32_t y;
+    lv_area_t written;
+
+    lv_area_set(&written, act_x1, act_y1, act_x2, act_y2);
+
+    /*Skip the clipped rows and columns of the source*/
+    color_p += (act_y1 - area->y1) * src_w + (act_x1 - area->x1);
 
-    /*32 or 24 bit per pixel*/
-    if (vinfo.bits_per_pixel == 32 || vinfo.bits_per_pixel == 24) {
-        uint32_t *fbp32 = (uint32_t*) fbp;
-        int32_t y;
+    if (blit_row == NULL) {
+        /*Not supported bit per pixel*/
+    }
+    /*1 bit per pixel: `location` is a bit offset*/
+    else if (vinfo.bits_per_pixel == 1) {
         for (y = act_y1; y <= act_y2; y++) {
 #ifdef USE_SUNXIFB_DOUBLE_BUFFER
             if (sinfo.fbnum > 1)
-                location = act_x1 + y * fbp_line_length / 4;
+                location = act_x1 + y * fbp_w;
             else
 #endif /* USE_SUNXIFB_DOUBLE_BUFFER */
                 location = (act_x1 + vinfo.xoffset)
-                        + (y + vinfo.yoffset) * finfo.line_length / 4;
-            memcpy(&fbp32[location], (uint32_t*) color_p,
-                    (act_x2 - act_x1 + 1) * 4);
-            color_p += w;
+                        + (y + vinfo.yoffset) * vinfo.xres;
+            blit_row(&fbp8[location / 8], color_p, w, location % 8, y);
+            color_p += src_w;
         }
     }
-    /*16 bit per pixel*/
-    else if (vinfo.bits_per_pixel == 16) {
-        uint16_t *fbp16 = (uint16_t*) fbp;
-        int32_t y;
-        for (y = act_y1; y <= act_y2; y++) {
-#ifdef USE_SUNXIFB_DOUBLE_BUFFER
-            if (sinfo.fbnum > 1)
-                location = act_x1 + y * fbp_line_length / 2;
-            else
-#endif /* USE_SUNXIFB_DOUBLE_BUFFER */
-                location = (act_x1 + vinfo.xoffset)
-                        + (y + vinfo.yoffset) * finfo.line_length / 2;
-            memcpy(&fbp16[location], (uint32_t*) color_p,
-                    (act_x2 - act_x1 + 1) * 2);
-            color_p += w;
+    /*Rotated by the CPU: the area is in LVGL's rotated coordinates*/
+    else if (cpu_rotated != LV_DISP_ROT_NONE) {
+        int32_t px1, py1, px2, py2;
+        int32_t h = act_y2 - act_y1 + 1;
+
+        if (cpu_rotated == LV_DISP_ROT_90) {
+            px1 = act_y1;
+            px2 = act_y2;
+            py1 = vinfo.yres - 1 - act_x2;
+            py2 = vinfo.yres - 1 - act_x1;
+        } else if (cpu_rotated == LV_DISP_ROT_270) {
+            px1 = vinfo.xres - 1 - act_y2;
+            px2 = vinfo.xres - 1 - act_y1;
+            py1 = act_x1;
+            py2 = act_x2;
+        } else {
+            px1 = vinfo.xres - 1 - act_x2;
+            px2 = vinfo.xres - 1 - act_x1;
+            py1 = vinfo.yres - 1 - act_y2;
+            py2 = vinfo.yres - 1 - act_y1;
         }
+
+        blit_rotate(fb_addr(px1, py1), finfo.line_length, color_p, src_w, w, h,
+                cpu_rotated);
+        lv_area_set(&written, px1, py1, px2, py2);
     }
-    /*8 bit per pixel*/
-    else if (vinfo.bits_per_pixel == 8) {
-        uint8_t *fbp8 = (uint8_t*) fbp;
-        int32_t y;
-        for (y = act_y1; y <= act_y2; y++) {
-#ifdef USE_SUNXIFB_DOUBLE_BUFFER
-            if (sinfo.fbnum > 1)
-                location = act_x1 + y * fbp_line_length;
-            else
-#endif /* USE_SUNXIFB_DOUBLE_BUFFER */
-                location = (act_x1 + vinfo.xoffset)
-                        + (y + vinfo.yoffset) * finfo.line_length;
-            memcpy(&fbp8[location], (uint32_t*) color_p, (act_x2 - act_x1 + 1));
-            color_p += w;
+    /*32 bit per pixel over the video layer: only the tiles holding UI*/
+    else if (comp.en && vinfo.bits_per_pixel == 32
+            && comp_flush(area, color_p, act_x1, act_y1, act_x2, act_y2, &written)) {
+        if (lv_disp_flush_is_last(drv)) {
+            comp.stats.frames++;
+            comp.stats.last_written_px = comp.frame_written;
+            comp.stats.last_cleared_px = comp.frame_cleared;
+            comp.stats.last_skipped_px = comp.frame_skipped;
+            comp.stats.total_written_px += comp.frame_written + comp.frame_cleared;
+            comp.frame_open = false;
         }
     }
-    /*1 bit per pixel*/
-    else if (vinfo.bits_per_pixel == 1) {
-        uint8_t *fbp8 = (uint8_t*) fbp;
-        int32_t x;
-        int32_t y;
+    /*8, 16, 24 or 32 bit per pixel*/
+    else {
         for (y = act_y1; y <= act_y2; y++) {
-            for (x = act_x1; x <= act_x2; x++) {
-#ifdef USE_SUNXIFB_DOUBLE_BUFFER
-                if (sinfo.fbnum > 1)
-                    location = x + y * fbp_w;
-                else
-#endif /* USE_SUNXIFB_DOUBLE_BUFFER */
-                    location = (x + vinfo.xoffset)
-                            + (y + vinfo.yoffset) * vinfo.xres;
-                byte_location = location / 8; /* find the byte we need to change */
-                bit_location = location % 8; /* inside the byte found, find the bit we need to change */
-                fbp8[byte_location] &= ~(((uint8_t)(1)) << bit_location);
-                fbp8[byte_location] |= ((uint8_t)(color_p->full))
-                        << bit_location;
-                color_p++;
-            }
-
-            color_p += area->x2 - act_x2;
+            blit_row(fb_addr(act_x1, y), color_p, w, act_x1, y);
+            color_p += src_w;
         }
-    } else {
-        /*Not supported bit per pixel*/
     }
 
     //May be some direct update command is required
     //ret = ioctl(state->fd, FBIO_UPDATE, (unsigned long)((uintptr_t)rect));
 
+#ifdef SUNXIFB_DAMAGE_TRACK
+    if (sinfo.fbnum > 1 && sinfo.dbuf_en && written.x1 <= written.x2)
+        damage_add(&sinfo.damage, written.x1, written.y1, written.x2, written.y2);
+#endif /* SUNXIFB_DAMAGE_TRACK */
+
+    bool presented = false;
 #ifdef USE_SUNXIFB_DOUBLE_BUFFER
     if (sinfo.fbnum > 1 && sinfo.dbuf_en && lv_disp_flush_is_last(drv)) {
+        presented = true;
+
 #ifdef USE_SUNXIFB_CACHE
         uintptr_t args[2];
         args[0] = (uintptr_t) sinfo.screenfbp[sinfo.fbindex];
@@ -361,26 +573,8 @@ void sunxifb_flush(lv_disp_drv_t *drv, const lv_area_t *area,
                 vinfo.yres, sinfo.rotated);
 #endif /* USE_SUNXIFB_G2D_ROTATE */
 
-        vinfo.yoffset = sinfo.fbindex * vinfo.yres;
-        if (ioctl(fbfd, FBIOPAN_DISPLAY, &vinfo) < 0) {
-            perror("Error: FBIOPAN_DISPLAY fail");
-        }
-
-#if defined(USE_SUNXIFB_G2D) && !defined(USE_SUNXIFB_G2D_ROTATE)
-        sunxifb_g2d_blit_to_fb(finfo.smem_start, vinfo.xres_virtual,
-                vinfo.yres_virtual, 0, sinfo.fbindex * vinfo.yres, vinfo.xres,
-                vinfo.yres, finfo.smem_start, vinfo.xres_virtual,
-                vinfo.yres_virtual, 0, !sinfo.fbindex * vinfo.yres, vinfo.xres,
-                vinfo.yres, G2D_ROT_0);
-#elif !defined(USE_SUNXIFB_G2D_ROTATE)
-        memcpy(sinfo.screenfbp[!sinfo.fbindex], sinfo.screenfbp[sinfo.fbindex],
-                finfo.line_length * vinfo.yres);
-#endif /* USE_SUNXIFB_G2D && !USE_SUNXIFB_G2D_ROTATE */
-
-        sinfo.fbindex = !sinfo.fbindex;
-#ifndef USE_SUNXIFB_G2D_ROTATE
-        fbp = sinfo.screenfbp[sinfo.fbindex];
-#endif /* USE_SUNXIFB_G2D_ROTATE */
+        present_queue(sinfo.fbindex);
+        present_next();
 
 #ifdef LV_USE_SUNXIFB_DEBUG
         static struct timeval new, old;
@@ -405,9 +599,12 @@ void sunxifb_flush(lv_disp_drv_t *drv, const lv_area_t *area,
 
             if (fps_cnt > 0)
                 printf("sunxifb_flush fps_cnt=%u cur_fps=%u, max_fps=%u, "
-                        "min_fps=%u, cur_page=%d, avg_fps=%.2f\n", fps_cnt,
+                        "min_fps=%u, cur_page=%u, avg_fps=%.2f, copy_bytes=%u, "
+                        "comp_px=%u\n", fps_cnt,
                         cur_fps, max_fps, min_fps, sinfo.fbindex,
-                        (float) avg_fps / (float) fps_cnt);
+                        (float) avg_fps / (float) fps_cnt,
+                        sinfo.copy_stats.last_bytes,
+                        comp.stats.last_written_px + comp.stats.last_cleared_px);
 
             first++;
             old = new;
@@ -419,9 +616,27 @@ void sunxifb_flush(lv_disp_drv_t *drv, const lv_area_t *area,
     }
 #endif /* USE_SUNXIFB_DOUBLE_BUFFER */
 
+    /*Drawing straight into the visible buffer: the frame is shown now*/
+    if (!presented && lv_disp_flush_is_last(drv)) {
+        uint64_t now = get_time_us();
+        present_record(now, now);
+    }
+
     lv_disp_flush_ready(drv);
 }
 
+/**
+ * Tell if the driver rotates the frames itself (with G2D or the CPU).
+ * If not, the rotation has to be done by LVGL's `sw_rotate`.
+ */
+bool sunxifb_rotates(void) {
+#ifdef USE_SUNXIFB_G2D_ROTATE
+    return true;
+#else
+    return cpu_rotated != LV_DISP_ROT_NONE;
+#endif /* USE_SUNXIFB_G2D_ROTATE */
+}
+
 void sunxifb_get_sizes(uint32_t *width, uint32_t *height) {
     if (width)
         *width = vinfo.xres;
@@ -457,12 +672,17 @@ bool sunxifb_get_dbuf_en() {
 }
 
 int sunxifb_set_dbuf_en(lv_disp_drv_t *drv, bool dbuf_en) {
+    uint32_t i;
+
     if (sinfo.dbuf_en == dbuf_en)
         return 0;
 
     if (drv->draw_buf->flushing)
         return -2;
 
+    /*Let the queued frame reach the screen first*/
+    present_drain();
+
 #ifdef USE_SUNXIFB_CACHE
     uintptr_t args[2] = { dbuf_en, 0 };
     if (ioctl(fbfd, FBIO_ENABLE_CACHE, args) < 0) {
@@ -470,7 +690,7 @@ int sunxifb_set_dbuf_en(lv_disp_drv_t *drv, bool dbuf_en) {
         return -1;
     }
 
-    munmap(sinfo.screenfbp[0], finfo.line_length * vinfo.yres);
+    munmap(sinfo.screenfbp[0], screensize);
 
     // Re mmap the device to memory, settings will be effective
     fbp = (char*) mmap(0, screensize, PROT_READ | PROT_WRITE, MAP_SHARED, fbfd,
@@ -480,29 +700,47 @@ int sunxifb_set_dbuf_en(lv_disp_drv_t *drv, bool dbuf_en) {
         return -1;
     }
 
-    sinfo.screenfbp[0] = fbp;
-    sinfo.screenfbp[1] = fbp + finfo.line_length * vinfo.yres;
+    for (i = 0; i < sinfo.fbnum; i++)
+        sinfo.screenfbp[i] = fbp + i * finfo.line_length * vinfo.yres;
 #endif /* USE_SUNXIFB_CACHE */
 
     if (dbuf_en) {
-        vinfo.yoffset = sinfo.fbindex * vinfo.yres;
-        if (ioctl(fbfd, FBIOPAN_DISPLAY, &vinfo) < 0) {
-            perror("Error: FBIOPAN_DISPLAY fail");
-        }
+        /*The buffer drawn so far is on the screen, copy it to the others*/
+        pan_to(sinfo.fbindex);
 
+        for (i = 0; i < sinfo.fbnum; i++) {
+            if (i == sinfo.fbindex)
+                continue;
 #ifdef USE_SUNXIFB_G2D
-        sunxifb_g2d_blit_to_fb(finfo.smem_start, vinfo.xres_virtual,
-                vinfo.yres_virtual, 0, sinfo.fbindex * vinfo.yres, vinfo.xres,
-                vinfo.yres, finfo.smem_start, vinfo.xres_virtual,
-                vinfo.yres_virtual, 0, !sinfo.fbindex * vinfo.yres, vinfo.xres,
-                vinfo.yres, G2D_ROT_0);
+            sunxifb_g2d_blit_to_fb(finfo.smem_start, vinfo.xres_virtual,
+                    vinfo.yres_virtual, 0, sinfo.fbindex * vinfo.yres, vinfo.xres,
+                    vinfo.yres, finfo.smem_start, vinfo.xres_virtual,
+                    vinfo.yres_virtual, 0, i * vinfo.yres, vinfo.xres,
+                    vinfo.yres, G2D_ROT_0);
 #else
-        memcpy(sinfo.screenfbp[!sinfo.fbindex], sinfo.screenfbp[sinfo.fbindex],
-                finfo.line_length * vinfo.yres);
+            memcpy(sinfo.screenfbp[i], sinfo.screenfbp[sinfo.fbindex],
+                    finfo.line_length * vinfo.yres);
 #endif /* USE_SUNXIFB_G2D */
+        }
+
+        memset(sinfo.busy, 0, sizeof(sinfo.busy));
+        sinfo.scanout = sinfo.fbindex;
+        sinfo.busy[sinfo.scanout] = true;
+        sinfo.fbindex = (sinfo.scanout + 1) % sinfo.fbnum;
+    } else {
+        /*Draw straight into the buffer on the screen*/
+        sinfo.fbindex = sinfo.scanout;
     }
 
-    sinfo.fbindex = !sinfo.fbindex;
+#ifdef SUNXIFB_DAMAGE_TRACK
+    damage_reset(&sinfo.damage);
+    for (i = 0; i < sinfo.fbnum; i++)
+        damage_reset(&sinfo.pending[i]);
+#endif /* SUNXIFB_DAMAGE_TRACK */
+
+    /*The screen content is unknown after switching buffers*/
+    memset(comp.dirty, 1, sizeof(comp.dirty));
+
 #ifdef USE_SUNXIFB_G2D_ROTATE
     fbp = sinfo.rotatefbp;
 #else
@@ -512,10 +750,515 @@ int sunxifb_set_dbuf_en(lv_disp_drv_t *drv, bool dbuf_en) {
     sinfo.dbuf_en = dbuf_en;
     return 0;
 }
+
+void sunxifb_get_copy_stats(sunxifb_copy_stats_t *stats) {
+    if (stats)
+        *stats = sinfo.copy_stats;
+}
 #endif /* USE_SUNXIFB_DOUBLE_BUFFER */
 
+/**
+ * Enable compositing of a transparent UI over the video layer. Requires
+ * 32 bpp and a content mask set by `sunxifb_set_content_mask` every frame.
+ * Every tile is assumed dirty until it has been cleared once.
+ */
+void sunxifb_set_compositing(bool en) {
+    pthread_mutex_lock(&comp.lock);
+    comp.pending_seq[0] = 0;
+    comp.pending_seq[1] = 0;
+    comp.latched_seq = comp.seq;
+    memset(comp.mask, 1, sizeof(comp.mask));
+    memset(comp.dirty, 1, sizeof(comp.dirty));
+    comp.frame_open = false;
+    /*The mask is in LVGL's coordinates, not usable with CPU rotation*/
+    comp.en = en && cpu_rotated == LV_DISP_ROT_NONE
+            && comp.cols * comp.rows <= SUNXIFB_COMP_MAX_TILES;
+    pthread_mutex_unlock(&comp.lock);
+}
+
+void sunxifb_get_content_grid(uint32_t *cols, uint32_t *rows, uint32_t *tile) {
+    if (cols)
+        *cols = comp.cols;
+    if (rows)
+        *rows = comp.rows;
+    if (tile)
+        *tile = SUNXIFB_COMP_TILE;
+}
+
+/**
+ * Publish which tiles may contain UI pixels in the frame about to be rendered.
+ * Call it from the rendering thread before the frame's first flush.
+ * @param mask cols * rows bytes, row major, non-zero for tiles with content
+ */
+void sunxifb_set_content_mask(const uint8_t *mask) {
+    pthread_mutex_lock(&comp.lock);
+    comp.seq++;
+    memcpy(comp.pending[comp.seq & 1], mask, comp.cols * comp.rows);
+    comp.pending_seq[comp.seq & 1] = comp.seq;
+    pthread_mutex_unlock(&comp.lock);
+}
+
+void sunxifb_get_comp_stats(sunxifb_comp_stats_t *stats) {
+    if (stats)
+        *stats = comp.stats;
+}
+
+/**
+ * Get the frame pacing statistics, the percentiles are computed from the
+ * frame time histogram on every call
+ */
+void sunxifb_get_present_stats(sunxifb_present_stats_t *stats) {
+    uint32_t total = 0, sum = 0, i;
+
+    if (stats == NULL)
+        return;
+
+    pthread_mutex_lock(&pstats_lock);
+    *stats = pstats;
+    pthread_mutex_unlock(&pstats_lock);
+
+    stats->p50_ms = 0;
+    stats->p95_ms = 0;
+    stats->p99_ms = 0;
+    for (i = 0; i < SUNXIFB_FRAME_HIST_BUCKETS; i++)
+        total += stats->hist[i];
+    for (i = 0; i < SUNXIFB_FRAME_HIST_BUCKETS && total > 0; i++) {
+        sum += stats->hist[i];
+        /*Report the upper edge of the bucket*/
+        if (stats->p50_ms == 0 && (uint64_t) sum * 100 >= (uint64_t) total * 50)
+            stats->p50_ms = i + 1;
+        if (stats->p95_ms == 0 && (uint64_t) sum * 100 >= (uint64_t) total * 95)
+            stats->p95_ms = i + 1;
+        if (stats->p99_ms == 0 && (uint64_t) sum * 100 >= (uint64_t) total * 99)
+            stats->p99_ms = i + 1;
+    }
+}
+
 /**********************
  *   STATIC FUNCTIONS
  **********************/
+/**
+ * Address of pixel (x, y) of the buffer being drawn (8 bpp or more)
+ */
+static uint8_t* fb_addr(int32_t x, int32_t y) {
+    uint32_t bytes_pp = vinfo.bits_per_pixel / 8;
+
+#ifdef USE_SUNXIFB_DOUBLE_BUFFER
+    if (sinfo.fbnum > 1)
+        return (uint8_t*) fbp + x * bytes_pp + y * fbp_line_length;
+#endif /* USE_SUNXIFB_DOUBLE_BUFFER */
+    return (uint8_t*) fbp + (x + vinfo.xoffset) * bytes_pp
+            + (y + vinfo.yoffset) * finfo.line_length;
+}
+
+static uint64_t get_time_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * Refresh period of the panel from the timings, 60 Hz if they are unknown
+ */
+static uint32_t refresh_period_us(void) {
+    uint64_t htotal = vinfo.xres + vinfo.left_margin + vinfo.right_margin
+            + vinfo.hsync_len;
+    uint64_t vtotal = vinfo.yres + vinfo.upper_margin + vinfo.lower_margin
+            + vinfo.vsync_len;
+
+    if (vinfo.pixclock == 0)
+        return 16667;
+
+    /*pixclock is in picoseconds*/
+    return (uint32_t) (vinfo.pixclock * htotal * vtotal / 1000000);
+}
+
+/**
+ * Account a frame which reached the screen at `now_us`
+ * @param queued_us when the frame was handed over to be shown
+ */
+static void present_record(uint64_t queued_us, uint64_t now_us) {
+    uint32_t latency = (uint32_t) (now_us - queued_us);
+    uint32_t budget = LV_MAX(pstats.period_us, LV_DISP_DEF_REFR_PERIOD * 1000);
+
+    pthread_mutex_lock(&pstats_lock);
+
+    pstats.frames++;
+    pstats.last_latency_us = latency;
+    pstats.total_latency_us += latency;
+    if (pstats.max_latency_us < latency)
+        pstats.max_latency_us = latency;
+    /*More than a refresh period from queueing to the screen: a vblank was missed*/
+    if (pstats.period_us > 0 && latency > pstats.period_us + pstats.period_us / 10)
+        pstats.missed_vblanks += latency / pstats.period_us;
+
+    if (pstats_last_us != 0) {
+        uint32_t interval = (uint32_t) (now_us - pstats_last_us);
+        if (interval < SUNXIFB_IDLE_MS * 1000) {
+            uint32_t bucket = LV_MIN(interval / 1000, SUNXIFB_FRAME_HIST_BUCKETS - 1);
+            pstats.last_frame_us = interval;
+            pstats.hist[bucket]++;
+            /*Frames LVGL could have shown in the gap*/
+            uint32_t periods = (interval + budget / 2) / budget;
+            if (periods > 1)
+                pstats.dropped += periods - 1;
+        }
+    }
+    pstats_last_us = now_us;
+
+    pthread_mutex_unlock(&pstats_lock);
+}
+
+#ifdef USE_SUNXIFB_DOUBLE_BUFFER
+static void pan_to(uint32_t index) {
+    struct fb_var_screeninfo var = vinfo;
+
+    var.yoffset = index * vinfo.yres;
+    if (ioctl(fbfd, FBIOPAN_DISPLAY, &var) < 0) {
+        perror("Error: FBIOPAN_DISPLAY fail");
+    }
+}
+
+/**
+ * Show the queued buffers on the vblank, one at a time
+ */
+static void* present_thread(void *arg) {
+    LV_UNUSED(arg);
+
+    pthread_mutex_lock(&sinfo.present_lock);
+    while (sinfo.present_run) {
+        if (sinfo.queued < 0) {
+            pthread_cond_wait(&sinfo.present_cond, &sinfo.present_lock);
+            continue;
+        }
+
+        uint32_t index = sinfo.queued;
+        uint64_t queued_us = sinfo.queued_us;
+        sinfo.queued = -1;
+        pthread_cond_broadcast(&sinfo.present_cond);
+        pthread_mutex_unlock(&sinfo.present_lock);
+
+        pan_to(index);
+        uint32_t crtc = 0;
+        if (ioctl(fbfd, FBIO_WAITFORVSYNC, &crtc) < 0) {
+            perror("Error: FBIO_WAITFORVSYNC fail");
+        }
+        uint64_t now = get_time_us();
+
+        pthread_mutex_lock(&sinfo.present_lock);
+        /*The previous buffer has left the screen and can be drawn again*/
+        if (sinfo.scanout != index)
+            sinfo.busy[sinfo.scanout] = false;
+        sinfo.scanout = index;
+        present_record(queued_us, now);
+        pthread_cond_broadcast(&sinfo.present_cond);
+    }
+    pthread_mutex_unlock(&sinfo.present_lock);
+
+    return NULL;
+}
+
+/**
+ * Hand over the finished buffer to be shown
+ */
+static void present_queue(uint32_t index) {
+    uint64_t now = get_time_us();
+
+    if (!sinfo.vsync) {
+        pan_to(index);
+        sinfo.busy[sinfo.scanout] = false;
+        sinfo.scanout = index;
+        sinfo.busy[index] = true;
+        present_record(now, get_time_us());
+        return;
+    }
+
+    pthread_mutex_lock(&sinfo.present_lock);
+    while (sinfo.queued >= 0)
+        pthread_cond_wait(&sinfo.present_cond, &sinfo.present_lock);
+    sinfo.queued = index;
+    sinfo.queued_us = now;
+    sinfo.busy[index] = true;
+    pthread_cond_broadcast(&sinfo.present_cond);
+    pthread_mutex_unlock(&sinfo.present_lock);
+}
+
+/**
+ * Switch drawing to the next free buffer and bring it up to date with the
+ * frame just queued. Blocks while all the other buffers are queued or on the
+ * screen, which paces the rendering to the display.
+ */
+static void present_next(void) {
+    uint32_t prev = sinfo.fbindex;
+    uint32_t next = prev;
+    uint32_t i;
+
+#ifdef SUNXIFB_DAMAGE_TRACK
+    for (i = 0; i < sinfo.fbnum; i++) {
+        if (i != prev)
+            damage_merge(&sinfo.pending[i], &sinfo.damage);
+    }
+    damage_reset(&sinfo.damage);
+#endif /* SUNXIFB_DAMAGE_TRACK */
+
+    if (sinfo.vsync)
+        pthread_mutex_lock(&sinfo.present_lock);
+    for (;;) {
+        for (i = 1; i < sinfo.fbnum; i++) {
+            next = (prev + i) % sinfo.fbnum;
+            if (!sinfo.busy[next])
+                break;
+        }
+        if (i < sinfo.fbnum || !sinfo.vsync)
+            break;
+        pthread_cond_wait(&sinfo.present_cond, &sinfo.present_lock);
+    }
+    if (sinfo.vsync)
+        pthread_mutex_unlock(&sinfo.present_lock);
+
+#if defined(USE_SUNXIFB_G2D) && !defined(USE_SUNXIFB_G2D_ROTATE)
+    sunxifb_g2d_blit_to_fb(finfo.smem_start, vinfo.xres_virtual,
+            vinfo.yres_virtual, 0, prev * vinfo.yres, vinfo.xres,
+            vinfo.yres, finfo.smem_start, vinfo.xres_virtual,
+            vinfo.yres_virtual, 0, next * vinfo.yres, vinfo.xres,
+            vinfo.yres, G2D_ROT_0);
+#elif defined(SUNXIFB_DAMAGE_TRACK)
+    /*The buffer misses the frames drawn since it was last used*/
+    sinfo.copy_stats.last_bytes = damage_sync(sinfo.screenfbp[next],
+            sinfo.screenfbp[prev], &sinfo.pending[next]);
+    sinfo.copy_stats.total_bytes += sinfo.copy_stats.last_bytes;
+    sinfo.copy_stats.frames++;
+#endif /* USE_SUNXIFB_G2D && !USE_SUNXIFB_G2D_ROTATE */
+
+    sinfo.fbindex = next;
+#ifndef USE_SUNXIFB_G2D_ROTATE
+    fbp = sinfo.screenfbp[next];
+#endif /* USE_SUNXIFB_G2D_ROTATE */
+}
+
+/**
+ * Wait until nothing is queued and only the buffer on the screen is in use
+ */
+static void present_drain(void) {
+    uint32_t i, busy;
+
+    if (!sinfo.vsync)
+        return;
+
+    pthread_mutex_lock(&sinfo.present_lock);
+    for (;;) {
+        busy = 0;
+        for (i = 0; i < sinfo.fbnum; i++)
+            busy += sinfo.busy[i];
+        if (sinfo.queued < 0 && busy <= 1)
+            break;
+        pthread_cond_wait(&sinfo.present_cond, &sinfo.present_lock);
+    }
+    pthread_mutex_unlock(&sinfo.present_lock);
+}
+#endif /* USE_SUNXIFB_DOUBLE_BUFFER */
+
+/**
+ * Take the oldest mask published after the one in use: masks are published
+ * at render start, so it belongs to the frame whose first area is flushed now
+ */
+static void comp_latch(void) {
+    int i = -1;
+
+    pthread_mutex_lock(&comp.lock);
+    if (comp.pending_seq[0] > comp.latched_seq)
+        i = 0;
+    if (comp.pending_seq[1] > comp.latched_seq
+            && (i < 0 || comp.pending_seq[1] < comp.pending_seq[0]))
+        i = 1;
+    if (i >= 0) {
+        memcpy(comp.mask, comp.pending[i], comp.cols * comp.rows);
+        comp.latched_seq = comp.pending_seq[i];
+    }
+    pthread_mutex_unlock(&comp.lock);
+}
+
+/**
+ * Flush an area tile by tile: copy tiles with content, clear dirty empty
+ * tiles, skip clean empty tiles.
+ * @param written set to the bounding box of the pixels written
+ * @return false if the area can not be handled (nothing written)
+ */
+static bool comp_flush(const lv_area_t *area, lv_color_t *color_p,
+        int32_t act_x1, int32_t act_y1, int32_t act_x2, int32_t act_y2,
+        lv_area_t *written) {
+    enum { RUN_SKIP, RUN_CLEAR, RUN_COPY };
+    const int32_t t = SUNXIFB_COMP_TILE;
+    lv_coord_t src_w = lv_area_get_width(area);
+    int32_t ty, tx, y;
+
+    if (!comp.frame_open) {
+        comp_latch();
+        comp.frame_open = true;
+        comp.frame_written = 0;
+        comp.frame_cleared = 0;
+        comp.frame_skipped = 0;
+    }
+
+    lv_area_set(written, LV_COORD_MAX, LV_COORD_MAX, LV_COORD_MIN, LV_COORD_MIN);
+
+    for (ty = act_y1 / t; ty <= act_y2 / t; ty++) {
+        int32_t y1 = LV_MAX(act_y1, ty * t);
+        int32_t y2 = LV_MIN(act_y2, ty * t + t - 1);
+        uint8_t *mask = &comp.mask[ty * comp.cols];
+        uint8_t *dirty = &comp.dirty[ty * comp.cols];
+        bool full_rows = (y1 == ty * t) && (y2 == ty * t + t - 1 || y2 == (int32_t) fbp_h - 1);
+
+        tx = act_x1 / t;
+        while (tx <= act_x2 / t) {
+            int kind = mask[tx] ? RUN_COPY : (dirty[tx] ? RUN_CLEAR : RUN_SKIP);
+            int32_t tx_end = tx;
+
+            /*Extend the run over neighbour tiles of the same kind*/
+            while (tx_end + 1 <= act_x2 / t) {
+                int next = mask[tx_end + 1] ? RUN_COPY : (dirty[tx_end + 1] ? RUN_CLEAR : RUN_SKIP);
+                if (next != kind)
+                    break;
+                tx_end++;
+            }
+
+            int32_t x1 = LV_MAX(act_x1, tx * t);
+            int32_t x2 = LV_MIN(act_x2, tx_end * t + t - 1);
+            uint32_t px = (x2 - x1 + 1) * (y2 - y1 + 1);
+            int32_t i;
+
+            if (kind == RUN_SKIP) {
+                comp.frame_skipped += px;
+            } else {
+                for (y = y1; y <= y2; y++) {
+                    if (kind == RUN_COPY)
+                        blit_row(fb_addr(x1, y),
+                                color_p + (y - act_y1) * src_w + (x1 - act_x1),
+                                x2 - x1 + 1, x1, y);
+                    else
+                        memset(fb_addr(x1, y), 0, (x2 - x1 + 1) * 4);
+                }
+
+                if (kind == RUN_COPY)
+                    comp.frame_written += px;
+                else
+                    comp.frame_cleared += px;
+
+                written->x1 = LV_MIN(written->x1, x1);
+                written->y1 = LV_MIN(written->y1, y1);
+                written->x2 = LV_MAX(written->x2, x2);
+                written->y2 = LV_MAX(written->y2, y2);
+            }
+
+            for (i = tx; i <= tx_end; i++) {
+                bool full = full_rows
+                        && x1 <= i * t
+                        && (x2 >= i * t + t - 1 || x2 == (int32_t) fbp_w - 1);
+                if (kind == RUN_COPY)
+                    dirty[i] = 1;
+                else if (kind == RUN_CLEAR && full)
+                    dirty[i] = 0;
+            }
+
+            tx = tx_end + 1;
+        }
+    }
+
+    return true;
+}
+
+#ifdef SUNXIFB_DAMAGE_TRACK
+/**
+ * Remember an area drawn in the current frame.
+ * Strips of the same area flushed one after another are merged back together;
+ * too many areas or too many pixels switch to a full-frame copy.
+ */
+static void damage_add(struct sunxifb_damage *d, int32_t x1, int32_t y1,
+        int32_t x2, int32_t y2) {
+    uint32_t i;
+
+    if (d->full)
+        return;
+
+    d->px += (x2 - x1 + 1) * (y2 - y1 + 1);
+    if (d->px * 100 > fbp_w * fbp_h * SUNXIFB_DAMAGE_FULL_PCT) {
+        d->full = true;
+        return;
+    }
+
+    for (i = 0; i < d->cnt; i++) {
+        lv_area_t *a = &d->area[i];
+        if (a->x1 == x1 && a->x2 == x2 && y1 <= a->y2 + 1 && y2 >= a->y1 - 1) {
+            a->y1 = LV_MIN(a->y1, y1);
+            a->y2 = LV_MAX(a->y2, y2);
+            return;
+        }
+    }
+
+    if (d->cnt >= SUNXIFB_DAMAGE_MAX) {
+        d->full = true;
+        return;
+    }
+
+    lv_area_set(&d->area[d->cnt++], x1, y1, x2, y2);
+}
+
+/**
+ * Add the damage of a frame to the damage a buffer is missing
+ */
+static void damage_merge(struct sunxifb_damage *dst,
+        const struct sunxifb_damage *src) {
+    uint32_t i;
+
+    if (src->full) {
+        dst->full = true;
+        return;
+    }
+
+    for (i = 0; i < src->cnt; i++)
+        damage_add(dst, src->area[i].x1, src->area[i].y1, src->area[i].x2,
+                src->area[i].y2);
+}
+
+static void damage_reset(struct sunxifb_damage *d) {
+    d->cnt = 0;
+    d->px = 0;
+    d->full = false;
+}
+
+/**
+ * Copy the damaged areas `d` from `src` to `dst` and reset the damage.
+ * @return number of bytes copied
+ */
+static uint32_t damage_sync(char *dst, const char *src,
+        struct sunxifb_damage *d) {
+    uint32_t bytes = 0;
+    uint32_t i;
+    int32_t y;
+
+    /*1 bpp areas are not byte aligned, always copy everything*/
+    if (d->full || vinfo.bits_per_pixel < 8) {
+        bytes = finfo.line_length * vinfo.yres;
+        memcpy(dst, src, bytes);
+        sinfo.copy_stats.full_copies++;
+    } else {
+        uint32_t bytes_pp = vinfo.bits_per_pixel / 8;
+        for (i = 0; i < d->cnt; i++) {
+            const lv_area_t *a = &d->area[i];
+            uint32_t offset = a->y1 * finfo.line_length + a->x1 * bytes_pp;
+            uint32_t len = (a->x2 - a->x1 + 1) * bytes_pp;
+            for (y = a->y1; y <= a->y2; y++) {
+                memcpy(dst + offset, src + offset, len);
+                offset += finfo.line_length;
+            }
+            bytes += len * (a->y2 - a->y1 + 1);
+        }
+    }
+
+    damage_reset(d);
+
+    return bytes;
+}
+#endif /* SUNXIFB_DAMAGE_TRACK */
 
 #endif
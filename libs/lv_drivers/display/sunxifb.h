@@ -32,23 +32,65 @@ extern "C" {
 /*********************
  *      DEFINES
  *********************/
+/*Frame time histogram: 1 ms per bucket, the last one also counts longer frames*/
+#define SUNXIFB_FRAME_HIST_BUCKETS  64
 
 /**********************
  *      TYPEDEFS
  **********************/
+typedef struct {
+    uint32_t frames;           /*Frames flushed with compositing enabled*/
+    uint32_t last_written_px;  /*UI pixels copied to the screen in the last frame*/
+    uint32_t last_cleared_px;  /*Empty pixels cleared in the last frame*/
+    uint32_t last_skipped_px;  /*Empty pixels left alone in the last frame*/
+    uint64_t total_written_px; /*Copied + cleared pixels since enabled*/
+} sunxifb_comp_stats_t;
+
+typedef struct {
+    uint32_t buffers;          /*Framebuffers in the present queue*/
+    uint32_t period_us;        /*Refresh period of the panel*/
+    uint32_t frames;           /*Frames shown*/
+    uint32_t dropped;          /*Frames missing between two shown frames, in refresh periods*/
+    uint32_t missed_vblanks;   /*Vblanks waited for beyond the first after queueing*/
+    uint32_t last_frame_us;    /*Time between the last two shown frames*/
+    uint32_t last_latency_us;  /*Last frame: queued -> on the screen*/
+    uint32_t max_latency_us;
+    uint64_t total_latency_us; /*Divide by frames for the average*/
+    uint32_t p50_ms;           /*Frame time percentiles, from the histogram*/
+    uint32_t p95_ms;
+    uint32_t p99_ms;
+    uint32_t hist[SUNXIFB_FRAME_HIST_BUCKETS]; /*Frame times, idle gaps excluded*/
+} sunxifb_present_stats_t;
+
+#ifdef USE_SUNXIFB_DOUBLE_BUFFER
+typedef struct {
+    uint32_t frames;      /*Frames presented with a CPU back buffer sync*/
+    uint32_t full_copies; /*Frames that fell back to copying the whole frame*/
+    uint32_t last_bytes;  /*Bytes copied into the back buffer for the last frame*/
+    uint64_t total_bytes; /*Bytes copied since init*/
+} sunxifb_copy_stats_t;
+#endif /* USE_SUNXIFB_DOUBLE_BUFFER */
 
 /**********************
  * GLOBAL PROTOTYPES
  **********************/
 void sunxifb_init(uint32_t rotated);
 void sunxifb_exit(void);
+void sunxifb_restore_console(void);
 void sunxifb_flush(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color_p);
 void sunxifb_get_sizes(uint32_t *width, uint32_t *height);
+bool sunxifb_rotates(void);
 void* sunxifb_alloc(size_t size, char *label);
 void sunxifb_free(void **data, char *label);
+void sunxifb_set_compositing(bool en);
+void sunxifb_get_content_grid(uint32_t *cols, uint32_t *rows, uint32_t *tile);
+void sunxifb_set_content_mask(const uint8_t *mask);
+void sunxifb_get_comp_stats(sunxifb_comp_stats_t *stats);
+void sunxifb_get_present_stats(sunxifb_present_stats_t *stats);
 #ifdef USE_SUNXIFB_DOUBLE_BUFFER
 bool sunxifb_get_dbuf_en();
 int sunxifb_set_dbuf_en(lv_disp_drv_t * drv, bool dbuf_en);
+void sunxifb_get_copy_stats(sunxifb_copy_stats_t *stats);
 #endif /* USE_SUNXIFB_DOUBLE_BUFFER */
 
 /**********************
@@ -0,0 +1,223 @@
+/**
+ * @file vfb.c
+ * Headless display: renders into a heap buffer instead of a device so the UI
+ * can run and be profiled on a host without a panel.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "vfb.h"
+#if USE_VFB
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+#ifndef VFB_HOR_RES
+#define VFB_HOR_RES  800
+#endif
+
+#ifndef VFB_VER_RES
+#define VFB_VER_RES  480
+#endif
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static void dump_frame(void);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static lv_color_t *vfbp = NULL;
+static uint32_t vfb_w = VFB_HOR_RES;
+static uint32_t vfb_h = VFB_VER_RES;
+static vfb_stats_t stats;
+static volatile uint32_t tick_ms;
+
+static vfb_dump_t dump_mode = VFB_DUMP_NONE;
+static char dump_path[256];
+static FILE *dump_fp = NULL;
+static uint8_t *dump_line = NULL;
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+void vfb_init(uint32_t rotated) {
+    /*Rotation is done by LVGL (sw_rotate), the buffer keeps the panel orientation*/
+    LV_UNUSED(rotated);
+
+    vfbp = calloc(vfb_w * vfb_h, sizeof(lv_color_t));
+    if (vfbp == NULL) {
+        perror("Error: cannot allocate virtual frame buffer");
+        return;
+    }
+
+    memset(&stats, 0, sizeof(stats));
+    tick_ms = 0;
+
+    printf("vfb wh=%ux%u, bpp=%d\n", vfb_w, vfb_h, LV_COLOR_DEPTH);
+}
+
+void vfb_exit(void) {
+    vfb_set_dump(VFB_DUMP_NONE, NULL);
+    free(vfbp);
+    vfbp = NULL;
+}
+
+/**
+ * Flush a buffer to the marked area
+ * @param drv pointer to driver where this function belongs
+ * @param area an area where to copy `color_p`
+ * @param color_p an array of pixel to copy to the `area` part of the screen
+ */
+void vfb_flush(lv_disp_drv_t * drv, const lv_area_t * area,
+        lv_color_t * color_p) {
+    if (vfbp == NULL || area->x2 < 0 || area->y2 < 0
+            || area->x1 > (int32_t) vfb_w - 1
+            || area->y1 > (int32_t) vfb_h - 1) {
+        lv_disp_flush_ready(drv);
+        return;
+    }
+
+    /*Truncate the area to the screen*/
+    int32_t act_x1 = area->x1 < 0 ? 0 : area->x1;
+    int32_t act_y1 = area->y1 < 0 ? 0 : area->y1;
+    int32_t act_x2 =
+            area->x2 > (int32_t) vfb_w - 1 ? (int32_t) vfb_w - 1 : area->x2;
+    int32_t act_y2 =
+            area->y2 > (int32_t) vfb_h - 1 ? (int32_t) vfb_h - 1 : area->y2;
+
+    lv_coord_t w = act_x2 - act_x1 + 1;
+    lv_coord_t src_w = lv_area_get_width(area);
+    int32_t y;
+
+    color_p += (act_y1 - area->y1) * src_w + (act_x1 - area->x1);
+    for (y = act_y1; y <= act_y2; y++) {
+        memcpy(&vfbp[y * vfb_w + act_x1], color_p, w * sizeof(lv_color_t));
+        color_p += src_w;
+    }
+
+    stats.areas++;
+    stats.pixels += (uint64_t) w * (act_y2 - act_y1 + 1);
+
+    if (lv_disp_flush_is_last(drv)) {
+        stats.frames++;
+        dump_frame();
+    }
+
+    lv_disp_flush_ready(drv);
+}
+
+void vfb_get_sizes(uint32_t *width, uint32_t *height) {
+    if (width)
+        *width = vfb_w;
+
+    if (height)
+        *height = vfb_h;
+}
+
+void* vfb_alloc(size_t size, char *label) {
+    LV_UNUSED(label);
+    return malloc(size);
+}
+
+void vfb_free(void **data, char *label) {
+    LV_UNUSED(label);
+    if (*data != NULL) {
+        free(*data);
+        *data = NULL;
+    }
+}
+
+/**
+ * Write every completed frame to disk
+ * @param mode VFB_DUMP_PPM, VFB_DUMP_RAW or VFB_DUMP_NONE to stop dumping
+ * @param path PPM: printf pattern with one %u for the frame number; RAW: output file
+ * @return true on success
+ */
+bool vfb_set_dump(vfb_dump_t mode, const char *path) {
+    if (dump_fp != NULL) {
+        fclose(dump_fp);
+        dump_fp = NULL;
+    }
+    free(dump_line);
+    dump_line = NULL;
+    dump_mode = VFB_DUMP_NONE;
+
+    if (mode == VFB_DUMP_NONE || path == NULL)
+        return true;
+
+    if (mode == VFB_DUMP_RAW) {
+        dump_fp = fopen(path, "wb");
+        if (dump_fp == NULL) {
+            perror("Error: cannot open vfb dump file");
+            return false;
+        }
+    } else {
+        dump_line = malloc(vfb_w * 3);
+        if (dump_line == NULL)
+            return false;
+    }
+
+    strncpy(dump_path, path, sizeof(dump_path) - 1);
+    dump_path[sizeof(dump_path) - 1] = '\0';
+    dump_mode = mode;
+    return true;
+}
+
+const lv_color_t * vfb_get_buf(void) {
+    return vfbp;
+}
+
+void vfb_get_stats(vfb_stats_t *s) {
+    *s = stats;
+}
+
+uint32_t vfb_tick_get(void) {
+    return tick_ms;
+}
+
+void vfb_tick_inc(uint32_t ms) {
+    tick_ms += ms;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+static void dump_frame(void) {
+    if (dump_mode == VFB_DUMP_RAW) {
+        if (fwrite(vfbp, sizeof(lv_color_t), vfb_w * vfb_h, dump_fp)
+                == vfb_w * vfb_h)
+            stats.dumped++;
+    } else if (dump_mode == VFB_DUMP_PPM) {
+        char path[300];
+        uint32_t x, y;
+
+        snprintf(path, sizeof(path), dump_path, stats.frames);
+        FILE *fp = fopen(path, "wb");
+        if (fp == NULL)
+            return;
+
+        fprintf(fp, "P6\n%u %u\n255\n", vfb_w, vfb_h);
+        for (y = 0; y < vfb_h; y++) {
+            const lv_color_t *src = &vfbp[y * vfb_w];
+            for (x = 0; x < vfb_w; x++) {
+                lv_color32_t c;
+                c.full = lv_color_to32(src[x]);
+                dump_line[x * 3] = c.ch.red;
+                dump_line[x * 3 + 1] = c.ch.green;
+                dump_line[x * 3 + 2] = c.ch.blue;
+            }
+            fwrite(dump_line, 3, vfb_w, fp);
+        }
+        fclose(fp);
+        stats.dumped++;
+    }
+}
+
+#endif /* USE_VFB */
@@ -0,0 +1,82 @@
+/**
+ * @file vfb.h
+ *
+ */
+
+#ifndef VFB_H
+#define VFB_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#ifndef LV_DRV_NO_CONF
+#ifdef LV_CONF_INCLUDE_SIMPLE
+#include "lv_drv_conf.h"
+#else
+#include "../../lv_drv_conf.h"
+#endif
+#endif
+
+#if USE_VFB
+
+#ifdef LV_LVGL_H_INCLUDE_SIMPLE
+#include "lvgl.h"
+#else
+#include "lvgl/lvgl.h"
+#endif
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef enum {
+    VFB_DUMP_NONE = 0,
+    VFB_DUMP_PPM,   /*One P6 file per frame, the path is a printf pattern taking the frame number*/
+    VFB_DUMP_RAW,   /*All frames appended to one file as raw lv_color_t pixels*/
+} vfb_dump_t;
+
+typedef struct {
+    uint32_t frames;  /*Frames completed (last area flushed)*/
+    uint32_t areas;   /*Areas flushed*/
+    uint64_t pixels;  /*Pixels flushed*/
+    uint32_t dumped;  /*Frames written to the dump file(s)*/
+} vfb_stats_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+/*Same interface as sunxifb so HAL can switch backends*/
+void vfb_init(uint32_t rotated);
+void vfb_exit(void);
+void vfb_flush(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color_p);
+void vfb_get_sizes(uint32_t *width, uint32_t *height);
+void* vfb_alloc(size_t size, char *label);
+void vfb_free(void **data, char *label);
+
+/*Headless extras*/
+bool vfb_set_dump(vfb_dump_t mode, const char *path);
+const lv_color_t * vfb_get_buf(void);
+void vfb_get_stats(vfb_stats_t *stats);
+
+/*Deterministic clock: only advances when vfb_tick_inc() is called*/
+uint32_t vfb_tick_get(void);
+void vfb_tick_inc(uint32_t ms);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#endif  /*USE_VFB*/
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /*VFB_H*/
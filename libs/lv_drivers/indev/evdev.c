@@ -10,12 +10,20 @@
 #if USE_EVDEV != 0 || USE_BSD_EVDEV
 
 #include <stdio.h>
+#include <errno.h>
+#include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/ioctl.h>
 #if USE_BSD_EVDEV
 #include <dev/evdev/input.h>
 #else
 #include <linux/input.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include "evlog.h"
 #endif
 
 #if USE_XKB
@@ -25,15 +33,47 @@
 /*********************
  *      DEFINES
  *********************/
+#define EVDEV_QUEUE_LEN 64   /*Frames between the input thread and read_cb, power of 2*/
+#define EVDEV_READ_BATCH 64  /*input_events fetched by one read()*/
+
+#ifndef input_event_sec
+#define input_event_sec time.tv_sec
+#define input_event_usec time.tv_usec
+#endif
 
 /**********************
  *      TYPEDEFS
  **********************/
+/*One SYN_REPORT worth of pointer state*/
+typedef struct {
+    int x;
+    int y;
+    int state;
+    uint64_t time_us; /*CLOCK_MONOTONIC time the kernel stamped on the frame*/
+} evdev_frame_t;
 
 /**********************
  *  STATIC PROTOTYPES
  **********************/
 int map(int x, int in_min, int in_max, int out_min, int out_max);
+static bool evdev_handle_pointer(const struct input_event * in);
+static void evdev_mt_reset(void);
+static void evdev_mt_sync(void);
+static void evdev_store(lv_indev_drv_t * drv, lv_indev_data_t * data, int x, int y, int state);
+#if !USE_BSD_EVDEV
+static void * evdev_thread(void * arg);
+static void evdev_push(const evdev_frame_t * frame);
+static bool evdev_pop(evdev_frame_t * frame);
+static void evdev_resync(void);
+static uint64_t evdev_time_us(void);
+static int evdev_timeout_ms(uint64_t deadline_us, uint64_t now_us);
+static void evdev_thread_event(const struct input_event * in, bool stamped, uint32_t * frames, uint32_t * syn_dropped);
+static int evdev_frame_notify(uint64_t time_us);
+static void evdev_record(const struct input_event * in, bool stamped);
+static void evdev_replay_begin(void);
+static uint64_t evdev_replay_due_us(void);
+static uint32_t evdev_replay_run(uint32_t * frames);
+#endif
 
 /**********************
  *  STATIC VARIABLES
@@ -45,6 +85,52 @@ int evdev_button;
 
 int evdev_key_val;
 
+/*Multi-touch protocol B: contacts per slot, and the contact that drives the LVGL pointer*/
+static evdev_touch_t evdev_slots[EVDEV_MT_SLOTS];
+static int evdev_slot;
+static int evdev_primary = -1;
+static int evdev_primary_id = -1;
+static bool evdev_mt;
+static bool evdev_mt_wait_up;  /*the primary contact lifted while others are down: no new press until all are up*/
+
+#if !USE_BSD_EVDEV
+/*Input thread: the only reader of evdev_fd (and owner of evdev_root_x/y, evdev_button) while running*/
+static struct {
+    bool running;
+    pthread_t tid;
+    int epoll_fd;
+    int stop_fd;
+    bool kernel_time;        /*event timestamps are CLOCK_MONOTONIC*/
+    void (*notify_cb)(void);
+    evdev_frame_cb_t frame_cb;
+    void * frame_cb_data;
+    evdev_frame_t queue[EVDEV_QUEUE_LEN];
+    unsigned head;           /*written by the input thread*/
+    unsigned tail;           /*written by read_cb*/
+    pthread_mutex_t pending_lock;
+    bool pending_en;         /*newest frame, newer than everything in the queue: the queue was full*/
+    evdev_frame_t pending;
+    evdev_frame_t last;      /*last frame handed to LVGL*/
+    bool dropped;            /*input thread: after SYN_DROPPED, ignore events up to the next SYN_REPORT*/
+    uint64_t cb_deadline_us; /*input thread: when the frame callback wants to run without a frame, 0: never*/
+    pthread_mutex_t stats_lock;
+    evdev_stats_t stats;
+    evlog_writer_t record;   /*recording: every event read from evdev_fd*/
+    evlog_t replay;          /*replay: log fed instead of evdev_fd*/
+    bool replay_en;
+    uint32_t replay_idx;     /*next record*/
+    uint64_t replay_src_us;  /*log time of the next record*/
+    uint64_t replay_start_us;
+    float replay_speed;
+    bool replay_done;        /*written by the input thread*/
+} ethread = {
+    .epoll_fd = -1,
+    .stop_fd = -1,
+    .pending_lock = PTHREAD_MUTEX_INITIALIZER,
+    .stats_lock = PTHREAD_MUTEX_INITIALIZER,
+};
+#endif
+
 /**********************
  *      MACROS
  **********************/
@@ -74,6 +160,12 @@ void evdev_init(void)
  */
 bool evdev_set_file(char* dev_name)
 { 
+#if !USE_BSD_EVDEV
+     void (*notify_cb)(void) = ethread.notify_cb;
+     bool restart = ethread.running;
+     evdev_stop_thread();
+#endif
+
      if(evdev_fd != -1) {
         close(evdev_fd);
      }
@@ -101,6 +193,12 @@ bool evdev_set_file(char* dev_name)
      evdev_root_y = 0;
      evdev_key_val = 0;
      evdev_button = LV_INDEV_STATE_REL;
+     evdev_mt_reset();
+
+#if !USE_BSD_EVDEV
+     if(restart)
+        evdev_start_thread(notify_cb);
+#endif
 
      return true;
 }
@@ -108,111 +206,91 @@ bool evdev_set_file(char* dev_name)
  * Get the current position and state of the evdev
  * @param data store the evdev data here
  */
+int evdev_get_fd(void)
+{
+    return evdev_fd;
+}
+
 void evdev_read(lv_indev_drv_t * drv, lv_indev_data_t * data)
 {
     struct input_event in;
 
+#if !USE_BSD_EVDEV
+    if(ethread.running && drv->type == LV_INDEV_TYPE_POINTER) {
+        /*Buffered mode: hand every queued frame to LVGL, one per call*/
+        evdev_frame_t frame;
+        if(evdev_pop(&frame)) {
+            uint64_t now = evdev_time_us();
+            uint32_t latency = now > frame.time_us ? (uint32_t)(now - frame.time_us) : 0;
+
+            pthread_mutex_lock(&ethread.stats_lock);
+            ethread.stats.consumed++;
+            ethread.stats.last_latency_us = latency;
+            if(latency > ethread.stats.max_latency_us)
+                ethread.stats.max_latency_us = latency;
+            ethread.stats.total_latency_us += latency;
+            pthread_mutex_unlock(&ethread.stats_lock);
+
+            ethread.last = frame;
+            data->continue_reading = __atomic_load_n(&ethread.head, __ATOMIC_ACQUIRE) !=
+                                     __atomic_load_n(&ethread.tail, __ATOMIC_RELAXED) ||
+                                     __atomic_load_n(&ethread.pending_en, __ATOMIC_ACQUIRE);
+        }
+        evdev_store(drv, data, ethread.last.x, ethread.last.y, ethread.last.state);
+        return;
+    }
+#endif
+
     while(read(evdev_fd, &in, sizeof(struct input_event)) > 0) {
-        if(in.type == EV_REL) {
-            if(in.code == REL_X)
-				#if EVDEV_SWAP_AXES
-					evdev_root_y += in.value;
-				#else
-					evdev_root_x += in.value;
-				#endif
-            else if(in.code == REL_Y)
-				#if EVDEV_SWAP_AXES
-					evdev_root_x += in.value;
-				#else
-					evdev_root_y += in.value;
-				#endif
-        } else if(in.type == EV_ABS) {
-            if(in.code == ABS_X)
-				#if EVDEV_SWAP_AXES
-					evdev_root_y = in.value;
-				#else
-					evdev_root_x = in.value;
-				#endif
-            else if(in.code == ABS_Y)
-				#if EVDEV_SWAP_AXES
-					evdev_root_x = in.value;
-				#else
-					evdev_root_y = in.value;
-				#endif
-            else if(in.code == ABS_MT_POSITION_X)
-                                #if EVDEV_SWAP_AXES
-                                        evdev_root_y = in.value;
-                                #else
-                                        evdev_root_x = in.value;
-                                #endif
-            else if(in.code == ABS_MT_POSITION_Y)
-                                #if EVDEV_SWAP_AXES
-                                        evdev_root_x = in.value;
-                                #else
-                                        evdev_root_y = in.value;
-                                #endif
-            else if(in.code == ABS_MT_TRACKING_ID) {
-                                if(in.value == -1)
-                                    evdev_button = LV_INDEV_STATE_REL;
-                                else if(in.value == 0)
-                                    evdev_button = LV_INDEV_STATE_PR;
-            } else if(in.code == ABS_PRESSURE) {
-                                if(in.value == 0)
-                                    evdev_button = LV_INDEV_STATE_REL;
-                                else if(in.value > 0)
-                                    evdev_button = LV_INDEV_STATE_PR;
-            }
-        } else if(in.type == EV_KEY) {
-            if(in.code == BTN_MOUSE || in.code == BTN_TOUCH) {
-                if(in.value == 0)
-                    evdev_button = LV_INDEV_STATE_REL;
-                else if(in.value == 1)
-                    evdev_button = LV_INDEV_STATE_PR;
-            } else if(drv->type == LV_INDEV_TYPE_KEYPAD) {
+#if !USE_BSD_EVDEV
+        evdev_record(&in, false);
+#endif
+        if(evdev_handle_pointer(&in))
+            continue;
+        if(in.type == EV_KEY && drv->type == LV_INDEV_TYPE_KEYPAD) {
 #if USE_XKB
-                data->key = xkb_process_key(in.code, in.value != 0);
+            data->key = xkb_process_key(in.code, in.value != 0);
 #else
-                switch(in.code) {
-                    case KEY_BACKSPACE:
-                        data->key = LV_KEY_BACKSPACE;
-                        break;
-                    case KEY_ENTER:
-                        data->key = LV_KEY_ENTER;
-                        break;
-                    case KEY_PREVIOUS:
-                        data->key = LV_KEY_PREV;
-                        break;
-                    case KEY_NEXT:
-                        data->key = LV_KEY_NEXT;
-                        break;
-                    case KEY_UP:
-                        data->key = LV_KEY_UP;
-                        break;
-                    case KEY_LEFT:
-                        data->key = LV_KEY_LEFT;
-                        break;
-                    case KEY_RIGHT:
-                        data->key = LV_KEY_RIGHT;
-                        break;
-                    case KEY_DOWN:
-                        data->key = LV_KEY_DOWN;
-                        break;
-                    case KEY_TAB:
-                        data->key = LV_KEY_NEXT;
-                        break;
-                    default:
-                        data->key = 0;
-                        break;
-                }
+            switch(in.code) {
+                case KEY_BACKSPACE:
+                    data->key = LV_KEY_BACKSPACE;
+                    break;
+                case KEY_ENTER:
+                    data->key = LV_KEY_ENTER;
+                    break;
+                case KEY_PREVIOUS:
+                    data->key = LV_KEY_PREV;
+                    break;
+                case KEY_NEXT:
+                    data->key = LV_KEY_NEXT;
+                    break;
+                case KEY_UP:
+                    data->key = LV_KEY_UP;
+                    break;
+                case KEY_LEFT:
+                    data->key = LV_KEY_LEFT;
+                    break;
+                case KEY_RIGHT:
+                    data->key = LV_KEY_RIGHT;
+                    break;
+                case KEY_DOWN:
+                    data->key = LV_KEY_DOWN;
+                    break;
+                case KEY_TAB:
+                    data->key = LV_KEY_NEXT;
+                    break;
+                default:
+                    data->key = 0;
+                    break;
+            }
 #endif /* USE_XKB */
-                if (data->key != 0) {
-                    /* Only record button state when actual output is produced to prevent widgets from refreshing */
-                    data->state = (in.value) ? LV_INDEV_STATE_PR : LV_INDEV_STATE_REL;
-                }
-                evdev_key_val = data->key;
-                evdev_button = data->state;
-                return;
+            if (data->key != 0) {
+                /* Only record button state when actual output is produced to prevent widgets from refreshing */
+                data->state = (in.value) ? LV_INDEV_STATE_PR : LV_INDEV_STATE_REL;
             }
+            evdev_key_val = data->key;
+            evdev_button = data->state;
+            return;
         }
     }
 
@@ -225,16 +303,373 @@ void evdev_read(lv_indev_drv_t * drv, lv_indev_data_t * data)
     if(drv->type != LV_INDEV_TYPE_POINTER)
         return ;
     /*Store the collected data*/
+    evdev_store(drv, data, evdev_root_x, evdev_root_y, evdev_button);
+}
+
+#if !USE_BSD_EVDEV
+/**
+ * Start a thread that blocks on the evdev fd, reads events in bulk and queues
+ * complete SYN_REPORT frames with their kernel timestamps for `evdev_read`.
+ * Only pointer devices use the queue. Don't read the fd elsewhere while it runs.
+ * @param notify_cb called from the input thread when the queue becomes non-empty
+ *                  (e.g. to wake up an idle LVGL thread), can be NULL
+ * @return true: the thread is running
+ */
+bool evdev_start_thread(void (*notify_cb)(void))
+{
+    if(ethread.running)
+        return true;
+    if(evdev_fd == -1 && !ethread.replay_en)
+        return false;
+
+    /*Read the kernel timestamps on the same clock the consumer uses*/
+    int clk = CLOCK_MONOTONIC;
+    ethread.kernel_time = evdev_fd != -1 && ioctl(evdev_fd, EVIOCSCLOCKID, &clk) == 0;
+
+    ethread.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    ethread.stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if(ethread.epoll_fd < 0 || ethread.stop_fd < 0) {
+        perror("evdev: epoll/eventfd");
+        goto err;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = evdev_fd;
+    if(evdev_fd != -1 && epoll_ctl(ethread.epoll_fd, EPOLL_CTL_ADD, evdev_fd, &ev) != 0)
+        goto err;
+    ev.data.fd = ethread.stop_fd;
+    if(epoll_ctl(ethread.epoll_fd, EPOLL_CTL_ADD, ethread.stop_fd, &ev) != 0)
+        goto err;
+
+    ethread.notify_cb = notify_cb;
+    ethread.head = 0;
+    ethread.tail = 0;
+    ethread.pending_en = false;
+    if(ethread.replay_en)
+        evdev_replay_begin();
+    ethread.last.x = evdev_root_x;
+    ethread.last.y = evdev_root_y;
+    ethread.last.state = evdev_button;
+    ethread.last.time_us = 0;
+
+    if(pthread_create(&ethread.tid, NULL, evdev_thread, NULL) != 0)
+        goto err;
+    ethread.running = true;
+
+    printf("[evdev] input thread started, %s timestamps, %s%s\n", ethread.kernel_time ? "kernel" : "read",
+           evdev_mt ? "multi-touch" : "single-touch", ethread.replay_en ? ", replaying" : "");
+    return true;
+
+err:
+    if(ethread.epoll_fd >= 0)
+        close(ethread.epoll_fd);
+    if(ethread.stop_fd >= 0)
+        close(ethread.stop_fd);
+    ethread.epoll_fd = -1;
+    ethread.stop_fd = -1;
+    return false;
+}
+
+/**
+ * Set a callback for every multi-touch frame, called on the input thread.
+ * Call it before `evdev_start_thread`.
+ * @param cb the callback, NULL to remove it. It gets NULL as frame when its
+ *           last returned timeout (ms, -1: none) expires without new input.
+ * @param user_data passed to the callback
+ */
+void evdev_set_frame_cb(evdev_frame_cb_t cb, void * user_data)
+{
+    ethread.frame_cb = cb;
+    ethread.frame_cb_data = user_data;
+}
+
+/**
+ * Stop the input thread, `evdev_read` reads the fd directly again
+ */
+void evdev_stop_thread(void)
+{
+    if(!ethread.running)
+        return;
+
+    uint64_t one = 1;
+    if(write(ethread.stop_fd, &one, sizeof(one)) < 0)
+        perror("evdev: stop");
+    pthread_join(ethread.tid, NULL);
+    ethread.running = false;
+
+    close(ethread.epoll_fd);
+    close(ethread.stop_fd);
+    ethread.epoll_fd = -1;
+    ethread.stop_fd = -1;
+}
+
+/**
+ * Get the input thread statistics
+ * @param stats store the statistics here
+ */
+void evdev_get_stats(evdev_stats_t * stats)
+{
+    pthread_mutex_lock(&ethread.stats_lock);
+    *stats = ethread.stats;
+    pthread_mutex_unlock(&ethread.stats_lock);
+}
+
+/**
+ * Start logging every event read from the device to a file (see evlog.h).
+ * The input thread is restarted if it runs.
+ * @param path the log file, truncated if it exists
+ * @return true: recording
+ */
+bool evdev_record_start(const char * path)
+{
+    bool restart = ethread.running;
+    evdev_stop_thread();
+
+    evlog_writer_close(&ethread.record);
+    uint16_t flags = (evdev_mt ? EVLOG_FLAG_MT : 0) | (EVDEV_SWAP_AXES ? EVLOG_FLAG_SWAP_AXES : 0);
+    bool ok = evlog_writer_open(&ethread.record, path, flags, evdev_time_us());
+    if(ok)
+        printf("[evdev] recording input to %s\n", path);
+
+    if(restart)
+        evdev_start_thread(ethread.notify_cb);
+    return ok;
+}
+
+/**
+ * Stop recording and flush the log
+ */
+void evdev_record_stop(void)
+{
+    if(ethread.record.fp == NULL)
+        return;
+
+    bool restart = ethread.running;
+    evdev_stop_thread();
+
+    printf("[evdev] recorded %u input events\n", ethread.record.count);
+    evlog_writer_close(&ethread.record);
+
+    if(restart)
+        evdev_start_thread(ethread.notify_cb);
+}
+
+/**
+ * Feed a recorded log to the input thread instead of the device, with the original
+ * timing divided by `speed`. Frames, gestures and statistics go through the same path
+ * as live input; the device is read but ignored until the log ends. Needs the input
+ * thread: replay begins when it (re)starts, the thread is restarted if it runs.
+ * @param path a log written by `evdev_record_start`
+ * @param speed 1: original speed, 2: twice as fast, ...
+ * @return true: the log is loaded
+ */
+bool evdev_replay_start(const char * path, float speed)
+{
+    bool restart = ethread.running;
+    evdev_stop_thread();
+
+    evlog_free(&ethread.replay);
+    ethread.replay_en = false;
+    __atomic_store_n(&ethread.replay_done, false, __ATOMIC_RELAXED);
+
+    bool ok = evlog_load(&ethread.replay, path) >= 0;
+    if(ok) {
+        if(((ethread.replay.header.flags & EVLOG_FLAG_SWAP_AXES) != 0) != (EVDEV_SWAP_AXES != 0))
+            printf("[evdev] %s was recorded with a different EVDEV_SWAP_AXES\n", path);
+        ethread.replay_en = true;
+        ethread.replay_speed = speed > 0 ? speed : 1.0f;
+        printf("[evdev] replaying %u input events from %s at %.2fx\n", ethread.replay.count, path,
+               ethread.replay_speed);
+    }
+
+    if(restart)
+        evdev_start_thread(ethread.notify_cb);
+    return ok;
+}
+
+/**
+ * @return true: a replay started by `evdev_replay_start` has fed its last event
+ */
+bool evdev_replay_is_done(void)
+{
+    return __atomic_load_n(&ethread.replay_done, __ATOMIC_ACQUIRE);
+}
+#endif
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+/**
+ * Apply a pointer event to the MT slots, evdev_root_x/y and evdev_button
+ * @return true: the event was a pointer event
+ */
+static bool evdev_handle_pointer(const struct input_event * in)
+{
+    if(in->type == EV_REL) {
+        if(in->code == REL_X)
+#if EVDEV_SWAP_AXES
+            evdev_root_y += in->value;
+#else
+            evdev_root_x += in->value;
+#endif
+        else if(in->code == REL_Y)
+#if EVDEV_SWAP_AXES
+            evdev_root_x += in->value;
+#else
+            evdev_root_y += in->value;
+#endif
+        return true;
+    } else if(in->type == EV_ABS) {
+        evdev_touch_t * t = evdev_slot >= 0 && evdev_slot < EVDEV_MT_SLOTS ? &evdev_slots[evdev_slot] : NULL;
+
+        if(in->code == ABS_MT_SLOT) {
+            evdev_slot = in->value;
+            evdev_mt = true;
+        } else if(in->code == ABS_MT_TRACKING_ID) {
+            if(t)
+                t->id = in->value;
+            evdev_mt = true;
+        } else if(in->code == ABS_MT_POSITION_X) {
+#if EVDEV_SWAP_AXES
+            if(t)
+                t->y = in->value;
+            if(!evdev_mt)
+                evdev_root_y = in->value;
+#else
+            if(t)
+                t->x = in->value;
+            if(!evdev_mt)
+                evdev_root_x = in->value;
+#endif
+        } else if(in->code == ABS_MT_POSITION_Y) {
+#if EVDEV_SWAP_AXES
+            if(t)
+                t->x = in->value;
+            if(!evdev_mt)
+                evdev_root_x = in->value;
+#else
+            if(t)
+                t->y = in->value;
+            if(!evdev_mt)
+                evdev_root_y = in->value;
+#endif
+        } else if(evdev_mt) {
+            /*ABS_X/Y and ABS_PRESSURE only emulate the oldest contact, the slots are authoritative*/
+        } else if(in->code == ABS_X) {
+#if EVDEV_SWAP_AXES
+            evdev_root_y = in->value;
+#else
+            evdev_root_x = in->value;
+#endif
+        } else if(in->code == ABS_Y) {
+#if EVDEV_SWAP_AXES
+            evdev_root_x = in->value;
+#else
+            evdev_root_y = in->value;
+#endif
+        } else if(in->code == ABS_PRESSURE) {
+            if(in->value == 0)
+                evdev_button = LV_INDEV_STATE_REL;
+            else if(in->value > 0)
+                evdev_button = LV_INDEV_STATE_PR;
+        }
+        return true;
+    } else if(in->type == EV_KEY && (in->code == BTN_MOUSE || in->code == BTN_TOUCH)) {
+        if(evdev_mt)
+            return true;
+        if(in->value == 0)
+            evdev_button = LV_INDEV_STATE_REL;
+        else if(in->value == 1)
+            evdev_button = LV_INDEV_STATE_PR;
+        return true;
+    } else if(in->type == EV_SYN && in->code == SYN_REPORT) {
+        evdev_mt_sync();
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * Forget all contacts and detect whether the device speaks MT protocol B
+ */
+static void evdev_mt_reset(void)
+{
+    for(int i = 0; i < EVDEV_MT_SLOTS; i++) {
+        evdev_slots[i].id = -1;
+        evdev_slots[i].x = 0;
+        evdev_slots[i].y = 0;
+    }
+    evdev_slot = 0;
+    evdev_primary = -1;
+    evdev_primary_id = -1;
+    evdev_mt = false;
+    evdev_mt_wait_up = false;
+
+#if !USE_BSD_EVDEV
+    unsigned long abs_bits[ABS_CNT / (8 * sizeof(unsigned long)) + 1];
+    memset(abs_bits, 0, sizeof(abs_bits));
+    if(ioctl(evdev_fd, EVIOCGBIT(EV_ABS, sizeof(abs_bits)), abs_bits) >= 0) {
+        unsigned long bit = 1UL << (ABS_MT_SLOT % (8 * sizeof(unsigned long)));
+        evdev_mt = abs_bits[ABS_MT_SLOT / (8 * sizeof(unsigned long))] & bit;
+    }
+#endif
+}
+
+/**
+ * End of a frame on an MT device: the first contact to touch drives the LVGL pointer
+ * until it lifts. Other fingers never move or re-press the pointer (no jumps during a pinch).
+ */
+static void evdev_mt_sync(void)
+{
+    if(!evdev_mt)
+        return;
+
+    if(evdev_primary >= 0 && evdev_slots[evdev_primary].id != evdev_primary_id) {
+        evdev_primary = -1;
+        evdev_primary_id = -1;
+        evdev_button = LV_INDEV_STATE_REL;
+        evdev_mt_wait_up = true;
+    }
+
+    int first = -1;
+    for(int i = 0; i < EVDEV_MT_SLOTS; i++) {
+        if(evdev_slots[i].id >= 0) {
+            first = i;
+            break;
+        }
+    }
+    if(first < 0)
+        evdev_mt_wait_up = false;
+
+    if(evdev_primary < 0 && !evdev_mt_wait_up && first >= 0) {
+        evdev_primary = first;
+        evdev_primary_id = evdev_slots[first].id;
+        evdev_button = LV_INDEV_STATE_PR;
+    }
+
+    if(evdev_primary >= 0) {
+        evdev_root_x = evdev_slots[evdev_primary].x;
+        evdev_root_y = evdev_slots[evdev_primary].y;
+    }
+}
 
+/**
+ * Calibrate, clamp and store a pointer sample
+ */
+static void evdev_store(lv_indev_drv_t * drv, lv_indev_data_t * data, int x, int y, int state)
+{
 #if EVDEV_CALIBRATE
-    data->point.x = map(evdev_root_x, EVDEV_HOR_MIN, EVDEV_HOR_MAX, 0, drv->disp->driver->hor_res);
-    data->point.y = map(evdev_root_y, EVDEV_VER_MIN, EVDEV_VER_MAX, 0, drv->disp->driver->ver_res);
+    data->point.x = map(x, EVDEV_HOR_MIN, EVDEV_HOR_MAX, 0, drv->disp->driver->hor_res);
+    data->point.y = map(y, EVDEV_VER_MIN, EVDEV_VER_MAX, 0, drv->disp->driver->ver_res);
 #else
-    data->point.x = evdev_root_x;
-    data->point.y = evdev_root_y;
+    data->point.x = x;
+    data->point.y = y;
 #endif
 
-    data->state = evdev_button;
+    data->state = state;
 
     if(data->point.x < 0)
       data->point.x = 0;
@@ -244,13 +679,387 @@ void evdev_read(lv_indev_drv_t * drv, lv_indev_data_t * data)
       data->point.x = drv->disp->driver->hor_res - 1;
     if(data->point.y >= drv->disp->driver->ver_res)
       data->point.y = drv->disp->driver->ver_res - 1;
+}
 
-    return ;
+#if !USE_BSD_EVDEV
+static uint64_t evdev_time_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
 }
 
-/**********************
- *   STATIC FUNCTIONS
- **********************/
+/**
+ * Queue a frame (input thread). If LVGL is too slow to drain the queue, the newest
+ * frame waits aside and later frames replace it until read_cb has emptied the queue
+ * and taken it, so the final state is never lost even if no more frames come.
+ */
+static void evdev_push(const evdev_frame_t * frame)
+{
+    unsigned head = ethread.head;
+    unsigned tail = __atomic_load_n(&ethread.tail, __ATOMIC_ACQUIRE);
+    bool was_empty = head == tail;
+
+    /*Once a frame waits aside, later frames can't overtake it through the queue*/
+    pthread_mutex_lock(&ethread.pending_lock);
+    if(ethread.pending_en || head - tail == EVDEV_QUEUE_LEN) {
+        bool replaced = ethread.pending_en;
+        ethread.pending = *frame;
+        __atomic_store_n(&ethread.pending_en, true, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&ethread.pending_lock);
+
+        if(replaced) {
+            pthread_mutex_lock(&ethread.stats_lock);
+            ethread.stats.overflows++;
+            pthread_mutex_unlock(&ethread.stats_lock);
+        }
+        else if(ethread.notify_cb) {
+            ethread.notify_cb();
+        }
+        return;
+    }
+    pthread_mutex_unlock(&ethread.pending_lock);
+
+    ethread.queue[head & (EVDEV_QUEUE_LEN - 1)] = *frame;
+    __atomic_store_n(&ethread.head, head + 1, __ATOMIC_RELEASE);
+
+    if(was_empty && ethread.notify_cb)
+        ethread.notify_cb();
+}
+
+/**
+ * Take the oldest frame (read_cb): the queue first, then the frame waiting aside
+ */
+static bool evdev_pop(evdev_frame_t * frame)
+{
+    unsigned tail = ethread.tail;
+
+    if(tail != __atomic_load_n(&ethread.head, __ATOMIC_ACQUIRE)) {
+        *frame = ethread.queue[tail & (EVDEV_QUEUE_LEN - 1)];
+        __atomic_store_n(&ethread.tail, tail + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    if(!__atomic_load_n(&ethread.pending_en, __ATOMIC_ACQUIRE))
+        return false;
+
+    pthread_mutex_lock(&ethread.pending_lock);
+    *frame = ethread.pending;
+    __atomic_store_n(&ethread.pending_en, false, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&ethread.pending_lock);
+    return true;
+}
+
+/**
+ * Query the current pointer state after the kernel dropped events (SYN_DROPPED)
+ */
+static void evdev_resync(void)
+{
+    struct input_absinfo abs;
+    unsigned long keys[KEY_CNT / (8 * sizeof(unsigned long)) + 1];
+
+    if(evdev_mt) {
+        struct {
+            uint32_t code;
+            int32_t values[EVDEV_MT_SLOTS];
+        } req;
+
+        req.code = ABS_MT_TRACKING_ID;
+        if(ioctl(evdev_fd, EVIOCGMTSLOTS(sizeof(req)), &req) == 0)
+            for(int i = 0; i < EVDEV_MT_SLOTS; i++)
+                evdev_slots[i].id = req.values[i];
+        req.code = EVDEV_SWAP_AXES ? ABS_MT_POSITION_Y : ABS_MT_POSITION_X;
+        if(ioctl(evdev_fd, EVIOCGMTSLOTS(sizeof(req)), &req) == 0)
+            for(int i = 0; i < EVDEV_MT_SLOTS; i++)
+                evdev_slots[i].x = req.values[i];
+        req.code = EVDEV_SWAP_AXES ? ABS_MT_POSITION_X : ABS_MT_POSITION_Y;
+        if(ioctl(evdev_fd, EVIOCGMTSLOTS(sizeof(req)), &req) == 0)
+            for(int i = 0; i < EVDEV_MT_SLOTS; i++)
+                evdev_slots[i].y = req.values[i];
+        if(ioctl(evdev_fd, EVIOCGABS(ABS_MT_SLOT), &abs) == 0)
+            evdev_slot = abs.value;
+
+        evdev_mt_sync();
+        return;
+    }
+
+    if(ioctl(evdev_fd, EVIOCGABS(ABS_X), &abs) == 0)
+#if EVDEV_SWAP_AXES
+        evdev_root_y = abs.value;
+#else
+        evdev_root_x = abs.value;
+#endif
+    if(ioctl(evdev_fd, EVIOCGABS(ABS_Y), &abs) == 0)
+#if EVDEV_SWAP_AXES
+        evdev_root_x = abs.value;
+#else
+        evdev_root_y = abs.value;
+#endif
+
+    memset(keys, 0, sizeof(keys));
+    if(ioctl(evdev_fd, EVIOCGKEY(sizeof(keys)), keys) >= 0) {
+        unsigned long bit = 1UL << (BTN_TOUCH % (8 * sizeof(unsigned long)));
+        bool pressed = keys[BTN_TOUCH / (8 * sizeof(unsigned long))] & bit;
+        evdev_button = pressed ? LV_INDEV_STATE_PR : LV_INDEV_STATE_REL;
+    }
+}
+
+/**
+ * Hand the contacts of the frame just completed to the frame callback
+ * @return the callback's timeout
+ */
+static int evdev_frame_notify(uint64_t time_us)
+{
+    evdev_mt_frame_t frame;
+
+    frame.time_us = time_us;
+    frame.count = 0;
+    if(evdev_mt) {
+        for(int i = 0; i < EVDEV_MT_SLOTS; i++) {
+            frame.slots[i] = evdev_slots[i];
+            if(evdev_slots[i].id >= 0)
+                frame.count++;
+        }
+    } else {
+        /*Single-touch device: one contact in slot 0*/
+        for(int i = 0; i < EVDEV_MT_SLOTS; i++)
+            frame.slots[i].id = -1;
+        if(evdev_button == LV_INDEV_STATE_PR) {
+            frame.slots[0].id = 0;
+            frame.slots[0].x = evdev_root_x;
+            frame.slots[0].y = evdev_root_y;
+            frame.count = 1;
+        }
+    }
+
+    return ethread.frame_cb(&frame, evdev_time_us(), ethread.frame_cb_data);
+}
+
+/**
+ * Milliseconds until a deadline, rounded up so epoll doesn't wake up early
+ * @return -1 if there is no deadline (0)
+ */
+static int evdev_timeout_ms(uint64_t deadline_us, uint64_t now_us)
+{
+    if(deadline_us == 0)
+        return -1;
+    if(deadline_us <= now_us)
+        return 0;
+    return (deadline_us - now_us + 999) / 1000;
+}
+
+/**
+ * Apply one event on the input thread and queue a frame per SYN_REPORT
+ * @param stamped the event time is CLOCK_MONOTONIC, otherwise the frame gets the current time
+ */
+static void evdev_thread_event(const struct input_event * in, bool stamped, uint32_t * frames, uint32_t * syn_dropped)
+{
+    if(in->type != EV_SYN) {
+        if(!ethread.dropped)
+            evdev_handle_pointer(in);
+        return;
+    }
+
+    if(in->code == SYN_DROPPED) {
+        ethread.dropped = true;
+        (*syn_dropped)++;
+    } else if(in->code == SYN_REPORT) {
+        if(ethread.dropped) {
+            ethread.dropped = false;
+            evdev_resync();
+        } else {
+            evdev_handle_pointer(in);
+        }
+
+        evdev_frame_t frame;
+        frame.x = evdev_root_x;
+        frame.y = evdev_root_y;
+        frame.state = evdev_button;
+        frame.time_us = stamped ? (uint64_t)in->input_event_sec * 1000000 + in->input_event_usec : evdev_time_us();
+        evdev_push(&frame);
+        (*frames)++;
+
+        if(ethread.frame_cb) {
+            int timeout = evdev_frame_notify(frame.time_us);
+            ethread.cb_deadline_us = timeout < 0 ? 0 : evdev_time_us() + (uint64_t)timeout * 1000;
+        }
+    }
+}
+
+/**
+ * Append an event read from the device to the recording, if any
+ * @param stamped the event time is CLOCK_MONOTONIC, otherwise the current time is logged
+ */
+static void evdev_record(const struct input_event * in, bool stamped)
+{
+    if(ethread.record.fp == NULL)
+        return;
+
+    uint64_t time_us = stamped ? (uint64_t)in->input_event_sec * 1000000 + in->input_event_usec : evdev_time_us();
+    evlog_write(&ethread.record, time_us, in->type, in->code, in->value);
+}
+
+/**
+ * Start feeding the log from its first record: forget the device state and
+ * take the protocol the log was recorded with
+ */
+static void evdev_replay_begin(void)
+{
+    evdev_mt_reset();
+    evdev_mt = (ethread.replay.header.flags & EVLOG_FLAG_MT) != 0;
+    evdev_root_x = 0;
+    evdev_root_y = 0;
+    evdev_button = LV_INDEV_STATE_REL;
+
+    ethread.replay_idx = 0;
+    ethread.replay_src_us = ethread.replay.count > 0 ? ethread.replay.records[0].dt_us : 0;
+    ethread.replay_start_us = evdev_time_us();
+}
+
+/**
+ * @return CLOCK_MONOTONIC time the next record is due
+ */
+static uint64_t evdev_replay_due_us(void)
+{
+    return ethread.replay_start_us + (uint64_t)(ethread.replay_src_us / ethread.replay_speed);
+}
+
+/**
+ * Feed the records that are due (input thread). They are stamped with their due time,
+ * so latency and gestures see the recorded timing. At the end of the log the pointer
+ * is released and the device takes over again.
+ * @return records fed
+ */
+static uint32_t evdev_replay_run(uint32_t * frames)
+{
+    uint64_t now = evdev_time_us();
+    uint32_t fed = 0;
+    uint32_t syn_dropped = 0;
+
+    while(ethread.replay_idx < ethread.replay.count) {
+        uint64_t due = evdev_replay_due_us();
+        if(due > now)
+            return fed;
+
+        const evlog_record_t * rec = &ethread.replay.records[ethread.replay_idx++];
+        if(ethread.replay_idx < ethread.replay.count)
+            ethread.replay_src_us += ethread.replay.records[ethread.replay_idx].dt_us;
+        fed++;
+
+        /*The events the kernel dropped while recording are lost, and there is no device to resync from*/
+        if(rec->type == EV_SYN && rec->code == SYN_DROPPED)
+            continue;
+
+        struct input_event in;
+        memset(&in, 0, sizeof(in));
+        in.input_event_sec = due / 1000000;
+        in.input_event_usec = due % 1000000;
+        in.type = rec->type;
+        in.code = rec->code;
+        in.value = rec->value;
+        evdev_thread_event(&in, true, frames, &syn_dropped);
+    }
+
+    printf("[evdev] replay done, %u input events\n", ethread.replay.count);
+    evlog_free(&ethread.replay);
+    ethread.replay_en = false;
+
+    evdev_mt_reset();
+    evdev_button = LV_INDEV_STATE_REL;
+    evdev_frame_t frame;
+    frame.x = evdev_root_x;
+    frame.y = evdev_root_y;
+    frame.state = LV_INDEV_STATE_REL;
+    frame.time_us = now;
+    evdev_push(&frame);
+    (*frames)++;
+    if(ethread.frame_cb) {
+        int timeout = evdev_frame_notify(now);
+        ethread.cb_deadline_us = timeout < 0 ? 0 : evdev_time_us() + (uint64_t)timeout * 1000;
+    }
+
+    __atomic_store_n(&ethread.replay_done, true, __ATOMIC_RELEASE);
+    if(ethread.notify_cb)
+        ethread.notify_cb();
+    return fed;
+}
+
+/**
+ * Input thread: wait in epoll, read everything available in bulk and queue one
+ * frame per SYN_REPORT. While a log is replayed, its records are fed when due instead.
+ */
+static void * evdev_thread(void * arg)
+{
+    struct input_event buf[EVDEV_READ_BATCH];
+
+    (void)arg;
+    ethread.dropped = false;
+    ethread.cb_deadline_us = 0;
+
+    for(;;) {
+        uint64_t now = evdev_time_us();
+        int timeout = evdev_timeout_ms(ethread.cb_deadline_us, now);
+        if(ethread.replay_en) {
+            int due = evdev_timeout_ms(evdev_replay_due_us(), now);
+            if(timeout < 0 || due < timeout)
+                timeout = due;
+        }
+
+        struct epoll_event ev;
+        int n = epoll_wait(ethread.epoll_fd, &ev, 1, timeout);
+        if(n < 0) {
+            if(errno == EINTR)
+                continue;
+            perror("evdev: epoll_wait");
+            break;
+        }
+        if(n > 0 && ev.data.fd == ethread.stop_fd)
+            break;
+
+        uint32_t reads = 0, events = 0, frames = 0, syn_dropped = 0, replayed = 0;
+        while(n > 0) {
+            ssize_t len = read(evdev_fd, buf, sizeof(buf));
+            if(len <= 0)
+                break;
+            reads++;
+
+            size_t count = len / sizeof(struct input_event);
+            events += count;
+            for(size_t i = 0; i < count; i++) {
+                evdev_record(&buf[i], ethread.kernel_time);
+                /*The panel is ignored while a log is replayed*/
+                if(!ethread.replay_en)
+                    evdev_thread_event(&buf[i], ethread.kernel_time, &frames, &syn_dropped);
+            }
+
+            if((size_t)len < sizeof(buf))
+                break;
+        }
+
+        if(ethread.replay_en)
+            replayed = evdev_replay_run(&frames);
+
+        if(ethread.cb_deadline_us != 0) {
+            now = evdev_time_us();
+            if(now >= ethread.cb_deadline_us) {
+                int cb_timeout = ethread.frame_cb ? ethread.frame_cb(NULL, now, ethread.frame_cb_data) : -1;
+                ethread.cb_deadline_us = cb_timeout < 0 ? 0 : now + (uint64_t)cb_timeout * 1000;
+            }
+        }
+
+        pthread_mutex_lock(&ethread.stats_lock);
+        ethread.stats.reads += reads;
+        ethread.stats.events += events;
+        ethread.stats.frames += frames;
+        ethread.stats.syn_dropped += syn_dropped;
+        ethread.stats.replayed += replayed;
+        pthread_mutex_unlock(&ethread.stats_lock);
+    }
+
+    return NULL;
+}
+#endif
+
 int map(int x, int in_min, int in_max, int out_min, int out_max)
 {
   return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
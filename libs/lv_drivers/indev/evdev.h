@@ -32,10 +32,41 @@ extern "C" {
 /*********************
  *      DEFINES
  *********************/
+#define EVDEV_MT_SLOTS 10   /*Multi-touch contacts tracked*/
 
 /**********************
  *      TYPEDEFS
  **********************/
+/*One multi-touch contact*/
+typedef struct {
+    int id;  /*tracking id, -1: the slot is not in contact*/
+    int x;
+    int y;
+} evdev_touch_t;
+
+/*Contacts after a SYN_REPORT, in device coordinates (after EVDEV_SWAP_AXES)*/
+typedef struct {
+    uint64_t time_us;  /*CLOCK_MONOTONIC time of the frame*/
+    int count;         /*contacts down*/
+    evdev_touch_t slots[EVDEV_MT_SLOTS];
+} evdev_mt_frame_t;
+
+/*Frame callback, see `evdev_set_frame_cb`. Returns the ms after which it wants to be called again without a frame, -1: never*/
+typedef int (*evdev_frame_cb_t)(const evdev_mt_frame_t * frame, uint64_t now_us, void * user_data);
+
+/*Input thread statistics*/
+typedef struct {
+    uint32_t reads;            /*read() calls*/
+    uint32_t events;           /*input_events read*/
+    uint32_t frames;           /*SYN_REPORT frames queued*/
+    uint32_t consumed;         /*frames handed to LVGL*/
+    uint32_t overflows;        /*frames replaced because LVGL didn't drain the queue*/
+    uint32_t syn_dropped;      /*times the kernel dropped events (SYN_DROPPED)*/
+    uint32_t replayed;         /*events fed from a replay log*/
+    uint32_t last_latency_us;  /*kernel timestamp -> read_cb of the last frame*/
+    uint32_t max_latency_us;
+    uint64_t total_latency_us;
+} evdev_stats_t;
 
 /**********************
  * GLOBAL PROTOTYPES
@@ -57,6 +88,57 @@ bool evdev_set_file(char* dev_name);
  * @param data store the evdev data here
  */
 void evdev_read(lv_indev_drv_t * drv, lv_indev_data_t * data);
+/**
+ * Get the file descriptor of the evdev, e.g. to poll it for new events
+ * @return the descriptor or -1 if the device is not open
+ */
+int evdev_get_fd(void);
+
+#if !USE_BSD_EVDEV
+/**
+ * Start a thread that reads the evdev in bulk and queues timestamped
+ * SYN_REPORT frames for `evdev_read` (pointer devices only)
+ * @param notify_cb called from the input thread when the queue becomes non-empty, can be NULL
+ * @return true: the thread is running
+ */
+bool evdev_start_thread(void (*notify_cb)(void));
+/**
+ * Set a callback for every multi-touch frame, called on the input thread (e.g. for gesture recognition)
+ * @param cb the callback, NULL to remove it
+ * @param user_data passed to the callback
+ */
+void evdev_set_frame_cb(evdev_frame_cb_t cb, void * user_data);
+/**
+ * Stop the input thread
+ */
+void evdev_stop_thread(void);
+/**
+ * Get the input thread statistics
+ * @param stats store the statistics here
+ */
+void evdev_get_stats(evdev_stats_t * stats);
+/**
+ * Start logging every event read from the device to a compact binary file (see evlog.h)
+ * @param path the log file
+ * @return true: recording
+ */
+bool evdev_record_start(const char * path);
+/**
+ * Stop recording and flush the log
+ */
+void evdev_record_stop(void);
+/**
+ * Feed a recorded log through the input thread instead of the device
+ * @param path a log written by `evdev_record_start`
+ * @param speed 1: original timing, 2: twice as fast, ...
+ * @return true: the log is loaded, it plays when the input thread (re)starts
+ */
+bool evdev_replay_start(const char * path, float speed);
+/**
+ * @return true: the replay has fed its last event
+ */
+bool evdev_replay_is_done(void);
+#endif
 
 
 /**********************
@@ -0,0 +1,133 @@
+/**
+ * @file evlog.c
+ * Compact binary log of timestamped input_events
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "evlog.h"
+#if (USE_EVDEV && !USE_BSD_EVDEV) || USE_VINPUT
+
+#include <stdlib.h>
+#include <string.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+#define EVLOG_BUF_SIZE (16 * 1024)  /*stdio buffer: the input thread only hits the disk every ~1300 events*/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+bool evlog_writer_open(evlog_writer_t * writer, const char * path, uint16_t flags, uint64_t start_us) {
+    evlog_header_t header;
+
+    memset(writer, 0, sizeof(*writer));
+
+    writer->fp = fopen(path, "wb");
+    if (writer->fp == NULL) {
+        perror("evlog: cannot create log");
+        return false;
+    }
+    setvbuf(writer->fp, NULL, _IOFBF, EVLOG_BUF_SIZE);
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, EVLOG_MAGIC, sizeof(header.magic));
+    header.version = EVLOG_VERSION;
+    header.flags = flags;
+    if (fwrite(&header, sizeof(header), 1, writer->fp) != 1) {
+        perror("evlog: write");
+        fclose(writer->fp);
+        writer->fp = NULL;
+        return false;
+    }
+
+    writer->last_us = start_us;
+    return true;
+}
+
+bool evlog_write(evlog_writer_t * writer, uint64_t time_us, uint16_t type, uint16_t code, int32_t value) {
+    evlog_record_t rec;
+
+    if (writer->fp == NULL)
+        return false;
+
+    /*Out of order timestamps (e.g. read time after a kernel time) count as simultaneous*/
+    uint64_t dt = time_us > writer->last_us ? time_us - writer->last_us : 0;
+    rec.dt_us = dt > UINT32_MAX ? UINT32_MAX : (uint32_t)dt;
+    rec.type = type;
+    rec.code = code;
+    rec.value = value;
+    if (time_us > writer->last_us)
+        writer->last_us = time_us;
+
+    if (fwrite(&rec, sizeof(rec), 1, writer->fp) != 1)
+        return false;
+    writer->count++;
+    return true;
+}
+
+void evlog_writer_close(evlog_writer_t * writer) {
+    if (writer->fp == NULL)
+        return;
+
+    fclose(writer->fp);
+    writer->fp = NULL;
+}
+
+bool evlog_probe(const char * path) {
+    evlog_header_t header;
+    bool ok = false;
+
+    FILE * fp = fopen(path, "rb");
+    if (fp == NULL)
+        return false;
+    if (fread(&header, sizeof(header), 1, fp) == 1)
+        ok = memcmp(header.magic, EVLOG_MAGIC, sizeof(header.magic)) == 0 && header.version == EVLOG_VERSION;
+    fclose(fp);
+    return ok;
+}
+
+int evlog_load(evlog_t * log, const char * path) {
+    memset(log, 0, sizeof(*log));
+
+    FILE * fp = fopen(path, "rb");
+    if (fp == NULL) {
+        perror("evlog: cannot open log");
+        return -1;
+    }
+
+    if (fread(&log->header, sizeof(log->header), 1, fp) != 1 ||
+        memcmp(log->header.magic, EVLOG_MAGIC, sizeof(log->header.magic)) != 0 ||
+        log->header.version != EVLOG_VERSION) {
+        printf("evlog: %s is not an input event log\n", path);
+        fclose(fp);
+        return -1;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp) - (long)sizeof(evlog_header_t);
+    fseek(fp, sizeof(evlog_header_t), SEEK_SET);
+
+    uint32_t count = size > 0 ? size / sizeof(evlog_record_t) : 0;
+    if (count > 0) {
+        log->records = malloc(count * sizeof(evlog_record_t));
+        if (log->records == NULL) {
+            fclose(fp);
+            return -1;
+        }
+        log->count = fread(log->records, sizeof(evlog_record_t), count, fp);
+    }
+    fclose(fp);
+
+    return log->count;
+}
+
+void evlog_free(evlog_t * log) {
+    free(log->records);
+    log->records = NULL;
+    log->count = 0;
+}
+
+#endif /* (USE_EVDEV && !USE_BSD_EVDEV) || USE_VINPUT */
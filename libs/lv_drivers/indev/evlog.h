@@ -0,0 +1,120 @@
+/**
+ * @file evlog.h
+ * Compact binary log of timestamped input_events, for recording and replaying touch sessions
+ *
+ * File layout (native byte order):
+ *   evlog_header_t
+ *   evlog_record_t[]   one per input_event, 12 bytes instead of 24 for a 64-bit input_event
+ */
+
+#ifndef EVLOG_H
+#define EVLOG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#ifndef LV_DRV_NO_CONF
+#ifdef LV_CONF_INCLUDE_SIMPLE
+#include "lv_drv_conf.h"
+#else
+#include "../../lv_drv_conf.h"
+#endif
+#endif
+
+#if (USE_EVDEV && !USE_BSD_EVDEV) || USE_VINPUT
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+#define EVLOG_MAGIC "EVLG"
+#define EVLOG_VERSION 1
+
+#define EVLOG_FLAG_MT         0x01  /*recorded from a multi-touch protocol B device*/
+#define EVLOG_FLAG_SWAP_AXES  0x02  /*recorded by a build with EVDEV_SWAP_AXES*/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+    char magic[4];     /*EVLOG_MAGIC*/
+    uint16_t version;  /*EVLOG_VERSION*/
+    uint16_t flags;    /*EVLOG_FLAG_...*/
+    uint32_t reserved;
+} evlog_header_t;
+
+typedef struct {
+    uint32_t dt_us;    /*time since the previous record (the start of the recording for the first)*/
+    uint16_t type;
+    uint16_t code;
+    int32_t value;
+} evlog_record_t;
+
+typedef struct {
+    FILE * fp;
+    uint64_t last_us;  /*CLOCK_MONOTONIC time of the previous record*/
+    uint32_t count;    /*records written*/
+} evlog_writer_t;
+
+typedef struct {
+    evlog_header_t header;
+    evlog_record_t * records;
+    uint32_t count;
+} evlog_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Create a log file and write its header
+ * @param writer the writer to initialize
+ * @param path file to create (truncated if it exists)
+ * @param flags EVLOG_FLAG_...
+ * @param start_us CLOCK_MONOTONIC time the recording starts
+ * @return true: the file is open
+ */
+bool evlog_writer_open(evlog_writer_t * writer, const char * path, uint16_t flags, uint64_t start_us);
+/**
+ * Append an event. Writes are buffered, the file is written in large blocks.
+ * @param time_us CLOCK_MONOTONIC time of the event
+ * @return true: the event was appended
+ */
+bool evlog_write(evlog_writer_t * writer, uint64_t time_us, uint16_t type, uint16_t code, int32_t value);
+/**
+ * Flush and close the log
+ */
+void evlog_writer_close(evlog_writer_t * writer);
+/**
+ * Check whether a file is an input event log
+ * @return true: the file starts with a valid header
+ */
+bool evlog_probe(const char * path);
+/**
+ * Load a whole log into memory
+ * @return number of records, -1 on error
+ */
+int evlog_load(evlog_t * log, const char * path);
+/**
+ * Free a loaded log
+ */
+void evlog_free(evlog_t * log);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#endif /* (USE_EVDEV && !USE_BSD_EVDEV) || USE_VINPUT */
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* EVLOG_H */
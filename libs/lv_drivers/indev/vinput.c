@@ -0,0 +1,307 @@
+/**
+ * @file vinput.c
+ * Scripted pointer input for headless runs
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "vinput.h"
+#if USE_VINPUT
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <linux/input.h>
+#include "evlog.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+#define VINPUT_MT_SLOTS 10  /*contacts tracked when converting a multi-touch log*/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef enum {
+    VINPUT_DOWN,
+    VINPUT_MOVE,
+    VINPUT_UP,
+    VINPUT_END,
+} vinput_type_t;
+
+typedef struct {
+    uint32_t time;
+    vinput_type_t type;
+    lv_coord_t x;
+    lv_coord_t y;
+} vinput_event_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static bool vinput_add(vinput_event_t * ev, uint32_t * cap);
+static int vinput_load_log(const char * path);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static vinput_event_t *events = NULL;
+static uint32_t event_cnt = 0;
+static uint32_t event_idx = 0;
+static lv_coord_t cur_x;
+static lv_coord_t cur_y;
+static bool pressed;
+static float speed = 1.0f;
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+int vinput_init(const char *path) {
+    uint32_t cap = 0;
+    char line[128];
+    int line_no = 0;
+
+    vinput_deinit();
+
+    if (path == NULL)
+        return 0;
+    if (evlog_probe(path))
+        return vinput_load_log(path);
+
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        perror("vinput: cannot open script");
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        vinput_event_t ev;
+        char cmd[8];
+        int x = 0, y = 0;
+        unsigned long time;
+
+        line_no++;
+        if (line[0] == '#' || line[0] == '\n' || line[0] == '\r')
+            continue;
+
+        int n = sscanf(line, "%lu %7s %d %d", &time, cmd, &x, &y);
+        if (n < 2) {
+            printf("vinput: %s:%d: syntax error\n", path, line_no);
+            continue;
+        }
+
+        if (strcmp(cmd, "down") == 0 && n == 4)
+            ev.type = VINPUT_DOWN;
+        else if (strcmp(cmd, "move") == 0 && n == 4)
+            ev.type = VINPUT_MOVE;
+        else if (strcmp(cmd, "up") == 0)
+            ev.type = VINPUT_UP;
+        else if (strcmp(cmd, "end") == 0)
+            ev.type = VINPUT_END;
+        else {
+            printf("vinput: %s:%d: unknown event\n", path, line_no);
+            continue;
+        }
+        ev.time = time / speed;
+        ev.x = x;
+        ev.y = y;
+
+        if (!vinput_add(&ev, &cap))
+            break;
+    }
+    fclose(fp);
+
+    printf("vinput: %u events from %s\n", event_cnt, path);
+    return event_cnt;
+}
+
+void vinput_set_speed(float s) {
+    speed = s > 0 ? s : 1.0f;
+}
+
+void vinput_deinit(void) {
+    free(events);
+    events = NULL;
+    event_cnt = 0;
+    event_idx = 0;
+    cur_x = 0;
+    cur_y = 0;
+    pressed = false;
+}
+
+void vinput_read(lv_indev_drv_t * drv, lv_indev_data_t * data) {
+    uint32_t now = lv_tick_get();
+
+    LV_UNUSED(drv);
+
+    /*Apply every event that is due. Only the last position of a burst is
+     *reported, like a real touch panel sampled once per read*/
+    while (event_idx < event_cnt && events[event_idx].time <= now) {
+        const vinput_event_t *ev = &events[event_idx++];
+        switch (ev->type) {
+        case VINPUT_DOWN:
+            pressed = true;
+            cur_x = ev->x;
+            cur_y = ev->y;
+            break;
+        case VINPUT_MOVE:
+            cur_x = ev->x;
+            cur_y = ev->y;
+            break;
+        case VINPUT_UP:
+            pressed = false;
+            break;
+        case VINPUT_END:
+            event_idx = event_cnt;
+            break;
+        }
+
+        /*Report a press/release before later events can hide it*/
+        if (ev->type == VINPUT_DOWN || ev->type == VINPUT_UP)
+            break;
+    }
+
+    data->point.x = cur_x;
+    data->point.y = cur_y;
+    data->state = pressed ? LV_INDEV_STATE_PR : LV_INDEV_STATE_REL;
+}
+
+bool vinput_is_done(void) {
+    return event_idx >= event_cnt;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+static bool vinput_add(vinput_event_t * ev, uint32_t * cap) {
+    if (event_cnt == *cap) {
+        uint32_t n = *cap ? *cap * 2 : 64;
+        vinput_event_t *p = realloc(events, n * sizeof(vinput_event_t));
+        if (p == NULL)
+            return false;
+        events = p;
+        *cap = n;
+    }
+    events[event_cnt++] = *ev;
+    return true;
+}
+
+/**
+ * Convert a recorded input event log (see evlog.h) to pointer events. The pointer
+ * follows the same contact as evdev: the first finger down, until it lifts, then
+ * nothing until all fingers are up.
+ */
+static int vinput_load_log(const char * path) {
+    evlog_t log;
+    struct {
+        int id;
+        int x;
+        int y;
+    } slots[VINPUT_MT_SLOTS];
+    int slot = 0;
+    int primary = -1;
+    int primary_id = -1;
+    bool wait_up = false;
+    int x = 0, y = 0;
+    bool down = false, was_down = false;
+    int last_x = -1, last_y = -1;
+    uint64_t time_us = 0;
+    uint32_t cap = 0;
+
+    if (evlog_load(&log, path) < 0)
+        return -1;
+
+    bool mt = log.header.flags & EVLOG_FLAG_MT;
+    bool swap = log.header.flags & EVLOG_FLAG_SWAP_AXES;
+    for (int i = 0; i < VINPUT_MT_SLOTS; i++)
+        slots[i].id = -1;
+
+    for (uint32_t i = 0; i < log.count; i++) {
+        const evlog_record_t *rec = &log.records[i];
+        bool in_slot = slot >= 0 && slot < VINPUT_MT_SLOTS;
+
+        time_us += rec->dt_us;
+        if (rec->type == EV_ABS) {
+            if (rec->code == ABS_MT_SLOT)
+                slot = rec->value;
+            else if (rec->code == ABS_MT_TRACKING_ID && in_slot)
+                slots[slot].id = rec->value;
+            else if (rec->code == ABS_MT_POSITION_X && in_slot)
+                slots[slot].x = rec->value;
+            else if (rec->code == ABS_MT_POSITION_Y && in_slot)
+                slots[slot].y = rec->value;
+            else if (mt)
+                continue;
+            else if (rec->code == ABS_X)
+                x = rec->value;
+            else if (rec->code == ABS_Y)
+                y = rec->value;
+            else if (rec->code == ABS_PRESSURE)
+                down = rec->value > 0;
+            continue;
+        }
+        if (rec->type == EV_KEY && (rec->code == BTN_TOUCH || rec->code == BTN_MOUSE)) {
+            if (!mt)
+                down = rec->value != 0;
+            continue;
+        }
+        if (rec->type != EV_SYN || rec->code != SYN_REPORT)
+            continue;
+
+        if (mt) {
+            if (primary >= 0 && slots[primary].id != primary_id) {
+                primary = -1;
+                wait_up = true;
+            }
+            int first = -1;
+            for (int j = 0; j < VINPUT_MT_SLOTS && first < 0; j++)
+                if (slots[j].id >= 0)
+                    first = j;
+            if (first < 0)
+                wait_up = false;
+            if (primary < 0 && !wait_up && first >= 0) {
+                primary = first;
+                primary_id = slots[first].id;
+            }
+            down = primary >= 0;
+            if (down) {
+                x = slots[primary].x;
+                y = slots[primary].y;
+            }
+        }
+
+        /*The log holds device axes, swap them like evdev did when recording*/
+        vinput_event_t ev;
+        ev.time = time_us / 1000 / speed;
+        ev.x = swap ? y : x;
+        ev.y = swap ? x : y;
+        if (down && !was_down)
+            ev.type = VINPUT_DOWN;
+        else if (down && (ev.x != last_x || ev.y != last_y))
+            ev.type = VINPUT_MOVE;
+        else if (!down && was_down)
+            ev.type = VINPUT_UP;
+        else
+            continue;
+
+        was_down = down;
+        last_x = ev.x;
+        last_y = ev.y;
+        if (!vinput_add(&ev, &cap))
+            break;
+    }
+
+    if (was_down) {
+        vinput_event_t ev = {(uint32_t)(time_us / 1000 / speed), VINPUT_UP, last_x, last_y};
+        vinput_add(&ev, &cap);
+    }
+    vinput_event_t end = {(uint32_t)(time_us / 1000 / speed), VINPUT_END, 0, 0};
+    vinput_add(&end, &cap);
+
+    printf("vinput: %u events from %u logged input events in %s\n", event_cnt, log.count, path);
+    evlog_free(&log);
+    return event_cnt;
+}
+
+#endif /* USE_VINPUT */
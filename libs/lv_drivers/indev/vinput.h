@@ -0,0 +1,85 @@
+/**
+ * @file vinput.h
+ *
+ */
+
+#ifndef VINPUT_H
+#define VINPUT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#ifndef LV_DRV_NO_CONF
+#ifdef LV_CONF_INCLUDE_SIMPLE
+#include "lv_drv_conf.h"
+#else
+#include "../../lv_drv_conf.h"
+#endif
+#endif
+
+#if USE_VINPUT
+
+#ifdef LV_LVGL_H_INCLUDE_SIMPLE
+#include "lvgl.h"
+#else
+#include "lvgl/lvgl.h"
+#endif
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Load a pointer script. One event per line, times in ms of lv_tick_get():
+ *   <ms> down <x> <y>
+ *   <ms> move <x> <y>
+ *   <ms> up
+ *   <ms> end        (optional, the script is done at this time)
+ * Empty lines and lines starting with '#' are ignored.
+ * An input event log recorded on the device (see evlog.h) is also accepted.
+ * @param path script file or input event log, NULL for no input
+ * @return number of events loaded, -1 on error
+ */
+int vinput_init(const char *path);
+/**
+ * Set the replay speed of scripts loaded afterwards
+ * @param speed 1: original timing, 2: twice as fast, ...
+ */
+void vinput_set_speed(float speed);
+/**
+ * Free the loaded script
+ */
+void vinput_deinit(void);
+/**
+ * Replay the script as a pointer device
+ * @param data store the pointer state here
+ */
+void vinput_read(lv_indev_drv_t * drv, lv_indev_data_t * data);
+/**
+ * @return true when every event of the script has been replayed
+ */
+bool vinput_is_done(void);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#endif /* USE_VINPUT */
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* VINPUT_H */
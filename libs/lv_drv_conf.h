@@ -343,6 +343,22 @@
 
 #if USE_SUNXIFB
 #  define SUNXIFB_PATH          "/dev/fb0"
+/*Draw into a back buffer and pan to it on the vblank. Uses as many
+ *buffers (2 or 3) as the framebuffer memory holds, single buffer otherwise*/
+#  define USE_SUNXIFB_DOUBLE_BUFFER
+#endif
+
+/*-----------------------------------------
+ *  Virtual frame buffer (headless, in memory)
+ *.........................................*/
+#ifndef USE_VFB
+#  define USE_VFB               0
+#endif
+
+#if USE_VFB
+#  define VFB_HOR_RES           800
+#  define VFB_VER_RES           480
+#  define VFB_FRAME_MS          16      /*Max. virtual time step per lv_task_handler() call*/
 #endif
 
 /*-----------------------------------------
@@ -471,6 +487,13 @@
 #  endif  /*EVDEV_CALIBRATE*/
 #endif  /*USE_EVDEV*/
 
+/*-------------------------------------------------
+ * Scripted pointer input (headless, pairs with USE_VFB)
+ *------------------------------------------------*/
+#ifndef USE_VINPUT
+#  define USE_VINPUT          USE_VFB
+#endif
+
 /*-------------------------------------------------
  * Full keyboard support for evdev and libinput interface
  *------------------------------------------------*/
@@ -1,7 +1,6 @@
 #include "../include/common_inc.h"
 #include "Model.h"
 
-pthread_mutex_t lv_mutex;
 static pthread_t threadLvgl;
 static Page::Model *model;
 
@@ -12,6 +11,7 @@ int main(int argc, char *argv[])
 {
     printf("[Sys] EasyMediaPlayer begin!\n");
 
+#if !USE_VFB
     // 清除fb0
     system("dd if=/dev/zero of=/dev/fb0");
     // 打开音频通路并设置音量
@@ -20,6 +20,7 @@ int main(int argc, char *argv[])
 
     // TODO：解决重复挂载的问题
     system("mount /dev/sda /mnt/exUDISK/");
+#endif
 
     // Init HAL
     HAL::Init();
@@ -30,10 +31,12 @@ int main(int argc, char *argv[])
     /* Handle LitlevGL tasks (tickless mode) */
     pthread_create(&threadLvgl, NULL, threadLvglHandler, NULL);
 
-    while (1)
-    {
-        // ...
-    }
+    // 主线程没有其他事务，阻塞等待LVGL线程
+    pthread_join(threadLvgl, NULL);
+
+    // 收到退出信号或无屏幕运行的输入脚本结束后LVGL线程返回：先停掉Model线程，再释放显示和输入
+    delete model;
+    HAL::Deinit();
 
     return 0;
 }
@@ -46,6 +49,8 @@ int main(int argc, char *argv[])
 void *threadLvglHandler(void *)
 {
     HAL::LVGL_Proc();
+
+    return NULL;
 }
 
 /**
@@ -0,0 +1,222 @@
+#include "DisplayFlusher.h"
+#include "../../utils/Tick/Tick.h"
+#include <stdio.h>
+#include <string.h>
+
+/* 调试时每隔这么多帧打印一次统计 */
+#define DISPLAYFLUSHER_LOG_FRAMES 300
+
+/**
+ * @brief 显示刷新器构造函数
+ * @param flushCb 底层flush函数
+ * @param threaded 是否创建刷新线程（需要两个绘制缓冲才有意义）
+ */
+DisplayFlusher::DisplayFlusher(FlushCb flushCb, bool threaded)
+{
+    _flushCb = flushCb;
+    _renderStartCb = NULL;
+    _threaded = threaded;
+    _stop = false;
+    _threadRunning = false;
+    _frameStartUs = 0;
+    _segStartUs = 0;
+    _renderUs = 0;
+    _waitUs = 0;
+    _flushUs = 0;
+    memset(&_work, 0, sizeof(_work));
+
+    pthread_mutex_init(&_mutex, NULL);
+    pthread_cond_init(&_jobCond, NULL);
+    pthread_cond_init(&_doneCond, NULL);
+
+    if (_threaded)
+    {
+        if (pthread_create(&_pthread, NULL, threadProcHandler, this) == 0)
+            _threadRunning = true;
+        else
+        {
+            printf("[Flush] create flush thread failed, flush in LVGL thread\n");
+            _threaded = false;
+        }
+    }
+}
+
+DisplayFlusher::~DisplayFlusher()
+{
+    Stop();
+    pthread_cond_destroy(&_doneCond);
+    pthread_cond_destroy(&_jobCond);
+    pthread_mutex_destroy(&_mutex);
+}
+
+/**
+ * @brief 接管显示驱动的回调，需在lv_disp_drv_register之前调用
+ */
+void DisplayFlusher::Attach(lv_disp_drv_t *drv)
+{
+    drv->user_data = this;
+    drv->flush_cb = flushHandler;
+    drv->render_start_cb = renderStartHandler;
+    if (_threaded)
+        drv->wait_cb = waitHandler;
+}
+
+/**
+ * @brief 停止刷新线程，正在刷新的区域会先完成
+ */
+void DisplayFlusher::Stop(void)
+{
+    if (!_threadRunning)
+        return;
+
+    pthread_mutex_lock(&_mutex);
+    _stop = true;
+    pthread_cond_signal(&_jobCond);
+    pthread_mutex_unlock(&_mutex);
+
+    if (!pthread_equal(pthread_self(), _pthread))
+        pthread_join(_pthread, NULL);
+    _threadRunning = false;
+    _threaded = false;
+}
+
+/**
+ * @brief 刷新线程：依次把队列里的区域拷贝到framebuffer
+ */
+void *DisplayFlusher::threadProcHandler(void *arg)
+{
+    DisplayFlusher *flusher = (DisplayFlusher *)arg;
+    Job job;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&flusher->_mutex);
+        while (flusher->_jobs.IsEmpty() && !flusher->_stop)
+            pthread_cond_wait(&flusher->_jobCond, &flusher->_mutex);
+        pthread_mutex_unlock(&flusher->_mutex);
+
+        if (!flusher->_jobs.Pop(job))
+            break; // 队列已空且要求退出
+
+        flusher->doFlush(job);
+
+        // 底层flush已调用lv_disp_flush_ready，唤醒在waitHandler里等待的LVGL线程
+        pthread_mutex_lock(&flusher->_mutex);
+        pthread_cond_broadcast(&flusher->_doneCond);
+        pthread_mutex_unlock(&flusher->_mutex);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief 刷新一个区域并更新统计，在刷新线程（或非线程模式下的LVGL线程）中调用
+ */
+void DisplayFlusher::doFlush(const Job &job)
+{
+    uint64_t t0 = tick_get_us();
+    _flushCb(job.drv, &job.area, job.color_p);
+    uint64_t t1 = tick_get_us();
+
+    _flushUs += t1 - t0;
+    _work.areas++;
+
+    if (!job.last)
+    {
+        _stats.Write(_work);
+        return;
+    }
+
+    _work.frames++;
+    _work.lastFrameUs = t1 - job.frameStartUs;
+    _work.lastRenderUs = job.renderUs;
+    _work.lastFlushUs = _flushUs;
+    _work.lastWaitUs = job.waitUs;
+    _work.totalFrameUs += _work.lastFrameUs;
+    _work.totalRenderUs += _work.lastRenderUs;
+    _work.totalFlushUs += _work.lastFlushUs;
+    _work.totalWaitUs += _work.lastWaitUs;
+    _flushUs = 0;
+    _stats.Write(_work);
+
+#ifdef LV_USE_SUNXIFB_DEBUG
+    if (_work.frames % DISPLAYFLUSHER_LOG_FRAMES == 0)
+        printf("[Flush] avg frame %llu us, render %llu us, flush %llu us, wait %llu us (%s)\n",
+               (unsigned long long)(_work.totalFrameUs / _work.frames),
+               (unsigned long long)(_work.totalRenderUs / _work.frames),
+               (unsigned long long)(_work.totalFlushUs / _work.frames),
+               (unsigned long long)(_work.totalWaitUs / _work.frames),
+               _threaded ? "threaded" : "inline");
+#endif
+}
+
+/**
+ * @brief LVGL开始渲染一帧
+ */
+void DisplayFlusher::renderStartHandler(lv_disp_drv_t *drv)
+{
+    DisplayFlusher *flusher = (DisplayFlusher *)drv->user_data;
+
+    flusher->_frameStartUs = tick_get_us();
+    flusher->_segStartUs = flusher->_frameStartUs;
+    flusher->_renderUs = 0;
+    flusher->_waitUs = 0;
+
+    if (flusher->_renderStartCb != NULL)
+        flusher->_renderStartCb(drv);
+}
+
+/**
+ * @brief LVGL渲染完一个区域，线程模式下入队后立即返回继续渲染下一个区域
+ */
+void DisplayFlusher::flushHandler(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_p)
+{
+    DisplayFlusher *flusher = (DisplayFlusher *)drv->user_data;
+    uint64_t now = tick_get_us();
+
+    flusher->_renderUs += now - flusher->_segStartUs;
+
+    Job job;
+    job.drv = drv;
+    job.area = *area;
+    job.color_p = color_p;
+    job.last = lv_disp_flush_is_last(drv);
+    job.frameStartUs = flusher->_frameStartUs;
+    job.renderUs = flusher->_renderUs;
+    job.waitUs = flusher->_waitUs;
+
+    bool queued = false;
+    if (flusher->_threaded)
+    {
+        pthread_mutex_lock(&flusher->_mutex);
+        queued = flusher->_jobs.Push(job);
+        if (queued)
+            pthread_cond_signal(&flusher->_jobCond);
+        pthread_mutex_unlock(&flusher->_mutex);
+    }
+
+    // 非线程模式（或队列意外已满）时就地刷新
+    if (!queued)
+        flusher->doFlush(job);
+
+    flusher->_segStartUs = tick_get_us();
+}
+
+/**
+ * @brief LVGL等待另一个绘制缓冲刷新完成，阻塞在条件变量上而不是空转
+ */
+void DisplayFlusher::waitHandler(lv_disp_drv_t *drv)
+{
+    DisplayFlusher *flusher = (DisplayFlusher *)drv->user_data;
+    uint64_t t0 = tick_get_us();
+
+    flusher->_renderUs += t0 - flusher->_segStartUs;
+
+    pthread_mutex_lock(&flusher->_mutex);
+    while (drv->draw_buf->flushing && flusher->_threaded)
+        pthread_cond_wait(&flusher->_doneCond, &flusher->_mutex);
+    pthread_mutex_unlock(&flusher->_mutex);
+
+    flusher->_segStartUs = tick_get_us();
+    flusher->_waitUs += flusher->_segStartUs - t0;
+}
@@ -0,0 +1,307 @@
+#include "GestureRecognizer.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief 手势识别器构造函数
+ * @param notifyCb 有新手势时在输入线程调用（例如唤醒LVGL线程）
+ */
+GestureRecognizer::GestureRecognizer(NotifyCb notifyCb)
+{
+    _notifyCb = notifyCb;
+    _state = IDLE;
+    _id = -1;
+    memset(&_start, 0, sizeof(_start));
+    _historyLen = 0;
+    _moved = false;
+    _swiped = false;
+    _longPressed = false;
+    _pinchIds[0] = _pinchIds[1] = -1;
+    _pinchDist = 0;
+    _lastScale = 1.0f;
+    memset(&_work, 0, sizeof(_work));
+}
+
+/**
+ * @brief 处理一帧触摸（输入线程调用）
+ * @param touches 按下的触点，为空表示没有新输入、只是超时
+ * @param count 触点数
+ * @param timeUs 输入帧的时间
+ * @param nowUs 当前时间
+ * @retval 下次无输入时需要再调用的毫秒数，-1表示不需要
+ */
+int GestureRecognizer::Process(const Touch *touches, int count, uint64_t timeUs, uint64_t nowUs)
+{
+    if (touches == NULL)
+    {
+        checkLongPress(nowUs);
+        return timeout(nowUs);
+    }
+
+    _work.frames++;
+
+    switch (_state)
+    {
+    case IDLE:
+        if (count == 1)
+            beginSingle(touches[0], timeUs);
+        else if (count >= 2)
+            beginPinch(touches, count, timeUs);
+        break;
+
+    case SINGLE:
+    {
+        const Touch *touch = find(touches, count, _id);
+        if (count >= 2 && !_swiped && !_longPressed)
+            beginPinch(touches, count, timeUs);
+        else if (touch == NULL)
+        {
+            endSingle(timeUs);
+            _state = count == 0 ? IDLE : WAIT_UP;
+        }
+        else
+        {
+            moveSingle(*touch, timeUs);
+            checkLongPress(nowUs);
+        }
+        break;
+    }
+
+    case PINCHING:
+    {
+        const Touch *a = find(touches, count, _pinchIds[0]);
+        const Touch *b = find(touches, count, _pinchIds[1]);
+        Gesture gesture;
+        memset(&gesture, 0, sizeof(gesture));
+        gesture.timeUs = timeUs;
+        gesture.scale = _lastScale;
+
+        if (a == NULL || b == NULL)
+        {
+            gesture.type = PINCH_END;
+            emit(gesture);
+            _state = count == 0 ? IDLE : WAIT_UP;
+            break;
+        }
+
+        float scale = hypotf(a->x - b->x, a->y - b->y) / _pinchDist;
+        if (fabsf(scale - _lastScale) >= GESTURE_PINCH_STEP)
+        {
+            _lastScale = scale;
+            gesture.type = PINCH;
+            gesture.x = (a->x + b->x) / 2;
+            gesture.y = (a->y + b->y) / 2;
+            gesture.scale = scale;
+            emit(gesture);
+        }
+        break;
+    }
+
+    case WAIT_UP:
+        if (count == 0)
+            _state = IDLE;
+        break;
+    }
+
+    _stats.Write(_work);
+    return timeout(nowUs);
+}
+
+void GestureRecognizer::beginSingle(const Touch &touch, uint64_t timeUs)
+{
+    _state = SINGLE;
+    _id = touch.id;
+    _start.x = touch.x;
+    _start.y = touch.y;
+    _start.us = timeUs;
+    _history[0] = _start;
+    _historyLen = 1;
+    _moved = false;
+    _swiped = false;
+    _longPressed = false;
+}
+
+void GestureRecognizer::moveSingle(const Touch &touch, uint64_t timeUs)
+{
+    Sample &sample = _history[_historyLen % GESTURE_HISTORY];
+    sample.x = touch.x;
+    sample.y = touch.y;
+    sample.us = timeUs;
+    _historyLen++;
+
+    int dx = touch.x - _start.x;
+    int dy = touch.y - _start.y;
+    if (!_moved && dx * dx + dy * dy > GESTURE_SLOP_PX * GESTURE_SLOP_PX)
+        _moved = true;
+
+    if (!_swiped && !_longPressed)
+        _swiped = trySwipe(timeUs);
+}
+
+/**
+ * @brief 单指抬起：移动中没达到速度的，按松手前的速度再判断一次（快速甩动）
+ */
+void GestureRecognizer::endSingle(uint64_t timeUs)
+{
+    if (!_swiped && !_longPressed)
+        trySwipe(timeUs);
+    _id = -1;
+}
+
+void GestureRecognizer::beginPinch(const Touch *touches, int count, uint64_t timeUs)
+{
+    float dist = hypotf(touches[0].x - touches[1].x, touches[0].y - touches[1].y);
+
+    if (dist < GESTURE_PINCH_MIN_PX)
+    {
+        _state = WAIT_UP;
+        return;
+    }
+
+    _state = PINCHING;
+    _pinchIds[0] = touches[0].id;
+    _pinchIds[1] = touches[1].id;
+    _pinchDist = dist;
+    _lastScale = 1.0f;
+    _work.pinches++;
+
+    Gesture gesture;
+    memset(&gesture, 0, sizeof(gesture));
+    gesture.type = PINCH_BEGIN;
+    gesture.x = (touches[0].x + touches[1].x) / 2;
+    gesture.y = (touches[0].y + touches[1].y) / 2;
+    gesture.scale = 1.0f;
+    gesture.timeUs = timeUs;
+    emit(gesture);
+}
+
+/**
+ * @brief 按住不动到时间了就上报长按
+ * @retval true 本次上报了长按
+ */
+bool GestureRecognizer::checkLongPress(uint64_t nowUs)
+{
+    if (_state != SINGLE || _moved || _swiped || _longPressed)
+        return false;
+    if (nowUs - _start.us < (uint64_t)GESTURE_LONG_PRESS_MS * 1000)
+        return false;
+
+    _longPressed = true;
+    _work.longPresses++;
+
+    Gesture gesture;
+    memset(&gesture, 0, sizeof(gesture));
+    gesture.type = LONG_PRESS;
+    gesture.x = _start.x;
+    gesture.y = _start.y;
+    gesture.timeUs = _start.us + (uint64_t)GESTURE_LONG_PRESS_MS * 1000;
+    emit(gesture);
+    _stats.Write(_work);
+    return true;
+}
+
+/**
+ * @brief 位移和主方向上的速度都够了就上报滑动
+ * @retval true 上报了滑动
+ */
+bool GestureRecognizer::trySwipe(uint64_t timeUs)
+{
+    const Sample &last = _history[(_historyLen - 1) % GESTURE_HISTORY];
+    int dx = last.x - _start.x;
+    int dy = last.y - _start.y;
+    float vx, vy;
+
+    if (dx * dx + dy * dy < GESTURE_SWIPE_MIN_PX * GESTURE_SWIPE_MIN_PX || !velocity(vx, vy))
+        return false;
+
+    bool horizontal = abs(dx) >= abs(dy);
+    float v = horizontal ? vx : vy;
+    int d = horizontal ? dx : dy;
+    // 速度要够快，且与位移同向（甩回来的不算）
+    if (fabsf(v) < GESTURE_SWIPE_MIN_VELOCITY || (v > 0) != (d > 0))
+        return false;
+
+    Gesture gesture;
+    memset(&gesture, 0, sizeof(gesture));
+    gesture.type = SWIPE;
+    if (horizontal)
+        gesture.dir = dx > 0 ? LV_DIR_RIGHT : LV_DIR_LEFT;
+    else
+        gesture.dir = dy > 0 ? LV_DIR_BOTTOM : LV_DIR_TOP;
+    gesture.x = _start.x;
+    gesture.y = _start.y;
+    gesture.dx = dx;
+    gesture.dy = dy;
+    gesture.vx = vx;
+    gesture.vy = vy;
+    gesture.timeUs = timeUs;
+    _work.swipes++;
+    emit(gesture);
+    return true;
+}
+
+/**
+ * @brief 最近GESTURE_VELOCITY_WINDOW_MS内的平均速度
+ * @retval true 成功 / false 采样不足
+ */
+bool GestureRecognizer::velocity(float &vx, float &vy) const
+{
+    uint32_t n = _historyLen < GESTURE_HISTORY ? _historyLen : GESTURE_HISTORY;
+    if (n < 2)
+        return false;
+
+    const Sample &last = _history[(_historyLen - 1) % GESTURE_HISTORY];
+    const Sample *first = &last;
+    for (uint32_t i = 2; i <= n; i++)
+    {
+        const Sample &sample = _history[(_historyLen - i) % GESTURE_HISTORY];
+        if (last.us - sample.us > (uint64_t)GESTURE_VELOCITY_WINDOW_MS * 1000)
+            break;
+        first = &sample;
+    }
+
+    uint64_t dt = last.us - first->us;
+    if (dt == 0)
+        return false;
+
+    vx = (last.x - first->x) * 1e6f / dt;
+    vy = (last.y - first->y) * 1e6f / dt;
+    return true;
+}
+
+const GestureRecognizer::Touch *GestureRecognizer::find(const Touch *touches, int count, int id) const
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (touches[i].id == id)
+            return &touches[i];
+    }
+    return NULL;
+}
+
+void GestureRecognizer::emit(const Gesture &gesture)
+{
+    if (!_queue.Push(gesture))
+    {
+        _work.dropped++;
+        return;
+    }
+
+    if (_notifyCb)
+        _notifyCb();
+}
+
+/**
+ * @brief 等待长按时，返回到期的剩余时间
+ */
+int GestureRecognizer::timeout(uint64_t nowUs) const
+{
+    if (_state != SINGLE || _moved || _swiped || _longPressed)
+        return -1;
+
+    uint64_t deadline = _start.us + (uint64_t)GESTURE_LONG_PRESS_MS * 1000;
+    if (nowUs >= deadline)
+        return 0;
+    return (deadline - nowUs + 999) / 1000;
+}
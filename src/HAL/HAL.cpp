@@ -1,86 +1,218 @@
 #include "HAL.h"
 #include "ResourcePool.h"
+#include "DisplayFlusher.h"
+#include "MappedFs.h"
+#include <errno.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 
-/* File system funtion */
-static void *fs_open(lv_fs_drv_t *drv, const char *path, lv_fs_mode_t mode);
-static lv_fs_res_t fs_close(lv_fs_drv_t *drv, void *file_p);
-static lv_fs_res_t fs_read(lv_fs_drv_t *drv, void *file_p, void *buf, uint32_t btr, uint32_t *br);
-static lv_fs_res_t fs_seek(lv_fs_drv_t *drv, void *file_p, uint32_t pos, lv_fs_whence_t whence);
-static lv_fs_res_t fs_tell(lv_fs_drv_t *drv, void *file_p, uint32_t *pos_p);
+/* 调试时每隔这么久打印一次刷新调度统计 */
+#define HAL_SCHED_LOG_MS 10000
 
 /* Signal handler */
 void signalExitCallback(int signal);
+void signalFatalCallback(int signal);
 /* set Signal Callback */
 void install_signal_handler(void);
 /* LVGL tick get */
 uint32_t custom_tick_get(void);
 
+/* LVGL的全局锁：LVGL线程处理时持有，其他线程调用LVGL接口前获取 */
+pthread_mutex_t lv_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* 显示刷新器，统计渲染/刷新耗时，分块模式下在独立线程中刷新 */
+static DisplayFlusher *flusher;
+
+/* 刷新调度：唤醒LVGL线程的eventfd，以及发布给其他线程的统计 */
+static int wakeFd = -1;
+static SeqLock<HAL::SchedStats> schedStats;
+
+/* 收到的退出信号：信号处理函数只置位并唤醒LVGL线程，由LVGL线程退出循环后按顺序清理 */
+static volatile sig_atomic_t exitSignal;
+
+#if USE_EVDEV
+/* 触摸输入线程：是否在运行，以及队列由空变为非空的通知（输入线程置位，LVGL线程清除） */
+static bool inputThread;
+static std::atomic<bool> inputPending(false);
+
+static void inputNotify(void);
+
+/* 手势识别：在输入线程按帧识别，在LVGL线程分发 */
+static GestureRecognizer *gestures;
+static HAL::GestureCb gestureCb;
+
+/* 触摸重采样：输入线程写入主触点的采样，LVGL线程按帧的显示时间取位置 */
+static InputResampler resampler;
+static int resampleId = -1;  // 跟踪的主触点ID
+static bool resampleWaitUp; // 主触点抬起后，等所有手指抬起再跟踪新的触点
+
+/* 输入回放：回放结束时打印回放期间的帧耗时和CPU占用，作为可重复的性能测试 */
+static bool inputReplay;
+
+static int inputFrameCb(const evdev_mt_frame_t *frame, uint64_t nowUs, void *userData);
+static void resampleFrame(const evdev_mt_frame_t *frame);
+static void rotatePoint(lv_disp_t *disp, int &x, int &y);
+static void gestureDispatch(lv_disp_t *disp);
+static void replayReport(const HAL::SchedStats &stats, uint64_t nowUs);
+#endif
+
+#if !USE_VFB
+static bool schedIsBusy(lv_disp_t *disp);
+static void schedSetActive(lv_disp_t *disp, bool active);
+static void schedReadInput(void);
+#endif
+
+#if !USE_VFB
+/* UI合成：每帧开始渲染前标记含有UI内容的图块，只把这些图块写入framebuffer */
+static uint8_t *compMask;
+static uint32_t compCols, compRows, compTile;
+
+static void compMarkArea(const lv_area_t *area);
+static void compMarkObj(lv_obj_t *obj);
+static void compRenderStart(lv_disp_drv_t *drv);
+#endif
+
+/* 显示后端：USE_VFB时使用内存中的虚拟framebuffer（无屏幕、时钟可控），否则使用/dev/fb0 */
+#if USE_VFB
+#define disp_backend_init vfb_init
+#define disp_backend_exit vfb_exit
+#define disp_backend_flush vfb_flush
+#define disp_backend_get_sizes vfb_get_sizes
+#define disp_backend_alloc vfb_alloc
+#define disp_backend_free vfb_free
+#define disp_backend_rotates() false
+#define disp_backend_period_us() (VFB_FRAME_MS * 1000)
+#else
+#define disp_backend_init sunxifb_init
+#define disp_backend_exit sunxifb_exit
+#define disp_backend_flush sunxifb_flush
+#define disp_backend_get_sizes sunxifb_get_sizes
+#define disp_backend_alloc sunxifb_alloc
+#define disp_backend_free sunxifb_free
+#define disp_backend_rotates sunxifb_rotates
+
+static uint32_t disp_backend_period_us(void)
+{
+    sunxifb_present_stats_t stats;
+    sunxifb_get_present_stats(&stats);
+    return stats.period_us;
+}
+#endif
+
 /**
  * @brief 硬件抽象层初始化
  *
  */
 void HAL::Init(void)
 {
+#if TICK_BENCHMARK
+    tick_benchmark();
+#endif
+
     // LittlevGL init
     lv_init();
     uint32_t rotated = LV_DISP_ROT_NONE;
 
     // Linux frame buffer device init
-    sunxifb_init(rotated);
+    disp_backend_init(rotated);
 
     // A buffer for LittlevGL to draw the screen's content
     static uint32_t width, height;
-    sunxifb_get_sizes(&width, &height);
+    disp_backend_get_sizes(&width, &height);
+
+    // HAL_DRAW_BUF_DIV > 1 时使用两个1/HAL_DRAW_BUF_DIV屏幕大小的缓冲，渲染与刷新重叠
+    static lv_color_t *buf1, *buf2;
+    uint32_t bufSize = width * height;
+    if (HAL_DRAW_BUF_DIV > 1)
+        bufSize = width * ((height + HAL_DRAW_BUF_DIV - 1) / HAL_DRAW_BUF_DIV);
 
-    static lv_color_t *buf;
-    buf = (lv_color_t *)sunxifb_alloc(width * height * sizeof(lv_color_t), (char *)"lv_examples");
+    buf1 = (lv_color_t *)disp_backend_alloc(bufSize * sizeof(lv_color_t), (char *)"lv_examples");
+    buf2 = NULL;
+    if (HAL_DRAW_BUF_DIV > 1)
+        buf2 = (lv_color_t *)disp_backend_alloc(bufSize * sizeof(lv_color_t), (char *)"lv_examples2");
 
-    if (buf == NULL)
+    if (buf1 == NULL || (HAL_DRAW_BUF_DIV > 1 && buf2 == NULL))
     {
-        sunxifb_exit();
+        if (buf2 != NULL)
+            disp_backend_free((void **)&buf2, (char *)"lv_examples2");
+        disp_backend_free((void **)&buf1, (char *)"lv_examples");
+        disp_backend_exit();
         printf("malloc draw buffer fail\n");
         return;
     }
 
     // Initialize a descriptor for the buffer
     static lv_disp_draw_buf_t disp_buf;
-    lv_disp_draw_buf_init(&disp_buf, buf, NULL, width * height);
+    lv_disp_draw_buf_init(&disp_buf, buf1, buf2, bufSize);
+    printf("[HAL] draw buffer %u lines x %d\n", bufSize / width, buf2 != NULL ? 2 : 1);
 
     // Initialize and register a display driver
     static lv_disp_drv_t disp_drv;
     lv_disp_drv_init(&disp_drv);
     disp_drv.draw_buf = &disp_buf;
-    disp_drv.flush_cb = sunxifb_flush;
     disp_drv.hor_res = width;
     disp_drv.ver_res = height;
     disp_drv.rotated = rotated;
-#ifndef USE_SUNXIFB_G2D_ROTATE
-    if (rotated != LV_DISP_ROT_NONE)
+    // 显示驱动不能自己旋转时由LVGL逐块软件旋转
+    if (rotated != LV_DISP_ROT_NONE && !disp_backend_rotates())
         disp_drv.sw_rotate = 1;
+    flusher = new DisplayFlusher(disp_backend_flush, buf2 != NULL);
+    flusher->Attach(&disp_drv);
+    lv_disp_t *disp = lv_disp_drv_register(&disp_drv);
+
+    // 活动时按显示帧率刷新，比屏幕更快的刷新看不到
+    uint32_t periodMs = LV_MAX(LV_DISP_DEF_REFR_PERIOD, disp_backend_period_us() / 1000);
+    lv_timer_set_period(disp->refr_timer, periodMs);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    HAL::SchedStats sched = {0};
+    sched.periodMs = periodMs;
+    sched.active = true;
+    schedStats.Write(sched);
+
+#if USE_VFB
+    // 无屏幕运行：EMP_VFB_DUMP=ppm:<带%u的路径> 或 raw:<文件> 保存每一帧
+    const char *dump = getenv("EMP_VFB_DUMP");
+    if (dump != NULL && strncmp(dump, "ppm:", 4) == 0)
+        vfb_set_dump(VFB_DUMP_PPM, dump + 4);
+    else if (dump != NULL && strncmp(dump, "raw:", 4) == 0)
+        vfb_set_dump(VFB_DUMP_RAW, dump + 4);
 #endif
-    lv_disp_drv_register(&disp_drv);
 
-    evdev_init();
     static lv_indev_drv_t indev_drv;
     // Basic initialization
     lv_indev_drv_init(&indev_drv);
     indev_drv.type = LV_INDEV_TYPE_POINTER;
+    // 回放速度：EMP_INPUT_SPEED=2 为两倍速
+    const char *speed = getenv("EMP_INPUT_SPEED");
+    float inputSpeed = speed != NULL ? atof(speed) : 1.0f;
+#if USE_VINPUT
+    // 触摸由脚本或设备上录制的输入日志EMP_VINPUT回放
+    vinput_set_speed(inputSpeed);
+    vinput_init(getenv("EMP_VINPUT"));
+    indev_drv.read_cb = vinput_read;
+#else
+    evdev_init();
     indev_drv.read_cb = evdev_read;
+    // EMP_INPUT_RECORD=<文件> 录制触摸事件；EMP_INPUT_REPLAY=<文件> 由输入线程按录制时的节奏回放
+    const char *record = getenv("EMP_INPUT_RECORD");
+    const char *replay = getenv("EMP_INPUT_REPLAY");
+    if (record != NULL)
+        evdev_record_start(record);
+    if (replay != NULL)
+        inputReplay = evdev_replay_start(replay, inputSpeed);
+    // 独立线程批量读取触摸并按SYN_REPORT成帧，LVGL按缓冲模式逐帧读取；失败时仍由读取定时器轮询fd
+    gestures = new GestureRecognizer(HAL::WakeUp);
+    evdev_set_frame_cb(inputFrameCb, gestures);
+    inputThread = evdev_start_thread(inputNotify);
+#endif
     // Register the driver in LVGL and save the created input device object
     lv_indev_t *evdev_indev = lv_indev_drv_register(&indev_drv);
 
-    // file system initialization
-    static lv_fs_drv_t fs_drv;
-    lv_fs_drv_init(&fs_drv);
-
-    fs_drv.letter = 'S';
-    fs_drv.open_cb = fs_open;
-    fs_drv.close_cb = fs_close;
-    fs_drv.read_cb = fs_read;
-    fs_drv.seek_cb = fs_seek;
-    fs_drv.tell_cb = fs_tell;
-
-    lv_fs_drv_register(&fs_drv);
+    // file system initialization：小文件映射后按指针读取，大文件pread加块缓存，.bin图片直接使用映射
+    // 存储分区上的文件用户随时可能改写，一律pread
+    static const char *const userRoots[] = {UDISK_DIR, EXUDISK_DIR, NULL};
+    MappedFs::Config fsConfig = {MAPPEDFS_MAP_MAX, MAPPEDFS_BLOCK_SIZE, MAPPEDFS_CACHE_BLOCKS, userRoots};
+    MappedFs::Init('S', &fsConfig);
 
     /* Initialize resource pool */
     ResourcePool::Init();
@@ -95,182 +227,768 @@ void HAL::Init(void)
  */
 void HAL::LVGL_Proc(void)
 {
+#if USE_VFB
+    // 无屏幕运行：不睡眠，直接把虚拟时钟推进到下一个定时器，结果与机器快慢无关，
+    // 同时统计每次lv_task_handler的实际耗时
+    uint32_t calls = 0;
+    uint64_t totalUs = 0, maxUs = 0;
+
+    for (;;)
+    {
+        uint64_t t0 = tick_get_us();
+        pthread_mutex_lock(&lv_mutex);
+        uint32_t ms = lv_task_handler();
+        pthread_mutex_unlock(&lv_mutex);
+        uint64_t us = tick_get_us() - t0;
+
+        calls++;
+        totalUs += us;
+        if (us > maxUs)
+            maxUs = us;
+
+#if USE_VINPUT
+        if (vinput_is_done())
+            break;
+#endif
+        if (exitSignal)
+            break;
+        vfb_tick_inc(LV_CLAMP(1, ms, VFB_FRAME_MS));
+    }
+
+    // 等刷新线程把最后一帧刷完，统计才完整
+    flusher->Stop();
+
+    vfb_stats_t vfbStats;
+    vfb_get_stats(&vfbStats);
+    DisplayFlusher::Stats renderStats = flusher->GetStats();
+    printf("[HAL] %u ms virtual, lv_task_handler %u calls, avg %llu us, max %llu us\n",
+           vfb_tick_get(), calls, (unsigned long long)(calls ? totalUs / calls : 0),
+           (unsigned long long)maxUs);
+    printf("[HAL] %u frames, %u areas, %llu px, render avg %llu us, flush avg %llu us\n",
+           vfbStats.frames, vfbStats.areas, (unsigned long long)vfbStats.pixels,
+           (unsigned long long)(renderStats.frames ? renderStats.totalRenderUs / renderStats.frames : 0),
+           (unsigned long long)(renderStats.frames ? renderStats.totalFlushUs / renderStats.frames : 0));
+#else
+    // 有动画、滚动、按下或待重绘区域时按显示帧率运行；界面静止时暂停刷新和输入定时器，
+    // 阻塞在触摸fd和eventfd上，直到下一个LVGL定时器到期、有触摸或被HAL::WakeUp唤醒
+    lv_disp_t *disp = lv_disp_get_default();
+#if USE_EVDEV
+    int inputFd = inputThread ? -1 : evdev_get_fd();
+#else
+    int inputFd = -1;
+#endif
+    HAL::SchedStats stats = schedStats.Read();
+    bool active = true;
+    bool input = false;
+    uint64_t stateUs = tick_get_us();
+#ifdef LV_USE_SUNXIFB_DEBUG
+    uint64_t logUs = stateUs;
+    HAL::SchedStats logStats = stats;
+#endif
+
     for (;;)
     {
         pthread_mutex_lock(&lv_mutex);
+        if (input && !active)
+        {
+            schedSetActive(disp, true);
+            active = true;
+            stats.activations++;
+        }
+        else if (input)
+        {
+            // 新的触摸帧立即交给LVGL，不等读取定时器的周期
+            schedReadInput();
+        }
+        input = false;
+#if USE_EVDEV
+        gestureDispatch(disp);
+#endif
+
         uint32_t ms = lv_task_handler();
+        bool busy = schedIsBusy(disp);
+        if (busy != active)
+        {
+            schedSetActive(disp, busy);
+            active = busy;
+            if (busy)
+            {
+                stats.activations++;
+                ms = 0;
+            }
+            else
+            {
+                // 刷新和输入定时器已暂停，重新取得下一个定时器的时间
+                ms = lv_task_handler();
+            }
+        }
         pthread_mutex_unlock(&lv_mutex);
-        usleep(ms * 1000);
+
+        uint64_t now = tick_get_us();
+        if (stats.active)
+            stats.activeUs += now - stateUs;
+        else
+            stats.idleUs += now - stateUs;
+        stateUs = now;
+        stats.active = active;
+
+        struct timespec cpu;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+        stats.cpuUs = (uint64_t)cpu.tv_sec * 1000000 + cpu.tv_nsec / 1000;
+        schedStats.Write(stats);
+#if USE_EVDEV
+        if (inputReplay)
+            replayReport(stats, now);
+#endif
+
+#ifdef LV_USE_SUNXIFB_DEBUG
+        if (now - logUs >= HAL_SCHED_LOG_MS * 1000)
+        {
+            double sec = (now - logUs) / 1e6;
+            printf("[HAL] sched %.1f wakeups/s (idle %.1f/s), active %u%%, cpu %.1f%%\n",
+                   (stats.wakeups - logStats.wakeups) / sec,
+                   (stats.idleWakeups - logStats.idleWakeups) / sec,
+                   (uint32_t)((stats.activeUs - logStats.activeUs) * 100 / (now - logUs)),
+                   (stats.cpuUs - logStats.cpuUs) / 1e4 / sec);
+#if USE_EVDEV
+            evdev_stats_t in;
+            if (HAL::GetInputStats(in) && in.consumed > 0)
+                printf("[HAL] input %u frames in %u reads, latency avg %llu us, max %u us, %u overflows\n",
+                       in.frames, in.reads, (unsigned long long)(in.total_latency_us / in.consumed),
+                       in.max_latency_us, in.overflows);
+#endif
+            logUs = now;
+            logStats = stats;
+        }
+#endif
+
+        // 活动时触摸fd由读取定时器轮询，只等eventfd（输入线程和HAL::WakeUp）
+        struct pollfd fds[2] = {{wakeFd, POLLIN, 0}, {inputFd, POLLIN, 0}};
+        int nfds = !active && inputFd >= 0 ? 2 : 1;
+        int timeout = ms == LV_NO_TIMER_READY ? -1 : (int)ms;
+        if (poll(fds, nfds, timeout) > 0)
+        {
+            uint64_t count;
+            if (fds[0].revents & POLLIN)
+                read(wakeFd, &count, sizeof(count));
+            input = nfds == 2 && (fds[1].revents & POLLIN);
+        }
+#if USE_EVDEV
+        if (inputPending.exchange(false))
+            input = true;
+#endif
+        if (!active)
+            stats.idleWakeups++;
+        stats.wakeups++;
+
+        if (exitSignal)
+            break;
     }
+#endif
+
+    if (exitSignal)
+        printf("[Sys] Got signal %d, exiting ...\n", (int)exitSignal);
 }
 
 /**
- * @brief 系统退出回调函数
+ * @brief 唤醒LVGL线程，可在任意线程调用
  *
- * @param signal
+ * 其他线程改变了界面要显示的状态时调用（例如让LVGL定时器立即运行后），界面静止时
+ * LVGL线程不会周期性醒来。
  */
-void signalExitCallback(int signal)
+void HAL::WakeUp(void)
 {
-    printf("[Sys] Got signal %d, exiting ...\n", signal);
+    uint64_t one = 1;
 
-    sunxifb_free((void **)&lv_disp_get_default()->driver->draw_buf->buf1, (char *)"lv_examples");
-    sunxifb_exit();
-    lv_deinit();
+    if (wakeFd >= 0)
+        write(wakeFd, &one, sizeof(one));
+}
 
-    exit(0);
+#if USE_EVDEV
+/**
+ * @brief 获取触摸输入线程统计（含触摸到LVGL读取的延迟）
+ * @retval true 成功 / false 输入线程未运行
+ */
+bool HAL::GetInputStats(evdev_stats_t &stats)
+{
+    if (!inputThread)
+        return false;
+
+    evdev_get_stats(&stats);
+    return true;
 }
 
 /**
- * @brief 系统退出信号绑定
+ * @brief 设置手势回调，在LVGL线程调用，坐标已按显示旋转换算
+ * @retval true 成功 / false 输入线程未运行，收不到手势
+ */
+bool HAL::SetGestureCb(GestureCb cb)
+{
+    gestureCb = cb;
+    return inputThread;
+}
+
+/**
+ * @brief 获取手势识别统计
+ */
+bool HAL::GetGestureStats(GestureRecognizer::Stats &stats)
+{
+    if (!inputThread)
+        return false;
+
+    stats = gestures->GetStats();
+    return true;
+}
+
+/**
+ * @brief 取主触点在帧显示时的位置（按触摸事件时间戳插值/外推），在LVGL线程调用
  *
+ * 拖动动画在LV_EVENT_PRESSING里用它代替lv_indev_get_point，位置对应的是这一帧真正显示的时刻，
+ * 而不是LVGL上次读取触摸的时刻。坐标已按显示旋转换算。
+ * @retval true 手指按下 / false 已抬起或输入线程未运行（point不变）
  */
-void install_signal_handler(void)
+bool HAL::GetResampledPointer(lv_point_t &point)
 {
-    signal(SIGBUS, signalExitCallback);
-    signal(SIGFPE, signalExitCallback);
-    signal(SIGHUP, signalExitCallback);
-    signal(SIGILL, signalExitCallback);
-    signal(SIGINT, signalExitCallback);
-    signal(SIGIOT, signalExitCallback);
-    signal(SIGPIPE, signalExitCallback);
-    signal(SIGQUIT, signalExitCallback);
-    signal(SIGSEGV, signalExitCallback);
-    signal(SIGSYS, signalExitCallback);
-    signal(SIGTERM, signalExitCallback);
-    signal(SIGTRAP, signalExitCallback);
-    signal(SIGUSR1, signalExitCallback);
-    signal(SIGUSR2, signalExitCallback);
+    if (!inputThread)
+        return false;
+
+    // 本帧在下一个显示周期显示
+    int x, y;
+    if (!resampler.Resample(tick_get_us() + disp_backend_period_us(), x, y))
+        return false;
+
+    rotatePoint(lv_disp_get_default(), x, y);
+    point.x = x;
+    point.y = y;
+    return true;
 }
 
-/* Set in lv_conf.h as `LV_TICK_CUSTOM_SYS_TIME_EXPR` */
-uint32_t custom_tick_get(void)
+/**
+ * @brief 设置触摸重采样参数（预测量、最多外推时间）
+ */
+void HAL::SetResamplerConfig(const InputResampler::Config &config)
+{
+    resampler.SetConfig(config);
+}
+
+/**
+ * @brief 每个触摸帧（或识别器要求的超时）在输入线程调用，交给重采样和手势识别器
+ */
+static int inputFrameCb(const evdev_mt_frame_t *frame, uint64_t nowUs, void *userData)
 {
-    static uint64_t start_ms = 0;
-    if (start_ms == 0)
+    GestureRecognizer *recognizer = (GestureRecognizer *)userData;
+
+    if (frame == NULL)
+        return recognizer->Process(NULL, 0, 0, nowUs);
+
+    resampleFrame(frame);
+
+    GestureRecognizer::Touch touches[EVDEV_MT_SLOTS];
+    int count = 0;
+    for (int i = 0; i < EVDEV_MT_SLOTS; i++)
     {
-        struct timeval tv_start;
-        gettimeofday(&tv_start, NULL);
-        start_ms = ((uint64_t)tv_start.tv_sec * 1000000 + (uint64_t)tv_start.tv_usec) / 1000;
+        if (frame->slots[i].id < 0)
+            continue;
+        touches[count].id = frame->slots[i].id;
+        touches[count].x = frame->slots[i].x;
+        touches[count].y = frame->slots[i].y;
+        count++;
     }
 
-    struct timeval tv_now;
-    gettimeofday(&tv_now, NULL);
-    uint64_t now_ms;
-    now_ms = ((uint64_t)tv_now.tv_sec * 1000000 + (uint64_t)tv_now.tv_usec) / 1000;
+    return recognizer->Process(touches, count, frame->time_us, nowUs);
+}
+
+/**
+ * @brief 跟踪主触点写入重采样器，与evdev报给LVGL的主触点一致：第一根按下的手指，
+ *        它抬起后直到所有手指抬起才跟踪新的触点
+ */
+static void resampleFrame(const evdev_mt_frame_t *frame)
+{
+    const evdev_touch_t *primary = NULL;
+    const evdev_touch_t *first = NULL;
 
-    uint32_t time_ms = now_ms - start_ms;
-    return time_ms;
+    for (int i = 0; i < EVDEV_MT_SLOTS; i++)
+    {
+        const evdev_touch_t *touch = &frame->slots[i];
+        if (touch->id < 0)
+            continue;
+        if (first == NULL)
+            first = touch;
+        if (touch->id == resampleId)
+            primary = touch;
+    }
+
+    if (first == NULL)
+    {
+        resampleId = -1;
+        resampleWaitUp = false;
+        resampler.Release();
+        return;
+    }
+
+    if (resampleId < 0 && !resampleWaitUp)
+    {
+        resampleId = first->id;
+        primary = first;
+    }
+
+    if (primary != NULL)
+        resampler.Add(primary->id, primary->x, primary->y, frame->time_us);
+    else if (!resampleWaitUp)
+    {
+        resampleId = -1;
+        resampleWaitUp = true;
+        resampler.Release();
+    }
 }
 
 /**
- * Open a file
- * @param drv pointer to a driver where this function belongs
- * @param path path to the file beginning with the driver letter (e.g. S:/folder/file.txt)
- * @param mode read: FS_MODE_RD, write: FS_MODE_WR, both: FS_MODE_RD | FS_MODE_WR
- * @return pointer to FIL struct or NULL in case of fail
+ * @brief 触摸设备坐标按显示旋转换算（与LVGL处理触摸点的方式一致）
  */
-static void *fs_open(lv_fs_drv_t *drv, const char *path, lv_fs_mode_t mode)
+static void rotatePoint(lv_disp_t *disp, int &x, int &y)
 {
-    char smode[4] = {0};
-    FILE *fp = NULL;
+    uint32_t rotated = disp->driver->rotated;
 
-    if (mode == LV_FS_MODE_WR)
-        strcpy(smode, "wb");
-    else if (mode == LV_FS_MODE_RD)
-        strcpy(smode, "rb");
-    else if (mode == (LV_FS_MODE_WR | LV_FS_MODE_RD))
-        strcpy(smode, "wb+");
-    else
-        return NULL;
+    if (rotated == LV_DISP_ROT_180 || rotated == LV_DISP_ROT_270)
+    {
+        x = disp->driver->hor_res - x - 1;
+        y = disp->driver->ver_res - y - 1;
+    }
+    if (rotated == LV_DISP_ROT_90 || rotated == LV_DISP_ROT_270)
+    {
+        int tmp = y;
+        y = x;
+        x = disp->driver->ver_res - tmp - 1;
+    }
+}
 
-    fp = fopen(path, smode);
+/**
+ * @brief 取出识别好的手势，按显示旋转换算坐标和方向后回调
+ */
+static void gestureDispatch(lv_disp_t *disp)
+{
+    GestureRecognizer::Gesture gesture;
+    uint32_t rotated = disp->driver->rotated;
 
-    return fp;
+    while (gestures->Pop(gesture))
+    {
+        int x = gesture.x, y = gesture.y;
+        rotatePoint(disp, x, y);
+        gesture.x = x;
+        gesture.y = y;
+
+        if (rotated == LV_DISP_ROT_180 || rotated == LV_DISP_ROT_270)
+        {
+            gesture.dx = -gesture.dx;
+            gesture.dy = -gesture.dy;
+            gesture.vx = -gesture.vx;
+            gesture.vy = -gesture.vy;
+        }
+        if (rotated == LV_DISP_ROT_90 || rotated == LV_DISP_ROT_270)
+        {
+            int16_t tmp = gesture.dy;
+            gesture.dy = gesture.dx;
+            gesture.dx = -tmp;
+            float vtmp = gesture.vy;
+            gesture.vy = gesture.vx;
+            gesture.vx = -vtmp;
+        }
+        if (gesture.type == GestureRecognizer::SWIPE)
+        {
+            if (abs(gesture.dx) >= abs(gesture.dy))
+                gesture.dir = gesture.dx > 0 ? LV_DIR_RIGHT : LV_DIR_LEFT;
+            else
+                gesture.dir = gesture.dy > 0 ? LV_DIR_BOTTOM : LV_DIR_TOP;
+        }
+
+#ifdef LV_USE_SUNXIFB_DEBUG
+        printf("[HAL] gesture %d, %llu us after the touch\n", gesture.type,
+               (unsigned long long)(tick_get_us() - gesture.timeUs));
+#endif
+        if (gestureCb)
+            gestureCb(gesture);
+    }
 }
 
 /**
- * Close an opened file
- * @param drv pointer to a driver where this function belongs
- * @param file_p pointer to a FIL variable. (opened with fs_open)
- * @return LV_FS_RES_OK: no error, the file is read
- *         any error from lv_fs_res_t enum
+ * @brief 输入回放开始时记下统计，结束时打印回放期间的帧数、帧耗时、CPU占用和输入延迟
  */
-static lv_fs_res_t fs_close(lv_fs_drv_t *drv, void *file_p)
+static void replayReport(const HAL::SchedStats &stats, uint64_t nowUs)
 {
-    lv_fs_res_t res = LV_FS_RES_NOT_IMP;
+    static bool started;
+    static HAL::SchedStats startStats;
+    static DisplayFlusher::Stats startRender;
+    static evdev_stats_t startInput;
+    static uint64_t startUs;
 
-    FILE *fp = (FILE *)file_p;
+    if (!started)
+    {
+        started = true;
+        startStats = stats;
+        startRender = flusher->GetStats();
+        evdev_get_stats(&startInput);
+        startUs = nowUs;
+        return;
+    }
+    if (!evdev_replay_is_done())
+        return;
+    inputReplay = false;
+
+    DisplayFlusher::Stats render = flusher->GetStats();
+    evdev_stats_t input;
+    evdev_get_stats(&input);
+    uint32_t frames = render.frames - startRender.frames;
+    uint32_t consumed = input.consumed - startInput.consumed;
+    double sec = (nowUs - startUs) / 1e6;
+
+    printf("[HAL] replay %.2f s: %u frames (%.1f fps), frame avg %llu us, render avg %llu us, flush avg %llu us\n",
+           sec, frames, frames / sec,
+           (unsigned long long)(frames ? (render.totalFrameUs - startRender.totalFrameUs) / frames : 0),
+           (unsigned long long)(frames ? (render.totalRenderUs - startRender.totalRenderUs) / frames : 0),
+           (unsigned long long)(frames ? (render.totalFlushUs - startRender.totalFlushUs) / frames : 0));
+    printf("[HAL] replay cpu %.1f%%, active %u%%, %u wakeups, input latency avg %llu us\n",
+           (stats.cpuUs - startStats.cpuUs) / 1e4 / sec,
+           (uint32_t)((stats.activeUs - startStats.activeUs) * 100 / (nowUs - startUs)),
+           stats.wakeups - startStats.wakeups,
+           (unsigned long long)(consumed ? (input.total_latency_us - startInput.total_latency_us) / consumed : 0));
+}
 
-    if (0 == fclose(fp))
-        res = LV_FS_RES_OK;
-    else
-        res = LV_FS_RES_FS_ERR;
+/**
+ * @brief 输入线程有新的触摸帧：唤醒LVGL线程
+ */
+static void inputNotify(void)
+{
+    inputPending.store(true);
+    HAL::WakeUp();
+}
+#else
+bool HAL::GetResampledPointer(lv_point_t &point)
+{
+    // 没有触摸输入线程，调用方使用lv_indev_get_point
+    return false;
+}
 
-    return res;
+void HAL::SetResamplerConfig(const InputResampler::Config &config)
+{
 }
 
+bool HAL::SetGestureCb(GestureCb cb)
+{
+    // 没有触摸输入线程（虚拟输入回放），手势由LVGL识别
+    return false;
+}
+
+bool HAL::GetGestureStats(GestureRecognizer::Stats &stats)
+{
+    return false;
+}
+#endif
+
 /**
- * Read data from an opened file
- * @param drv pointer to a driver where this function belongs
- * @param file_p pointer to a FIL variable.
- * @param buf pointer to a memory block where to store the read data
- * @param btr number of Bytes To Read
- * @param br the real number of read bytes (Byte Read)
- * @return LV_FS_RES_OK: no error, the file is read
- *         any error from lv_fs_res_t enum
+ * @brief 获取刷新调度统计
  */
-static lv_fs_res_t fs_read(lv_fs_drv_t *drv, void *file_p, void *buf, uint32_t btr, uint32_t *br)
+bool HAL::GetSchedStats(SchedStats &stats)
 {
-    lv_fs_res_t res = LV_FS_RES_NOT_IMP;
+    stats = schedStats.Read();
+    return true;
+}
 
-    FILE *fp = (FILE *)file_p;
+#if !USE_VFB
+/**
+ * @brief 界面是否需要按帧率刷新：有动画、待重绘区域、按下或滚动（含松手后的惯性）
+ */
+static bool schedIsBusy(lv_disp_t *disp)
+{
+    if (lv_anim_count_running() > 0 || disp->inv_p > 0)
+        return true;
 
-    *br = fread(buf, (size_t)1, (size_t)btr, fp);
-    if (*br == btr)
-        res = LV_FS_RES_OK;
+    lv_indev_t *indev = NULL;
+    while ((indev = lv_indev_get_next(indev)) != NULL)
+    {
+        if (indev->proc.state == LV_INDEV_STATE_PRESSED)
+            return true;
+        if (indev->driver->type == LV_INDEV_TYPE_POINTER &&
+            indev->proc.types.pointer.scroll_obj != NULL)
+            return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief 恢复/暂停刷新定时器和输入读取定时器，恢复时让它们立即运行
+ */
+static void schedSetActive(lv_disp_t *disp, bool active)
+{
+    lv_indev_t *indev = NULL;
+
+    if (active)
+    {
+        lv_timer_resume(disp->refr_timer);
+        lv_timer_ready(disp->refr_timer);
+    }
     else
-        res = LV_FS_RES_FS_ERR;
+        lv_timer_pause(disp->refr_timer);
 
-    return res;
+    while ((indev = lv_indev_get_next(indev)) != NULL)
+    {
+        if (indev->driver->read_timer == NULL)
+            continue;
+        if (active)
+        {
+            lv_timer_resume(indev->driver->read_timer);
+            lv_timer_ready(indev->driver->read_timer);
+        }
+        else
+            lv_timer_pause(indev->driver->read_timer);
+    }
 }
 
 /**
- * Set the read write pointer. Also expand the file size if necessary.
- * @param drv pointer to a driver where this function belongs
- * @param file_p pointer to a FIL variable. (opened with fs_open )
- * @param pos the new position of read write pointer
- * @param whence only LV_SEEK_SET is supported
- * @return LV_FS_RES_OK: no error, the file is read
- *         any error from lv_fs_res_t enum
+ * @brief 让输入读取定时器在本轮立即运行
  */
-static lv_fs_res_t fs_seek(lv_fs_drv_t *drv, void *file_p, uint32_t pos, lv_fs_whence_t whence)
+static void schedReadInput(void)
 {
-    lv_fs_res_t res = LV_FS_RES_NOT_IMP;
+    lv_indev_t *indev = NULL;
 
-    FILE *fp = (FILE *)file_p;
+    while ((indev = lv_indev_get_next(indev)) != NULL)
+    {
+        if (indev->driver->read_timer != NULL)
+            lv_timer_ready(indev->driver->read_timer);
+    }
+}
+#endif
 
-    if (0 == fseek(fp, pos, whence))
-        res = LV_FS_RES_OK;
-    else
-        res = LV_FS_RES_FS_ERR;
+/**
+ * @brief 获取每帧渲染/刷新耗时统计
+ */
+bool HAL::GetRenderStats(DisplayFlusher::Stats &stats)
+{
+    if (flusher == NULL)
+        return false;
+
+    stats = flusher->GetStats();
+    return true;
+}
+
+#if !USE_VFB
+/**
+ * @brief 获取framebuffer上屏统计：帧间隔直方图与分位数、丢帧、翻页延迟
+ */
+bool HAL::GetPresentStats(sunxifb_present_stats_t &stats)
+{
+    sunxifb_get_present_stats(&stats);
+    return true;
+}
+#endif
+
+#if !USE_VFB
+/**
+ * @brief 开关UI合成模式：屏幕透明叠加在视频层上时，只写入有UI对象的图块，
+ *        空白图块只清零一次，减少每帧写framebuffer的带宽
+ * @retval true 成功 / false 分辨率过大，未开启
+ */
+bool HAL::SetUiCompositing(bool en)
+{
+    if (flusher == NULL)
+        return false;
+
+    if (en && compMask == NULL)
+    {
+        sunxifb_get_content_grid(&compCols, &compRows, &compTile);
+        compMask = (uint8_t *)malloc(compCols * compRows);
+        if (compMask == NULL)
+            return false;
+    }
+
+    sunxifb_set_compositing(en);
+    flusher->SetRenderStartCb(en ? compRenderStart : NULL);
+
+    printf("[HAL] UI compositing %s, %ux%u tiles of %u px\n", en ? "on" : "off",
+           compCols, compRows, compTile);
+    return true;
+}
+
+/**
+ * @brief 获取UI合成每帧写入的像素统计
+ */
+bool HAL::GetCompositingStats(sunxifb_comp_stats_t &stats)
+{
+    sunxifb_get_comp_stats(&stats);
+    return true;
+}
+
+static void compMarkArea(const lv_area_t *area)
+{
+    int32_t x1 = LV_MAX(area->x1, 0) / (int32_t)compTile;
+    int32_t y1 = LV_MAX(area->y1, 0) / (int32_t)compTile;
+    int32_t x2 = LV_MIN(area->x2 / (int32_t)compTile, (int32_t)compCols - 1);
+    int32_t y2 = LV_MIN(area->y2 / (int32_t)compTile, (int32_t)compRows - 1);
+
+    for (int32_t y = y1; y <= y2; y++)
+        if (x1 <= x2)
+            memset(&compMask[y * compCols + x1], 1, x2 - x1 + 1);
+}
+
+/**
+ * @brief 标记对象及其子对象会绘制的区域，宁多勿少：漏标的区域会被清成透明
+ */
+static void compMarkObj(lv_obj_t *obj)
+{
+    if (lv_obj_has_flag(obj, LV_OBJ_FLAG_HIDDEN))
+        return;
+
+    bool draws = lv_obj_get_class(obj) != &lv_obj_class;
+    if (!draws)
+    {
+        // 基础对象只在有背景、边框、阴影、轮廓、背景图或滚动条时才绘制
+        draws = lv_obj_get_style_bg_opa(obj, LV_PART_MAIN) > LV_OPA_TRANSP ||
+                (lv_obj_get_style_border_width(obj, LV_PART_MAIN) > 0 &&
+                 lv_obj_get_style_border_opa(obj, LV_PART_MAIN) > LV_OPA_TRANSP) ||
+                (lv_obj_get_style_shadow_width(obj, LV_PART_MAIN) > 0 &&
+                 lv_obj_get_style_shadow_opa(obj, LV_PART_MAIN) > LV_OPA_TRANSP) ||
+                (lv_obj_get_style_outline_width(obj, LV_PART_MAIN) > 0 &&
+                 lv_obj_get_style_outline_opa(obj, LV_PART_MAIN) > LV_OPA_TRANSP) ||
+                (lv_obj_get_style_bg_img_src(obj, LV_PART_MAIN) != NULL &&
+                 lv_obj_get_style_bg_img_opa(obj, LV_PART_MAIN) > LV_OPA_TRANSP) ||
+                (lv_obj_has_flag(obj, LV_OBJ_FLAG_SCROLLABLE) &&
+                 (lv_obj_get_scroll_top(obj) > 0 || lv_obj_get_scroll_bottom(obj) > 0 ||
+                  lv_obj_get_scroll_left(obj) > 0 || lv_obj_get_scroll_right(obj) > 0));
+    }
+    if (lv_obj_get_style_opa(obj, LV_PART_MAIN) <= LV_OPA_MIN)
+        draws = false;
+
+    if (draws)
+    {
+        lv_area_t area = obj->coords;
+        lv_coord_t ext = _lv_obj_get_ext_draw_size(obj);
+        lv_area_increase(&area, ext, ext);
+        compMarkArea(&area);
+    }
 
-    return res;
+    // 子对象可能覆盖父对象的透明度，仍需遍历
+    uint32_t cnt = lv_obj_get_child_cnt(obj);
+    for (uint32_t i = 0; i < cnt; i++)
+        compMarkObj(lv_obj_get_child(obj, i));
 }
 
 /**
- * Give the position of the read write pointer
- * @param drv pointer to a driver where this function belongs
- * @param file_p pointer to a FIL variable.
- * @param pos_p pointer to to store the result
- * @return LV_FS_RES_OK: no error, the file is read
- *         any error from lv_fs_res_t enum
+ * @brief LVGL开始渲染一帧（布局已更新），发布本帧的内容图块
  */
-static lv_fs_res_t fs_tell(lv_fs_drv_t *drv, void *file_p, uint32_t *pos_p)
+static void compRenderStart(lv_disp_drv_t *drv)
 {
-    (void)drv;
-    FILE *fp = (FILE *)file_p;
+    lv_disp_t *disp = lv_disp_get_default();
 
-    *pos_p = ftell(fp);
+    memset(compMask, 0, compCols * compRows);
+    if (disp->prev_scr != NULL)
+        compMarkObj(disp->prev_scr);
+    if (disp->act_scr != NULL)
+        compMarkObj(disp->act_scr);
+    compMarkObj(disp->top_layer);
+    compMarkObj(disp->sys_layer);
 
-    return LV_FS_RES_OK;
-}
\ No newline at end of file
+    sunxifb_set_content_mask(compMask);
+}
+#else
+bool HAL::SetUiCompositing(bool en)
+{
+    // 只有/dev/fb0后端叠加在视频层上
+    return false;
+}
+#endif
+
+/**
+ * @brief 退出时按顺序释放显示和输入，在LVGL线程返回、Model销毁之后调用
+ */
+void HAL::Deinit(void)
+{
+#if USE_EVDEV
+    // 录制的输入日志在退出前写完
+    evdev_stop_thread();
+    evdev_record_stop();
+#endif
+
+    if (flusher != NULL)
+        flusher->Stop();
+    lv_disp_t *disp = lv_disp_get_default();
+    if (disp != NULL)
+    {
+        lv_disp_draw_buf_t *drawBuf = disp->driver->draw_buf;
+        if (drawBuf->buf2 != NULL)
+            disp_backend_free((void **)&drawBuf->buf2, (char *)"lv_examples2");
+        disp_backend_free((void **)&drawBuf->buf1, (char *)"lv_examples");
+    }
+    disp_backend_exit();
+    lv_deinit();
+}
+
+/**
+ * @brief 退出信号（SIGINT、SIGTERM等）回调函数
+ *
+ * 信号可能打断持有锁的任意线程，这里只记录信号并写eventfd唤醒LVGL线程，
+ * 清理由主线程在LVGL线程返回后完成。
+ *
+ * @param signal
+ */
+void signalExitCallback(int signal)
+{
+    int savedErrno = errno;
+    uint64_t one = 1;
+
+    exitSignal = signal;
+    if (wakeFd >= 0)
+        write(wakeFd, &one, sizeof(one));
+    errno = savedErrno;
+}
+
+/**
+ * @brief 致命信号（SIGSEGV、SIGBUS等）回调函数
+ *
+ * 进程状态已不可信，不再释放资源：只把显示切回控制台，然后直接_exit。
+ *
+ * @param signal
+ */
+void signalFatalCallback(int signal)
+{
+    static const char msg[] = "[Sys] Fatal signal, exiting ...\n";
+
+#if !USE_VFB
+    // fbdev不会在进程退出时恢复显示偏移
+    sunxifb_restore_console();
+#endif
+    write(STDERR_FILENO, msg, sizeof(msg) - 1);
+    _exit(128 + signal);
+}
+
+/**
+ * @brief 系统退出信号绑定
+ *
+ */
+void install_signal_handler(void)
+{
+    signal(SIGBUS, signalFatalCallback);
+    signal(SIGFPE, signalFatalCallback);
+    signal(SIGILL, signalFatalCallback);
+    signal(SIGIOT, signalFatalCallback);
+    signal(SIGSEGV, signalFatalCallback);
+    signal(SIGSYS, signalFatalCallback);
+    signal(SIGTRAP, signalFatalCallback);
+
+    signal(SIGHUP, signalExitCallback);
+    signal(SIGINT, signalExitCallback);
+    signal(SIGPIPE, signalExitCallback);
+    signal(SIGQUIT, signalExitCallback);
+    signal(SIGTERM, signalExitCallback);
+    signal(SIGUSR1, signalExitCallback);
+    signal(SIGUSR2, signalExitCallback);
+}
+
+/* Set in lv_conf.h as `LV_TICK_CUSTOM_SYS_TIME_EXPR` */
+uint32_t custom_tick_get(void)
+{
+#if USE_VFB
+    return vfb_tick_get();
+#else
+    return tick_get_ms();
+#endif
+}
@@ -0,0 +1,233 @@
+#include "InputResampler.h"
+#include <math.h>
+#include <string.h>
+
+/* 回放评估时，速度低于这个值（像素/秒）的帧不计算滞后 */
+#define INPUTRESAMPLER_LAG_MIN_VELOCITY 100.0f
+
+InputResampler::InputResampler()
+{
+    _config.predictUs = INPUTRESAMPLER_PREDICT_US;
+    _config.maxExtrapolateUs = INPUTRESAMPLER_MAX_EXTRAPOLATE_US;
+    _id = -1;
+    memset(&_work, 0, sizeof(_work));
+}
+
+/**
+ * @brief 加入主触点的一个采样（输入线程调用），触点ID变化时重新开始
+ */
+void InputResampler::Add(int id, int x, int y, uint64_t us)
+{
+    if (id != _id || !_work.down)
+    {
+        _id = id;
+        _work.count = 0;
+        _work.down = true;
+    }
+
+    Sample &sample = _work.samples[_work.count % INPUTRESAMPLER_HISTORY];
+    sample.x = x;
+    sample.y = y;
+    sample.us = us;
+    _work.count++;
+    _history.Write(_work);
+}
+
+/**
+ * @brief 手指抬起（输入线程调用）
+ */
+void InputResampler::Release(void)
+{
+    if (!_work.down)
+        return;
+
+    _id = -1;
+    _work.down = false;
+    _history.Write(_work);
+}
+
+/**
+ * @brief 取presentUs（帧的显示时间）时的手指位置，可在任意线程调用
+ * @retval true 手指按下 / false 已抬起（x、y为最后的位置）或没有采样
+ */
+bool InputResampler::Resample(uint64_t presentUs, int &x, int &y) const
+{
+    History history = _history.Read();
+
+    return estimate(history, presentUs, _config, x, y) && history.down;
+}
+
+/**
+ * @brief 在历史采样上插值，超出最新采样时按最小二乘速度外推
+ * @retval true 成功 / false 没有采样
+ */
+bool InputResampler::estimate(const History &history, uint64_t targetUs, const Config &config, int &x, int &y)
+{
+    uint32_t n = history.count < INPUTRESAMPLER_HISTORY ? history.count : INPUTRESAMPLER_HISTORY;
+    if (n == 0)
+        return false;
+
+#define SAMPLE(i) history.samples[(history.count - 1 - (i)) % INPUTRESAMPLER_HISTORY] // 0为最新
+    const Sample &last = SAMPLE(0);
+    int64_t target = (int64_t)targetUs + config.predictUs;
+
+    x = last.x;
+    y = last.y;
+    if (!history.down)
+        return true;
+
+    if (target <= (int64_t)last.us)
+    {
+        // 插值：找到target两边的采样
+        for (uint32_t i = 1; i < n; i++)
+        {
+            const Sample &a = SAMPLE(i);
+            const Sample &b = SAMPLE(i - 1);
+            if (target >= (int64_t)a.us)
+            {
+                float k = b.us > a.us ? (float)(target - (int64_t)a.us) / (b.us - a.us) : 1.0f;
+                x = lroundf(a.x + (b.x - a.x) * k);
+                y = lroundf(a.y + (b.y - a.y) * k);
+                return true;
+            }
+            x = a.x;
+            y = a.y;
+        }
+        return true;
+    }
+
+    // 手指停住时触摸屏不再上报，不能按旧的速度一直外推
+    uint64_t ahead = target - last.us;
+    if (ahead > INPUTRESAMPLER_STALE_US)
+        return true;
+    if (ahead > config.maxExtrapolateUs)
+        ahead = config.maxExtrapolateUs;
+
+    // 最近一段时间内的采样做最小二乘，得到速度（像素/微秒）
+    float st = 0, sx = 0, sy = 0;
+    uint32_t m = 0;
+    for (uint32_t i = 0; i < n && last.us - SAMPLE(i).us <= INPUTRESAMPLER_VELOCITY_WINDOW_US; i++, m++)
+    {
+        st += -(float)(last.us - SAMPLE(i).us);
+        sx += SAMPLE(i).x;
+        sy += SAMPLE(i).y;
+    }
+    if (m < 2)
+        return true;
+
+    float mt = st / m, mx = sx / m, my = sy / m;
+    float stt = 0, stx = 0, sty = 0;
+    for (uint32_t i = 0; i < m; i++)
+    {
+        float dt = -(float)(last.us - SAMPLE(i).us) - mt;
+        stt += dt * dt;
+        stx += dt * (SAMPLE(i).x - mx);
+        sty += dt * (SAMPLE(i).y - my);
+    }
+    if (stt <= 0)
+        return true;
+
+    x = lroundf(last.x + stx / stt * ahead);
+    y = lroundf(last.y + sty / stt * ahead);
+    return true;
+#undef SAMPLE
+}
+
+/**
+ * @brief 轨迹在us时刻的位置（线性插值）
+ */
+static void traceAt(const InputResampler::Sample *trace, size_t count, uint64_t us, float &x, float &y)
+{
+    size_t i = 1;
+    while (i < count - 1 && trace[i].us < us)
+        i++;
+
+    const InputResampler::Sample &a = trace[i - 1];
+    const InputResampler::Sample &b = trace[i];
+    float k = b.us > a.us ? ((float)us - a.us) / (b.us - a.us) : 1.0f;
+    x = a.x + (b.x - a.x) * k;
+    y = a.y + (b.y - a.y) * k;
+}
+
+/**
+ * @brief 回放一条触摸轨迹，评估重采样的位置误差和滞后
+ *
+ * 模拟：采样按时间戳到达；每帧在f时刻开始渲染、f + frameUs显示。直接读取的方式只能拿到
+ * 最近一次LVGL读取（每readPeriodUs一次）时的最新点，重采样则用f之前到达的全部采样
+ * 估计显示时刻的位置。真实位置取轨迹在显示时刻的插值。
+ */
+InputResampler::Report InputResampler::Replay(const Config &config, const Sample *trace, size_t count,
+                                              uint32_t frameUs, uint32_t readPeriodUs)
+{
+    Report report;
+    memset(&report, 0, sizeof(report));
+    if (count < 2 || frameUs == 0 || readPeriodUs == 0)
+        return report;
+
+    InputResampler resampler;
+    resampler.SetConfig(config);
+
+    uint64_t begin = trace[0].us;
+    uint64_t end = trace[count - 1].us;
+    size_t next = 0;
+    double rawSum = 0, sum = 0, rawLagSum = 0, lagSum = 0;
+    uint32_t lagFrames = 0;
+
+    for (uint64_t f = begin; f + frameUs <= end; f += frameUs)
+    {
+        while (next < count && trace[next].us <= f)
+        {
+            resampler.Add(0, trace[next].x, trace[next].y, trace[next].us);
+            next++;
+        }
+        uint64_t present = f + frameUs;
+
+        float tx, ty, ax, ay, bx, by;
+        traceAt(trace, count, present, tx, ty);
+        traceAt(trace, count, present - 1000, ax, ay);
+        traceAt(trace, count, present + 1000, bx, by);
+        float vx = (bx - ax) / 2000, vy = (by - ay) / 2000; // 像素/微秒
+
+        // 直接读取：最近一次LVGL读取时已到达的最新点
+        uint64_t read = begin + (f - begin) / readPeriodUs * readPeriodUs;
+        size_t raw = 0;
+        while (raw + 1 < count && trace[raw + 1].us <= read)
+            raw++;
+
+        int x, y;
+        resampler.Resample(present, x, y);
+
+        float rawEx = tx - trace[raw].x, rawEy = ty - trace[raw].y;
+        float ex = tx - x, ey = ty - y;
+        float rawErr = hypotf(rawEx, rawEy), err = hypotf(ex, ey);
+
+        rawSum += rawErr;
+        sum += err;
+        if (rawErr > report.rawMaxErr)
+            report.rawMaxErr = rawErr;
+        if (err > report.maxErr)
+            report.maxErr = err;
+
+        // 误差投影到运动方向上，除以速度得到等效的时间滞后
+        float v2 = vx * vx + vy * vy;
+        if (v2 * 1e12f >= INPUTRESAMPLER_LAG_MIN_VELOCITY * INPUTRESAMPLER_LAG_MIN_VELOCITY)
+        {
+            rawLagSum += (rawEx * vx + rawEy * vy) / v2;
+            lagSum += (ex * vx + ey * vy) / v2;
+            lagFrames++;
+        }
+        report.frames++;
+    }
+
+    if (report.frames > 0)
+    {
+        report.rawMeanErr = rawSum / report.frames;
+        report.meanErr = sum / report.frames;
+    }
+    if (lagFrames > 0)
+    {
+        report.rawLagMs = rawLagSum / lagFrames / 1000;
+        report.lagMs = lagSum / lagFrames / 1000;
+    }
+    return report;
+}
@@ -0,0 +1,702 @@
+#include "MappedFs.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* 文件身份：同一个文件且打开后没有被改写（大小和修改时间不变） */
+struct FileId
+{
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+};
+
+/* 一个只读文件的整个映射，关闭后保留，按最近使用淘汰 */
+struct Mapping
+{
+    FileId id;
+    uint8_t *data; // NULL表示空闲
+    uint32_t refs; // 打开着的文件数
+    uint64_t lastUse;
+};
+
+/* 大文件的一个缓存块 */
+struct Block
+{
+    FileId id;
+    uint32_t index;
+    uint32_t len; // 有效字节数，文件末尾的块可能不满
+    uint64_t lastUse;
+    bool valid;
+    bool loading; // 正在锁外读入，不能被查找或淘汰
+    uint8_t *data;
+};
+
+/* 打开的文件：由映射读取（fd已关闭），或用fd pread/pwrite */
+struct File
+{
+    int fd;
+    FileId id;
+    Mapping *map;
+    uint32_t pos;
+    bool writable;
+    int64_t lastBlock; // 上次读取的块，用于判断顺序读取
+};
+
+static void *fsOpen(lv_fs_drv_t *drv, const char *path, lv_fs_mode_t mode);
+static lv_fs_res_t fsClose(lv_fs_drv_t *drv, void *file_p);
+static lv_fs_res_t fsRead(lv_fs_drv_t *drv, void *file_p, void *buf, uint32_t btr, uint32_t *br);
+static lv_fs_res_t fsWrite(lv_fs_drv_t *drv, void *file_p, const void *buf, uint32_t btw, uint32_t *bw);
+static lv_fs_res_t fsSeek(lv_fs_drv_t *drv, void *file_p, uint32_t pos, lv_fs_whence_t whence);
+static lv_fs_res_t fsTell(lv_fs_drv_t *drv, void *file_p, uint32_t *pos_p);
+
+static lv_res_t decoderInfo(lv_img_decoder_t *decoder, const void *src, lv_img_header_t *header);
+static lv_res_t decoderOpen(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc);
+static void decoderClose(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc);
+
+static bool isUserPath(const char *path);
+static void fileId(const struct stat &st, FileId &id);
+static bool sameFile(const FileId &a, const FileId &b);
+static Mapping *mapAcquire(const char *path, const FileId &id, int fd);
+static void invalidate(const FileId &id);
+static lv_fs_res_t readCached(File *file, uint8_t *buf, uint32_t btr, uint32_t *br);
+static ssize_t preadFull(int fd, uint8_t *buf, size_t len, off_t offset);
+
+static lv_fs_drv_t fsDrv;
+static MappedFs::Config config;
+static bool zeroCopy = true;
+static char cwd[PATH_MAX]; // 相对路径按启动时的工作目录判断是否在用户目录下
+
+/* 以下由lock保护：LVGL线程之外也可能通过LVGL文件接口读取 */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static MappedFs::Stats stats;
+static Mapping maps[MAPPEDFS_MAP_CACHE];
+static Block *blocks;
+static uint64_t useClock;
+
+/**
+ * @brief 注册文件系统驱动和.bin图片解码器，在lv_init之后调用
+ * @param letter 盘符，如'S'
+ * @param config 为空时使用MAPPEDFS_*的默认值
+ */
+void MappedFs::Init(char letter, const Config *cfg)
+{
+    if (cfg != NULL)
+    {
+        config = *cfg;
+    }
+    else
+    {
+        config.mapMax = MAPPEDFS_MAP_MAX;
+        config.blockSize = MAPPEDFS_BLOCK_SIZE;
+        config.cacheBlocks = MAPPEDFS_CACHE_BLOCKS;
+        config.preadRoots = NULL;
+    }
+    if (config.blockSize == 0)
+        config.blockSize = MAPPEDFS_BLOCK_SIZE;
+    if (getcwd(cwd, sizeof(cwd)) == NULL)
+        cwd[0] = '\0';
+
+    if (config.cacheBlocks > 0)
+    {
+        blocks = (Block *)calloc(config.cacheBlocks, sizeof(Block));
+        for (uint32_t i = 0; blocks != NULL && i < config.cacheBlocks; i++)
+        {
+            blocks[i].data = (uint8_t *)malloc(config.blockSize);
+            if (blocks[i].data == NULL)
+            {
+                config.cacheBlocks = i;
+                break;
+            }
+        }
+        if (blocks == NULL)
+            config.cacheBlocks = 0;
+    }
+
+    lv_fs_drv_init(&fsDrv);
+    fsDrv.letter = letter;
+    fsDrv.open_cb = fsOpen;
+    fsDrv.close_cb = fsClose;
+    fsDrv.read_cb = fsRead;
+    fsDrv.write_cb = fsWrite;
+    fsDrv.seek_cb = fsSeek;
+    fsDrv.tell_cb = fsTell;
+    lv_fs_drv_register(&fsDrv);
+
+    // 后创建的解码器先尝试，不能直接使用映射的图片交给内置解码器
+    lv_img_decoder_t *decoder = lv_img_decoder_create();
+    lv_img_decoder_set_info_cb(decoder, decoderInfo);
+    lv_img_decoder_set_open_cb(decoder, decoderOpen);
+    lv_img_decoder_set_close_cb(decoder, decoderClose);
+}
+
+/**
+ * @brief 取得已打开文件的映射，直接按指针访问内容（文件关闭前有效）
+ * @retval true 成功 / false 不是本驱动打开的文件，或文件没有映射（太大、可写）
+ */
+bool MappedFs::GetData(lv_fs_file_t *file, const uint8_t *&data, uint32_t &size)
+{
+    if (file->drv != &fsDrv || file->file_d == NULL)
+        return false;
+
+    File *f = (File *)file->file_d;
+    if (f->map == NULL)
+        return false;
+
+    data = f->map->data;
+    size = f->id.size;
+    return true;
+}
+
+/**
+ * @brief 开关图片解码器直接使用映射（关闭后由LVGL内置解码器逐行读取，用于对比）
+ */
+void MappedFs::SetZeroCopy(bool en)
+{
+    zeroCopy = en;
+}
+
+MappedFs::Stats MappedFs::GetStats(void)
+{
+    pthread_mutex_lock(&lock);
+    Stats copy = stats;
+    pthread_mutex_unlock(&lock);
+    return copy;
+}
+
+/**
+ * @brief 打开文件：只读且不超过mapMax的文件整个映射（复用保留的映射），其他的用fd读写
+ * @param path 去掉盘符后的路径
+ */
+static void *fsOpen(lv_fs_drv_t *drv, const char *path, lv_fs_mode_t mode)
+{
+    struct stat st;
+    bool mappable = !isUserPath(path);
+
+    if (mode != LV_FS_MODE_RD && mode != LV_FS_MODE_WR && mode != (LV_FS_MODE_WR | LV_FS_MODE_RD))
+        return NULL;
+
+    File *file = (File *)calloc(1, sizeof(File));
+    if (file == NULL)
+        return NULL;
+    file->fd = -1;
+    file->lastBlock = -1;
+
+    if (mode & LV_FS_MODE_WR)
+    {
+        // 与原来的"wb"/"wb+"相同：创建或清空
+        int flags = (mode & LV_FS_MODE_RD) ? O_RDWR : O_WRONLY;
+        file->fd = open(path, flags | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (file->fd < 0 || fstat(file->fd, &st) != 0)
+            goto err;
+        fileId(st, file->id);
+        file->writable = true;
+
+        pthread_mutex_lock(&lock);
+        stats.opens++;
+        invalidate(file->id);
+        pthread_mutex_unlock(&lock);
+        return file;
+    }
+
+    // 先按路径stat：保留的映射还有效时不用再打开文件
+    if (stat(path, &st) != 0)
+        goto err;
+    fileId(st, file->id);
+
+    if (mappable && file->id.size > 0 && (uint64_t)file->id.size <= config.mapMax)
+    {
+        pthread_mutex_lock(&lock);
+        stats.opens++;
+        file->map = mapAcquire(path, file->id, -1);
+        if (file->map != NULL)
+        {
+            stats.mapped++;
+            stats.mapReuses++;
+        }
+        pthread_mutex_unlock(&lock);
+        if (file->map != NULL)
+            return file;
+    }
+    else
+    {
+        pthread_mutex_lock(&lock);
+        stats.opens++;
+        pthread_mutex_unlock(&lock);
+    }
+
+    file->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (file->fd < 0 || fstat(file->fd, &st) != 0)
+        goto err;
+    fileId(st, file->id);
+
+    if (mappable && file->id.size > 0 && (uint64_t)file->id.size <= config.mapMax)
+    {
+        pthread_mutex_lock(&lock);
+        file->map = mapAcquire(path, file->id, file->fd);
+        if (file->map != NULL)
+            stats.mapped++;
+        pthread_mutex_unlock(&lock);
+        if (file->map != NULL)
+        {
+            close(file->fd);
+            file->fd = -1;
+        }
+    }
+    return file;
+
+err:
+    if (file->fd >= 0)
+        close(file->fd);
+    free(file);
+    return NULL;
+}
+
+static lv_fs_res_t fsClose(lv_fs_drv_t *drv, void *file_p)
+{
+    File *file = (File *)file_p;
+    lv_fs_res_t res = LV_FS_RES_OK;
+
+    if (file->map != NULL)
+    {
+        pthread_mutex_lock(&lock);
+        file->map->refs--;
+        file->map->lastUse = ++useClock;
+        pthread_mutex_unlock(&lock);
+    }
+    if (file->fd >= 0 && close(file->fd) != 0)
+        res = LV_FS_RES_FS_ERR;
+
+    free(file);
+    return res;
+}
+
+/**
+ * @brief 读取：到文件末尾时读出的字节数少于要求，仍返回成功（与lv_fs的约定一致）
+ */
+static lv_fs_res_t fsRead(lv_fs_drv_t *drv, void *file_p, void *buf, uint32_t btr, uint32_t *br)
+{
+    File *file = (File *)file_p;
+    lv_fs_res_t res = LV_FS_RES_OK;
+
+    *br = 0;
+    if (file->map != NULL)
+    {
+        uint32_t size = file->id.size;
+        uint32_t n = file->pos >= size ? 0 : LV_MIN(btr, size - file->pos);
+        memcpy(buf, file->map->data + file->pos, n);
+        file->pos += n;
+        *br = n;
+    }
+    else if (file->writable)
+    {
+        ssize_t n = preadFull(file->fd, (uint8_t *)buf, btr, file->pos);
+        if (n < 0)
+            return LV_FS_RES_FS_ERR;
+        file->pos += n;
+        *br = n;
+    }
+    else
+    {
+        res = readCached(file, (uint8_t *)buf, btr, br);
+    }
+
+    pthread_mutex_lock(&lock);
+    stats.reads++;
+    stats.bytes += *br;
+    pthread_mutex_unlock(&lock);
+    return res;
+}
+
+static lv_fs_res_t fsWrite(lv_fs_drv_t *drv, void *file_p, const void *buf, uint32_t btw, uint32_t *bw)
+{
+    File *file = (File *)file_p;
+    uint32_t done = 0;
+
+    *bw = 0;
+    if (!file->writable)
+        return LV_FS_RES_DENIED;
+
+    while (done < btw)
+    {
+        ssize_t n = pwrite(file->fd, (const uint8_t *)buf + done, btw - done, file->pos + done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        done += n;
+    }
+
+    file->pos += done;
+    if ((off_t)file->pos > file->id.size)
+        file->id.size = file->pos;
+    *bw = done;
+    return done == btw ? LV_FS_RES_OK : LV_FS_RES_FS_ERR;
+}
+
+/**
+ * @brief 移动读写位置，按LVGL的whence计算（不能直接当作SEEK_*传给系统）
+ */
+static lv_fs_res_t fsSeek(lv_fs_drv_t *drv, void *file_p, uint32_t pos, lv_fs_whence_t whence)
+{
+    File *file = (File *)file_p;
+    uint64_t base;
+
+    if (whence == LV_FS_SEEK_SET)
+        base = 0;
+    else if (whence == LV_FS_SEEK_CUR)
+        base = file->pos;
+    else if (whence == LV_FS_SEEK_END)
+        base = file->id.size;
+    else
+        return LV_FS_RES_INV_PARAM;
+
+    if (base + pos > UINT32_MAX)
+        return LV_FS_RES_INV_PARAM;
+
+    file->pos = base + pos;
+    return LV_FS_RES_OK;
+}
+
+static lv_fs_res_t fsTell(lv_fs_drv_t *drv, void *file_p, uint32_t *pos_p)
+{
+    *pos_p = ((File *)file_p)->pos;
+    return LV_FS_RES_OK;
+}
+
+/**
+ * @brief 从映射里读出.bin图片的头，没有映射的（太大的文件）交给内置解码器
+ */
+static lv_res_t decoderInfo(lv_img_decoder_t *decoder, const void *src, lv_img_header_t *header)
+{
+    const char *path = (const char *)src;
+
+    if (!zeroCopy || lv_img_src_get_type(src) != LV_IMG_SRC_FILE)
+        return LV_RES_INV;
+    if (path[0] != fsDrv.letter || path[1] != ':' || strcmp(lv_fs_get_ext(path), "bin") != 0)
+        return LV_RES_INV;
+
+    lv_fs_file_t file;
+    if (lv_fs_open(&file, path, LV_FS_MODE_RD) != LV_FS_RES_OK)
+        return LV_RES_INV;
+
+    const uint8_t *data;
+    uint32_t size;
+    lv_res_t res = LV_RES_INV;
+    if (MappedFs::GetData(&file, data, size) && size >= sizeof(lv_img_header_t))
+    {
+        memcpy(header, data, sizeof(lv_img_header_t));
+        res = LV_RES_OK;
+    }
+    lv_fs_close(&file);
+    return res;
+}
+
+/**
+ * @brief 真彩色图片的像素直接指向映射，LVGL绘制时不再逐行读取；其他格式交给内置解码器
+ */
+static lv_res_t decoderOpen(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc)
+{
+    lv_img_cf_t cf = (lv_img_cf_t)dsc->header.cf;
+
+    if (cf != LV_IMG_CF_TRUE_COLOR && cf != LV_IMG_CF_TRUE_COLOR_ALPHA && cf != LV_IMG_CF_TRUE_COLOR_CHROMA_KEYED)
+        return LV_RES_INV;
+
+    lv_fs_file_t *file = (lv_fs_file_t *)lv_mem_alloc(sizeof(lv_fs_file_t));
+    if (file == NULL)
+        return LV_RES_INV;
+    if (lv_fs_open(file, (const char *)dsc->src, LV_FS_MODE_RD) != LV_FS_RES_OK)
+    {
+        lv_mem_free(file);
+        return LV_RES_INV;
+    }
+
+    const uint8_t *data;
+    uint32_t size;
+    uint32_t need = sizeof(lv_img_header_t) + lv_img_buf_get_img_size(dsc->header.w, dsc->header.h, cf);
+    if (!MappedFs::GetData(file, data, size) || size < need)
+    {
+        lv_fs_close(file);
+        lv_mem_free(file);
+        return LV_RES_INV;
+    }
+
+    dsc->img_data = data + sizeof(lv_img_header_t);
+    dsc->user_data = file;
+
+    pthread_mutex_lock(&lock);
+    stats.zeroCopy++;
+    pthread_mutex_unlock(&lock);
+    return LV_RES_OK;
+}
+
+static void decoderClose(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc)
+{
+    lv_fs_file_t *file = (lv_fs_file_t *)dsc->user_data;
+
+    if (file == NULL)
+        return;
+
+    lv_fs_close(file);
+    lv_mem_free(file);
+    dsc->user_data = NULL;
+}
+
+/**
+ * @brief 文件是否在用户可改写的目录下（U盘、SD卡等）
+ *
+ * 这些文件随时可能被覆盖或截短，映射后访问截掉的部分会触发SIGBUS，所以只用pread读取
+ */
+static bool isUserPath(const char *path)
+{
+    char abs[PATH_MAX];
+
+    if (config.preadRoots == NULL)
+        return false;
+
+    if (path[0] != '/')
+    {
+        if (snprintf(abs, sizeof(abs), "%s/%s", cwd, path) >= (int)sizeof(abs))
+            return false;
+        path = abs;
+    }
+    for (const char *const *root = config.preadRoots; *root != NULL; root++)
+    {
+        if (strncmp(path, *root, strlen(*root)) == 0)
+            return true;
+    }
+    return false;
+}
+
+static void fileId(const struct stat &st, FileId &id)
+{
+    id.dev = st.st_dev;
+    id.ino = st.st_ino;
+    id.size = st.st_size;
+    id.mtime = st.st_mtim;
+}
+
+static bool sameFile(const FileId &a, const FileId &b)
+{
+    return a.dev == b.dev && a.ino == b.ino && a.size == b.size &&
+           a.mtime.tv_sec == b.mtime.tv_sec && a.mtime.tv_nsec == b.mtime.tv_nsec;
+}
+
+/**
+ * @brief 取得文件的映射（持有lock时调用）：复用保留的映射，fd有效时新建
+ * @param fd -1只查找
+ * @retval 映射，引用计数已加一；NULL表示没有（保留表已满时由调用方改用pread）
+ */
+static Mapping *mapAcquire(const char *path, const FileId &id, int fd)
+{
+    Mapping *victim = NULL;
+
+    for (int i = 0; i < MAPPEDFS_MAP_CACHE; i++)
+    {
+        Mapping *map = &maps[i];
+        if (map->data != NULL && sameFile(map->id, id))
+        {
+            map->refs++;
+            return map;
+        }
+        if (map->refs == 0 && (victim == NULL || map->data == NULL ||
+                               (victim->data != NULL && map->lastUse < victim->lastUse)))
+            victim = map;
+    }
+    if (fd < 0 || victim == NULL)
+        return NULL;
+
+    void *data = mmap(NULL, id.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+    {
+        printf("[MappedFs] mmap %s failed: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    // 图片、字体通常会整个读取，提前让内核读入
+    madvise(data, id.size, MADV_WILLNEED);
+
+    if (victim->data != NULL)
+        munmap(victim->data, victim->id.size);
+    victim->id = id;
+    victim->data = (uint8_t *)data;
+    victim->refs = 1;
+    return victim;
+}
+
+/**
+ * @brief 文件被改写：丢掉它空闲的映射和缓存块（持有lock时调用）
+ */
+static void invalidate(const FileId &id)
+{
+    for (int i = 0; i < MAPPEDFS_MAP_CACHE; i++)
+    {
+        Mapping *map = &maps[i];
+        if (map->data != NULL && map->refs == 0 && map->id.dev == id.dev && map->id.ino == id.ino)
+        {
+            munmap(map->data, map->id.size);
+            map->data = NULL;
+        }
+    }
+    for (uint32_t i = 0; i < config.cacheBlocks; i++)
+    {
+        if (blocks[i].id.dev == id.dev && blocks[i].id.ino == id.ino)
+            blocks[i].valid = false;
+    }
+}
+
+/**
+ * @brief 大文件读取：小的读取经过块缓存，不小于一块的直接pread到调用方的缓冲；
+ *        顺序读到下一块时提前让内核读入再下一块
+ *
+ * 锁只保护块表和统计，pread和fadvise都在锁外进行：未命中时先把淘汰的块标记为loading，
+ * 读入后再发布，其他线程读别的文件不用等这次I/O
+ */
+static lv_fs_res_t readCached(File *file, uint8_t *buf, uint32_t btr, uint32_t *br)
+{
+    uint32_t bs = config.blockSize;
+    uint32_t done = 0;
+    lv_fs_res_t res = LV_FS_RES_OK;
+
+    while (done < btr && file->pos < (uint64_t)file->id.size)
+    {
+        if (config.cacheBlocks == 0 || btr - done >= bs)
+        {
+            ssize_t n = preadFull(file->fd, buf + done, btr - done, file->pos);
+            if (n < 0)
+                res = LV_FS_RES_FS_ERR;
+            if (n <= 0)
+                break;
+            pthread_mutex_lock(&lock);
+            stats.direct++;
+            pthread_mutex_unlock(&lock);
+            done += n;
+            file->pos += n;
+            continue;
+        }
+
+        uint32_t index = file->pos / bs;
+        uint32_t offset = file->pos - index * bs;
+        uint32_t n = 0;
+        Block *block = NULL;
+        Block *victim = NULL;
+
+        pthread_mutex_lock(&lock);
+        for (uint32_t i = 0; i < config.cacheBlocks; i++)
+        {
+            Block *b = &blocks[i];
+            if (b->loading)
+                continue;
+            if (b->valid && b->index == index && sameFile(b->id, file->id))
+            {
+                block = b;
+                break;
+            }
+            if (victim == NULL || !b->valid || (victim->valid && b->lastUse < victim->lastUse))
+                victim = b;
+        }
+        if (block != NULL)
+        {
+            stats.hits++;
+            block->lastUse = ++useClock;
+            if (offset < block->len)
+            {
+                n = LV_MIN(block->len - offset, btr - done);
+                memcpy(buf + done, block->data + offset, n);
+            }
+        }
+        else if (victim != NULL)
+        {
+            victim->valid = false;
+            victim->loading = true;
+        }
+        pthread_mutex_unlock(&lock);
+
+        if (block == NULL && victim == NULL)
+        {
+            // 所有块都在被其他线程读入：这次不经过缓存
+            ssize_t r = preadFull(file->fd, buf + done, btr - done, file->pos);
+            if (r < 0)
+                res = LV_FS_RES_FS_ERR;
+            if (r <= 0)
+                break;
+            n = r;
+            pthread_mutex_lock(&lock);
+            stats.direct++;
+            pthread_mutex_unlock(&lock);
+        }
+        else if (block == NULL)
+        {
+            ssize_t r = preadFull(file->fd, victim->data, bs, (off_t)index * bs);
+
+            pthread_mutex_lock(&lock);
+            victim->loading = false;
+            if (r >= 0)
+            {
+                victim->id = file->id;
+                victim->index = index;
+                victim->len = r;
+                victim->valid = true;
+                victim->lastUse = ++useClock;
+                stats.misses++;
+                if (offset < victim->len)
+                {
+                    n = LV_MIN(victim->len - offset, btr - done);
+                    memcpy(buf + done, victim->data + offset, n);
+                }
+            }
+            pthread_mutex_unlock(&lock);
+            if (r < 0)
+            {
+                res = LV_FS_RES_FS_ERR;
+                break;
+            }
+        }
+
+        if (index == file->lastBlock + 1 && (uint64_t)(index + 1) * bs < (uint64_t)file->id.size)
+        {
+            posix_fadvise(file->fd, (off_t)(index + 1) * bs, bs, POSIX_FADV_WILLNEED);
+            pthread_mutex_lock(&lock);
+            stats.readAheads++;
+            pthread_mutex_unlock(&lock);
+        }
+        file->lastBlock = index;
+
+        if (n == 0)
+            break;
+        done += n;
+        file->pos += n;
+    }
+
+    *br = done;
+    return res;
+}
+
+/**
+ * @brief pread直到读满或到文件末尾
+ * @retval 读出的字节数，-1为出错
+ */
+static ssize_t preadFull(int fd, uint8_t *buf, size_t len, off_t offset)
+{
+    size_t done = 0;
+
+    while (done < len)
+    {
+        ssize_t n = pread(fd, buf + done, len - done, offset + done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return done > 0 ? (ssize_t)done : -1;
+        if (n == 0)
+            break;
+        done += n;
+    }
+    return done;
+}
@@ -0,0 +1,301 @@
+#include "KeyframeIndex.h"
+#include "../../utils/Tick/Tick.h"
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define KEYFRAME_INDEX_MAGIC "EMPK"
+
+static inline uint32_t be32(const uint8_t *b)
+{
+    return ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | b[3];
+}
+
+static uint32_t readBe32(FILE *fp, bool &ok)
+{
+    uint8_t b[4];
+
+    if (fread(b, 1, 4, fp) != 4)
+    {
+        ok = false;
+        return 0;
+    }
+
+    return be32(b);
+}
+
+/**
+ * @brief 在[pos, end)范围内找下一个指定类型的box
+ * @param pos 输入搜索起点，输出找到的box之后的位置（可以继续找同类型的下一个）
+ * @param body 找到的box内容起点
+ * @param boxEnd 找到的box结束位置
+ */
+static bool nextBox(FILE *fp, off_t &pos, off_t end, const char *type, off_t &body, off_t &boxEnd)
+{
+    while (pos + 8 <= end)
+    {
+        bool ok = true;
+        if (fseeko(fp, pos, SEEK_SET) != 0)
+            return false;
+
+        uint64_t size = readBe32(fp, ok);
+        char name[4];
+        if (!ok || fread(name, 1, 4, fp) != 4)
+            return false;
+
+        off_t header = 8;
+        if (size == 1)
+        {
+            size = (uint64_t)readBe32(fp, ok) << 32;
+            size |= readBe32(fp, ok);
+            header = 16;
+        }
+        else if (size == 0)
+            size = end - pos;
+        if (!ok || size < (uint64_t)header || pos + (off_t)size > end)
+            return false;
+
+        off_t start = pos;
+        pos += size;
+        if (memcmp(name, type, 4) == 0)
+        {
+            body = start + header;
+            boxEnd = start + size;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief 按路径逐级找子box，如"mdia/minf/stbl"
+ */
+static bool findPath(FILE *fp, off_t start, off_t end, const char *path, off_t &body, off_t &boxEnd)
+{
+    body = start;
+    boxEnd = end;
+    for (const char *p = path; *p != '\0'; p += (p[4] == '/') ? 5 : 4)
+    {
+        off_t pos = body;
+        if (!nextBox(fp, pos, boxEnd, p, body, boxEnd))
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief 从MP4视频轨的stss（关键帧序号）和stts（每帧时长）算出关键帧时间
+ */
+bool KeyframeIndex::parseMp4(const std::string &path, std::vector<uint32_t> &keyframes)
+{
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (fp == NULL)
+        return false;
+
+    fseeko(fp, 0, SEEK_END);
+    off_t fileEnd = ftello(fp);
+
+    // 第一个box必须是ftyp，否则不是MP4
+    off_t pos = 0, body = 0, boxEnd = 0, moov = 0, moovEnd = 0;
+    bool ok = nextBox(fp, pos, fileEnd, "ftyp", body, boxEnd) && body == 8 &&
+              (pos = 0, nextBox(fp, pos, fileEnd, "moov", moov, moovEnd));
+
+    bool found = false;
+    off_t trakPos = moov, trak, trakEnd;
+    while (ok && !found && nextBox(fp, trakPos, moovEnd, "trak", trak, trakEnd))
+    {
+        off_t hdlr, hdlrEnd, mdhd, mdhdEnd, stbl, stblEnd;
+        if (!findPath(fp, trak, trakEnd, "mdia/hdlr", hdlr, hdlrEnd) ||
+            !findPath(fp, trak, trakEnd, "mdia/mdhd", mdhd, mdhdEnd) ||
+            !findPath(fp, trak, trakEnd, "mdia/minf/stbl", stbl, stblEnd))
+            continue;
+
+        // hdlr: version/flags(4) pre_defined(4) handler_type(4)
+        char handler[4];
+        fseeko(fp, hdlr + 8, SEEK_SET);
+        if (fread(handler, 1, 4, fp) != 4 || memcmp(handler, "vide", 4) != 0)
+            continue;
+        found = true;
+
+        // mdhd: version 1 的创建/修改时间是64位
+        bool rdOk = true;
+        fseeko(fp, mdhd, SEEK_SET);
+        uint32_t version = readBe32(fp, rdOk) >> 24;
+        fseeko(fp, mdhd + (version == 1 ? 20 : 12), SEEK_SET);
+        uint32_t timescale = readBe32(fp, rdOk);
+
+        off_t stss, stssEnd, stts, sttsEnd, p;
+        p = stbl;
+        if (!nextBox(fp, p, stblEnd, "stss", stss, stssEnd))
+            break; // 没有stss表示每帧都是关键帧，不需要索引
+        p = stbl;
+        if (!rdOk || timescale == 0 || !nextBox(fp, p, stblEnd, "stts", stts, sttsEnd))
+        {
+            ok = false;
+            break;
+        }
+
+        fseeko(fp, stss + 4, SEEK_SET);
+        uint32_t syncCount = std::min<uint32_t>(readBe32(fp, rdOk), KEYFRAME_INDEX_MAX);
+        std::vector<uint32_t> syncSamples(syncCount);
+        for (uint32_t i = 0; i < syncCount && rdOk; i++)
+            syncSamples[i] = readBe32(fp, rdOk);
+
+        // stts: version/flags(4) entry_count(4) {sample_count(4) sample_delta(4)}...，整张表一次读入
+        fseeko(fp, stts + 4, SEEK_SET);
+        uint32_t entryCount = readBe32(fp, rdOk);
+        if (!rdOk || entryCount > (uint64_t)(sttsEnd - stts - 8) / 8)
+        {
+            ok = false;
+            break;
+        }
+        std::vector<uint8_t> table((size_t)entryCount * 8);
+        rdOk = fread(table.data(), 1, table.size(), fp) == table.size();
+
+        // 沿stts累加时间，遇到关键帧序号时记录
+        uint64_t sample = 1, ticks = 0;
+        uint32_t next = 0;
+        for (uint32_t e = 0; e < entryCount && next < syncCount && rdOk; e++)
+        {
+            uint32_t count = be32(&table[(size_t)e * 8]);
+            uint32_t delta = be32(&table[(size_t)e * 8 + 4]);
+            while (next < syncCount && syncSamples[next] < sample + count)
+            {
+                uint64_t t = ticks + (uint64_t)(syncSamples[next] - sample) * delta;
+                keyframes.push_back(t * 1000 / timescale);
+                next++;
+            }
+            sample += count;
+            ticks += (uint64_t)count * delta;
+        }
+        ok = rdOk;
+    }
+    fclose(fp);
+
+    std::sort(keyframes.begin(), keyframes.end());
+
+    return ok;
+}
+
+KeyframeIndex::KeyframeIndex(const char *dir)
+{
+    _dir = dir;
+    if (!_dir.empty() && _dir.back() != '/')
+        _dir += '/';
+}
+
+std::string KeyframeIndex::indexPath(uint64_t size, int64_t mtime) const
+{
+    // FNV-1a(路径 + 大小 + 修改时间)
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    auto mix = [&hash](const void *data, size_t len)
+    {
+        for (size_t i = 0; i < len; i++)
+        {
+            hash ^= ((const uint8_t *)data)[i];
+            hash *= 0x100000001b3ULL;
+        }
+    };
+    mix(_path.data(), _path.size());
+    mix(&size, sizeof(size));
+    mix(&mtime, sizeof(mtime));
+
+    char name[24];
+    snprintf(name, sizeof(name), "%016llx.kf", (unsigned long long)hash);
+
+    return _dir + name;
+}
+
+bool KeyframeIndex::loadDisk(const std::string &file)
+{
+    FILE *fp = fopen(file.c_str(), "rb");
+    if (fp == NULL)
+        return false;
+
+    char magic[4];
+    uint32_t count = 0;
+    bool ok = fread(magic, 1, 4, fp) == 4 && memcmp(magic, KEYFRAME_INDEX_MAGIC, 4) == 0 &&
+              fread(&count, sizeof(count), 1, fp) == 1 && count <= KEYFRAME_INDEX_MAX;
+    if (ok)
+    {
+        _keyframes.resize(count);
+        ok = fread(_keyframes.data(), sizeof(uint32_t), count, fp) == count;
+    }
+    fclose(fp);
+
+    if (!ok)
+        _keyframes.clear();
+
+    return ok;
+}
+
+void KeyframeIndex::saveDisk(const std::string &file) const
+{
+    std::string tmpPath = file + ".tmp";
+    FILE *fp = fopen(tmpPath.c_str(), "wb");
+    if (fp == NULL)
+        return;
+
+    uint32_t count = _keyframes.size();
+    bool ok = fwrite(KEYFRAME_INDEX_MAGIC, 1, 4, fp) == 4 &&
+              fwrite(&count, sizeof(count), 1, fp) == 1 &&
+              fwrite(_keyframes.data(), sizeof(uint32_t), count, fp) == count;
+    ok = (fclose(fp) == 0) && ok;
+
+    if (!ok || rename(tmpPath.c_str(), file.c_str()) != 0)
+        unlink(tmpPath.c_str());
+}
+
+/**
+ * @brief 载入视频的关键帧索引，磁盘上没有则解析文件生成并保存（第一次播放时）
+ * @retval true 有可用的索引（可能为空） / false 解析失败
+ */
+bool KeyframeIndex::Load(const std::string &path, uint64_t size, int64_t mtime)
+{
+    _path = path;
+    _keyframes.clear();
+
+    std::string file = indexPath(size, mtime);
+    if (loadDisk(file))
+        return true;
+
+    uint64_t t0 = tick_get_us();
+    bool ok = parseMp4(path, _keyframes);
+    if (!ok)
+    {
+        // 解析失败不保存，空索引会让这个文件以后一直不能对齐关键帧；由调用者决定是否重试
+        _keyframes.clear();
+        printf("[Keyframe] %s: no index (not MP4 or unreadable)\n", path.c_str());
+        return false;
+    }
+
+    mkdir(_dir.c_str(), 0755);
+    saveDisk(file);
+    printf("[Keyframe] %s: %u keyframes, built in %uus\n", path.c_str(),
+           (uint32_t)_keyframes.size(), (uint32_t)(tick_get_us() - t0));
+
+    return ok;
+}
+
+/**
+ * @brief 对齐到最近的关键帧
+ * @param posMs 目标时间（ms）
+ * @retval 最近的关键帧时间；索引为空时原样返回
+ */
+int KeyframeIndex::Snap(int posMs) const
+{
+    if (_keyframes.empty() || posMs < 0)
+        return posMs;
+
+    auto it = std::lower_bound(_keyframes.begin(), _keyframes.end(), (uint32_t)posMs);
+    if (it == _keyframes.end())
+        return _keyframes.back();
+    if (it != _keyframes.begin() && (uint32_t)posMs - *(it - 1) < *it - (uint32_t)posMs)
+        --it;
+
+    return *it;
+}
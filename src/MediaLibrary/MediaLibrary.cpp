@@ -0,0 +1,697 @@
+#include "MediaLibrary.h"
+#include "../../utils/Tick/Tick.h"
+#include <algorithm>
+#include <unordered_set>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+
+/* 关心的目录事件：写完关闭、移入移出、删除；不监听IN_CREATE，避免探测到写了一半的文件 */
+#define WATCH_MASK (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | \
+                    IN_DELETE_SELF | IN_MOVE_SELF | IN_UNMOUNT | IN_ONLYDIR)
+
+/* 支持的视频文件格式 */
+static const char *fileType[] = {".avi", ".mkv", ".flv", ".ts", ".mp4", ".webm", ".asf", ".mpg", ".mpeg", ".mov", ".vob", ".3gp", ".wmv", ".pmp"};
+
+/* 后缀匹配表：fileType[]转成小写后缀集合，只在第一次使用时构建 */
+struct SuffixMatcher
+{
+    std::unordered_set<std::string> suffixes;
+    size_t maxLen = 0;
+
+    SuffixMatcher()
+    {
+        for (auto type : fileType)
+        {
+            suffixes.insert(type);
+            maxLen = std::max(maxLen, strlen(type));
+        }
+    }
+
+    bool Match(const char *name) const
+    {
+        const char *dot = strrchr(name, '.');
+        if (dot == NULL || dot == name)
+            return false;
+
+        size_t len = strlen(dot);
+        if (len > maxLen)
+            return false;
+
+        char lower[16];
+        for (size_t i = 0; i < len; i++)
+            lower[i] = tolower((unsigned char)dot[i]);
+
+        return suffixes.count(std::string(lower, len)) != 0;
+    }
+};
+
+/**
+ * @brief 媒体库构造函数
+ * @param roots 扫描的根目录，按优先级排列（同名文件以靠前的目录为准）
+ * @param cachePath 元数据缓存文件路径，为NULL则不缓存元数据
+ */
+MediaLibrary::MediaLibrary(const std::vector<std::string> &roots, const char *cachePath)
+{
+    for (auto root : roots)
+    {
+        if (!root.empty() && root.back() != '/')
+            root += '/';
+        _roots.push_back(root);
+    }
+
+    _watches.resize(_roots.size(), {-1, 0, 0});
+    _threadRunning = false;
+    _stop = false;
+    _inotifyFd = -1;
+    _mountsFd = -1;
+    _stopFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    _ready = false;
+    _stats = {0};
+    _cache = (cachePath != NULL) ? new MetadataCache(cachePath) : nullptr;
+
+    pthread_mutex_init(&_mutex, NULL);
+}
+
+MediaLibrary::~MediaLibrary()
+{
+    stopThread();
+
+    if (_stopFd >= 0)
+        close(_stopFd);
+    delete _cache;
+
+    pthread_mutex_destroy(&_mutex);
+}
+
+/**
+ * @brief 判断是否为支持的视频文件（按后缀，不区分大小写）
+ */
+bool MediaLibrary::IsMediaFile(const char *name)
+{
+    static const SuffixMatcher matcher;
+
+    return matcher.Match(name);
+}
+
+/**
+ * @brief 通知扫描/监视线程退出并等待
+ */
+void MediaLibrary::stopThread(void)
+{
+    if (!_threadRunning)
+        return;
+
+    uint64_t one = 1;
+    _stop = true;
+    if (write(_stopFd, &one, sizeof(one)) < 0)
+        printf("[Library] wake watcher failed\n");
+    pthread_join(_pthread, NULL);
+
+    _threadRunning = false;
+    _stop = false;
+    eventfd_t val;
+    eventfd_read(_stopFd, &val);
+}
+
+/**
+ * @brief 在后台线程中扫描所有根目录并持续监视变化，立即返回
+ * @param updateCb 更新回调，在扫描/监视线程中调用：全量扫描完成、探测完成、每批增量更新后各调用一次
+ */
+void MediaLibrary::StartScan(UpdateCb updateCb)
+{
+    stopThread();
+
+    _updateCb = updateCb;
+    _threadRunning = (pthread_create(&_pthread, NULL, threadProcHandler, this) == 0);
+}
+
+void *MediaLibrary::threadProcHandler(void *arg)
+{
+    MediaLibrary *library = static_cast<MediaLibrary *>(arg);
+    std::unordered_set<std::string> dirty;
+
+    // 先建立监视再扫描，扫描期间发生的变化会留在inotify队列里，不会漏掉
+    library->_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    library->_mountsFd = open("/proc/self/mounts", O_RDONLY | O_CLOEXEC);
+    library->checkRoots(dirty);
+    dirty.clear();
+
+    // 先发布带缓存元数据的索引，再探测变化的文件，两次都通知
+    library->scan();
+    library->probe();
+
+    if (library->_inotifyFd >= 0)
+        library->watch();
+    else
+        printf("[Library] inotify unavailable, library will not follow changes\n");
+
+    if (library->_inotifyFd >= 0)
+        close(library->_inotifyFd);
+    if (library->_mountsFd >= 0)
+        close(library->_mountsFd);
+    library->_inotifyFd = library->_mountsFd = -1;
+    for (auto &w : library->_watches)
+        w = {-1, 0, 0};
+
+    return NULL;
+}
+
+/**
+ * @brief 用新索引整体替换旧索引
+ */
+void MediaLibrary::publish(std::unordered_map<std::string, MediaEntry> &entries)
+{
+    pthread_mutex_lock(&_mutex);
+    _entries.swap(entries);
+    _ready = true;
+    pthread_mutex_unlock(&_mutex);
+}
+
+/**
+ * @brief 扫描所有根目录，未变化的文件直接使用缓存的元数据
+ */
+void MediaLibrary::scan(void)
+{
+    std::unordered_map<std::string, MediaEntry> entries;
+    ScanStats stats = {0};
+    uint64_t t0 = tick_get_us();
+
+    if (_cache != nullptr)
+    {
+        _cache->Load();
+        _cache->BeginScan();
+    }
+    stats.loadUs = tick_get_us() - t0;
+
+    for (int i = 0; i < (int)_roots.size(); i++)
+    {
+        DIR *dir = opendir(_roots[i].c_str());
+        if (dir == NULL)
+            continue;
+
+        int dfd = dirfd(dir);
+        struct dirent *ent;
+        while ((ent = readdir(dir)) != NULL)
+        {
+            if (ent->d_type != DT_REG && ent->d_type != DT_UNKNOWN)
+                continue;
+
+            if (!IsMediaFile(ent->d_name))
+            {
+                stats.skipped++;
+                continue;
+            }
+
+            struct stat st;
+            if (fstatat(dfd, ent->d_name, &st, 0) != 0 || !S_ISREG(st.st_mode))
+                continue;
+
+            // 同名文件以优先级高的根目录为准
+            MediaEntry entry;
+            entry.name = ent->d_name;
+            entry.path = _roots[i] + entry.name;
+            entry.root = i;
+            entry.size = st.st_size;
+            entry.mtime = st.st_mtime;
+            entry.hasMeta = false;
+            entry.meta = {0};
+            if (entries.count(entry.name) != 0)
+                continue;
+
+            if (_cache != nullptr && _cache->Find(entry.path, entry.size, entry.mtime, entry.meta))
+            {
+                entry.hasMeta = true;
+                stats.cacheHits++;
+            }
+            entries.emplace(entry.name, entry);
+            stats.files++;
+        }
+        closedir(dir);
+    }
+
+    stats.scanUs = tick_get_us() - t0;
+    printf("[Library] scanned %u files (%u skipped, %u cached) in %uus, cache load %uus\n",
+           stats.files, stats.skipped, stats.cacheHits, stats.scanUs, stats.loadUs);
+
+    pthread_mutex_lock(&_mutex);
+    _stats = stats;
+    pthread_mutex_unlock(&_mutex);
+
+    Changes changes = {true};
+    if (_updateCb)
+    {
+        for (auto &it : entries)
+            changes.added.push_back(it.first);
+    }
+
+    publish(entries);
+
+    if (_updateCb)
+        _updateCb(changes);
+}
+
+/**
+ * @brief 探测缓存未命中（新增或变化）的文件，更新索引并写回缓存
+ */
+void MediaLibrary::probe(void)
+{
+    std::vector<MediaEntry> pending;
+    uint64_t t0 = tick_get_us();
+
+    pthread_mutex_lock(&_mutex);
+    for (auto &it : _entries)
+    {
+        if (!it.second.hasMeta)
+            pending.push_back(it.second);
+    }
+    pthread_mutex_unlock(&_mutex);
+
+    if (_probeCb)
+    {
+        for (auto &entry : pending)
+        {
+            if (_stop)
+                return;
+            entry.hasMeta = _probeCb(entry.path, entry.meta);
+            if (entry.hasMeta && _cache != nullptr)
+                _cache->Put(entry.path, entry.size, entry.mtime, entry.meta);
+        }
+    }
+
+    if (_cache != nullptr)
+        _cache->Save();
+
+    uint32_t probeUs = tick_get_us() - t0;
+    Changes changes = {false};
+
+    pthread_mutex_lock(&_mutex);
+    for (auto &entry : pending)
+    {
+        auto it = _entries.find(entry.name);
+        if (it != _entries.end() && it->second.path == entry.path)
+        {
+            it->second = entry;
+            changes.updated.push_back(entry.name);
+        }
+    }
+    _stats.probed = _probeCb ? pending.size() : 0;
+    _stats.probeUs = probeUs;
+    pthread_mutex_unlock(&_mutex);
+
+    if (!pending.empty() && _probeCb)
+    {
+        printf("[Library] probed %u changed files in %uus\n", (uint32_t)pending.size(), probeUs);
+        if (_updateCb)
+            _updateCb(changes);
+    }
+}
+
+/**
+ * @brief 监视循环：收集变化的文件名，安静MEDIALIBRARY_COALESCE_MS后（或最多推迟
+ *        MEDIALIBRARY_COALESCE_MAX_MS）作为一批应用
+ */
+void MediaLibrary::watch(void)
+{
+    std::unordered_set<std::string> dirty;
+    uint64_t firstUs = 0;
+    struct pollfd fds[3];
+
+    fds[0] = {_inotifyFd, POLLIN, 0};
+    fds[1] = {_mountsFd, POLLPRI, 0};
+    fds[2] = {_stopFd, POLLIN, 0};
+
+    while (!_stop)
+    {
+        int timeout = -1;
+        if (!dirty.empty())
+        {
+            uint64_t waitedMs = (tick_get_us() - firstUs) / 1000;
+            timeout = (waitedMs >= MEDIALIBRARY_COALESCE_MAX_MS) ? 0 : MEDIALIBRARY_COALESCE_MS;
+        }
+
+        int ret = poll(fds, 3, timeout);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            printf("[Library] poll failed, errno %d\n", errno);
+            break;
+        }
+        if (fds[2].revents)
+            break;
+
+        bool rootsChanged = false;
+        if (fds[0].revents & POLLIN)
+            rootsChanged = readEvents(dirty);
+        if (fds[1].revents & (POLLPRI | POLLERR))
+            rootsChanged = true;
+        if (rootsChanged)
+            checkRoots(dirty);
+
+        if (dirty.empty())
+            continue;
+        if (firstUs == 0)
+            firstUs = tick_get_us();
+
+        // 安静超时或推迟太久，应用这一批
+        if (ret == 0 || tick_get_us() - firstUs >= (uint64_t)MEDIALIBRARY_COALESCE_MAX_MS * 1000)
+        {
+            applyChanges(dirty);
+            dirty.clear();
+            firstUs = 0;
+        }
+    }
+}
+
+/**
+ * @brief 读出所有inotify事件，把涉及的视频文件名加入dirty
+ * @retval true 有根目录本身被删除/移动/卸载，或事件队列溢出，需要重新检查根目录
+ */
+bool MediaLibrary::readEvents(std::unordered_set<std::string> &dirty)
+{
+    alignas(struct inotify_event) char buf[4096];
+    bool rootsChanged = false;
+    uint32_t events = 0;
+
+    while (true)
+    {
+        ssize_t len = read(_inotifyFd, buf, sizeof(buf));
+        if (len <= 0)
+            break;
+
+        for (char *p = buf; p < buf + len;)
+        {
+            struct inotify_event *ev = (struct inotify_event *)p;
+            p += sizeof(struct inotify_event) + ev->len;
+            events++;
+
+            if (ev->mask & IN_Q_OVERFLOW)
+            {
+                // 事件丢失，所有根目录重新列一遍；已有的条目也要重新检查，丢失的可能是删除事件
+                for (int i = 0; i < (int)_roots.size(); i++)
+                {
+                    markRootEntries(i, dirty);
+                    listRoot(i, dirty);
+                }
+                continue;
+            }
+            if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_UNMOUNT | IN_IGNORED))
+            {
+                rootsChanged = true;
+                continue;
+            }
+            if (ev->len > 0 && IsMediaFile(ev->name))
+                dirty.insert(ev->name);
+        }
+    }
+
+    pthread_mutex_lock(&_mutex);
+    _stats.events += events;
+    pthread_mutex_unlock(&_mutex);
+
+    return rootsChanged;
+}
+
+/**
+ * @brief 检查各根目录是否出现、消失或被挂载覆盖，重新建立监视，
+ *        变化的根目录下（新旧）所有文件名加入dirty
+ */
+void MediaLibrary::checkRoots(std::unordered_set<std::string> &dirty)
+{
+    if (_inotifyFd < 0)
+        return;
+
+    for (int i = 0; i < (int)_roots.size(); i++)
+    {
+        RootWatch &w = _watches[i];
+        struct stat st;
+        bool exists = (stat(_roots[i].c_str(), &st) == 0 && S_ISDIR(st.st_mode));
+
+        if (exists && w.wd >= 0 && w.dev == st.st_dev && w.ino == st.st_ino)
+            continue;
+        if (!exists && w.wd < 0)
+            continue;
+
+        // 旧目录上的文件全部重新解析
+        markRootEntries(i, dirty);
+
+        if (w.wd >= 0)
+            inotify_rm_watch(_inotifyFd, w.wd);
+        w = {-1, 0, 0};
+
+        if (exists)
+        {
+            w.wd = inotify_add_watch(_inotifyFd, _roots[i].c_str(), WATCH_MASK);
+            w.dev = st.st_dev;
+            w.ino = st.st_ino;
+        }
+        printf("[Library] %s %s\n", _roots[i].c_str(), w.wd >= 0 ? "attached" : "detached");
+
+        if (w.wd >= 0)
+            listRoot(i, dirty);
+    }
+}
+
+/**
+ * @brief 把库中属于该根目录的所有条目加入dirty，应用时已不存在的会被删除
+ */
+void MediaLibrary::markRootEntries(int root, std::unordered_set<std::string> &dirty)
+{
+    pthread_mutex_lock(&_mutex);
+    for (auto &it : _entries)
+    {
+        if (it.second.root == root)
+            dirty.insert(it.first);
+    }
+    pthread_mutex_unlock(&_mutex);
+}
+
+/**
+ * @brief 把根目录下所有视频文件名加入dirty
+ */
+void MediaLibrary::listRoot(int root, std::unordered_set<std::string> &dirty)
+{
+    DIR *dir = opendir(_roots[root].c_str());
+    if (dir == NULL)
+        return;
+
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL)
+    {
+        if ((ent->d_type == DT_REG || ent->d_type == DT_UNKNOWN) && IsMediaFile(ent->d_name))
+            dirty.insert(ent->d_name);
+    }
+    closedir(dir);
+}
+
+/**
+ * @brief 按根目录优先级重新解析一个文件名当前对应的文件
+ * @retval true 存在 / false 所有根目录下都不存在
+ */
+bool MediaLibrary::resolve(const std::string &name, MediaEntry &entry)
+{
+    for (int i = 0; i < (int)_roots.size(); i++)
+    {
+        if (_watches[i].wd < 0)
+            continue;
+
+        struct stat st;
+        std::string path = _roots[i] + name;
+        if (stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+        {
+            entry.name = name;
+            entry.path = path;
+            entry.root = i;
+            entry.size = st.st_size;
+            entry.mtime = st.st_mtime;
+            entry.hasMeta = false;
+            entry.meta = {0};
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief 应用一批变化：只重新stat涉及的文件，新文件查缓存或探测元数据，然后通知
+ */
+void MediaLibrary::applyChanges(std::unordered_set<std::string> &dirty)
+{
+    uint64_t t0 = tick_get_us();
+    Changes changes = {false};
+
+    for (auto &name : dirty)
+    {
+        MediaEntry entry, old;
+        bool exists = resolve(name, entry);
+
+        pthread_mutex_lock(&_mutex);
+        auto it = _entries.find(name);
+        bool had = (it != _entries.end());
+        if (had)
+            old = it->second;
+        if (had && !exists)
+            _entries.erase(it);
+        pthread_mutex_unlock(&_mutex);
+
+        if (!exists)
+        {
+            if (had)
+            {
+                // 所在目录还挂载着说明是真的删除了；卸载的保留缓存，重新插入时不用再探测
+                if (_cache != nullptr && _watches[old.root].wd >= 0)
+                    _cache->Erase(old.path);
+                changes.removed.push_back(name);
+            }
+            continue;
+        }
+
+        if (had && old.path == entry.path && old.size == entry.size && old.mtime == entry.mtime)
+            continue;
+
+        if (_cache != nullptr && _cache->Find(entry.path, entry.size, entry.mtime, entry.meta))
+            entry.hasMeta = true;
+        else if (_probeCb)
+        {
+            entry.hasMeta = _probeCb(entry.path, entry.meta);
+            if (entry.hasMeta && _cache != nullptr)
+                _cache->Put(entry.path, entry.size, entry.mtime, entry.meta);
+        }
+
+        pthread_mutex_lock(&_mutex);
+        _entries[name] = entry;
+        pthread_mutex_unlock(&_mutex);
+
+        (had ? changes.updated : changes.added).push_back(name);
+    }
+
+    if (_cache != nullptr)
+        _cache->Save();
+
+    uint32_t batchUs = tick_get_us() - t0;
+    pthread_mutex_lock(&_mutex);
+    _stats.files = _entries.size();
+    _stats.batches++;
+    _stats.lastBatchUs = batchUs;
+    pthread_mutex_unlock(&_mutex);
+
+    if (changes.added.empty() && changes.updated.empty() && changes.removed.empty())
+        return;
+
+    printf("[Library] +%u ~%u -%u files in %uus\n", (uint32_t)changes.added.size(),
+           (uint32_t)changes.updated.size(), (uint32_t)changes.removed.size(), batchUs);
+    if (_updateCb)
+        _updateCb(changes);
+}
+
+/**
+ * @brief 扫描完成前的查找：直接stat每个根目录下的同名文件
+ */
+bool MediaLibrary::lookupDirect(const std::string &name, MediaEntry &entry)
+{
+    if (!IsMediaFile(name.c_str()) || name.find('/') != std::string::npos)
+        return false;
+
+    for (int i = 0; i < (int)_roots.size(); i++)
+    {
+        struct stat st;
+        std::string path = _roots[i] + name;
+        if (stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+        {
+            entry.name = name;
+            entry.path = path;
+            entry.root = i;
+            entry.size = st.st_size;
+            entry.mtime = st.st_mtime;
+            entry.hasMeta = false;
+            entry.meta = {0};
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool MediaLibrary::IsReady(void)
+{
+    pthread_mutex_lock(&_mutex);
+    bool ready = _ready;
+    pthread_mutex_unlock(&_mutex);
+
+    return ready;
+}
+
+/**
+ * @brief 按文件名查找视频
+ * @param name 文件名
+ * @param entry 查找结果
+ * @retval true 找到 / false 没找到
+ */
+bool MediaLibrary::Lookup(const std::string &name, MediaEntry &entry)
+{
+    pthread_mutex_lock(&_mutex);
+    if (_ready)
+    {
+        auto it = _entries.find(name);
+        bool found = (it != _entries.end());
+        if (found)
+            entry = it->second;
+        pthread_mutex_unlock(&_mutex);
+        return found;
+    }
+    pthread_mutex_unlock(&_mutex);
+
+    // 索引还没建好，退回到逐个目录stat（不遍历目录）
+    return lookupDirect(name, entry);
+}
+
+/**
+ * @brief 获取按根目录优先级、文件名排序的所有条目（含元数据，可直接用于列表显示）
+ */
+std::vector<MediaLibrary::MediaEntry> MediaLibrary::GetEntries(void)
+{
+    std::vector<MediaEntry> entries;
+
+    pthread_mutex_lock(&_mutex);
+    entries.reserve(_entries.size());
+    for (auto &it : _entries)
+        entries.push_back(it.second);
+    pthread_mutex_unlock(&_mutex);
+
+    std::sort(entries.begin(), entries.end(), [](const MediaEntry &a, const MediaEntry &b)
+              { return a.root != b.root ? a.root < b.root : a.name < b.name; });
+
+    return entries;
+}
+
+/**
+ * @brief 获取按根目录优先级、文件名排序的播放列表
+ */
+std::vector<std::string> MediaLibrary::GetPlaylist(void)
+{
+    std::vector<std::string> playlist;
+
+    for (auto &entry : GetEntries())
+        playlist.push_back(entry.path);
+
+    return playlist;
+}
+
+MediaLibrary::ScanStats MediaLibrary::GetStats(void)
+{
+    pthread_mutex_lock(&_mutex);
+    ScanStats stats = _stats;
+    pthread_mutex_unlock(&_mutex);
+
+    return stats;
+}
@@ -0,0 +1,222 @@
+#include "MetadataCache.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define METADATA_CACHE_MAGIC "EMPC"
+#define METADATA_CACHE_VERSION 1
+
+MetadataCache::MetadataCache(const std::string &path)
+{
+    _path = path;
+    _map = nullptr;
+    _mapSize = 0;
+    _records = nullptr;
+    _strings = nullptr;
+    _count = 0;
+    _dirty = false;
+}
+
+MetadataCache::~MetadataCache()
+{
+    unmap();
+}
+
+/**
+ * @brief FNV-1a 64位哈希
+ */
+uint64_t MetadataCache::hashPath(const char *path, size_t len)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= (uint8_t)path[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+void MetadataCache::unmap(void)
+{
+    if (_map != nullptr)
+        munmap(_map, _mapSize);
+
+    _map = nullptr;
+    _mapSize = 0;
+    _records = nullptr;
+    _strings = nullptr;
+    _count = 0;
+    _index.clear();
+}
+
+/**
+ * @brief 一次mmap载入缓存文件，只建立 路径哈希 -> 记录 的索引，不解析每条记录
+ * @retval true 成功 / false 文件不存在或格式不对（视为空缓存）
+ */
+bool MetadataCache::Load(void)
+{
+    unmap();
+
+    int fd = open(_path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(Header))
+    {
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    // 文件可能被截断或损坏，先用除法检查记录数，避免32位下 count * sizeof(Record) 溢出
+    const Header *header = (const Header *)map;
+    size_t body = (size_t)st.st_size - sizeof(Header);
+    bool valid = memcmp(header->magic, METADATA_CACHE_MAGIC, 4) == 0 &&
+                 header->version == METADATA_CACHE_VERSION &&
+                 header->count <= body / sizeof(Record) &&
+                 header->stringsSize == body - (size_t)header->count * sizeof(Record);
+
+    const Record *records = (const Record *)((const char *)map + sizeof(Header));
+    // 每条记录的路径都必须落在字符串表内，Find据此直接比较，不再检查
+    for (uint32_t i = 0; valid && i < header->count; i++)
+    {
+        valid = records[i].pathOffset <= header->stringsSize &&
+                records[i].pathLen <= header->stringsSize - records[i].pathOffset;
+    }
+
+    if (!valid)
+    {
+        printf("[MetaCache] %s is invalid, ignore it.\n", _path.c_str());
+        munmap(map, st.st_size);
+        return false;
+    }
+
+    _map = map;
+    _mapSize = st.st_size;
+    _count = header->count;
+    _records = records;
+    _strings = (const char *)(_records + _count);
+
+    _index.reserve(_count);
+    for (uint32_t i = 0; i < _count; i++)
+        _index[_records[i].pathHash] = i;
+
+    return true;
+}
+
+/**
+ * @brief 开始新一轮扫描，之后Find命中或Put的记录会在Save时保留
+ */
+void MetadataCache::BeginScan(void)
+{
+    _live.clear();
+    _dirty = false;
+}
+
+/**
+ * @brief 查找未变化文件的元数据
+ * @retval true 命中 / false 不存在或文件已变化
+ */
+bool MetadataCache::Find(const std::string &path, uint64_t size, int64_t mtime, Meta &meta)
+{
+    auto it = _index.find(hashPath(path.c_str(), path.size()));
+    if (it == _index.end())
+        return false;
+
+    const Record &rec = _records[it->second];
+    if (rec.pathLen != path.size() ||
+        memcmp(_strings + rec.pathOffset, path.c_str(), rec.pathLen) != 0 ||
+        rec.size != size || rec.mtime != mtime)
+        return false;
+
+    meta = rec.meta;
+    _live[path] = {size, mtime, meta};
+    return true;
+}
+
+/**
+ * @brief 记录新探测到的元数据，同一路径的旧记录被覆盖
+ */
+void MetadataCache::Put(const std::string &path, uint64_t size, int64_t mtime, const Meta &meta)
+{
+    _live[path] = {size, mtime, meta};
+    _dirty = true;
+}
+
+/**
+ * @brief 删除已不存在的文件的记录
+ */
+void MetadataCache::Erase(const std::string &path)
+{
+    if (_live.erase(path) != 0)
+        _dirty = true;
+}
+
+/**
+ * @brief 把本轮扫描的记录写回磁盘（先写临时文件再rename），没有变化时不写
+ */
+bool MetadataCache::Save(void)
+{
+    if (!_dirty && _live.size() == _count)
+        return true;
+
+    std::string tmpPath = _path + ".tmp";
+    FILE *fp = fopen(tmpPath.c_str(), "wb");
+    if (fp == NULL)
+    {
+        printf("[MetaCache] can not create %s\n", tmpPath.c_str());
+        return false;
+    }
+
+    Header header;
+    memcpy(header.magic, METADATA_CACHE_MAGIC, 4);
+    header.version = METADATA_CACHE_VERSION;
+    header.count = _live.size();
+    header.stringsSize = 0;
+    for (auto &live : _live)
+        header.stringsSize += live.first.size();
+
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+
+    uint32_t offset = 0;
+    for (auto &live : _live)
+    {
+        Record rec;
+        memset(&rec, 0, sizeof(rec));
+        rec.pathHash = hashPath(live.first.c_str(), live.first.size());
+        rec.size = live.second.size;
+        rec.mtime = live.second.mtime;
+        rec.pathOffset = offset;
+        rec.pathLen = live.first.size();
+        rec.meta = live.second.meta;
+        offset += rec.pathLen;
+        ok = ok && fwrite(&rec, sizeof(rec), 1, fp) == 1;
+    }
+    for (auto &live : _live)
+        ok = ok && fwrite(live.first.data(), 1, live.first.size(), fp) == live.first.size();
+
+    ok = (fflush(fp) == 0) && ok;
+    fsync(fileno(fp));
+    fclose(fp);
+
+    if (!ok || rename(tmpPath.c_str(), _path.c_str()) != 0)
+    {
+        printf("[MetaCache] save %s failed\n", _path.c_str());
+        unlink(tmpPath.c_str());
+        return false;
+    }
+
+    _dirty = false;
+    // 重新映射，下一轮扫描直接使用新文件
+    return Load();
+}
@@ -1,35 +1,79 @@
 #include "MediaPlayer.h"
-
-static bool fullScreenState = false;
+#include "../../utils/Tick/Tick.h"
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
 
 int CallbackForTPlayer(void *pUserData, int msg, int param0, void *param1);
 
 MediaPlayer::MediaPlayer(std::string *url)
 {
     _prepareFinishFlag = false;
+    _threadExitFlag = false;
+    _reqSeq = 0;
+    _latestReqId = 0;
+    _lastTimings = {0};
+    _active = 0;
+    _prerollDepth = 0;
+    _playlistIndex = -1;
+    _completePending = false;
+    _volume = -1;
+    _speed = PLAY_SPEED_1;
+    _switchStats = {0};
+    _eventStats = {0};
+    _seekStats = {0};
+    _seekStartUs = 0;
+    _seekSnapped = false;
+    _prerollPending = false;
+
+    for (auto &slot : _slots)
+    {
+        slot.owner = this;
+        slot.player = nullptr;
+        slot.prepared = false;
+        slot.failed = false;
+        slot.preparing = false;
+        slot.rssKb = 0;
+        slot.dropped = 0;
+        slot.seekPending = false;
+        slot.videoWidth = 0;
+        slot.videoHeight = 0;
+    }
+
+    // 初始化信号量，必须在设置消息回调之前，回调会立即使用它
+    sem_init(&_sem, 0, 0);
+    pthread_mutex_init(&_reqMutex, NULL);
+    pthread_mutex_init(&_snapMutex, NULL);
+    pthread_mutex_init(&_playerMutex, NULL);
 
     // 创建播放器
-    mTPlayer = TPlayerCreate(CEDARX_PLAYER);
-    if (mTPlayer == nullptr)
+    if (!createSlot(_slots[_active]))
     {
+        mTPlayer = nullptr;
         printf("[Player] can not create tplayer, quit.\n");
         return;
     }
-    TPlayerSetDebugFlag(mTPlayer, false);
-    // 设置消息回调函数
-    TPlayerSetNotifyCallback(mTPlayer, CallbackForTPlayer, this);
+    mTPlayer = _slots[_active].player;
 
-    // 初始化信号量
-    sem_init(&_sem, 0, 0);
+    updateSnapshot([](PlaybackSnapshot &snap)
+                   {
+                       snap = {0};
+                       snap.durationMs = 3000;
+                       snap.speed = PLAY_SPEED_1;
+                   });
 
     // 设置循环播放
     SetLoop(true);
 
-    // url路径不为空，则开始播放音视频
+    // 创建播放器线程，打开视频的耗时操作都放在这里执行
+    pthread_create(&_pthread, NULL, threadProcHandler, this);
+
+    // url路径不为空，则开始准备音视频
     if (url != nullptr)
     {
         _sourceUrl = *url;
-        SetNewVideo(_sourceUrl);
+        OpenAsync(_sourceUrl, false);
     }
 }
 
@@ -38,79 +82,917 @@ MediaPlayer::~MediaPlayer(void)
     if (!mTPlayer)
     {
         printf("[Player] player not init.\n");
+        pthread_mutex_destroy(&_playerMutex);
+        pthread_mutex_destroy(&_snapMutex);
+        pthread_mutex_destroy(&_reqMutex);
+        sem_destroy(&_sem);
         return;
     }
 
-    printf("[Player] player reset.\n");
-    TPlayerReset(mTPlayer);
+    // 通知播放器线程退出并等待回收
+    _threadExitFlag = true;
+    sem_post(&_sem);
+    pthread_join(_pthread, NULL);
 
-    printf("[Player] player destroy.\n");
-    TPlayerDestroy(mTPlayer);
+    printf("[Player] player reset & destroy.\n");
+    for (auto &slot : _slots)
+        destroySlot(slot);
     mTPlayer = NULL;
 
+    pthread_mutex_destroy(&_playerMutex);
+    pthread_mutex_destroy(&_snapMutex);
+    pthread_mutex_destroy(&_reqMutex);
     sem_destroy(&_sem);
 }
 
 /**
- * @brief 播放新的视频
+ * @brief 读取当前进程的常驻内存
+ * @retval 常驻内存（KB），读取失败返回0
+ */
+static long getRssKb(void)
+{
+    long pages = 0, rss = 0;
+    FILE *fp = fopen("/proc/self/statm", "r");
+
+    if (fp == NULL)
+        return 0;
+    if (fscanf(fp, "%ld %ld", &pages, &rss) != 2)
+        rss = 0;
+    fclose(fp);
+
+    return rss * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/**
+ * @brief 创建一个TPlayer实例
+ */
+bool MediaPlayer::createSlot(PlayerSlot &slot)
+{
+    slot.player = TPlayerCreate(CEDARX_PLAYER);
+    if (slot.player == nullptr)
+        return false;
+
+    TPlayerSetDebugFlag(slot.player, false);
+    // 设置消息回调函数，用户数据为实例本身，以区分消息来自哪个实例
+    TPlayerSetNotifyCallback(slot.player, CallbackForTPlayer, &slot);
+
+    slot.url.clear();
+    slot.prepared = false;
+    slot.failed = false;
+    slot.preparing = false;
+    slot.rssKb = 0;
+    slot.videoWidth = 0;
+    slot.videoHeight = 0;
+
+    return true;
+}
+
+/**
+ * @brief 复位并销毁一个TPlayer实例
+ */
+void MediaPlayer::destroySlot(PlayerSlot &slot)
+{
+    if (slot.player == nullptr)
+        return;
+
+    TPlayerReset(slot.player);
+    TPlayerDestroy(slot.player);
+    slot.player = nullptr;
+    slot.url.clear();
+    slot.prepared = false;
+    slot.preparing = false;
+    slot.rssKb = 0;
+    slot.videoWidth = 0;
+    slot.videoHeight = 0;
+}
+
+/**
+ * @brief 异步打开新的视频，立即返回，不阻塞调用者
+ * @param url 视频路径
+ * @param autoStart 准备完成后是否自动开始播放
+ * @param doneCb 完成回调，在播放器线程中调用（未完成的旧请求会以PREPARE_CANCELED回调）
+ * @retval 请求id
+ */
+uint32_t MediaPlayer::OpenAsync(const std::string &url, bool autoStart, PrepareDoneCb doneCb)
+{
+    OpenRequest req;
+
+    req.url = url;
+    req.autoStart = autoStart;
+    req.doneCb = doneCb;
+    req.enqueueUs = tick_get_us();
+
+    pthread_mutex_lock(&_reqMutex);
+    req.id = ++_reqSeq;
+    // 新请求取代所有还没完成的旧请求，旧请求留在队列里由播放器线程回调PREPARE_CANCELED
+    _latestReqId = req.id;
+    _reqQueue.push_back(req);
+    pthread_mutex_unlock(&_reqMutex);
+
+    // 唤醒播放器线程（正在等待准备完成的请求也会因此被取消）
+    sem_post(&_sem);
+
+    return req.id;
+}
+
+/**
+ * @brief 获取最近一次打开视频的各阶段耗时
+ */
+MediaPlayer::PrepareTimings MediaPlayer::GetPrepareTimings(void)
+{
+    pthread_mutex_lock(&_reqMutex);
+    PrepareTimings timings = _lastTimings;
+    pthread_mutex_unlock(&_reqMutex);
+
+    return timings;
+}
+
+/**
+ * @brief 播放新的视频（同步版本，会阻塞调用者直到准备完成，UI线程请使用OpenAsync）
  */
 bool MediaPlayer::SetNewVideo(std::string &url)
 {
+    sem_t done;
+    PrepareResult result = PREPARE_FAILED;
+
+    sem_init(&done, 0, 0);
+    OpenAsync(url, false, [&](uint32_t id, PrepareResult res, const PrepareTimings &timings)
+              {
+                  result = res;
+                  sem_post(&done);
+              });
+    sem_wait(&done);
+    sem_destroy(&done);
+
+    return result == PREPARE_OK;
+}
+
+/**
+ * @brief 播放器线程处理函数
+ *
+ * @return void*
+ */
+void *MediaPlayer::threadProcHandler(void *arg)
+{
+    MediaPlayer *player = static_cast<MediaPlayer *>(arg);
+    OpenRequest req;
+    const uint64_t periodUs = MEDIAPLAYER_SNAPSHOT_PERIOD_MS * 1000;
+
+    while (!player->_threadExitFlag)
+    {
+        // 先把所有事务处理完再睡眠，唤醒可能已在等待准备时被消耗掉
+        while (!player->_threadExitFlag)
+        {
+            player->drainEvents();
+
+            // 播放时按固定周期刷新快照
+            PlaybackSnapshot snap = player->_snapshot.Read();
+            if (snap.playing && tick_get_us() - snap.sampleUs >= periodUs)
+                player->sampleSnapshot();
+
+            if (player->popRequest(req))
+            {
+                player->processOpen(req);
+                continue;
+            }
+
+            // 活动实例播放结束，切换到播放列表的下一个
+            if (player->_completePending)
+            {
+                player->_completePending = false;
+                player->SkipToNext();
+                continue;
+            }
+
+            // 空闲时预加载播放列表后续的视频
+            if (player->prerollStandby())
+                continue;
+
+            break;
+        }
+
+        // 播放时睡到下一次采样，有备用实例在准备时也定时醒来检查超时，否则一直睡到被唤醒
+        if (player->_snapshot.Read().playing || player->_prerollPending)
+        {
+            struct timespec timeout;
+            clock_gettime(CLOCK_REALTIME, &timeout);
+            timeout.tv_nsec += MEDIAPLAYER_SNAPSHOT_PERIOD_MS * 1000000L;
+            timeout.tv_sec += timeout.tv_nsec / 1000000000L;
+            timeout.tv_nsec %= 1000000000L;
+            sem_timedwait(&player->_sem, &timeout);
+        }
+        else
+        {
+            sem_wait(&player->_sem);
+        }
+    }
+
+    // 退出前取消还没执行的请求，等待结果的调用者（如SetNewVideo）不会一直阻塞
+    while (player->popRequest(req))
+    {
+        PrepareTimings timings = {0};
+        if (req.doneCb)
+            req.doneCb(req.id, PREPARE_CANCELED, timings);
+    }
+
+    return NULL;
+}
+
+bool MediaPlayer::popRequest(OpenRequest &req)
+{
+    bool ret = false;
+
+    pthread_mutex_lock(&_reqMutex);
+    if (!_reqQueue.empty())
+    {
+        req = _reqQueue.front();
+        _reqQueue.pop_front();
+        ret = true;
+    }
+    pthread_mutex_unlock(&_reqMutex);
+
+    return ret;
+}
+
+bool MediaPlayer::isSuperseded(uint32_t id)
+{
+    pthread_mutex_lock(&_reqMutex);
+    bool ret = (id != _latestReqId);
+    pthread_mutex_unlock(&_reqMutex);
+
+    return ret;
+}
+
+/**
+ * @brief 等待实例准备完成
+ * @param slot 正在准备的实例
+ * @param id 打开请求id，被新请求取代时取消；为0表示预加载，有任何其他事务时取消
+ */
+MediaPlayer::PrepareResult MediaPlayer::waitPrepared(PlayerSlot &slot, uint32_t id)
+{
+    // 超时时间 3s（sem_timedwait使用CLOCK_REALTIME绝对时间）
+    struct timespec timeout;
+    clock_gettime(CLOCK_REALTIME, &timeout);
+    timeout.tv_sec += 3;
+
+    drainEvents();
+    while (!slot.prepared)
+    {
+        if (slot.failed)
+            return PREPARE_FAILED;
+
+        if (_threadExitFlag)
+            return PREPARE_CANCELED;
+
+        if (id != 0 && isSuperseded(id))
+            return PREPARE_CANCELED;
+
+        if (id == 0)
+        {
+            pthread_mutex_lock(&_reqMutex);
+            bool busy = !_reqQueue.empty() || _completePending;
+            pthread_mutex_unlock(&_reqMutex);
+            if (busy)
+                return PREPARE_CANCELED;
+        }
+
+        if (sem_timedwait(&_sem, &timeout) != 0 && errno == ETIMEDOUT)
+        {
+            drainEvents();
+            return slot.prepared ? PREPARE_OK : PREPARE_TIMEOUT;
+        }
+        drainEvents();
+    }
+
+    return PREPARE_OK;
+}
+
+/**
+ * @brief 记录一次切换的间隙
+ */
+void MediaPlayer::recordSwitch(bool prerollHit, uint32_t gapUs)
+{
+    pthread_mutex_lock(&_reqMutex);
+    _switchStats.switchCount++;
+    if (prerollHit)
+        _switchStats.prerollHits++;
+    else
+        _switchStats.prerollMiss++;
+    _switchStats.lastGapUs = gapUs;
+    if (gapUs > _switchStats.maxGapUs)
+        _switchStats.maxGapUs = gapUs;
+    _switchStats.totalGapUs += gapUs;
+    pthread_mutex_unlock(&_reqMutex);
+}
+
+/**
+ * @brief 把循环、音量和播放速度应用到刚换入或刚准备好的实例，只在播放器线程中调用，调用者持有_playerMutex
+ * @param defaultVolume 用户没有设置过音量时使用的音量，-1为不修改
+ */
+void MediaPlayer::applyState(TPlayer *player, int defaultVolume)
+{
+    pthread_mutex_lock(&_reqMutex);
+    // 有播放列表时不循环，播放结束后切换到下一个
+    bool loop = _playlist.size() <= 1;
+    int volume = _volume >= 0 ? _volume : defaultVolume;
+    TplayerPlaySpeedType speed = _speed;
+    pthread_mutex_unlock(&_reqMutex);
+
+    // 不保留最后一帧
+    TPlayerSetHoldLastPicture(player, 0);
+    TPlayerSetLooping(player, loop);
+    if (volume >= 0)
+        TPlayerSetVolume(player, volume);
+    // 新准备的实例默认为正常速度
+    if (speed != PLAY_SPEED_1)
+        TPlayerSetSpeed(player, speed);
+}
+
+/**
+ * @brief 若某个备用实例已准备好请求的视频，直接换成活动实例
+ * @retval true 已换入 / false 没有可用的备用实例
+ */
+bool MediaPlayer::swapToStandby(OpenRequest &req, PrepareTimings &timings)
+{
+    int standby = -1;
+
+    for (int i = 0; i < 1 + MEDIAPLAYER_PREROLL_MAX; i++)
+    {
+        if (i != _active && _slots[i].player != nullptr && _slots[i].prepared && _slots[i].url == req.url)
+        {
+            standby = i;
+            break;
+        }
+    }
+    if (standby < 0)
+        return false;
+
+    // UI线程的Start/Pause/SeekTo等都在锁内使用mTPlayer，换实例期间不能插进来
+    pthread_mutex_lock(&_playerMutex);
+    TPlayer *old = mTPlayer;
+    int volume = TPlayerGetVolume(old);
+
+    // 先暂停旧实例，换入后立即开始播放
+    TPlayerPause(old);
+    _slots[_active].prepared = false;
+    _slots[_active].url.clear();
+
+    _active = standby;
+    _slots[_active].preparing = false;
+    mTPlayer = _slots[_active].player;
+    pthread_mutex_lock(&_reqMutex);
+    _sourceUrl = req.url;
+    pthread_mutex_unlock(&_reqMutex);
+
+    // 备用实例是按默认状态准备的，换入后补上当前的循环、音量和速度
+    applyState(mTPlayer, volume);
+    applyDisplayRect(_slots[_active]);
+    _prepareFinishFlag = true;
+    pthread_mutex_unlock(&_playerMutex);
+
+    if (req.autoStart)
+        Start();
+
+    printf("[Player] swapped in pre-rolled player, url=%s\n", _sourceUrl.c_str());
+
+    // 旧实例已不再是mTPlayer，UI线程不会再用到，在锁外复位释放解码资源
+    TPlayerReset(old);
+
+    return true;
+}
+
+/**
+ * @brief 在活动实例上执行打开：复位 -> 设置路径 -> 解析头部信息，并记录各阶段耗时
+ */
+MediaPlayer::PrepareResult MediaPlayer::openOnActive(OpenRequest &req, PrepareTimings &timings)
+{
+    PrepareResult result = PREPARE_OK;
+    uint64_t t0, t1;
+
+    // 先让UI线程的播放控制失效，准备期间只有播放器线程使用活动实例
+    pthread_mutex_lock(&_playerMutex);
     _prepareFinishFlag = false;
-    _sourceUrl = url;
+    pthread_mutex_unlock(&_playerMutex);
 
-    // 复位播放器
+    pthread_mutex_lock(&_reqMutex);
+    _sourceUrl = req.url;
+    pthread_mutex_unlock(&_reqMutex);
+    _slots[_active].url = req.url;
+    updateSnapshot([](PlaybackSnapshot &snap)
+                   {
+                       snap.prepared = false;
+                       snap.playing = false;
+                       snap.buffering = false;
+                       snap.positionMs = 0;
+                   });
+    _slots[_active].prepared = false;
+    _slots[_active].failed = false;
+
+    // 复位播放器，SetLoop/SetRotate等不检查准备标志的调用仍可能同时到来，复位到开始准备期间持锁
+    pthread_mutex_lock(&_playerMutex);
+    t0 = tick_get_us();
     TPlayerReset(mTPlayer);
+    t1 = tick_get_us();
+    timings.resetUs = t1 - t0;
 
     // 设置播放文件路径url
+    t0 = t1;
     if (TPlayerSetDataSource(mTPlayer, _sourceUrl.c_str(), NULL) != 0)
     {
         printf("[Player] TPlayerSetDataSource() return fail.\n");
-        return false;
+        result = PREPARE_FAILED;
     }
     else
     {
         printf("[Player] setDataSource end.\n");
     }
+    t1 = tick_get_us();
+    timings.setSourceUs = t1 - t0;
 
     // 解析头部信息
-    if (TPlayerPrepareAsync(mTPlayer) != 0)
+    t0 = t1;
+    if (result == PREPARE_OK && TPlayerPrepareAsync(mTPlayer) != 0)
     {
         printf("[Player] TPlayerPrepareAsync() return fail.\n");
-        return false;
+        result = PREPARE_FAILED;
     }
-    else
+    pthread_mutex_unlock(&_playerMutex);
+    if (result == PREPARE_OK)
     {
         printf("[Player] preparing...\n");
+        result = waitPrepared(_slots[_active], req.id);
     }
+    t1 = tick_get_us();
+    timings.prepareUs = t1 - t0;
 
-    // 等待信号量，超时时间 3s
-    struct timespec timeout = {.tv_sec = 3, .tv_nsec = 0};
-    int ret = sem_timedwait(&_sem, &timeout);
-    if (ret != 0)
+    switch (result)
     {
+    case PREPARE_OK:
+        printf("[Player] prepared successfully!\n");
+        pthread_mutex_lock(&_playerMutex);
+        applyState(mTPlayer, -1);
+        _prepareFinishFlag = true;
+        pthread_mutex_unlock(&_playerMutex);
+
+        if (req.autoStart && !isSuperseded(req.id))
+            Start();
+        break;
+    case PREPARE_CANCELED:
+        printf("[Player] prepare canceled, url=%s\n", _sourceUrl.c_str());
+        _slots[_active].url.clear();
+        break;
+    default:
         printf("[Player] MediaPlayer prepare failed, url=%s\n", _sourceUrl.c_str());
+        _slots[_active].url.clear();
+        break;
+    }
+
+    return result;
+}
+
+/**
+ * @brief 执行一次打开请求，优先换入已预加载的备用实例
+ */
+void MediaPlayer::processOpen(OpenRequest &req)
+{
+    PrepareTimings timings = {0};
+    PrepareResult result = PREPARE_OK;
+    bool prerollHit;
+
+    // 还没开始执行就被新请求取代，直接回调取消
+    if (isSuperseded(req.id))
+    {
+        if (req.doneCb)
+            req.doneCb(req.id, PREPARE_CANCELED, timings);
+        return;
+    }
+
+    // 记录在播放列表中的位置，预加载据此决定下一个视频
+    pthread_mutex_lock(&_reqMutex);
+    for (int i = 0; i < (int)_playlist.size(); i++)
+    {
+        if (_playlist[i] == req.url)
+        {
+            _playlistIndex = i;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&_reqMutex);
+
+    // 命中预加载时跳过复位与准备
+    prerollHit = swapToStandby(req, timings);
+    if (!prerollHit)
+        result = openOnActive(req, timings);
+
+    // 新视频（或失败后的空状态）立即发布一次快照
+    sampleSnapshot();
+
+    timings.totalUs = tick_get_us() - req.enqueueUs;
+    printf("[Player] open timings: reset=%uus, setSource=%uus, prepare=%uus, total=%uus\n",
+           timings.resetUs, timings.setSourceUs, timings.prepareUs, timings.totalUs);
+
+    if (result == PREPARE_OK && req.autoStart)
+        recordSwitch(prerollHit, timings.totalUs);
+
+    pthread_mutex_lock(&_reqMutex);
+    _lastTimings = timings;
+    pthread_mutex_unlock(&_reqMutex);
+
+    if (req.doneCb)
+        req.doneCb(req.id, result, timings);
+}
+
+/**
+ * @brief 预加载失败的文件是否应继续跳过：大小和修改时间都没变就跳过，每隔一段时间才重新检查
+ */
+bool MediaPlayer::prerollFailed(const std::string &url)
+{
+    for (auto it = _prerollFailed.begin(); it != _prerollFailed.end(); ++it)
+    {
+        if (it->url != url)
+            continue;
+
+        uint64_t nowUs = tick_get_us();
+        if (nowUs - it->checkUs < MEDIAPLAYER_PREROLL_RETRY_MS * 1000ULL)
+            return true;
+        it->checkUs = nowUs;
+
+        struct stat st;
+        bool exists = stat(url.c_str(), &st) == 0;
+        if ((!exists && it->size < 0) || (exists && st.st_size == it->size && st.st_mtime == it->mtime))
+            return true;
+
+        // 文件被替换过，重新尝试
+        _prerollFailed.erase(it);
         return false;
     }
-    else
+
+    return false;
+}
+
+/**
+ * @brief 检查正在准备的备用实例：准备完成、出错或超时时结束这次预加载
+ * @retval true 已结束 / false 还在准备
+ */
+bool MediaPlayer::finishPreroll(PlayerSlot &slot)
+{
+    uint32_t us = tick_get_us() - slot.prepareStartUs;
+
+    if (slot.prepared)
     {
-        printf("[Player] prepared successfully!\n");
+        slot.preparing = false;
+        slot.rssKb += getRssKb() - slot.rssStartKb;
+        pthread_mutex_lock(&_reqMutex);
+        _switchStats.standbyRssKb = 0;
+        for (auto &s : _slots)
+            _switchStats.standbyRssKb += (&s != &_slots[_active]) ? s.rssKb : 0;
+        pthread_mutex_unlock(&_reqMutex);
+
+        printf("[Player] pre-rolled %s in %uus\n", slot.url.c_str(), us);
+        return true;
     }
-    // 不保留最后一帧
-    TPlayerSetHoldLastPicture(mTPlayer, 0);
-    // 循环播放
-    SetLoop(1);
 
+    if (!slot.failed && us < MEDIAPLAYER_PREROLL_TIMEOUT_MS * 1000U)
+        return false;
+
+    // 失败：记下文件的大小和修改时间，文件没变之前不再预加载它
+    PrerollFailure failure;
+    struct stat st;
+    failure.url = slot.url;
+    failure.size = stat(slot.url.c_str(), &st) == 0 ? st.st_size : -1;
+    failure.mtime = failure.size >= 0 ? st.st_mtime : 0;
+    failure.checkUs = tick_get_us();
+    _prerollFailed.push_back(failure);
+
+    printf("[Player] pre-roll %s %s after %uus, skipped until it changes\n", slot.url.c_str(),
+           slot.failed ? "failed" : "timed out", us);
+    TPlayerReset(slot.player);
+    slot.url.clear();
+    slot.preparing = false;
+    slot.prepared = false;
+    slot.failed = false;
     return true;
 }
 
+/**
+ * @brief 按预加载深度创建/销毁备用实例，并为播放列表后续的视频预先准备
+ *
+ * 只发起准备，不等待：备用实例的PREPARED事件唤醒播放器线程后，下一次调用时结束预加载。
+ * 准备失败的文件记录下来，文件没变之前不再尝试。
+ * @retval true 做了一次预加载（可能还有剩余） / false 没有需要做的
+ */
+bool MediaPlayer::prerollStandby(void)
+{
+    std::vector<std::string> wanted;
+    int depth;
+
+    pthread_mutex_lock(&_reqMutex);
+    depth = _prerollDepth;
+    if (_playlist.size() > 1 && _playlistIndex >= 0)
+    {
+        for (int i = 1; i <= depth && i < (int)_playlist.size(); i++)
+            wanted.push_back(_playlist[(_playlistIndex + i) % _playlist.size()]);
+    }
+    pthread_mutex_unlock(&_reqMutex);
+
+    // 销毁多余的备用实例
+    int standbyCnt = 0;
+    for (int i = 0; i < 1 + MEDIAPLAYER_PREROLL_MAX; i++)
+    {
+        if (i == _active || _slots[i].player == nullptr)
+            continue;
+        if (++standbyCnt > depth)
+        {
+            pthread_mutex_lock(&_reqMutex);
+            _switchStats.standbyRssKb -= _slots[i].rssKb;
+            pthread_mutex_unlock(&_reqMutex);
+            destroySlot(_slots[i]);
+        }
+    }
+
+    // 结束已完成、出错或超时的预加载
+    bool finished = false;
+    _prerollPending = false;
+    for (int i = 0; i < 1 + MEDIAPLAYER_PREROLL_MAX; i++)
+    {
+        if (i == _active || !_slots[i].preparing)
+            continue;
+        if (finishPreroll(_slots[i]))
+            finished = true;
+        else
+            _prerollPending = true;
+    }
+    if (finished)
+        return true;
+
+    for (auto &url : wanted)
+    {
+        bool ready = false;
+        PlayerSlot *free = nullptr;
+
+        for (int i = 0; i < 1 + MEDIAPLAYER_PREROLL_MAX; i++)
+        {
+            if (i == _active)
+                continue;
+            PlayerSlot &slot = _slots[i];
+            if (slot.player != nullptr && (slot.prepared || slot.preparing) && slot.url == url)
+            {
+                ready = true;
+                break;
+            }
+        }
+        if (ready || prerollFailed(url))
+            continue;
+
+        // 找一个没有准备任何需要的视频的备用实例，没有则新建
+        for (int i = 0; i < 1 + MEDIAPLAYER_PREROLL_MAX && free == nullptr; i++)
+        {
+            if (i == _active)
+                continue;
+            PlayerSlot &slot = _slots[i];
+            bool needed = false;
+            for (auto &w : wanted)
+                needed |= ((slot.prepared || slot.preparing) && slot.url == w);
+            if (slot.player != nullptr && !needed)
+                free = &slot;
+        }
+        for (int i = 0; i < 1 + MEDIAPLAYER_PREROLL_MAX && free == nullptr; i++)
+        {
+            if (i != _active && _slots[i].player == nullptr)
+            {
+                long rss = getRssKb();
+                if (!createSlot(_slots[i]))
+                    return false;
+                _slots[i].rssKb = getRssKb() - rss;
+                free = &_slots[i];
+            }
+        }
+        if (free == nullptr)
+            return false;
+
+        free->url = url;
+        free->prepared = false;
+        free->failed = false;
+        free->preparing = true;
+        free->prepareStartUs = tick_get_us();
+        free->rssStartKb = getRssKb();
+        TPlayerReset(free->player);
+        if (TPlayerSetDataSource(free->player, url.c_str(), NULL) != 0 ||
+            TPlayerPrepareAsync(free->player) != 0)
+            free->failed = true;
+
+        // 出错的马上记下，否则等PREPARED事件
+        if (!finishPreroll(*free))
+            _prerollPending = true;
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief 设置播放列表，开启预加载时会在后台准备后续的视频
+ */
+void MediaPlayer::SetPlaylist(const std::vector<std::string> &urls)
+{
+    pthread_mutex_lock(&_reqMutex);
+    _playlist = urls;
+    _playlistIndex = -1;
+    for (int i = 0; i < (int)_playlist.size(); i++)
+    {
+        if (_playlist[i] == _sourceUrl)
+        {
+            _playlistIndex = i;
+            break;
+        }
+    }
+    bool loop = _playlist.size() <= 1;
+    pthread_mutex_unlock(&_reqMutex);
+
+    // 正在播放的视频也要按新的播放列表决定是否循环，否则会一直循环下去
+    SetLoop(loop);
+
+    sem_post(&_sem);
+}
+
+/**
+ * @brief 切换到播放列表的下一个视频（已预加载时无需复位与准备）
+ */
+void MediaPlayer::SkipToNext(void)
+{
+    std::string url;
+
+    pthread_mutex_lock(&_reqMutex);
+    if (!_playlist.empty())
+        url = _playlist[(_playlistIndex + 1) % _playlist.size()];
+    pthread_mutex_unlock(&_reqMutex);
+
+    if (!url.empty())
+        OpenAsync(url);
+}
+
+/**
+ * @brief 设置预加载深度
+ * @param depth 同时预先准备的后续视频个数（0 ~ MEDIAPLAYER_PREROLL_MAX），0为关闭
+ */
+void MediaPlayer::SetPrerollDepth(int depth)
+{
+    if (depth < 0)
+        depth = 0;
+    if (depth > MEDIAPLAYER_PREROLL_MAX)
+        depth = MEDIAPLAYER_PREROLL_MAX;
+
+    pthread_mutex_lock(&_reqMutex);
+    _prerollDepth = depth;
+    pthread_mutex_unlock(&_reqMutex);
+
+    sem_post(&_sem);
+}
+
+/**
+ * @brief 获取切换统计
+ */
+MediaPlayer::SwitchStats MediaPlayer::GetSwitchStats(void)
+{
+    pthread_mutex_lock(&_reqMutex);
+    SwitchStats stats = _switchStats;
+    pthread_mutex_unlock(&_reqMutex);
+
+    return stats;
+}
+
+static int probeNotify(void *pUserData, int msg, int param0, void *param1)
+{
+    return 0;
+}
+
+/**
+ * @brief 同步探测视频元数据（时长、分辨率、编码），使用临时的TPlayer实例，可在任意线程调用
+ * @param url 视频路径
+ * @retval true 成功 / false 无法解析
+ */
+bool MediaPlayer::Probe(const std::string &url, int &durationMs, int &width, int &height, int &codec)
+{
+    TPlayer *player = TPlayerCreate(CEDARX_PLAYER);
+    if (player == NULL)
+        return false;
+
+    bool ok = false;
+    TPlayerSetNotifyCallback(player, probeNotify, NULL);
+    if (TPlayerSetDataSource(player, url.c_str(), NULL) == 0 && TPlayerPrepare(player) == 0)
+    {
+        MediaInfo *info = TPlayerGetMediaInfo(player);
+        if (info != NULL)
+        {
+            durationMs = info->nDurationMs;
+            width = height = codec = 0;
+            if (info->nVideoStreamNum > 0 && info->pVideoStreamInfo != NULL)
+            {
+                width = info->pVideoStreamInfo[0].nWidth;
+                height = info->pVideoStreamInfo[0].nHeight;
+                codec = info->pVideoStreamInfo[0].eCodecFormat;
+            }
+            ok = true;
+        }
+    }
+
+    TPlayerReset(player);
+    TPlayerDestroy(player);
+
+    if (!ok)
+        printf("[MediaPlayer] probe %s failed\n", url.c_str());
+
+    return ok;
+}
+
+/**
+ * @brief 修改并重新发布快照（任意线程）
+ */
+void MediaPlayer::updateSnapshot(const std::function<void(PlaybackSnapshot &snap)> &modify)
+{
+    pthread_mutex_lock(&_snapMutex);
+    PlaybackSnapshot snap = _snapshot.Read();
+    modify(snap);
+    _snapshot.Write(snap);
+    pthread_mutex_unlock(&_snapMutex);
+}
+
+/**
+ * @brief 从TPlayer采样并发布快照，只在播放器线程中调用
+ */
+void MediaPlayer::sampleSnapshot(void)
+{
+    int pos = 0, duration = 3000, volume = 0;
+    bool playing = false;
+
+    pthread_mutex_lock(&_playerMutex);
+    bool prepared = _prepareFinishFlag;
+    if (prepared)
+    {
+        TPlayerGetCurrentPosition(mTPlayer, &pos);
+        TPlayerGetDuration(mTPlayer, &duration);
+        volume = TPlayerGetVolume(mTPlayer);
+        playing = TPlayerIsPlaying(mTPlayer);
+    }
+    pthread_mutex_unlock(&_playerMutex);
+
+    uint64_t nowUs = tick_get_us();
+    updateSnapshot([&](PlaybackSnapshot &snap)
+                   {
+                       snap.positionMs = pos;
+                       snap.durationMs = duration;
+                       snap.volume = volume;
+                       snap.prepared = prepared;
+                       snap.playing = playing;
+                       snap.sampleUs = nowUs;
+                   });
+}
+
+/**
+ * @brief 根据单调时钟从上次采样推算当前播放时间点
+ */
+int MediaPlayer::interpolatePos(const PlaybackSnapshot &snap, uint64_t nowUs)
+{
+    // 与TplayerPlaySpeedType一一对应
+    static const int speedFactor[] = {16, 8, 4, 2, 1, -2, -4, -8, -16};
+
+    if (!snap.playing || snap.buffering || nowUs <= snap.sampleUs)
+        return snap.positionMs;
+
+    int factor = 1;
+    if (snap.speed >= 0 && snap.speed < (int)(sizeof(speedFactor) / sizeof(speedFactor[0])))
+        factor = speedFactor[snap.speed];
+
+    int64_t pos = snap.positionMs + (int64_t)(nowUs - snap.sampleUs) * factor / 1000;
+    if (pos < 0)
+        pos = 0;
+    if (pos > snap.durationMs)
+        pos = snap.durationMs;
+
+    return (int)pos;
+}
+
 /**
  * @brief 开始播放
  */
 void MediaPlayer::Start(void)
 {
+    pthread_mutex_lock(&_playerMutex);
     if (_prepareFinishFlag != false)
+    {
         TPlayerStart(mTPlayer);
+
+        uint64_t nowUs = tick_get_us();
+        updateSnapshot([&](PlaybackSnapshot &snap)
+                       {
+                           snap.positionMs = interpolatePos(snap, nowUs);
+                           snap.playing = true;
+                           snap.sampleUs = nowUs;
+                       });
+        // 唤醒播放器线程开始定时采样
+        sem_post(&_sem);
+    }
+    pthread_mutex_unlock(&_playerMutex);
 }
 
 /**
@@ -118,32 +1000,62 @@ void MediaPlayer::Start(void)
  */
 void MediaPlayer::Pause(void)
 {
+    pthread_mutex_lock(&_playerMutex);
     if (_prepareFinishFlag != false)
+    {
         TPlayerPause(mTPlayer);
+
+        uint64_t nowUs = tick_get_us();
+        updateSnapshot([&](PlaybackSnapshot &snap)
+                       {
+                           snap.positionMs = interpolatePos(snap, nowUs);
+                           snap.playing = false;
+                           snap.sampleUs = nowUs;
+                       });
+    }
+    pthread_mutex_unlock(&_playerMutex);
 }
 
 /**
  * @brief 设置播放时间点
  * @param seekMs 播放时间点 ms
+ * @param snapped seekMs是否已对齐到关键帧（只用于分开统计跳转延迟）
  */
-void MediaPlayer::SetCurrentPos(int seekMs)
+void MediaPlayer::SetCurrentPos(int seekMs, bool snapped)
 {
+    pthread_mutex_lock(&_playerMutex);
     if (_prepareFinishFlag != false)
+    {
+        pthread_mutex_lock(&_reqMutex);
+        _seekStartUs = tick_get_us();
+        _seekSnapped = snapped;
+        pthread_mutex_unlock(&_reqMutex);
+        _slots[_active].seekPending = true;
+
         TPlayerSeekTo(mTPlayer, seekMs);
+
+        uint64_t nowUs = tick_get_us();
+        updateSnapshot([&](PlaybackSnapshot &snap)
+                       {
+                           snap.positionMs = seekMs;
+                           snap.sampleUs = nowUs;
+                       });
+    }
+    pthread_mutex_unlock(&_playerMutex);
 }
 
 /**
- * @brief 获取当前播放时间点
+ * @brief 获取当前播放时间点（读快照并按单调时钟插值，不调用TPlayer）
  * @retval 当前播放的时间点（ms）
  */
 int MediaPlayer::GetCurrentPos(void)
 {
-    int ms = 0;
+    PlaybackSnapshot snap = _snapshot.Read();
 
-    if (_prepareFinishFlag != false)
-        TPlayerGetCurrentPosition(mTPlayer, &ms);
+    if (!snap.prepared)
+        return 0;
 
-    return ms;
+    return interpolatePos(snap, tick_get_us());
 }
 
 /**
@@ -152,12 +1064,9 @@ int MediaPlayer::GetCurrentPos(void)
  */
 int MediaPlayer::GetDuration(void)
 {
-    int ms = 3000;
-
-    if (_prepareFinishFlag != false)
-        TPlayerGetDuration(mTPlayer, &ms);
+    PlaybackSnapshot snap = _snapshot.Read();
 
-    return ms;
+    return snap.prepared ? snap.durationMs : 3000;
 }
 
 /**
@@ -166,14 +1075,11 @@ int MediaPlayer::GetDuration(void)
  */
 int MediaPlayer::GetVolume(void)
 {
-    int volume = 0;
-
-    if (_prepareFinishFlag != false)
-        volume = TPlayerGetVolume(mTPlayer);
+    PlaybackSnapshot snap = _snapshot.Read();
 
     // printf("[MediaPlayer] getVolume: %d\n", volume);
 
-    return volume;
+    return snap.prepared ? snap.volume : 0;
 }
 
 /**
@@ -182,8 +1088,18 @@ int MediaPlayer::GetVolume(void)
  */
 void MediaPlayer::SetVolume(int volume)
 {
+    pthread_mutex_lock(&_reqMutex);
+    _volume = volume;
+    pthread_mutex_unlock(&_reqMutex);
+
+    pthread_mutex_lock(&_playerMutex);
     if (_prepareFinishFlag != false)
+    {
         TPlayerSetVolume(mTPlayer, volume);
+        updateSnapshot([&](PlaybackSnapshot &snap)
+                       { snap.volume = volume; });
+    }
+    pthread_mutex_unlock(&_playerMutex);
 
     // printf("[MediaPlayer] setVolume: %d\n", volume);
 }
@@ -195,11 +1111,9 @@ void MediaPlayer::SetVolume(int volume)
  */
 bool MediaPlayer::GetState(void)
 {
-    bool state = false;
-    if (_prepareFinishFlag != false)
-        state = TPlayerIsPlaying(mTPlayer);
+    PlaybackSnapshot snap = _snapshot.Read();
 
-    return state;
+    return snap.prepared && snap.playing;
 }
 
 /**
@@ -212,15 +1126,17 @@ bool MediaPlayer::GetState(void)
  */
 bool MediaPlayer::SetDisplayArea(int x, int y, unsigned int width, unsigned int height)
 {
+    bool ret = false;
+
+    pthread_mutex_lock(&_playerMutex);
     if (_prepareFinishFlag != false)
     {
         TPlayerSetDisplayRect(mTPlayer, x, y, width, height);
-        return true;
-    }
-    else
-    {
-        return false;
+        ret = true;
     }
+    pthread_mutex_unlock(&_playerMutex);
+
+    return ret;
 }
 
 /**
@@ -229,7 +1145,9 @@ bool MediaPlayer::SetDisplayArea(int x, int y, unsigned int width, unsigned int
  */
 void MediaPlayer::SetLoop(bool isLoop)
 {
+    pthread_mutex_lock(&_playerMutex);
     TPlayerSetLooping(mTPlayer, isLoop);
+    pthread_mutex_unlock(&_playerMutex);
 }
 
 /**
@@ -238,15 +1156,23 @@ void MediaPlayer::SetLoop(bool isLoop)
  */
 bool MediaPlayer::SetRotate(TplayerVideoRotateType rotateDegree)
 {
-    bool state = false;
-    if (TPlayerSetRotate(mTPlayer, rotateDegree) == 0)
-    {
-        return true;
-    }
-    else
-    {
-        return false;
-    }
+    pthread_mutex_lock(&_playerMutex);
+    bool state = (TPlayerSetRotate(mTPlayer, rotateDegree) == 0);
+    pthread_mutex_unlock(&_playerMutex);
+
+    return state;
+}
+
+/**
+ * @brief 获取当前视频的媒体信息
+ */
+MediaInfo *MediaPlayer::GetMediaInfo(void)
+{
+    pthread_mutex_lock(&_playerMutex);
+    MediaInfo *info = TPlayerGetMediaInfo(mTPlayer);
+    pthread_mutex_unlock(&_playerMutex);
+
+    return info;
 }
 
 /**
@@ -255,17 +1181,58 @@ bool MediaPlayer::SetRotate(TplayerVideoRotateType rotateDegree)
  */
 bool MediaPlayer::SetFullScreen(bool isFullScreen)
 {
+    pthread_mutex_lock(&_playerMutex);
     _fullScreenFlag = isFullScreen;
+    // 还没收到解码尺寸时，在EVENT_VIDEO_SIZE里按新的模式设置
+    if (_prepareFinishFlag)
+        applyDisplayRect(_slots[_active]);
+    pthread_mutex_unlock(&_playerMutex);
 
-    fullScreenState = isFullScreen;
-
-    printf("[MediaPlayer] SetFullScreen: %d\n", (int)fullScreenState);
+    printf("[MediaPlayer] SetFullScreen: %d\n", (int)isFullScreen);
     return true;
 }
 
 bool MediaPlayer::GetFullScreen(void)
 {
-    return _fullScreenFlag;
+    pthread_mutex_lock(&_playerMutex);
+    bool isFullScreen = _fullScreenFlag;
+    pthread_mutex_unlock(&_playerMutex);
+
+    return isFullScreen;
+}
+
+/**
+ * @brief 按全屏标志和解码尺寸设置实例的显示区域，调用者持有_playerMutex
+ *
+ * 全屏铺满屏幕；否则保持宽高比缩小到屏幕内（不放大）并居中
+ */
+void MediaPlayer::applyDisplayRect(PlayerSlot &slot)
+{
+    int w = slot.videoWidth;
+    int h = slot.videoHeight;
+
+    if (slot.player == nullptr || w <= 0 || h <= 0)
+        return;
+
+    if (_fullScreenFlag)
+    {
+        TPlayerSetDisplayRect(slot.player, 0, 0, LCD_WIDTH, LCD_HEIGHT);
+        printf("[Player] display rect: full screen %dx%d\n", (int)LCD_WIDTH, (int)LCD_HEIGHT);
+        return;
+    }
+
+    float scaleX = LCD_WIDTH / w;
+    float scaleY = LCD_HEIGHT / h;
+    float scale = scaleX < scaleY ? scaleX : scaleY;
+    if (scale < 1.0f)
+    {
+        w = w * scale;
+        h = h * scale;
+    }
+    int x = (LCD_WIDTH - w) / 2;
+    int y = (LCD_HEIGHT - h) / 2;
+    TPlayerSetDisplayRect(slot.player, x, y, w, h);
+    printf("[Player] display rect: x = %d, y = %d, w = %d, h = %d\n", x, y, w, h);
 }
 
 /**
@@ -286,52 +1253,59 @@ bool MediaPlayer::GetFullScreen(void)
 // } TplayerPlaySpeedType;
 bool MediaPlayer::SetSpeed(TplayerPlaySpeedType speed)
 {
-    bool state = false;
-    if (TPlayerSetSpeed(mTPlayer, speed) == 0)
-    {
-        return true;
-    }
-    else
+    pthread_mutex_lock(&_playerMutex);
+    bool state = (TPlayerSetSpeed(mTPlayer, speed) == 0);
+    if (state)
     {
+        // 之后换入或新打开的视频沿用这个速度
+        pthread_mutex_lock(&_reqMutex);
+        _speed = speed;
+        pthread_mutex_unlock(&_reqMutex);
 
-        return false;
+        uint64_t nowUs = tick_get_us();
+        updateSnapshot([&](PlaybackSnapshot &snap)
+                       {
+                           snap.positionMs = interpolatePos(snap, nowUs);
+                           snap.speed = speed;
+                           snap.sampleUs = nowUs;
+                       });
     }
+    pthread_mutex_unlock(&_playerMutex);
+
+    return state;
 }
 
 /**
- * @brief  TPlayer消息回调函数
- * @param pUserData 用户数据，设置回调函数时传入
- * @param msg       消息类型
- * @param param0 参赛0
- * @param param1 参数1
+ * @brief 在播放器线程中处理一个事件（原来在解码器回调里做的事情）
  */
-int CallbackForTPlayer(void *pUserData, int msg, int param0, void *param1)
+void MediaPlayer::handleEvent(PlayerSlot &slot, const PlayerEvent &event)
 {
-    MediaPlayer *player = static_cast<MediaPlayer *>(pUserData);
-
-    switch (msg)
+    switch (event.type)
     {
-    case TPLAYER_NOTIFY_PREPARED:
+    case PlayerEvent::EVENT_PREPARED:
     {
-        // 发送信号量
         printf("[PlayerCb] TPLAYER_NOTIFY_PREPARED\n");
-        sem_post(&player->_sem);
-        player->_prepareFinishFlag = true;
+        slot.prepared = true;
         break;
     }
-    case TPLAYER_NOTIFY_PLAYBACK_COMPLETE:
+    case PlayerEvent::EVENT_PLAYBACK_COMPLETE:
     {
         printf("[PlayerCb] TPLAYER_NOTIFY_PLAYBACK_COMPLETE\n");
+        // 只有活动实例的播放结束才需要切换到下一个
+        if (event.active)
+            _completePending = true;
         break;
     }
-    case TPLAYER_NOTIFY_SEEK_COMPLETE:
+    case PlayerEvent::EVENT_SEEK_COMPLETE:
     {
         printf("[PlayerCb] TPLAYER_NOTIFY_SEEK_COMPLETE\n");
+        if (event.active)
+            sampleSnapshot();
         break;
     }
-    case TPLAYER_NOTIFY_MEDIA_ERROR:
+    case PlayerEvent::EVENT_MEDIA_ERROR:
     {
-        switch (param0)
+        switch (event.param0)
         {
         case TPLAYER_MEDIA_ERROR_UNKNOWN:
         {
@@ -350,76 +1324,214 @@ int CallbackForTPlayer(void *pUserData, int msg, int param0, void *param1)
         }
         }
         printf("[PlayerCb] error: open media source fail.\n");
+        // 正在等待准备的请求据此提前结束
+        slot.failed = true;
         break;
     }
-    case TPLAYER_NOTIFY_NOT_SEEKABLE:
+    case PlayerEvent::EVENT_NOT_SEEKABLE:
     {
         printf("[PlayerCb] TPLAYER_NOTIFY_NOT_SEEKABLE\n");
         break;
     }
-    case TPLAYER_NOTIFY_BUFFER_START:
+    case PlayerEvent::EVENT_BUFFER_START:
     {
         printf("[PlayerCb] TPLAYER_NOTIFY_BUFFER_START\n");
+        if (event.active)
+            updateSnapshot([](PlaybackSnapshot &snap)
+                           { snap.buffering = true; });
         break;
     }
-    case TPLAYER_NOTIFY_BUFFER_END:
+    case PlayerEvent::EVENT_BUFFER_END:
     {
         printf("[PlayerCb] TPLAYER_NOTIFY_BUFFER_END\n");
+        if (event.active)
+        {
+            updateSnapshot([](PlaybackSnapshot &snap)
+                           { snap.buffering = false; });
+            sampleSnapshot();
+        }
         break;
     }
-    case TPLAYER_NOTIFY_VIDEO_FRAME:
+    case PlayerEvent::EVENT_FIRST_FRAME:
     {
-        /* printf("get the decoded video frame\n"); */
+        if (!event.active)
+            break;
+
+        pthread_mutex_lock(&_reqMutex);
+        int i = _seekSnapped ? 1 : 0;
+        uint32_t latencyUs = event.timestampUs - _seekStartUs;
+        _seekStats.count[i]++;
+        _seekStats.lastUs[i] = latencyUs;
+        if (latencyUs > _seekStats.maxUs[i])
+            _seekStats.maxUs[i] = latencyUs;
+        _seekStats.totalUs[i] += latencyUs;
+        pthread_mutex_unlock(&_reqMutex);
+
+        printf("[Player] seek -> first frame %uus (%s)\n", latencyUs, i ? "keyframe" : "no index");
         break;
     }
-    case TPLAYER_NOTIFY_AUDIO_FRAME:
+    case PlayerEvent::EVENT_VIDEO_SIZE:
     {
-        /* printf("get the decoded audio frame\n"); */
+        printf("[PlayerCb] tplayerdemo: video decoded width = %d, height = %d\n", event.width, event.height);
+
+        // 记下尺寸，切换全屏时据此重新计算显示区域
+        pthread_mutex_lock(&_playerMutex);
+        slot.videoWidth = event.width;
+        slot.videoHeight = event.height;
+        applyDisplayRect(slot);
+        pthread_mutex_unlock(&_playerMutex);
+
         break;
     }
-    case TPLAYER_NOTIFY_SUBTITLE_FRAME:
+
+    default:
     {
-        /* printf("get the decoded subtitle frame\n"); */
+        printf("[PlayerCb] warning: unknown callback from Tinaplayer.\n");
         break;
     }
-    case TPLAYER_NOTYFY_DECODED_VIDEO_SIZE:
-    {
-        // TODO: full screen display
+    }
+}
 
-        printf("[PlayerCb] ChangeState = %d\n", (int)fullScreenState);
+/**
+ * @brief 取出所有实例的事件并处理，只在播放器线程中调用
+ */
+void MediaPlayer::drainEvents(void)
+{
+    PlayerEvent event;
+    EventCb eventCb;
 
-        int w, h, y;
-        w = ((int *)param1)[0]; // real decoded video width
-        h = ((int *)param1)[1]; // real decoded video height
-        printf("[PlayerCb] tplayerdemo: video decoded width = %d, height = %d\n", w, h);
+    pthread_mutex_lock(&_reqMutex);
+    eventCb = _eventCb;
+    pthread_mutex_unlock(&_reqMutex);
 
-        if (fullScreenState == false)
-        {
-            float divider = 1;
-            if (w > LCD_WIDTH)
-            {
-                divider = w / LCD_WIDTH;
-            }
-            w = w / divider;
-            h = h / divider;
-            y = (LCD_WIDTH - h) / 2;
-            printf("[PlayerCb] real set to display rect: w = %d, h = %d\n", w, h);
-            player->SetDisplayArea(0, y, w, h);
-        }
-        else
+    for (int i = 0; i < 1 + MEDIAPLAYER_PREROLL_MAX; i++)
+    {
+        PlayerSlot &slot = _slots[i];
+
+        while (slot.events.Pop(event))
         {
-            player->SetDisplayArea(0, 0, 480, 480);
-        }
+            uint32_t latencyUs = tick_get_us() - event.timestampUs;
 
-        break;
+            event.active = (i == _active);
+            handleEvent(slot, event);
+
+            pthread_mutex_lock(&_reqMutex);
+            _eventStats.count++;
+            _eventStats.dropped += slot.dropped.exchange(0);
+            _eventStats.lastLatencyUs = latencyUs;
+            if (latencyUs > _eventStats.maxLatencyUs)
+                _eventStats.maxLatencyUs = latencyUs;
+            _eventStats.totalLatencyUs += latencyUs;
+            pthread_mutex_unlock(&_reqMutex);
+
+            if (eventCb)
+                eventCb(event);
+        }
     }
+}
 
-    default:
+/**
+ * @brief 设置事件监听者，回调在播放器线程中执行
+ */
+void MediaPlayer::SetEventListener(EventCb eventCb)
+{
+    pthread_mutex_lock(&_reqMutex);
+    _eventCb = eventCb;
+    pthread_mutex_unlock(&_reqMutex);
+}
+
+/**
+ * @brief 获取事件队列统计
+ */
+MediaPlayer::EventStats MediaPlayer::GetEventStats(void)
+{
+    pthread_mutex_lock(&_reqMutex);
+    EventStats stats = _eventStats;
+    pthread_mutex_unlock(&_reqMutex);
+
+    return stats;
+}
+
+/**
+ * @brief 获取跳转 -> 第一帧的延迟统计，对比有无关键帧索引
+ */
+MediaPlayer::SeekStats MediaPlayer::GetSeekStats(void)
+{
+    pthread_mutex_lock(&_reqMutex);
+    SeekStats stats = _seekStats;
+    pthread_mutex_unlock(&_reqMutex);
+
+    return stats;
+}
+
+/**
+ * @brief  TPlayer消息回调函数，运行在CedarX的内部线程：准备/跳转/播放结束来自消息线程，
+ *         视频帧来自渲染线程，解码尺寸来自解码线程，可能同时调用
+ *         只把消息转换成事件放入多生产者无锁队列并唤醒播放器线程，不做打印和其他耗时操作
+ * @param pUserData 用户数据，设置回调函数时传入
+ * @param msg       消息类型
+ * @param param0 参赛0
+ * @param param1 参数1
+ */
+int CallbackForTPlayer(void *pUserData, int msg, int param0, void *param1)
+{
+    MediaPlayer::PlayerSlot *slot = static_cast<MediaPlayer::PlayerSlot *>(pUserData);
+    MediaPlayer::PlayerEvent event;
+
+    event.active = false;
+    event.param0 = param0;
+    event.width = 0;
+    event.height = 0;
+
+    switch (msg)
     {
-        printf("[PlayerCb] warning: unknown callback from Tinaplayer.\n");
+    case TPLAYER_NOTIFY_PREPARED:
+        event.type = MediaPlayer::PlayerEvent::EVENT_PREPARED;
+        break;
+    case TPLAYER_NOTIFY_PLAYBACK_COMPLETE:
+        event.type = MediaPlayer::PlayerEvent::EVENT_PLAYBACK_COMPLETE;
+        break;
+    case TPLAYER_NOTIFY_SEEK_COMPLETE:
+        event.type = MediaPlayer::PlayerEvent::EVENT_SEEK_COMPLETE;
+        break;
+    case TPLAYER_NOTIFY_MEDIA_ERROR:
+        event.type = MediaPlayer::PlayerEvent::EVENT_MEDIA_ERROR;
+        break;
+    case TPLAYER_NOTIFY_NOT_SEEKABLE:
+        event.type = MediaPlayer::PlayerEvent::EVENT_NOT_SEEKABLE;
+        break;
+    case TPLAYER_NOTIFY_BUFFER_START:
+        event.type = MediaPlayer::PlayerEvent::EVENT_BUFFER_START;
+        break;
+    case TPLAYER_NOTIFY_BUFFER_END:
+        event.type = MediaPlayer::PlayerEvent::EVENT_BUFFER_END;
+        break;
+    case TPLAYER_NOTIFY_VIDEO_FRAME:
+        /* 只关心跳转后的第一帧，用来统计跳转延迟 */
+        if (!slot->seekPending.load(std::memory_order_relaxed) || !slot->seekPending.exchange(false))
+            return 0;
+        event.type = MediaPlayer::PlayerEvent::EVENT_FIRST_FRAME;
+        break;
+    case TPLAYER_NOTIFY_AUDIO_FRAME:
+    case TPLAYER_NOTIFY_SUBTITLE_FRAME:
+        /* 解码帧通知数量很大且不需要处理 */
+        return 0;
+    case TPLAYER_NOTYFY_DECODED_VIDEO_SIZE:
+        event.type = MediaPlayer::PlayerEvent::EVENT_VIDEO_SIZE;
+        event.width = ((int *)param1)[0];  // real decoded video width
+        event.height = ((int *)param1)[1]; // real decoded video height
+        break;
+    default:
+        event.type = MediaPlayer::PlayerEvent::EVENT_UNKNOWN;
         break;
     }
-    }
+
+    event.timestampUs = tick_get_us();
+    if (!slot->events.Push(event))
+        slot->dropped++;
+
+    // sem_post不会阻塞
+    sem_post(&slot->owner->_sem);
 
     return 0;
 }
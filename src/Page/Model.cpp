@@ -1,12 +1,17 @@
 #include "Model.h"
+#include <sys/stat.h>
+#include <errno.h>
 
-#define VIDEO_DIR "/mnt/UDISK/video/"
-#define SD_VIDEO_DIR "/mnt/exUDISK/video/"
+#define VIDEO_DIR UDISK_DIR "video/"
+#define SD_VIDEO_DIR EXUDISK_DIR "video/"
+#define META_CACHE_PATH UDISK_DIR ".media_meta.cache"
+#define THUMB_CACHE_DIR UDISK_DIR ".thumbs/"
+#define KEYFRAME_DIR UDISK_DIR ".media_keyframes/"
 
-using namespace Page;
+/* 没拿到LVGL锁时，隔这么久再请求一次界面刷新 */
+#define MODEL_UPDATE_RETRY_MS 5
 
-/* 支持的视频文件格式 */
-static const char *fileType[] = {".avi", ".mkv", ".flv", ".ts", ".mp4", ".webm", "asf", "mpg", ".mpeg", ".mov", ".vob", ".3gp", ".wmv", ".pmp"};
+using namespace Page;
 
 /**
  * @brief Model构造函数
@@ -16,46 +21,189 @@ static const char *fileType[] = {".avi", ".mkv", ".flv", ".ts", ".mp4", ".webm",
  */
 Model::Model(std::function<void(void)> exitCb, pthread_mutex_t &mutex)
 {
-    _threadExitFlag = false;
     _mutex = &mutex;
+    _mp = nullptr;
+    _timer = nullptr;
+    _cmdStats = {0};
+    _library = new MediaLibrary({VIDEO_DIR, SD_VIDEO_DIR}, META_CACHE_PATH);
+    _library->SetProbeCallback([](const std::string &path, MetadataCache::Meta &meta)
+                               {
+        int durationMs, width, height, codec;
+        if (!MediaPlayer::Probe(path, durationMs, width, height, codec))
+            return false;
+        meta.durationMs = durationMs;
+        meta.width = width;
+        meta.height = height;
+        meta.codec = codec;
+        return true; });
+
+    // 缩略图在后台生成；开机就在播放，先暂停预取
+    _thumbs = new ThumbnailCache(new TPlayerFrameSource(), THUMB_CACHE_DIR);
+    _thumbs->SetPaused(true);
+
+    // 条件变量按单调时钟超时，重试界面刷新时不受系统时间调整影响
+    pthread_condattr_t condAttr;
+    pthread_condattr_init(&condAttr);
+    pthread_condattr_setclock(&condAttr, CLOCK_MONOTONIC);
+    pthread_mutex_init(&_cmdMutex, NULL);
+    pthread_cond_init(&_cmdCond, &condAttr);
+    pthread_condattr_destroy(&condAttr);
+    pthread_mutex_init(&_scrubMutex, NULL);
 
     // 设置UI回调函数
+    // 查询类回调直接读取播放器快照；操作类回调只把命令放入队列，由Model线程执行
     Operations uiOpts = {0};
 
     uiOpts.exitCb = exitCb;
     uiOpts.getStateCb = std::bind(&Model::getState, this);
-    uiOpts.pauseCb = std::bind(&Model::pause, this);
-    uiOpts.playCb = std::bind(&Model::play, this, std::placeholders::_1);
-    uiOpts.setCurCb = std::bind(&Model::setCur, this, std::placeholders::_1);
+    uiOpts.pauseCb = std::bind(&Model::pushCommand, this, Command::CMD_PAUSE, 0, (const char *)NULL);
+    uiOpts.playCb = std::bind(&Model::pushCommand, this, Command::CMD_PLAY, 0, std::placeholders::_1);
+    uiOpts.setCurCb = std::bind(&Model::pushCommand, this, Command::CMD_SEEK, std::placeholders::_1, (const char *)NULL);
     uiOpts.getCurCb = std::bind(&Model::getCur, this);
-    uiOpts.setVolumeCb = std::bind(&Model::setVolume, this, std::placeholders::_1);
+    uiOpts.setVolumeCb = std::bind(&Model::pushCommand, this, Command::CMD_SET_VOLUME, std::placeholders::_1, (const char *)NULL);
     uiOpts.getVolumeCb = std::bind(&Model::getVolume, this);
     uiOpts.getDurationCb = std::bind(&Model::getDuration, this);
-    uiOpts.setSpeedCb = std::bind(&Model::setSpeed, this, std::placeholders::_1);
-    uiOpts.setRotateCb = std::bind(&Model::setRotate, this, std::placeholders::_1);
-    uiOpts.setFullScreenCb = std::bind(&Model::setFullScreen, this, std::placeholders::_1);
+    uiOpts.setSpeedCb = std::bind(&Model::pushCommand, this, Command::CMD_SET_SPEED, std::placeholders::_1, (const char *)NULL);
+    uiOpts.setRotateCb = std::bind(&Model::pushCommand, this, Command::CMD_SET_ROTATE, std::placeholders::_1, (const char *)NULL);
+    uiOpts.setFullScreenCb = std::bind(&Model::pushCommand, this, Command::CMD_SET_FULLSCREEN, std::placeholders::_1, (const char *)NULL);
+    uiOpts.scrubCb = std::bind(&Model::scrub, this, std::placeholders::_1, std::placeholders::_2);
+    uiOpts.scrubEndCb = std::bind(&Model::scrubEnd, this, std::placeholders::_1);
+    uiOpts.panelCb = std::bind(&Model::setPanelVisible, this, std::placeholders::_1);
 
      _view.create(uiOpts);
 
+    // 预览帧生成后通知View重新取，不用在拖动时反复查询
+    _thumbs->SetReadyCallback([this](const std::string &name)
+                              { _view.previewReady(); });
+
     // 这里设置一个1000ms的定时器，软定时器，用于在onTimerUpdate里update
+    // 进度条只在底部面板上，面板收起时定时器暂停
     _timer = lv_timer_create(onTimerUpdate, 1000, this);
+    if (_view.ui.isBottomContCollapsed)
+        lv_timer_pause(_timer);
 
     // 创建执行线程，传递this指针
     pthread_create(&_pthread, NULL, threadProcHandler, this);
+
+    // 后台扫描视频目录并监视变化（含U盘/SD卡插拔），每批更新由Model线程刷新播放列表
+    // 未变化的文件直接用缓存的元数据，变化的文件探测完成后会再通知一次
+    _library->StartScan([this](const MediaLibrary::Changes &changes)
+                        { pushCommand(Command::CMD_LIBRARY_UPDATE, changes.added.size() + changes.updated.size() + changes.removed.size()); });
 }
 
 Model::~Model()
 {
-    _threadExitFlag = true;
-
-    // 等待线程退出，回收资源
+    // 通知线程退出，等待线程退出，回收资源
+    pushCommand(Command::CMD_SHUTDOWN);
     pthread_join(_pthread, NULL);
 
+    delete _thumbs;
+    delete _library;
+
+    pthread_cond_destroy(&_cmdCond);
+    pthread_mutex_destroy(&_cmdMutex);
+    pthread_mutex_destroy(&_scrubMutex);
+
     lv_timer_del(_timer);
 
     _view.release();
 }
 
+/**
+ * @brief 把命令放入队列并立即唤醒Model线程，不阻塞调用者
+ *
+ * @param type 命令类型
+ * @param value 命令参数
+ * @param name 视频名（仅CMD_PLAY）
+ */
+void Model::pushCommand(Command::Type type, int value, const char *name)
+{
+    Command cmd;
+
+    cmd.type = type;
+    cmd.value = value;
+    if (name != NULL)
+        cmd.name = name;
+    cmd.enqueueUs = tick_get_us();
+
+    pthread_mutex_lock(&_cmdMutex);
+    // 还没执行的跳转只保留最新的一个
+    if ((type == Command::CMD_SEEK || type == Command::CMD_SCRUB_SEEK) &&
+        !_cmdQueue.empty() && _cmdQueue.back().type == type)
+        _cmdQueue.pop_back();
+    _cmdQueue.push_back(cmd);
+    pthread_cond_signal(&_cmdCond);
+    pthread_mutex_unlock(&_cmdMutex);
+}
+
+/**
+ * @brief 在Model线程中执行一条命令
+ */
+void Model::execute(const Command &cmd)
+{
+    switch (cmd.type)
+    {
+    case Command::CMD_PLAY:
+        play(cmd.name.empty() ? NULL : cmd.name.c_str());
+        break;
+    case Command::CMD_PAUSE:
+        pause();
+        break;
+    case Command::CMD_SEEK:
+        setCur(cmd.value);
+        break;
+    case Command::CMD_SCRUB_SEEK:
+        if (_mp != nullptr)
+            _mp->SetCurrentPos(cmd.value, true);
+        break;
+    case Command::CMD_SET_VOLUME:
+        setVolume(cmd.value);
+        break;
+    case Command::CMD_SET_SPEED:
+        setSpeed(cmd.value);
+        break;
+    case Command::CMD_SET_ROTATE:
+        setRotate(cmd.value);
+        break;
+    case Command::CMD_SET_FULLSCREEN:
+        setFullScreen(cmd.value != 0);
+        break;
+    case Command::CMD_LIBRARY_UPDATE:
+        // 只在Model线程里重建播放列表，LVGL线程不接触媒体库
+        if (_mp != nullptr)
+            _mp->SetPlaylist(_library->GetPlaylist());
+        _thumbs->Prefetch(_library->GetEntries());
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief 获取命令队列统计
+ */
+Model::CommandStats Model::getCommandStats(void)
+{
+    pthread_mutex_lock(&_cmdMutex);
+    CommandStats stats = _cmdStats;
+    pthread_mutex_unlock(&_cmdMutex);
+
+    return stats;
+}
+
+/**
+ * @brief 获取播放状态快照，播放器还没创建时返回全零
+ */
+MediaPlayer::PlaybackSnapshot Model::getSnapshot(void)
+{
+    MediaPlayer::PlaybackSnapshot snapshot = {0};
+
+    if (_mp != nullptr)
+        snapshot = _mp->GetSnapshot();
+
+    return snapshot;
+}
+
 /**
  * @brief 定时器更新函数
  *
@@ -75,10 +223,29 @@ void Model::update(void)
 {
     if (_mp != nullptr)
     {
-        // ...
+        _view.updateProgress(getCur(), getDuration());
     }
 }
 
+/**
+ * @brief 让界面更新定时器马上运行并唤醒LVGL线程，在Model线程中调用
+ *
+ * 用trylock：析构时LVGL线程持锁等待本线程退出，不能阻塞在锁上
+ *
+ * @retval true 成功 / false 锁被占用，由调用者稍后重试
+ */
+bool Model::requestUpdate(void)
+{
+    if (pthread_mutex_trylock(_mutex) != 0)
+        return false;
+
+    lv_timer_ready(_timer);
+    pthread_mutex_unlock(_mutex);
+    HAL::WakeUp();
+
+    return true;
+}
+
 /**
  * @brief 线程处理函数
  *
@@ -90,18 +257,75 @@ void *Model::threadProcHandler(void *arg)
 
     model->_mp = new MediaPlayer(); // 创建播放器
     // 直接播放某视频
-    std::string url = "/mnt/UDISK/video/wallpaper4.mp4";
+    std::string url = VIDEO_DIR "wallpaper4.mp4";
     model->_mp->SetFullScreen(true);
-    model->_mp->SetNewVideo(url);
-    model->_mp->Start();
+    model->_mp->OpenAsync(url);
+    model->loadKeyframes(url);
 
-    while (!model->_threadExitFlag)
+    // 没有命令时阻塞在条件变量上，空闲时不占用CPU
+    bool updatePending = false; // 执行过命令，界面还没被通知刷新
+    for (;;)
     {
+        if (updatePending)
+            updatePending = !model->requestUpdate();
+
+        pthread_mutex_lock(&model->_cmdMutex);
+        while (model->_cmdQueue.empty())
+        {
+            if (!updatePending)
+            {
+                pthread_cond_wait(&model->_cmdCond, &model->_cmdMutex);
+                model->_cmdStats.wakeups++;
+                continue;
+            }
+
+            // 上次没拿到LVGL锁：等一小会儿，没有新命令就回去重试刷新
+            struct timespec timeout;
+            clock_gettime(CLOCK_MONOTONIC, &timeout);
+            timeout.tv_nsec += MODEL_UPDATE_RETRY_MS * 1000000L;
+            if (timeout.tv_nsec >= 1000000000L)
+            {
+                timeout.tv_sec++;
+                timeout.tv_nsec -= 1000000000L;
+            }
+            if (pthread_cond_timedwait(&model->_cmdCond, &model->_cmdMutex, &timeout) == ETIMEDOUT)
+                break;
+            model->_cmdStats.wakeups++;
+        }
+        if (model->_cmdQueue.empty())
+        {
+            pthread_mutex_unlock(&model->_cmdMutex);
+            continue;
+        }
+        Command cmd = model->_cmdQueue.front();
+        model->_cmdQueue.pop_front();
+
+        uint32_t latencyUs = tick_get_us() - cmd.enqueueUs;
+        struct timespec cpu;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+
+        model->_cmdStats.count++;
+        model->_cmdStats.lastLatencyUs = latencyUs;
+        if (latencyUs > model->_cmdStats.maxLatencyUs)
+            model->_cmdStats.maxLatencyUs = latencyUs;
+        model->_cmdStats.totalLatencyUs += latencyUs;
+        model->_cmdStats.threadCpuUs = (uint64_t)cpu.tv_sec * 1000000 + cpu.tv_nsec / 1000;
+        pthread_mutex_unlock(&model->_cmdMutex);
+
+        if (cmd.type == Command::CMD_SHUTDOWN)
+            break;
 
-        usleep(50000);
+        model->execute(cmd);
+
+        // 播放状态可能变了：让界面更新定时器马上运行，界面静止时LVGL线程不会自己醒来。
+        // 没拿到锁时保留请求，在下一轮循环里重试，不能丢掉
+        updatePending = true;
     }
 
     delete model->_mp;
+    model->_mp = nullptr;
+
+    return NULL;
 }
 
 /**
@@ -137,6 +361,7 @@ void Model::pause(void)
 {
     if (_mp != nullptr)
         _mp->Pause();
+    _thumbs->SetPaused(false);
 }
 
 /**
@@ -144,6 +369,8 @@ void Model::pause(void)
  */
 void Model::play(const char *name)
 {
+    _thumbs->SetPaused(true);
+
     if (name == NULL)
     {
         if (_mp != nullptr)
@@ -151,53 +378,119 @@ void Model::play(const char *name)
         return;
     }
 
-    std::string videoName(name);
+    // 通过媒体库的哈希索引查找，不再遍历目录
+    MediaLibrary::MediaEntry entry;
     std::string url;
 
-    // TODO：急需一个更加优雅的方法，来分类与加载视频源
+    if (_library->Lookup(name, entry))
+        url = entry.path;
 
-    // 检查VIDEO_DIR
-    DIR *dir = opendir(VIDEO_DIR);
-    if (dir != NULL)
+    // 异步打开，不等待解码器准备
+    if (!url.empty() && _mp != nullptr)
     {
-        struct dirent *ent;
-        while ((ent = readdir(dir)) != NULL)
-        {
-            if (ent->d_type == DT_REG && videoName == ent->d_name)
-            {
-                url = std::string(VIDEO_DIR) + videoName;
-                break;
-            }
-        }
-        closedir(dir);
+        _mp->OpenAsync(url);
+        loadKeyframes(url);
     }
+}
 
-    // 如果没找到，再检查SD_VIDEO_DIR
-    if (url.empty())
+/**
+ * @brief 底部面板展开/收起回调函数，在LVGL线程中调用
+ *
+ * 面板收起（全屏观看）时看不到进度条，暂停界面更新定时器；展开时立即更新一次
+ */
+void Model::setPanelVisible(bool visible)
+{
+    if (_timer == nullptr)
+        return;
+
+    if (visible)
     {
-        dir = opendir(SD_VIDEO_DIR);
-        if (dir != NULL)
-        {
-            struct dirent *ent;
-            while ((ent = readdir(dir)) != NULL)
-            {
-                if (ent->d_type == DT_REG && videoName == ent->d_name)
-                {
-                    url = std::string(SD_VIDEO_DIR) + videoName;
-                    break;
-                }
-            }
-            closedir(dir);
-        }
+        lv_timer_resume(_timer);
+        lv_timer_ready(_timer);
     }
-
-    if (!url.empty() && _mp != nullptr)
+    else
     {
-        _mp->SetNewVideo(url);
-        _mp->Start();
+        lv_timer_pause(_timer);
     }
 }
 
+/**
+ * @brief 请求当前视频的关键帧索引，在Model线程中调用，不阻塞
+ *
+ * 索引在缩略图线程中载入或解析，完成后才发布拖动预览对象；在此之前拖动不对齐、没有预览帧
+ */
+void Model::loadKeyframes(const std::string &path)
+{
+    pthread_mutex_lock(&_scrubMutex);
+    _scrubPath = path;
+    _scrubTarget = nullptr;
+    pthread_mutex_unlock(&_scrubMutex);
+
+    _thumbs->Post([this, path]()
+                  { buildKeyframes(path); });
+}
+
+/**
+ * @brief 载入（第一次播放时生成）关键帧索引并发布，在缩略图线程中调用
+ *
+ * 解析失败的文件（不是MP4等）按 路径 + 大小 + 修改时间 记下，文件不变就不再解析
+ */
+void Model::buildKeyframes(const std::string &path)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return;
+
+    std::shared_ptr<ScrubTarget> target = std::make_shared<ScrubTarget>(ScrubTarget{{}, KeyframeIndex(KEYFRAME_DIR)});
+    target->entry.name = path.substr(path.rfind('/') + 1);
+    target->entry.path = path;
+    target->entry.root = 0;
+    target->entry.size = st.st_size;
+    target->entry.mtime = st.st_mtime;
+    target->entry.hasMeta = false;
+    target->entry.meta = {0};
+
+    std::string failKey = path + '\n' + std::to_string((long long)st.st_size) + '\n' + std::to_string((long long)st.st_mtime);
+    if (_keyframeFailed.count(failKey) == 0 && !target->index.Load(path, st.st_size, st.st_mtime))
+        _keyframeFailed.insert(failKey);
+
+    // 期间已切换到其他视频则丢弃
+    pthread_mutex_lock(&_scrubMutex);
+    if (_scrubPath == path)
+        _scrubTarget = target;
+    pthread_mutex_unlock(&_scrubMutex);
+}
+
+/**
+ * @brief 拖动进度条：对齐到最近的关键帧并取预览帧，在LVGL线程中调用，不阻塞
+ * @param posMs 拖动到的时间点（ms）
+ * @param preview 预览帧，还没生成时为空（生成后再次调用即可取到）
+ * @retval 对齐后的时间点（ms），松手时用它跳转
+ */
+int Model::scrub(int posMs, ThumbnailCache::ThumbPtr &preview)
+{
+    pthread_mutex_lock(&_scrubMutex);
+    std::shared_ptr<const ScrubTarget> target = _scrubTarget;
+    pthread_mutex_unlock(&_scrubMutex);
+
+    if (target == nullptr)
+        return posMs;
+
+    int snapped = target->index.Snap(posMs);
+    preview = _thumbs->GetAt(target->entry, snapped);
+
+    return snapped;
+}
+
+/**
+ * @brief 松开进度条：丢弃还没开始的预览帧，再跳转到对齐后的时间点，在LVGL线程中调用
+ */
+void Model::scrubEnd(int posMs)
+{
+    _thumbs->EndScrub();
+    pushCommand(Command::CMD_SCRUB_SEEK, posMs);
+}
+
 /**
  * @brief UI设置播放时间点回调函数
  */
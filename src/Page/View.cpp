@@ -1,8 +1,20 @@
 #include "View.h"
 #include "ResourcePool.h"
+#include "HAL.h"
+#include <math.h>
 
 using namespace Page;
 
+/* 左右滑动快进/快退的秒数，滑得快（像素/秒）时跳得更远 */
+#define VIEW_SEEK_STEP_S 10
+#define VIEW_SEEK_FAST_STEP_S 30
+#define VIEW_SEEK_FAST_VELOCITY 2000
+/* 两指张开/捏合到这个比例时切换全屏 */
+#define VIEW_PINCH_FULLSCREEN 1.25f
+#define VIEW_PINCH_WINDOW 0.8f
+/* 拖动进度条时最多每隔这么久对齐关键帧、取一次预览帧（ms） */
+#define VIEW_SCRUB_INTERVAL_MS 50
+
 void View::create(Operations &opts)
 {
     // 获取View回调函数集
@@ -25,6 +37,9 @@ void View::create(Operations &opts)
     lv_obj_add_event_cb(ui.topCont.cancelBtn, buttonEventHandler, LV_EVENT_ALL, this);
     lv_obj_add_event_cb(ui.bottomCont.barBtn, buttonEventHandler, LV_EVENT_ALL, this);
     lv_obj_add_event_cb(ui.bottomCont.showBtn, buttonEventHandler, LV_EVENT_ALL, this);
+    lv_obj_add_event_cb(ui.bottomCont.progressSlider, sliderEventHandler, LV_EVENT_ALL, this);
+    // 手势优先由触摸输入线程识别，不受LVGL读取周期影响；不可用时仍处理LV_EVENT_GESTURE
+    _nativeGestures = HAL::SetGestureCb(std::bind(&View::onGesture, this, std::placeholders::_1));
 
     /* Transparent background style */
     static lv_style_t style_scr_act;
@@ -46,6 +61,8 @@ void View::create(Operations &opts)
                  lv_disp_get_default()->driver->draw_buf->size * sizeof(lv_color32_t));
     lv_style_set_bg_opa(&style_scr_act, LV_OPA_TRANSP);
     lv_obj_report_style_change(&style_scr_act);
+    // 只写入有UI对象的区域，空白处保持透明，不占用视频层的带宽
+    HAL::SetUiCompositing(true);
 
     // 动画的创建
     ui.anim_timeline = lv_anim_timeline_create();
@@ -104,8 +121,14 @@ void View::release()
         lv_anim_timeline_del(ui.anim_timelineBottom);
         ui.anim_timelineBottom = nullptr;
     }
+    if (_scrubTimer)
+    {
+        lv_timer_del(_scrubTimer);
+        _scrubTimer = nullptr;
+    }
     // 移除屏幕手势回调函数
     lv_obj_remove_event_cb(lv_scr_act(), onEvent);
+    HAL::SetGestureCb(nullptr);
 }
 
 void View::appearAnimStart(bool reverse) // 开始开场动画
@@ -128,6 +151,8 @@ void View::appearAnimBottom(bool reverse) // bottomCont动画
     lv_anim_timeline_start(ui.anim_timelineBottom);
 
     ui.isBottomContCollapsed = reverse;
+    if (_opts.panelCb)
+        _opts.panelCb(!reverse);
 }
 
 void View::AttachEvent(lv_obj_t *obj)
@@ -138,13 +163,13 @@ void View::AttachEvent(lv_obj_t *obj)
 // 自定义字体初始化
 void View::fontCreate(void)
 {
-    ui.fontCont.font16.name = "/mnt/UDISK/font/SmileySans.ttf";
+    ui.fontCont.font16.name = UDISK_DIR "font/SmileySans.ttf";
     ui.fontCont.font16.weight = 16;
     ui.fontCont.font16.style = FT_FONT_STYLE_NORMAL;
     ui.fontCont.font16.mem = nullptr;
     lv_ft_font_init(&ui.fontCont.font16);
 
-    ui.fontCont.font20.name = "/mnt/UDISK/font/SmileySans.ttf";
+    ui.fontCont.font20.name = UDISK_DIR "font/SmileySans.ttf";
     ui.fontCont.font20.weight = 20;
     ui.fontCont.font20.style = FT_FONT_STYLE_NORMAL;
     ui.fontCont.font20.mem = nullptr;
@@ -263,6 +288,24 @@ void View::bottomContCreate(lv_obj_t *obj)
     lv_obj_set_style_bg_img_src(image, ResourcePool::GetImage("objection"), LV_STATE_DEFAULT);
     lv_obj_align(image, LV_ALIGN_TOP_LEFT, 20, 0);
     ui.bottomCont.objectionImage = image;
+
+    // 设置进度条，范围为千分比
+    lv_obj_t *slider = lv_slider_create(cont);
+    lv_obj_set_size(slider, lv_pct(60), 8);
+    lv_obj_align(slider, LV_ALIGN_TOP_MID, 0, 10);
+    lv_slider_set_range(slider, 0, 1000);
+    lv_obj_set_style_bg_color(slider, lv_color_hex(0x222222), LV_PART_MAIN);
+    lv_obj_set_style_bg_color(slider, lv_color_hex(0x356b8c), LV_PART_INDICATOR);
+    lv_obj_set_style_bg_color(slider, lv_color_hex(0xf2daaa), LV_PART_KNOB);
+    ui.bottomCont.progressSlider = slider;
+
+    // 设置预览帧，拖动进度条时显示在进度条上方
+    lv_obj_t *preview = lv_img_create(obj);
+    lv_obj_add_flag(preview, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_set_style_radius(preview, 6, LV_PART_MAIN);
+    lv_obj_set_style_clip_corner(preview, true, LV_PART_MAIN);
+    lv_obj_align_to(preview, cont, LV_ALIGN_OUT_TOP_MID, 0, -10);
+    ui.bottomCont.previewImage = preview;
 }
 
 void View::topContCreate(lv_obj_t *obj)
@@ -416,6 +459,161 @@ void View::buttonEventHandler(lv_event_t *event)
     }
 }
 
+/**
+ * @brief 更新播放进度，拖动进度条时不更新
+ */
+void View::updateProgress(int curMs, int durationMs)
+{
+    if (_isScrubbing || durationMs <= 0)
+        return;
+
+    lv_slider_set_value(ui.bottomCont.progressSlider, (int64_t)curMs * 1000 / durationMs, LV_ANIM_OFF);
+}
+
+/**
+ * @brief 拖动到posMs：对齐关键帧，把滑块吸附过去，有预览帧就显示
+ */
+void View::scrubTo(int posMs)
+{
+    ThumbnailCache::ThumbPtr preview;
+
+    _scrubMs = _opts.scrubCb ? _opts.scrubCb(posMs, preview) : posMs;
+    if (_durationMs > 0)
+        lv_slider_set_value(ui.bottomCont.progressSlider, (int64_t)_scrubMs * 1000 / _durationMs, LV_ANIM_OFF);
+
+    if (preview != nullptr && preview != _preview)
+    {
+        _preview = preview;
+        lv_img_set_src(ui.bottomCont.previewImage, &_preview->dsc);
+        lv_obj_align_to(ui.bottomCont.previewImage, ui.bottomCont.cont, LV_ALIGN_OUT_TOP_MID, 0, -10);
+        lv_obj_clear_flag(ui.bottomCont.previewImage, LV_OBJ_FLAG_HIDDEN);
+    }
+}
+
+/**
+ * @brief 拖动中：用重采样得到的手指位置设置滑块，与LVGL的换算方式相同
+ *
+ * LVGL只在读取定时器到期时取最新的触摸点，显示时手指已经走远；重采样把位置推到
+ * 这一帧的显示时间，滑块和预览跟手更紧
+ */
+void View::scrubDrag(lv_obj_t *slider)
+{
+    lv_point_t point, raw;
+
+    if (!HAL::GetResampledPointer(point))
+        return;
+
+    lv_coord_t padLeft = lv_obj_get_style_pad_left(slider, LV_PART_MAIN);
+    lv_coord_t padRight = lv_obj_get_style_pad_right(slider, LV_PART_MAIN);
+    lv_coord_t w = lv_obj_get_width(slider) - padLeft - padRight;
+    if (w <= 0)
+        return;
+
+    lv_area_t coords;
+    lv_obj_get_coords(slider, &coords);
+    int32_t min = lv_slider_get_min_value(slider);
+    int32_t max = lv_slider_get_max_value(slider);
+    int32_t value = ((point.x - (coords.x1 + padLeft)) * (max - min) + w / 2) / w + min;
+    value = LV_CLAMP(min, value, max);
+    lv_slider_set_value(slider, value, LV_ANIM_OFF);
+    _scrubTargetMs = (int64_t)value * _durationMs / 1000;
+    _scrubDirty = true;
+
+    // 统计重采样带来的超前量
+    lv_point_t vect;
+    lv_indev_t *indev = lv_indev_get_act();
+    lv_indev_get_point(indev, &raw);
+    lv_indev_get_vect(indev, &vect);
+    if (vect.x != 0)
+    {
+        _resampledMoves++;
+        _resampledLeadPx += vect.x > 0 ? point.x - raw.x : raw.x - point.x;
+    }
+}
+
+/**
+ * @brief 缩略图线程生成了新的帧（任意线程调用），拖动中由定时器重新取一次预览帧
+ */
+void View::previewReady(void)
+{
+    _previewReady = true;
+    HAL::WakeUp();
+}
+
+/**
+ * @brief 拖动期间的定时器：合并这段时间的滑块事件，或在预览帧生成后再取一次
+ */
+void View::onScrubTimer(lv_timer_t *timer)
+{
+    View *instance = (View *)timer->user_data;
+
+    if (instance->_scrubDirty || instance->_previewReady.exchange(false))
+    {
+        instance->_scrubDirty = false;
+        instance->scrubTo(instance->_scrubTargetMs);
+    }
+}
+
+/**
+ * @brief 进度条事件：拖动时只预览，松手后才跳转一次
+ */
+void View::sliderEventHandler(lv_event_t *event)
+{
+    View *instance = (View *)lv_event_get_user_data(event);
+    LV_ASSERT_NULL(instance);
+
+    lv_event_code_t code = lv_event_get_code(event);
+    lv_obj_t *slider = lv_event_get_current_target(event);
+
+    if (code == LV_EVENT_PRESSED)
+    {
+        instance->_isScrubbing = true;
+        instance->_durationMs = instance->_opts.getDurationCb ? instance->_opts.getDurationCb() : 0;
+        instance->_scrubMs = (int64_t)lv_slider_get_value(slider) * instance->_durationMs / 1000;
+        instance->_scrubTargetMs = instance->_scrubMs;
+        instance->_scrubDirty = false;
+        instance->_previewReady = false;
+        instance->_resampledMoves = 0;
+        instance->_resampledLeadPx = 0;
+        if (instance->_scrubTimer == nullptr)
+            instance->_scrubTimer = lv_timer_create(onScrubTimer, VIEW_SCRUB_INTERVAL_MS, instance);
+    }
+    else if (code == LV_EVENT_VALUE_CHANGED && instance->_isScrubbing)
+    {
+        // 只记下位置，由定时器按固定间隔处理，手指快速移动时不会每个事件都取一次帧
+        instance->_scrubTargetMs = (int64_t)lv_slider_get_value(slider) * instance->_durationMs / 1000;
+        instance->_scrubDirty = true;
+    }
+    else if (code == LV_EVENT_PRESSING && instance->_isScrubbing)
+    {
+        // 滑块已按LVGL读到的点更新过，有触摸输入线程时改用按显示时间重采样的位置
+        instance->scrubDrag(slider);
+    }
+    else if ((code == LV_EVENT_RELEASED || code == LV_EVENT_PRESS_LOST) && instance->_isScrubbing)
+    {
+        instance->_isScrubbing = false;
+#ifdef LV_USE_SUNXIFB_DEBUG
+        if (instance->_resampledMoves > 0)
+            printf("[View] scrub: %u moves resampled, avg %.1f px ahead of the LVGL point\n",
+                   instance->_resampledMoves, (float)instance->_resampledLeadPx / instance->_resampledMoves);
+#endif
+        lv_timer_del(instance->_scrubTimer);
+        instance->_scrubTimer = nullptr;
+        // 最后一次移动还没处理，先对齐得到跳转的时间点
+        if (instance->_scrubDirty)
+        {
+            instance->_scrubDirty = false;
+            instance->scrubTo(instance->_scrubTargetMs);
+        }
+        lv_obj_add_flag(instance->ui.bottomCont.previewImage, LV_OBJ_FLAG_HIDDEN);
+        lv_img_set_src(instance->ui.bottomCont.previewImage, NULL);
+        instance->_preview = nullptr;
+
+        if (instance->_opts.scrubEndCb)
+            instance->_opts.scrubEndCb(instance->_scrubMs);
+    }
+}
+
 void View::onEvent(lv_event_t *event)
 {
     View *instance = (View *)lv_event_get_user_data(event);
@@ -426,40 +624,122 @@ void View::onEvent(lv_event_t *event)
 
     if (obj == lv_scr_act())
     {
-        if (code == LV_EVENT_GESTURE)
+        if (code == LV_EVENT_GESTURE && !instance->_nativeGestures)
+            instance->onSwipe(lv_indev_get_gesture_dir(lv_indev_get_act()), 0);
+    }
+}
+
+/**
+ * @brief 触摸输入线程识别的手势，坐标已换算到屏幕
+ */
+void View::onGesture(const GestureRecognizer::Gesture &gesture)
+{
+    switch (gesture.type)
+    {
+    case GestureRecognizer::SWIPE:
+        // 从按钮、进度条上开始的滑动交给控件自己
+        if (!isControlAt(gesture.x, gesture.y))
+            onSwipe(gesture.dir, (gesture.dir & LV_DIR_HOR) ? gesture.vx : gesture.vy);
+        break;
+    case GestureRecognizer::LONG_PRESS:
+        // 长按画面：把收起的面板都展开
+        if (!isControlAt(gesture.x, gesture.y))
         {
-            switch (lv_indev_get_gesture_dir(lv_indev_get_act()))
-            {
-            case LV_DIR_LEFT:
-                printf("[View] LV_DIR_LEFT!\n");
-
-                break;
-            case LV_DIR_RIGHT:
-                printf("[View] LV_DIR_RIGHT!\n");
-
-                break;
-            case LV_DIR_TOP:
-                printf("[View] LV_DIR_TOP!\n");
-                if (!instance->ui.isTopContCollapsed)
-                    instance->appearAnimTop(true);
-
-                break;
-            case LV_DIR_BOTTOM:
-                printf("[View] LV_DIR_BOTTOM!\n");
-                if (instance->ui.isTopContCollapsed)
-                    instance->appearAnimTop(false);
-
-                if (!instance->ui.isBottomContCollapsed)
-                {
-                    instance->appearAnimBottom(true);
-                    // lv_obj_clear_flag(instance->ui.bottomCont.barBtn, LV_OBJ_FLAG_HIDDEN);
-                }
-                // instance->_opts.exitCb();
-                break;
-
-            default:
-                break;
-            }
+            if (ui.isTopContCollapsed)
+                appearAnimTop(false);
+            if (ui.isBottomContCollapsed)
+                appearAnimBottom(false);
+        }
+        break;
+    case GestureRecognizer::PINCH_BEGIN:
+        _pinchHandled = false;
+        break;
+    case GestureRecognizer::PINCH:
+        // 张开全屏，捏合退出全屏，每次缩放只切换一次
+        if (!_pinchHandled && _opts.setFullScreenCb &&
+            (gesture.scale >= VIEW_PINCH_FULLSCREEN || gesture.scale <= VIEW_PINCH_WINDOW))
+        {
+            _opts.setFullScreenCb(gesture.scale > 1.0f);
+            _pinchHandled = true;
         }
+        break;
+    default:
+        break;
     }
-}
\ No newline at end of file
+}
+
+/**
+ * @brief 滑动：上下收起/展开面板，左右快进/快退
+ * @param velocity 滑动方向上的速度（像素/秒），未知时为0
+ */
+void View::onSwipe(lv_dir_t dir, float velocity)
+{
+    int step = fabsf(velocity) >= VIEW_SEEK_FAST_VELOCITY ? VIEW_SEEK_FAST_STEP_S : VIEW_SEEK_STEP_S;
+
+    switch (dir)
+    {
+    case LV_DIR_LEFT:
+        printf("[View] LV_DIR_LEFT!\n");
+        seekBy(-step);
+
+        break;
+    case LV_DIR_RIGHT:
+        printf("[View] LV_DIR_RIGHT!\n");
+        seekBy(step);
+
+        break;
+    case LV_DIR_TOP:
+        printf("[View] LV_DIR_TOP!\n");
+        if (!ui.isTopContCollapsed)
+            appearAnimTop(true);
+
+        break;
+    case LV_DIR_BOTTOM:
+        printf("[View] LV_DIR_BOTTOM!\n");
+        if (ui.isTopContCollapsed)
+            appearAnimTop(false);
+
+        if (!ui.isBottomContCollapsed)
+        {
+            appearAnimBottom(true);
+            // lv_obj_clear_flag(ui.bottomCont.barBtn, LV_OBJ_FLAG_HIDDEN);
+        }
+        // _opts.exitCb();
+        break;
+
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief 相对当前位置跳转，限制在视频范围内
+ */
+void View::seekBy(int seconds)
+{
+    if (!_opts.getCurCb || !_opts.setCurCb)
+        return;
+
+    int pos = _opts.getCurCb() / 1000 + seconds;
+    int duration = _opts.getDurationCb ? _opts.getDurationCb() / 1000 : pos;
+    _opts.setCurCb(LV_CLAMP(0, pos, duration));
+}
+
+/**
+ * @brief 屏幕上(x, y)处是否是按钮、进度条等自己处理触摸的控件
+ */
+bool View::isControlAt(lv_coord_t x, lv_coord_t y)
+{
+    lv_point_t point = {x, y};
+    lv_obj_t *obj = lv_indev_search_obj(lv_scr_act(), &point);
+
+    for (; obj != NULL; obj = lv_obj_get_parent(obj))
+    {
+        if (obj == ui.topCont.cancelBtn || obj == ui.topCont.lockBtn || obj == ui.topCont.listBtn ||
+            obj == ui.bottomCont.barBtn || obj == ui.bottomCont.showBtn ||
+            obj == ui.bottomCont.progressSlider)
+            return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,181 @@
+#include "FrameSource.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <tplayer.h>
+
+/* 等待第一帧的超时时间 */
+#define GRAB_TIMEOUT_MS 3000
+/* 取帧位置：片头10%，最多10s，跳过黑场片头 */
+#define GRAB_POS_MAX_MS 10000
+
+struct GrabContext
+{
+    pthread_mutex_t mutex; // 回调与超时退出互斥，保证超时后不再调用sink
+    sem_t sem;
+    const FrameSink *sink;
+    bool done;
+    bool ok;
+};
+
+static int grabNotify(void *pUserData, int msg, int param0, void *param1)
+{
+    GrabContext *ctx = (GrabContext *)pUserData;
+
+    if (msg != TPLAYER_NOTIFY_VIDEO_FRAME && msg != TPLAYER_NOTIFY_MEDIA_ERROR)
+        return 0;
+
+    pthread_mutex_lock(&ctx->mutex);
+    if (!ctx->done)
+    {
+        VideoPicData *pic = (VideoPicData *)param1;
+        if (msg == TPLAYER_NOTIFY_VIDEO_FRAME && pic != NULL && pic->pData0 != NULL && pic->pData1 != NULL)
+        {
+            // CedarX送出的视频帧是NV21，每行补齐到16/32字节，VU平面与Y平面的行宽相同
+            Frame frame;
+            frame.format = Frame::FRAME_NV21;
+            frame.width = pic->nWidth;
+            frame.height = pic->nHeight;
+            frame.stride = pic->nLineStride > 0 ? pic->nLineStride : pic->nWidth;
+            frame.stride1 = frame.stride;
+            frame.plane0 = (const uint8_t *)pic->pData0;
+            frame.plane1 = (const uint8_t *)pic->pData1;
+            (*ctx->sink)(frame);
+            ctx->ok = true;
+        }
+        ctx->done = true;
+        sem_post(&ctx->sem);
+    }
+    pthread_mutex_unlock(&ctx->mutex);
+
+    return 0;
+}
+
+bool TPlayerFrameSource::Grab(const std::string &path, int posMs, const FrameSink &sink)
+{
+    TPlayer *player = TPlayerCreate(CEDARX_PLAYER);
+    if (player == NULL)
+        return false;
+
+    GrabContext ctx;
+    pthread_mutex_init(&ctx.mutex, NULL);
+    sem_init(&ctx.sem, 0, 0);
+    ctx.sink = &sink;
+    ctx.done = false;
+    ctx.ok = false;
+
+    TPlayerSetNotifyCallback(player, grabNotify, &ctx);
+    if (TPlayerSetDataSource(player, path.c_str(), NULL) == 0 && TPlayerPrepare(player) == 0)
+    {
+        if (posMs < 0)
+        {
+            int durationMs = 0;
+            TPlayerGetDuration(player, &durationMs);
+            posMs = durationMs / 10;
+            if (posMs > GRAB_POS_MAX_MS)
+                posMs = GRAB_POS_MAX_MS;
+        }
+
+        // 静音，显示区域缩到1个像素，不干扰正在播放的画面
+        TPlayerSetVolume(player, 0);
+        TPlayerSetDisplayRect(player, 0, 0, 1, 1);
+        if (posMs > 0)
+            TPlayerSeekTo(player, posMs);
+        TPlayerStart(player);
+
+        struct timespec timeout;
+        clock_gettime(CLOCK_REALTIME, &timeout);
+        timeout.tv_sec += GRAB_TIMEOUT_MS / 1000;
+        timeout.tv_nsec += (GRAB_TIMEOUT_MS % 1000) * 1000000L;
+        timeout.tv_sec += timeout.tv_nsec / 1000000000L;
+        timeout.tv_nsec %= 1000000000L;
+        while (sem_timedwait(&ctx.sem, &timeout) != 0 && errno == EINTR)
+            ;
+    }
+
+    pthread_mutex_lock(&ctx.mutex);
+    ctx.done = true;
+    pthread_mutex_unlock(&ctx.mutex);
+
+    TPlayerReset(player);
+    TPlayerDestroy(player);
+
+    sem_destroy(&ctx.sem);
+    pthread_mutex_destroy(&ctx.mutex);
+
+    if (!ctx.ok)
+        printf("[Thumbnail] grab frame from %s failed\n", path.c_str());
+
+    return ctx.ok;
+}
+
+/**
+ * @brief 读一个PPM文件头里的下一个整数（跳过空白和注释）
+ */
+static bool ppmReadInt(FILE *fp, int &value)
+{
+    int c = fgetc(fp);
+    while (c == '#' || c == ' ' || c == '\t' || c == '\r' || c == '\n')
+    {
+        if (c == '#')
+        {
+            while (c != '\n' && c != EOF)
+                c = fgetc(fp);
+        }
+        c = fgetc(fp);
+    }
+
+    value = 0;
+    if (c < '0' || c > '9')
+        return false;
+    while (c >= '0' && c <= '9')
+    {
+        value = value * 10 + (c - '0');
+        c = fgetc(fp);
+    }
+
+    return true;
+}
+
+bool FileFrameSource::Grab(const std::string &path, int posMs, const FrameSink &sink)
+{
+    std::string ppmPath = path.substr(0, path.rfind('.')) + ".ppm";
+    FILE *fp = fopen(ppmPath.c_str(), "rb");
+    if (fp == NULL)
+        return false;
+
+    char magic[2];
+    int width, height, maxval;
+    bool ok = fread(magic, 1, 2, fp) == 2 && magic[0] == 'P' && magic[1] == '6' &&
+              ppmReadInt(fp, width) && ppmReadInt(fp, height) && ppmReadInt(fp, maxval) &&
+              width > 0 && height > 0 && maxval == 255;
+
+    std::vector<uint8_t> pixels;
+    if (ok)
+    {
+        pixels.resize((size_t)width * height * 3);
+        ok = fread(pixels.data(), 1, pixels.size(), fp) == pixels.size();
+    }
+    fclose(fp);
+
+    if (!ok)
+    {
+        printf("[Thumbnail] %s is not a valid P6 ppm\n", ppmPath.c_str());
+        return false;
+    }
+
+    Frame frame;
+    frame.format = Frame::FRAME_RGB888;
+    frame.width = width;
+    frame.height = height;
+    frame.stride = width * 3;
+    frame.stride1 = 0;
+    frame.plane0 = pixels.data();
+    frame.plane1 = NULL;
+    sink(frame);
+
+    return true;
+}
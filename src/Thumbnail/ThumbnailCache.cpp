@@ -0,0 +1,560 @@
+#include "ThumbnailCache.h"
+#include "../../utils/Tick/Tick.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define THUMBNAIL_DISK_MAGIC "EMPT"
+
+/* 磁盘缓存文件头，后面紧跟 width * height 个lv_color_t */
+struct DiskHeader
+{
+    char magic[4];
+    uint16_t width;
+    uint16_t height;
+    uint32_t pixelSize; // sizeof(lv_color_t)，颜色深度变了则缓存失效
+};
+
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= p[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+static inline uint8_t clamp8(int v)
+{
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+/**
+ * @brief 取源画面一个像素的RGB
+ */
+static inline void framePixel(const Frame &frame, int x, int y, int &r, int &g, int &b)
+{
+    if (frame.format == Frame::FRAME_RGB888)
+    {
+        const uint8_t *p = frame.plane0 + y * frame.stride + x * 3;
+        r = p[0];
+        g = p[1];
+        b = p[2];
+        return;
+    }
+
+    // BT.601 YUV -> RGB
+    const uint8_t *uv = frame.plane1 + (y >> 1) * frame.stride1 + (x & ~1);
+    int c = frame.plane0[y * frame.stride + x] - 16;
+    int d = (frame.format == Frame::FRAME_NV12 ? uv[0] : uv[1]) - 128;
+    int e = (frame.format == Frame::FRAME_NV12 ? uv[1] : uv[0]) - 128;
+    r = clamp8((298 * c + 409 * e + 128) >> 8);
+    g = clamp8((298 * c - 100 * d - 208 * e + 128) >> 8);
+    b = clamp8((298 * c + 516 * d + 128) >> 8);
+}
+
+/**
+ * @brief 保持比例缩小到maxWidth x maxHeight以内，每个目标像素对源区域最多4x4采样取平均
+ */
+static void scaleFrame(const Frame &frame, int maxWidth, int maxHeight, Thumbnail &thumb)
+{
+    int tw, th;
+    if ((int64_t)frame.width * maxHeight > (int64_t)frame.height * maxWidth)
+    {
+        tw = maxWidth;
+        th = (int64_t)frame.height * maxWidth / frame.width;
+    }
+    else
+    {
+        th = maxHeight;
+        tw = (int64_t)frame.width * maxHeight / frame.height;
+    }
+    tw = tw < 1 ? 1 : tw;
+    th = th < 1 ? 1 : th;
+
+    thumb.pixels.resize(tw * th);
+    for (int ty = 0; ty < th; ty++)
+    {
+        int y0 = ty * frame.height / th;
+        int y1 = (ty + 1) * frame.height / th;
+        int sy = (y1 - y0 + 3) / 4;
+        sy = sy < 1 ? 1 : sy;
+
+        for (int tx = 0; tx < tw; tx++)
+        {
+            int x0 = tx * frame.width / tw;
+            int x1 = (tx + 1) * frame.width / tw;
+            int sx = (x1 - x0 + 3) / 4;
+            sx = sx < 1 ? 1 : sx;
+
+            int sumR = 0, sumG = 0, sumB = 0, n = 0;
+            for (int y = y0; y < y1 || y == y0; y += sy)
+            {
+                for (int x = x0; x < x1 || x == x0; x += sx)
+                {
+                    int r, g, b;
+                    framePixel(frame, x, y, r, g, b);
+                    sumR += r;
+                    sumG += g;
+                    sumB += b;
+                    n++;
+                }
+            }
+            thumb.pixels[ty * tw + tx] = lv_color_make(sumR / n, sumG / n, sumB / n);
+        }
+    }
+
+    memset(&thumb.dsc, 0, sizeof(thumb.dsc));
+    thumb.dsc.header.cf = LV_IMG_CF_TRUE_COLOR;
+    thumb.dsc.header.w = tw;
+    thumb.dsc.header.h = th;
+    thumb.dsc.data_size = thumb.pixels.size() * sizeof(lv_color_t);
+    thumb.dsc.data = (const uint8_t *)thumb.pixels.data();
+}
+
+/**
+ * @brief 缩略图缓存构造函数
+ * @param source 帧来源，由ThumbnailCache负责释放
+ * @param diskDir 磁盘缓存目录，不存在时自动创建
+ * @param maxWidth/maxHeight 缩略图最大尺寸
+ * @param budget 内存预算（byte）
+ */
+ThumbnailCache::ThumbnailCache(FrameSource *source, const char *diskDir, int maxWidth, int maxHeight, size_t budget)
+{
+    _source = source;
+    _diskDir = diskDir;
+    if (!_diskDir.empty() && _diskDir.back() != '/')
+        _diskDir += '/';
+    mkdir(_diskDir.c_str(), 0755);
+
+    _maxWidth = maxWidth;
+    _maxHeight = maxHeight;
+    _memBytes = 0;
+    _budget = budget;
+    _paused = false;
+    _exit = false;
+    _stats = {0};
+
+    pthread_mutex_init(&_mutex, NULL);
+    pthread_cond_init(&_cond, NULL);
+    pthread_create(&_pthread, NULL, threadProcHandler, this);
+}
+
+ThumbnailCache::~ThumbnailCache()
+{
+    pthread_mutex_lock(&_mutex);
+    _exit = true;
+    pthread_cond_signal(&_cond);
+    pthread_mutex_unlock(&_mutex);
+    pthread_join(_pthread, NULL);
+
+    pthread_cond_destroy(&_cond);
+    pthread_mutex_destroy(&_mutex);
+
+    delete _source;
+}
+
+uint64_t ThumbnailCache::makeKey(const MediaLibrary::MediaEntry &entry, int posMs)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    hash = fnv1a(hash, entry.path.data(), entry.path.size());
+    hash = fnv1a(hash, &entry.size, sizeof(entry.size));
+    hash = fnv1a(hash, &entry.mtime, sizeof(entry.mtime));
+    if (posMs >= 0)
+        hash = fnv1a(hash, &posMs, sizeof(posMs));
+
+    return hash;
+}
+
+std::string ThumbnailCache::diskPath(uint64_t key)
+{
+    char name[24];
+
+    snprintf(name, sizeof(name), "%016llx.thumb", (unsigned long long)key);
+
+    return _diskDir + name;
+}
+
+ThumbnailCache::ThumbPtr ThumbnailCache::loadDisk(uint64_t key)
+{
+    FILE *fp = fopen(diskPath(key).c_str(), "rb");
+    if (fp == NULL)
+        return nullptr;
+
+    DiskHeader header;
+    std::shared_ptr<Thumbnail> thumb = std::make_shared<Thumbnail>();
+    bool ok = fread(&header, sizeof(header), 1, fp) == 1 &&
+              memcmp(header.magic, THUMBNAIL_DISK_MAGIC, 4) == 0 &&
+              header.pixelSize == sizeof(lv_color_t) &&
+              header.width > 0 && header.height > 0;
+    if (ok)
+    {
+        thumb->pixels.resize(header.width * header.height);
+        ok = fread(thumb->pixels.data(), sizeof(lv_color_t), thumb->pixels.size(), fp) == thumb->pixels.size();
+    }
+    fclose(fp);
+
+    if (!ok)
+        return nullptr;
+
+    memset(&thumb->dsc, 0, sizeof(thumb->dsc));
+    thumb->dsc.header.cf = LV_IMG_CF_TRUE_COLOR;
+    thumb->dsc.header.w = header.width;
+    thumb->dsc.header.h = header.height;
+    thumb->dsc.data_size = thumb->pixels.size() * sizeof(lv_color_t);
+    thumb->dsc.data = (const uint8_t *)thumb->pixels.data();
+
+    return thumb;
+}
+
+void ThumbnailCache::saveDisk(uint64_t key, const Thumbnail &thumb)
+{
+    std::string path = diskPath(key);
+    std::string tmpPath = path + ".tmp";
+    FILE *fp = fopen(tmpPath.c_str(), "wb");
+    if (fp == NULL)
+        return;
+
+    DiskHeader header;
+    memcpy(header.magic, THUMBNAIL_DISK_MAGIC, 4);
+    header.width = thumb.dsc.header.w;
+    header.height = thumb.dsc.header.h;
+    header.pixelSize = sizeof(lv_color_t);
+
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+              fwrite(thumb.pixels.data(), sizeof(lv_color_t), thumb.pixels.size(), fp) == thumb.pixels.size();
+    ok = (fclose(fp) == 0) && ok;
+
+    if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0)
+        unlink(tmpPath.c_str());
+}
+
+/**
+ * @brief 从帧来源取一帧并缩小（在缩略图线程中调用）
+ */
+ThumbnailCache::ThumbPtr ThumbnailCache::generate(const std::string &path, int posMs)
+{
+    std::shared_ptr<Thumbnail> thumb = std::make_shared<Thumbnail>();
+    bool ok = _source->Grab(path, posMs, [this, &thumb](const Frame &frame)
+                            { scaleFrame(frame, _maxWidth, _maxHeight, *thumb); });
+
+    if (!ok || thumb->pixels.empty())
+        return nullptr;
+
+    return thumb;
+}
+
+/**
+ * @brief 放入内存LRU并按预算淘汰，调用时需持有_mutex
+ */
+void ThumbnailCache::insert(uint64_t key, ThumbPtr thumb)
+{
+    if (_lruIndex.count(key) != 0)
+        return;
+
+    _lru.push_front({key, thumb});
+    _lruIndex[key] = _lru.begin();
+    _memBytes += sizeof(Thumbnail) + thumb->pixels.size() * sizeof(lv_color_t);
+    evict();
+}
+
+/**
+ * @brief 淘汰最久未使用的缩略图直到不超过预算，调用时需持有_mutex
+ */
+void ThumbnailCache::evict(void)
+{
+    while (_memBytes > _budget && !_lru.empty())
+    {
+        LruItem &item = _lru.back();
+        _memBytes -= sizeof(Thumbnail) + item.thumb->pixels.size() * sizeof(lv_color_t);
+        _lruIndex.erase(item.key);
+        _lru.pop_back();
+        _stats.evictions++;
+    }
+}
+
+/**
+ * @brief 加入任务队列，调用时需持有_mutex。需要放入内存的任务排在队首，
+ *        新的预览帧请求取代还没开始的旧预览帧请求
+ */
+void ThumbnailCache::enqueue(const MediaLibrary::MediaEntry &entry, uint64_t key, int posMs, bool toMemory)
+{
+    if (posMs >= 0 && _pending.count(key) == 0)
+    {
+        for (auto it = _jobs.begin(); it != _jobs.end();)
+        {
+            if (it->posMs >= 0)
+            {
+                _pending.erase(it->key);
+                it = _jobs.erase(it);
+            }
+            else
+                ++it;
+        }
+    }
+
+    if (_pending.count(key) != 0)
+    {
+        if (!toMemory)
+            return;
+
+        // 已在预取队列中，提升为需要放入内存并提到队首
+        for (auto it = _jobs.begin(); it != _jobs.end(); ++it)
+        {
+            if (it->key == key && !it->toMemory)
+            {
+                Job job = *it;
+                job.toMemory = true;
+                _jobs.erase(it);
+                _jobs.push_front(job);
+                break;
+            }
+        }
+        return;
+    }
+
+    Job job = {key, entry.name, entry.path, posMs, toMemory};
+    if (toMemory)
+        _jobs.push_front(job);
+    else
+        _jobs.push_back(job);
+    _pending.insert(key);
+    pthread_cond_signal(&_cond);
+}
+
+void *ThumbnailCache::threadProcHandler(void *arg)
+{
+    ThumbnailCache *cache = static_cast<ThumbnailCache *>(arg);
+
+    pthread_mutex_lock(&cache->_mutex);
+    while (true)
+    {
+        // 暂停时只处理需要马上显示的任务（它们总在队首）和不解码的任务
+        while (!cache->_exit && cache->_tasks.empty() &&
+               (cache->_jobs.empty() || (cache->_paused && !cache->_jobs.front().toMemory)))
+            pthread_cond_wait(&cache->_cond, &cache->_mutex);
+        if (cache->_exit)
+            break;
+
+        if (!cache->_tasks.empty())
+        {
+            Task task = cache->_tasks.front();
+            cache->_tasks.pop_front();
+            pthread_mutex_unlock(&cache->_mutex);
+            task();
+            pthread_mutex_lock(&cache->_mutex);
+            continue;
+        }
+
+        Job job = cache->_jobs.front();
+        cache->_jobs.pop_front();
+        // 播放中只允许为拖动预览帧解码，不和播放器争解码器
+        bool mayDecode = !cache->_paused || job.posMs >= 0;
+        pthread_mutex_unlock(&cache->_mutex);
+
+        // 先查磁盘，没有再解码；预取任务磁盘上有就不用读
+        ThumbPtr thumb;
+        bool fromDisk = false;
+        uint32_t decodeUs = 0;
+        if (job.posMs >= 0)
+            fromDisk = false; // 预览帧不落盘
+        else if (job.toMemory)
+        {
+            thumb = cache->loadDisk(job.key);
+            fromDisk = (thumb != nullptr);
+            if (!fromDisk && !mayDecode)
+            {
+                // 仍在_pending中，重复的Get不会再入队；期间已恢复则直接放回队首
+                pthread_mutex_lock(&cache->_mutex);
+                if (cache->_paused)
+                    cache->_deferred.push_back(job);
+                else
+                    cache->_jobs.push_front(job);
+                continue;
+            }
+        }
+        else
+            fromDisk = (access(cache->diskPath(job.key).c_str(), F_OK) == 0);
+
+        if (!fromDisk)
+        {
+            uint64_t t0 = tick_get_us();
+            thumb = cache->generate(job.path, job.posMs);
+            decodeUs = tick_get_us() - t0;
+            if (thumb != nullptr && job.posMs < 0)
+                cache->saveDisk(job.key, *thumb);
+        }
+
+        pthread_mutex_lock(&cache->_mutex);
+        cache->_pending.erase(job.key);
+        if (fromDisk)
+            cache->_stats.diskHits++;
+        else if (thumb != nullptr)
+        {
+            cache->_stats.decoded++;
+            cache->_stats.lastDecodeUs = decodeUs;
+        }
+        else
+            cache->_stats.failed++;
+
+        ReadyCb readyCb;
+        if (job.toMemory && thumb != nullptr)
+        {
+            cache->insert(job.key, thumb);
+            readyCb = cache->_readyCb;
+        }
+
+        if (readyCb)
+        {
+            pthread_mutex_unlock(&cache->_mutex);
+            readyCb(job.name);
+            pthread_mutex_lock(&cache->_mutex);
+        }
+    }
+    pthread_mutex_unlock(&cache->_mutex);
+
+    return NULL;
+}
+
+/**
+ * @brief 获取缩略图，不阻塞
+ * @retval 内存中有则返回；否则返回nullptr并在后台生成，完成后调用ReadyCb
+ */
+ThumbnailCache::ThumbPtr ThumbnailCache::Get(const MediaLibrary::MediaEntry &entry)
+{
+    return GetAt(entry, -1);
+}
+
+/**
+ * @brief 获取指定位置的预览帧，不阻塞
+ * @param posMs 帧位置（ms，应对齐到关键帧以提高命中率），小于0等同于Get
+ * @retval 内存中有则返回；否则返回nullptr并在后台生成，完成后调用ReadyCb
+ */
+ThumbnailCache::ThumbPtr ThumbnailCache::GetAt(const MediaLibrary::MediaEntry &entry, int posMs)
+{
+    uint64_t key = makeKey(entry, posMs);
+    ThumbPtr thumb;
+
+    pthread_mutex_lock(&_mutex);
+    auto it = _lruIndex.find(key);
+    if (it != _lruIndex.end())
+    {
+        _lru.splice(_lru.begin(), _lru, it->second);
+        thumb = it->second->thumb;
+        _stats.hits++;
+    }
+    else
+    {
+        _stats.misses++;
+        enqueue(entry, key, posMs, true);
+    }
+    pthread_mutex_unlock(&_mutex);
+
+    return thumb;
+}
+
+/**
+ * @brief 在后台为视频文件预先生成磁盘缓存（不占内存预算）
+ */
+void ThumbnailCache::Prefetch(const std::vector<MediaLibrary::MediaEntry> &entries)
+{
+    pthread_mutex_lock(&_mutex);
+    for (auto &entry : entries)
+    {
+        // 元数据已知且没有视频流的文件不用取帧
+        if (entry.hasMeta && entry.meta.width == 0)
+            continue;
+
+        uint64_t key = makeKey(entry, -1);
+        if (_lruIndex.count(key) == 0)
+            enqueue(entry, key, -1, false);
+    }
+    pthread_mutex_unlock(&_mutex);
+}
+
+/**
+ * @brief 设置内存预算，超出部分立即淘汰
+ */
+void ThumbnailCache::SetMemoryBudget(size_t bytes)
+{
+    pthread_mutex_lock(&_mutex);
+    _budget = bytes;
+    evict();
+    pthread_mutex_unlock(&_mutex);
+}
+
+/**
+ * @brief 暂停/恢复后台预取（正在播放时暂停，避免和播放抢解码器），Get触发的任务不受影响
+ */
+void ThumbnailCache::SetPaused(bool paused)
+{
+    pthread_mutex_lock(&_mutex);
+    _paused = paused;
+    if (!paused)
+    {
+        // 推迟的缩略图都是界面在等的，排到队首
+        _jobs.insert(_jobs.begin(), _deferred.begin(), _deferred.end());
+        _deferred.clear();
+    }
+    pthread_cond_signal(&_cond);
+    pthread_mutex_unlock(&_mutex);
+}
+
+/**
+ * @brief 拖动结束：丢弃还没开始生成的预览帧，松手后不再为它启动解码
+ */
+void ThumbnailCache::EndScrub(void)
+{
+    pthread_mutex_lock(&_mutex);
+    for (auto it = _jobs.begin(); it != _jobs.end();)
+    {
+        if (it->posMs >= 0)
+        {
+            _pending.erase(it->key);
+            it = _jobs.erase(it);
+        }
+        else
+            ++it;
+    }
+    pthread_mutex_unlock(&_mutex);
+}
+
+/**
+ * @brief 设置缩略图就绪回调，在缩略图线程中调用
+ */
+void ThumbnailCache::SetReadyCallback(ReadyCb readyCb)
+{
+    pthread_mutex_lock(&_mutex);
+    _readyCb = readyCb;
+    pthread_mutex_unlock(&_mutex);
+}
+
+/**
+ * @brief 在缩略图线程中执行一个不使用解码器的任务（比如解析关键帧索引），不阻塞调用者
+ *
+ * 任务按提交顺序执行，排在缩略图之前，暂停预取时也执行；析构时还没执行的任务被丢弃
+ */
+void ThumbnailCache::Post(Task task)
+{
+    pthread_mutex_lock(&_mutex);
+    _tasks.push_back(task);
+    pthread_cond_signal(&_cond);
+    pthread_mutex_unlock(&_mutex);
+}
+
+ThumbnailCache::Stats ThumbnailCache::GetStats(void)
+{
+    pthread_mutex_lock(&_mutex);
+    Stats stats = _stats;
+    stats.memBytes = _memBytes;
+    stats.budgetBytes = _budget;
+    pthread_mutex_unlock(&_mutex);
+
+    return stats;
+}
@@ -0,0 +1,100 @@
+#ifndef __MPSC_RING_H
+#define __MPSC_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+/**
+ * @brief 多生产者/单消费者无锁环形队列
+ *
+ * 每个单元带一个序号：序号等于写入位置时单元空闲，生产者用CAS抢占_head后写入数据，
+ * 再把序号加一发布给消费者；消费者取走后把序号推进一圈，单元重新空闲。
+ * 多个线程同时Push不会抢到同一个单元，任何一方都不会阻塞，队列满时Push返回false。
+ * 某个生产者抢到单元后还没发布时，消费者在这个单元处停下，之后的元素等下一次Pop再取。
+ *
+ * @tparam T 元素类型（需可拷贝）
+ * @tparam Capacity 容量，必须是2的幂
+ */
+template <typename T, size_t Capacity>
+class MpscRing
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of 2");
+
+public:
+    MpscRing() : _head(0), _tail(0)
+    {
+        for (size_t i = 0; i < Capacity; i++)
+            _cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 生产者写入一个元素，可以在多个线程中同时调用
+     * @retval true 成功 / false 队列已满
+     */
+    bool Push(const T &value)
+    {
+        size_t head = _head.load(std::memory_order_relaxed);
+        Cell *cell;
+
+        for (;;)
+        {
+            cell = &_cells[head & (Capacity - 1)];
+            intptr_t diff = (intptr_t)cell->seq.load(std::memory_order_acquire) - (intptr_t)head;
+            if (diff == 0)
+            {
+                if (_head.compare_exchange_weak(head, head + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false;
+            else
+                head = _head.load(std::memory_order_relaxed);
+        }
+
+        cell->value = value;
+        cell->seq.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief 消费者取出一个元素，只能在一个线程中调用
+     * @retval true 成功 / false 队列为空（或下一个单元还没发布）
+     */
+    bool Pop(T &value)
+    {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        Cell *cell = &_cells[tail & (Capacity - 1)];
+
+        if (cell->seq.load(std::memory_order_acquire) != tail + 1)
+            return false;
+
+        value = cell->value;
+        cell->seq.store(tail + Capacity, std::memory_order_release);
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool IsEmpty(void) const
+    {
+        return Size() == 0;
+    }
+
+    size_t Size(void) const
+    {
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    Cell _cells[Capacity];
+    alignas(64) std::atomic<size_t> _head; // 生产者抢占
+    alignas(64) std::atomic<size_t> _tail; // 消费者写
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef __SEQ_LOCK_H
+#define __SEQ_LOCK_H
+
+#include <stdint.h>
+#include <atomic>
+
+/**
+ * @brief 顺序锁，读者不加锁、不阻塞写者
+ *
+ * 写者写之前把序号加成奇数，写完再加成偶数；读者读到的前后序号一致且为偶数时数据有效，
+ * 否则重读。多个写者之间需要调用者自行互斥。
+ * 适合由一个线程周期性发布、多个线程高频读取的小结构体。
+ *
+ * @tparam T 数据类型（需可平凡拷贝）
+ */
+template <typename T>
+class SeqLock
+{
+public:
+    SeqLock() : _seq(0), _data() {}
+
+    void Write(const T &value)
+    {
+        uint32_t seq = _seq.load(std::memory_order_relaxed);
+
+        _seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        _data = value;
+        std::atomic_thread_fence(std::memory_order_release);
+        _seq.store(seq + 2, std::memory_order_relaxed);
+    }
+
+    T Read(void) const
+    {
+        T value;
+        uint32_t seq0, seq1;
+
+        do
+        {
+            seq0 = _seq.load(std::memory_order_acquire);
+            value = _data;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            seq1 = _seq.load(std::memory_order_relaxed);
+        } while ((seq0 & 1) || seq0 != seq1);
+
+        return value;
+    }
+
+private:
+    std::atomic<uint32_t> _seq;
+    T _data;
+};
+
+#endif
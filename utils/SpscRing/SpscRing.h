@@ -0,0 +1,73 @@
+#ifndef __SPSC_RING_H
+#define __SPSC_RING_H
+
+#include <stddef.h>
+#include <atomic>
+
+/**
+ * @brief 单生产者/单消费者无锁环形队列
+ *
+ * 生产者只写_head，消费者只写_tail，两边都不会阻塞，
+ * 适合在解码器回调等不能等待的线程里投递数据。
+ * 队列满时Push直接返回false，由调用者决定是否丢弃。
+ *
+ * @tparam T 元素类型（需可拷贝）
+ * @tparam Capacity 容量，必须是2的幂
+ */
+template <typename T, size_t Capacity>
+class SpscRing
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of 2");
+
+public:
+    SpscRing() : _head(0), _tail(0) {}
+
+    /**
+     * @brief 生产者写入一个元素
+     * @retval true 成功 / false 队列已满
+     */
+    bool Push(const T &value)
+    {
+        size_t head = _head.load(std::memory_order_relaxed);
+
+        if (head - _tail.load(std::memory_order_acquire) == Capacity)
+            return false;
+
+        _buffer[head & (Capacity - 1)] = value;
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief 消费者取出一个元素
+     * @retval true 成功 / false 队列为空
+     */
+    bool Pop(T &value)
+    {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+
+        if (tail == _head.load(std::memory_order_acquire))
+            return false;
+
+        value = _buffer[tail & (Capacity - 1)];
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool IsEmpty(void) const
+    {
+        return _tail.load(std::memory_order_acquire) == _head.load(std::memory_order_acquire);
+    }
+
+    size_t Size(void) const
+    {
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+
+private:
+    T _buffer[Capacity];
+    alignas(64) std::atomic<size_t> _head; // 生产者写
+    alignas(64) std::atomic<size_t> _tail; // 消费者写
+};
+
+#endif
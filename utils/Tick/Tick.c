@@ -0,0 +1,104 @@
+#include "Tick.h"
+#include <time.h>
+
+#if TICK_USE_COARSE
+#define TICK_MS_CLOCK CLOCK_MONOTONIC_COARSE
+#else
+#define TICK_MS_CLOCK CLOCK_MONOTONIC
+#endif
+
+/**
+ * @brief 获取毫秒时间
+ *
+ * clock_gettime走vDSO，不陷入内核；只用32位运算，
+ * 结果对2^32取模后与完整的64位毫秒值一致，回绕是连续的。
+ */
+uint32_t tick_get_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(TICK_MS_CLOCK, &ts);
+    return (uint32_t)ts.tv_sec * 1000U + (uint32_t)ts.tv_nsec / 1000000U;
+}
+
+/**
+ * @brief 获取微秒时间（总是使用高精度时钟）
+ */
+uint64_t tick_get_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000U + (uint32_t)ts.tv_nsec / 1000U;
+}
+
+/**
+ * @brief 距prev_ms经过的毫秒数，可以跨越回绕
+ */
+uint32_t tick_elapsed_ms(uint32_t prev_ms)
+{
+    return tick_get_ms() - prev_ms;
+}
+
+#if TICK_BENCHMARK
+#include <stdio.h>
+#include <sys/time.h>
+
+#define TICK_BENCH_CALLS 200000
+
+/* 原来的custom_tick_get：两次gettimeofday加64位除法 */
+static uint32_t bench_gettimeofday(void)
+{
+    static uint64_t start_ms = 0;
+    if (start_ms == 0)
+    {
+        struct timeval tv_start;
+        gettimeofday(&tv_start, NULL);
+        start_ms = ((uint64_t)tv_start.tv_sec * 1000000 + (uint64_t)tv_start.tv_usec) / 1000;
+    }
+
+    struct timeval tv_now;
+    gettimeofday(&tv_now, NULL);
+    uint64_t now_ms = ((uint64_t)tv_now.tv_sec * 1000000 + (uint64_t)tv_now.tv_usec) / 1000;
+
+    return now_ms - start_ms;
+}
+
+static uint32_t bench_coarse_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (uint32_t)ts.tv_sec * 1000U + (uint32_t)ts.tv_nsec / 1000000U;
+}
+
+static uint32_t bench_us(void)
+{
+    return (uint32_t)tick_get_us();
+}
+
+static void bench_run(const char *name, uint32_t (*fn)(void))
+{
+    volatile uint32_t sink = 0;
+    uint64_t t0 = tick_get_us();
+
+    for (uint32_t i = 0; i < TICK_BENCH_CALLS; i++)
+        sink += fn();
+
+    uint64_t us = tick_get_us() - t0;
+    if (us == 0)
+        us = 1;
+    printf("[Tick] %-16s %8u calls/s, %4u ns/call\n", name,
+           (uint32_t)((uint64_t)TICK_BENCH_CALLS * 1000000 / us),
+           (uint32_t)(us * 1000 / TICK_BENCH_CALLS));
+    (void)sink;
+}
+
+/**
+ * @brief 微基准：对比原gettimeofday实现与各单调时钟接口
+ */
+void tick_benchmark(void)
+{
+    bench_run("gettimeofday", bench_gettimeofday);
+    bench_run("tick_get_ms", tick_get_ms);
+    bench_run("monotonic_coarse", bench_coarse_ms);
+    bench_run("tick_get_us", bench_us);
+}
+#endif
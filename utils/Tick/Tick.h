@@ -0,0 +1,40 @@
+#ifndef __TICK_H
+#define __TICK_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+/* 毫秒接口使用CLOCK_MONOTONIC_COARSE：读取更快，但分辨率只有一个jiffy（HZ=100时10ms） */
+#ifndef TICK_USE_COARSE
+#define TICK_USE_COARSE 0
+#endif
+
+/* 启动时打印各种取时方式每秒可调用次数 */
+#ifndef TICK_BENCHMARK
+#define TICK_BENCHMARK 0
+#endif
+
+    /**
+     * @brief 全局统一的单调时钟
+     *
+     * LVGL（custom_tick_get）、Model、smooth_ui_toolkit的Transition（update(tick_get_ms())）
+     * 以及各模块的耗时统计都从这里取时间，不受系统时间调整影响。
+     * 时间起点为系统启动，毫秒值为32位、约49.7天回绕一次，比较时用tick_elapsed_ms。
+     */
+    uint32_t tick_get_ms(void);
+    uint64_t tick_get_us(void);
+    uint32_t tick_elapsed_ms(uint32_t prev_ms);
+
+#if TICK_BENCHMARK
+    void tick_benchmark(void);
+#endif
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif